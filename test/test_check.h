@@ -0,0 +1,24 @@
+
+/* 测试程序中的检查项
+ *
+ * 与 assert() 相同，但不受 NDEBUG 影响，默认的 -DNDEBUG 构建下同样求值并检查，
+ * 因此表达式可以带有副作用，如 CHECK(0 == tls_connection_sendv(...))
+ */
+
+#ifndef TINYLIB_TEST_CHECK_H
+#define TINYLIB_TEST_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(expr) \
+    do \
+    { \
+        if (!(expr)) \
+        { \
+            fprintf(stderr, "%s:%d: %s: check `%s' failed\n", __FILE__, __LINE__, __func__, #expr); \
+            abort(); \
+        } \
+    } while (0)
+
+#endif /* !TINYLIB_TEST_CHECK_H */
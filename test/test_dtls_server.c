@@ -0,0 +1,266 @@
+
+/* dtls_server 的测试
+ *   1. 若干对端只发出 ClientHello，应收到 HelloVerifyRequest，且服务端不为其保留任何会话
+ *   2. 多个 DTLS 客户端同时保持会话，各自发送数据并校验服务端的回显，
+ *      再发送一个非 DTLS 报文(首字节 0x80，如 RTP)，应原样收到服务端的回送，最后以 close_notify 关闭
+ *
+ * usage: test_dtls_server <cert file> <key file>
+ */
+
+#include "tinylib/ssl/dtls_server.h"
+#include "tinylib/util/log.h"
+#include "test/test_check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+
+#define SPOOF_COUNT 32
+#define CLIENT_COUNT 100
+
+static loop_t *g_loop = NULL;
+static dtls_server_t *g_server = NULL;
+static int g_sessions = 0;
+static int g_closed = 0;
+static int g_raw = 0;
+
+static
+void session_onmessage(dtls_session_t *session, void *message, unsigned size, void *userdata)
+{
+    CHECK(0 == dtls_session_send(session, message, size));
+    return;
+}
+
+static
+void session_onraw(dtls_session_t *session, void *packet, unsigned size, void *userdata)
+{
+    g_raw++;
+    CHECK(0 == dtls_session_send_raw(session, packet, size));
+    return;
+}
+
+static
+void session_onclose(dtls_session_t *session, int normal, void *userdata)
+{
+    CHECK(normal);
+    g_closed++;
+    dtls_session_destroy(session);
+    return;
+}
+
+static
+void server_onsession(dtls_session_t *session, void *userdata, const inetaddr_t *peer_addr)
+{
+    g_sessions++;
+    dtls_session_setcallback(session, session_onmessage, session_onraw, session_onclose, NULL);
+    return;
+}
+
+static
+void check_no_state(void *userdata)
+{
+    printf("after %d spoofed ClientHellos: %u sessions\n", SPOOF_COUNT, dtls_server_session_count(g_server));
+    CHECK(0 == dtls_server_session_count(g_server));
+    CHECK(0 == g_sessions);
+    return;
+}
+
+static
+void check_done(void *userdata)
+{
+    printf("sessions: %d, closed: %d, raw packets: %d, remaining: %u\n",
+        g_sessions, g_closed, g_raw, dtls_server_session_count(g_server));
+    CHECK(CLIENT_COUNT == g_sessions);
+    CHECK(CLIENT_COUNT == g_closed);
+    CHECK(CLIENT_COUNT == g_raw);
+    CHECK(0 == dtls_server_session_count(g_server));
+
+    loop_quit(g_loop);
+    return;
+}
+
+static
+void finish(void *userdata)
+{
+    /* 等待最后的 close_notify 到达 */
+    loop_runafter(g_loop, 200, check_done, NULL);
+    return;
+}
+
+static
+int connect_server(struct sockaddr_in *addr)
+{
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    CHECK(0 == connect(fd, (struct sockaddr*)addr, sizeof(*addr)));
+
+    return fd;
+}
+
+/* 连接之后的 socket 需告知 BIO，否则其 sendto() 没有目的地址 */
+static
+SSL* new_client_ssl(SSL_CTX *ssl_ctx, int fd, struct sockaddr_in *addr)
+{
+    SSL *ssl;
+    BIO *bio;
+
+    ssl = SSL_new(ssl_ctx);
+    bio = BIO_new_dgram(fd, BIO_NOCLOSE);
+    BIO_ctrl(bio, BIO_CTRL_DGRAM_SET_CONNECTED, 0, addr);
+    SSL_set_bio(ssl, bio, bio);
+
+    return ssl;
+}
+
+/* 以内存 BIO 取得 ClientHello，直接由UDP发出，之后不再理会服务端的回应 */
+static
+void spoof_client(SSL_CTX *ssl_ctx, struct sockaddr_in *addr)
+{
+    unsigned char hello[2048];
+    unsigned char reply[2048];
+    struct pollfd pfd;
+    SSL *ssl;
+    BIO *out;
+    int fd;
+    int ret;
+
+    ssl = SSL_new(ssl_ctx);
+    out = BIO_new(BIO_s_mem());
+    SSL_set_bio(ssl, BIO_new(BIO_s_mem()), out);
+    SSL_set_options(ssl, SSL_OP_NO_QUERY_MTU);
+    DTLS_set_link_mtu(ssl, 1500);
+    ret = SSL_connect(ssl);
+    CHECK(ret < 0 && SSL_get_error(ssl, ret) == SSL_ERROR_WANT_READ);
+    ret = BIO_read(out, hello, sizeof(hello));
+    CHECK(ret > 0);
+
+    fd = connect_server(addr);
+    CHECK(ret == send(fd, hello, ret, 0));
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    CHECK(1 == poll(&pfd, 1, 1000));
+    ret = (int)recv(fd, reply, sizeof(reply), 0);
+    CHECK(ret > 13 && reply[0] == 22 && reply[13] == 3);
+
+    SSL_free(ssl);
+    close(fd);
+
+    return;
+}
+
+static
+void* client_entry(void *arg)
+{
+    struct sockaddr_in addr;
+    struct timeval timeout;
+    SSL_CTX *ssl_ctx;
+    SSL *ssls[CLIENT_COUNT];
+    int fds[CLIENT_COUNT];
+    char message[64];
+    char reply[64];
+    unsigned char raw[32];
+    int i;
+    int ret;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(dtls_server_getport(g_server));
+
+    ssl_ctx = SSL_CTX_new(DTLS_client_method());
+    CHECK(ssl_ctx);
+
+    for (i = 0; i < SPOOF_COUNT; ++i)
+    {
+        spoof_client(ssl_ctx, &addr);
+    }
+    loop_run_inloop(g_loop, check_no_state, NULL);
+
+    /* 全部会话同时保持，哈希表随之扩张 */
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+    for (i = 0; i < CLIENT_COUNT; ++i)
+    {
+        fds[i] = connect_server(&addr);
+        setsockopt(fds[i], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ssls[i] = new_client_ssl(ssl_ctx, fds[i], &addr);
+        CHECK(1 == SSL_connect(ssls[i]));
+    }
+
+    for (i = 0; i < CLIENT_COUNT; ++i)
+    {
+        snprintf(message, sizeof(message), "hello %d", i);
+        CHECK((int)strlen(message) == SSL_write(ssls[i], message, strlen(message)));
+        memset(reply, 0, sizeof(reply));
+        ret = SSL_read(ssls[i], reply, sizeof(reply) - 1);
+        CHECK(ret == (int)strlen(message) && 0 == strcmp(message, reply));
+
+        memset(raw, i, sizeof(raw));
+        raw[0] = 0x80;
+        CHECK(sizeof(raw) == send(fds[i], raw, sizeof(raw), 0));
+        CHECK(sizeof(raw) == recv(fds[i], reply, sizeof(reply), 0));
+        CHECK(0 == memcmp(raw, reply, sizeof(raw)));
+    }
+
+    for (i = 0; i < CLIENT_COUNT; ++i)
+    {
+        SSL_shutdown(ssls[i]);
+        SSL_free(ssls[i]);
+        close(fds[i]);
+    }
+    SSL_CTX_free(ssl_ctx);
+
+    loop_run_inloop(g_loop, finish, NULL);
+
+    return NULL;
+}
+
+static
+void on_timeout(void *userdata)
+{
+    printf("timed out\n");
+    CHECK(0);
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t thread;
+    loop_timer_t *timer;
+
+    if (argc < 3)
+    {
+        printf("usage: %s <cert file> <key file>\n", argv[0]);
+        return 0;
+    }
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    g_loop = loop_new(64);
+    g_server = dtls_server_new(g_loop, "127.0.0.1", 0, argv[1], argv[2], server_onsession, NULL);
+    CHECK(g_server);
+
+    pthread_create(&thread, NULL, client_entry, NULL);
+    timer = loop_runafter(g_loop, 20000, on_timeout, NULL);
+    loop_loop(g_loop);
+    loop_cancel(g_loop, timer);
+    pthread_join(thread, NULL);
+
+    dtls_server_destroy(g_server);
+    loop_destroy(g_loop);
+
+    printf("all checks passed\n");
+
+    return 0;
+}
@@ -1,15 +1,130 @@
 
+/* 本文件中的 log_debug() 在编译期即被去掉 */
+#define LOG_COMPILE_LEVEL 4
+
 #include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
+#include "test/test_check.h"
 
 #include <stdio.h>
-#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+static int g_printed = 0;
+static int g_evaluated = 0;
+
+static
+void count_print(log_level_e level, const char *file, int line, const char *fmt, va_list ap)
+{
+    g_printed++;
+    return;
+}
+
+static
+int evaluate(void)
+{
+    g_evaluated++;
+    return g_evaluated;
+}
+
+/* 以下的日志属于 net 模块 */
+#undef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_NET
+
+static
+void net_info(void)
+{
+    log_info("net info: %d", evaluate());
+    return;
+}
+
+#undef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_DEFAULT
+
+/* 日志时间的格式化与线程缓存 */
+static
+void check_time_format(void)
+{
+    char text[32];
+    unsigned long long ms;
+
+    CHECK(29 == time_format_gmt(text, 1408279020555ULL));
+    CHECK(0 == strcmp(text, "Sun, 17 Aug 2014 12:37:00 GMT"));
+
+    /* 同一秒内只改变毫秒 */
+    CHECK(23 == time_format_local(text, 1408279020555ULL));
+    CHECK(0 == strcmp(text + 19, ".555"));
+    CHECK(23 == time_format_local(text, 1408279020007ULL));
+    CHECK(0 == strcmp(text + 19, ".007"));
+    CHECK(23 == time_format_local(text, 1408279021999ULL));
+    CHECK(0 == strcmp(text + 17, "01.999"));
+
+    /* 刷新之后读取的都是缓存的时间，失效之后重新读取系统时间 */
+    time_cache_update();
+    ms = time_cache_now_ms();
+    usleep(20 * 1000);
+    CHECK(ms == time_cache_now_ms());
+    time_cache_invalidate();
+    CHECK(time_cache_now_ms() >= ms + 20);
+
+    return;
+}
 
 int main(int argc, char const *argv[])
 {
+    int i;
+
+    check_time_format();
+
     log_warn("log_warn: arg: %s, number: %d, ratio: %f", "info", 4, 0.53);
     log_error("log_error: arg: %s", "error");
     log_log("log_log: arg: %s", "log");
     log_warn("this text will not be displayed");
-    
+
+    /* 未设置过级别时，指定输出函数即放开全部级别 */
+    log_init(count_print);
+    CHECK(LOG_LEVEL_DEBUG == log_getlevel(LOG_MODULE_NET));
+
+    /* 级别之外的日志不求值参数，也不进入输出函数 */
+    log_setlevel(LOG_LEVEL_WARN);
+    log_info("info: %d", evaluate());
+    CHECK(0 == g_evaluated && 0 == g_printed);
+    log_warn("warn: %d", evaluate());
+    CHECK(1 == g_evaluated && 1 == g_printed);
+
+    /* 编译期去掉的 debug 日志，即使运行时放开级别也不会输出 */
+    log_setlevel(LOG_LEVEL_DEBUG);
+    log_debug("debug: %d", evaluate());
+    CHECK(1 == g_evaluated && 1 == g_printed);
+
+    /* 模块的级别互不影响 */
+    log_setlevel(LOG_LEVEL_WARN);
+    log_setmodulelevel(LOG_MODULE_NET, LOG_LEVEL_INFO);
+    CHECK(LOG_LEVEL_INFO == log_getlevel(LOG_MODULE_NET));
+    CHECK(LOG_LEVEL_WARN == log_getlevel(LOG_MODULE_RTSP));
+    net_info();
+    CHECK(2 == g_evaluated && 2 == g_printed);
+    log_info("info: %d", evaluate());
+    CHECK(2 == g_evaluated && 2 == g_printed);
+
+    /* 已显式设置的级别不被 log_init() 覆盖 */
+    log_init(count_print);
+    CHECK(LOG_LEVEL_INFO == log_getlevel(LOG_MODULE_NET));
+    CHECK(LOG_LEVEL_WARN == log_getlevel(LOG_MODULE_RTSP));
+
+    /* 限频: 一个间隔内只输出一次，下一次输出之前先报告被抑制的条数 */
+    g_printed = 0;
+    for (i = 0; i < 1000; ++i)
+    {
+        log_error_ratelimit(100, "ratelimited error: %d", i);
+    }
+    CHECK(1 == g_printed);
+    usleep(150 * 1000);
+    log_error_ratelimit(100, "ratelimited error again");
+    log_error_ratelimit(100, "ratelimited error again");
+    CHECK(3 == g_printed);
+
+    printf("all checks passed\n");
+
     return 0;
 }
@@ -0,0 +1,321 @@
+
+/* 异步日志的测试
+ *   1. 阻塞策略: 多个线程同时输出，按尺寸滚动之后各个文件合起来应不丢、且每个线程内保持顺序
+ *   2. 丢弃策略: 缓冲区很小时，写出的条数与丢弃的条数之和应等于输出的条数
+ *   3. 崩溃时缓冲区中尚未写出的日志应被写出
+ *   4. 同步与异步输出时调用线程上每条日志的耗时
+ *
+ * usage: test_log_async [log file]
+ */
+
+#include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
+#include "test/test_check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define THREAD_COUNT 4
+#define LINES_PER_THREAD 20000
+#define ROTATE_KEEP 16
+#define DROP_LINES 10000
+#define BENCH_LINES 100000
+
+static const char *g_file = "/tmp/test_log_async.log";
+
+static
+void remove_files(void)
+{
+    char name[512];
+    int i;
+
+    unlink(g_file);
+    for (i = 1; i <= ROTATE_KEEP; ++i)
+    {
+        snprintf(name, sizeof(name), "%s.%d", g_file, i);
+        unlink(name);
+    }
+
+    return;
+}
+
+static
+void* worker_entry(void *arg)
+{
+    long id = (long)arg;
+    int i;
+
+    for (i = 0; i < LINES_PER_THREAD; ++i)
+    {
+        log_info("worker %ld seq %d", id, i);
+    }
+
+    return NULL;
+}
+
+/* 从最旧的文件读起，统计每个线程的行数并校验顺序 */
+static
+void check_rotated_files(void)
+{
+    char name[512];
+    char line[2048];
+    int next[THREAD_COUNT];
+    int files = 0;
+    FILE *fp;
+    char *pos;
+    long id;
+    int seq;
+    int i;
+
+    memset(next, 0, sizeof(next));
+    for (i = ROTATE_KEEP; i >= 0; --i)
+    {
+        if (i > 0)
+        {
+            snprintf(name, sizeof(name), "%s.%d", g_file, i);
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "%s", g_file);
+        }
+        fp = fopen(name, "r");
+        if (NULL == fp)
+        {
+            continue;
+        }
+        files++;
+
+        while (fgets(line, sizeof(line), fp))
+        {
+            pos = strstr(line, "worker ");
+            if (NULL == pos)
+            {
+                continue;
+            }
+            CHECK(2 == sscanf(pos, "worker %ld seq %d", &id, &seq));
+            CHECK(id >= 0 && id < THREAD_COUNT);
+            CHECK(seq == next[id]);
+            next[id]++;
+        }
+        fclose(fp);
+    }
+
+    printf("block: %d files after rotation, ", files);
+    for (i = 0; i < THREAD_COUNT; ++i)
+    {
+        printf("%d ", next[i]);
+        CHECK(LINES_PER_THREAD == next[i]);
+    }
+    printf("lines per thread\n");
+    CHECK(files > 1);
+
+    return;
+}
+
+static
+void test_block(void)
+{
+    log_async_config_t config;
+    pthread_t threads[THREAD_COUNT];
+    long i;
+
+    remove_files();
+
+    memset(&config, 0, sizeof(config));
+    config.file = g_file;
+    config.ring_size = 16 * 1024;
+    config.rotate_size = 1024 * 1024;
+    config.rotate_keep = ROTATE_KEEP;
+    config.overflow = LOG_OVERFLOW_BLOCK;
+    CHECK(0 == log_async_start(&config));
+    CHECK(-1 == log_async_start(&config));
+
+    for (i = 0; i < THREAD_COUNT; ++i)
+    {
+        pthread_create(&threads[i], NULL, worker_entry, (void*)i);
+    }
+    for (i = 0; i < THREAD_COUNT; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    log_async_flush();
+    log_async_stop();
+
+    CHECK(0 == log_async_dropped());
+    check_rotated_files();
+
+    return;
+}
+
+static
+void* drop_entry(void *arg)
+{
+    int i;
+
+    for (i = 0; i < DROP_LINES; ++i)
+    {
+        log_info("drop seq %d", i);
+    }
+
+    return NULL;
+}
+
+static
+void test_drop(void)
+{
+    log_async_config_t config;
+    pthread_t thread;
+    char line[2048];
+    int written = 0;
+    FILE *fp;
+
+    remove_files();
+
+    memset(&config, 0, sizeof(config));
+    config.file = g_file;
+    config.ring_size = 4096;
+    config.flush_interval = 1000;
+    config.overflow = LOG_OVERFLOW_DROP;
+    CHECK(0 == log_async_start(&config));
+
+    /* 新线程才会按新的尺寸建立缓冲区 */
+    pthread_create(&thread, NULL, drop_entry, NULL);
+    pthread_join(thread, NULL);
+    log_async_stop();
+
+    fp = fopen(g_file, "r");
+    CHECK(fp);
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strstr(line, "drop seq "))
+        {
+            written++;
+        }
+    }
+    fclose(fp);
+
+    printf("drop: %d written, %llu dropped\n", written, log_async_dropped());
+    CHECK(written + log_async_dropped() == DROP_LINES);
+
+    return;
+}
+
+static
+void test_crash(void)
+{
+    log_async_config_t config;
+    char line[2048];
+    int found = 0;
+    int status;
+    pid_t pid;
+    FILE *fp;
+
+    remove_files();
+
+    pid = fork();
+    CHECK(pid >= 0);
+    if (0 == pid)
+    {
+        memset(&config, 0, sizeof(config));
+        config.file = g_file;
+        config.flush_interval = 60000;
+        config.crash_flush = 1;
+        CHECK(0 == log_async_start(&config));
+
+        log_error("last words before crash");
+        raise(SIGSEGV);
+        _exit(0);
+    }
+
+    CHECK(pid == waitpid(pid, &status, 0));
+    CHECK(WIFSIGNALED(status) && SIGSEGV == WTERMSIG(status));
+
+    fp = fopen(g_file, "r");
+    CHECK(fp);
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strstr(line, "last words before crash"))
+        {
+            found = 1;
+        }
+    }
+    fclose(fp);
+
+    printf("crash: buffered line %s\n", found ? "flushed" : "lost");
+    CHECK(found);
+
+    return;
+}
+
+static
+unsigned long long now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static
+void bench(void)
+{
+    log_async_config_t config;
+    unsigned long long start;
+    unsigned long long sync_cost;
+    unsigned long long async_cost;
+    int i;
+
+    remove_files();
+
+    log_file(g_file);
+    start = now_us();
+    for (i = 0; i < BENCH_LINES; ++i)
+    {
+        log_info("bench seq %d, some payload %s", i, "0123456789abcdef");
+    }
+    sync_cost = now_us() - start;
+
+    memset(&config, 0, sizeof(config));
+    config.file = g_file;
+    config.ring_size = 1024 * 1024;
+    config.overflow = LOG_OVERFLOW_BLOCK;
+    CHECK(0 == log_async_start(&config));
+    start = now_us();
+    for (i = 0; i < BENCH_LINES; ++i)
+    {
+        log_info("bench seq %d, some payload %s", i, "0123456789abcdef");
+    }
+    async_cost = now_us() - start;
+    log_async_stop();
+
+    printf("bench: sync %llu ns/line, async %llu ns/line on the calling thread\n",
+        sync_cost * 1000 / BENCH_LINES, async_cost * 1000 / BENCH_LINES);
+
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+    {
+        g_file = argv[1];
+    }
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    test_block();
+    test_drop();
+    test_crash();
+    bench();
+
+    remove_files();
+    printf("all checks passed\n");
+
+    return 0;
+}
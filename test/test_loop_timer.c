@@ -6,6 +6,7 @@
 #endif
 
 #include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
 
 #include <time.h>
 #include <stdio.h>
@@ -13,6 +14,7 @@
 #include <assert.h>
 
 static loop_t *g_loop = NULL;
+static unsigned long long g_expire2_next = 0;
 
 static 
 void onexpire1(void* userdata)
@@ -25,7 +27,16 @@ void onexpire1(void* userdata)
 static 
 void onexpire2(void* userdata)
 {
-    log_info("onexpire2");
+    unsigned long long now;
+
+    /* 回调中读取的是本轮迭代缓存的时间，不晚于当前的单调时间 */
+    now = loop_now_ms(g_loop);
+    assert(now == loop_now_ms(g_loop));
+    assert(now <= ts_ms());
+    assert(now >= g_expire2_next);
+
+    log_info("onexpire2, %llu ms late", now - g_expire2_next);
+    g_expire2_next += 20;
 
     return;
 }
@@ -37,8 +48,13 @@ int main(int argc, char const *argv[])
 
     g_loop = loop_new(1);
     assert(g_loop);
+    if (argc > 1)
+    {
+        loop_usecoarseclock(g_loop, 1);
+    }
 
     timer1 = loop_runevery(g_loop, 67, onexpire1, &timer1);
+    g_expire2_next = loop_now_ms(g_loop) + 20;
     timer2 = loop_runevery(g_loop, 20, onexpire2, &timer2);
 
     loop_loop(g_loop);
@@ -0,0 +1,341 @@
+
+/* 运行指标的测试
+ *   1. 直方图的分桶精度及合并
+ *   2. 在一个 loop 中跑 tcp 回显、udp 收发、timer 及跨线程的异步任务，检查 loop_getmetrics() 的各项计数
+ *   3. 其他线程中的 udp 发送计入该线程，metrics_collect() 汇总全部线程，loop 线程退出之后计数仍保留在汇总中
+ */
+
+#include "tinylib/net/tcp_server.h"
+#include "tinylib/net/tcp_client.h"
+#include "tinylib/net/udp_peer.h"
+#include "tinylib/util/metrics.h"
+#include "tinylib/util/util.h"
+#include "tinylib/util/log.h"
+#include "test/test_check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define TCP_PORT 15391
+#define UDP_PORT 15392
+#define PAYLOAD_SIZE (64*1024)
+#define UDP_PACKETS 100
+#define UDP_PACKETS_FOREIGN 10
+#define UDP_PACKET_SIZE 100
+#define ASYNC_TASKS 1000
+#define TIMER_TIMES 5
+
+static loop_t *g_loop = NULL;
+static tcp_server_t *g_server = NULL;
+static tcp_client_t *g_client = NULL;
+static udp_peer_t *g_receiver = NULL;
+static udp_peer_t *g_sender = NULL;
+static loop_timer_t *g_timer = NULL;
+
+static volatile unsigned g_tcp_received = 0;
+static volatile unsigned g_udp_received = 0;
+static volatile unsigned g_async_done = 0;
+static volatile unsigned g_timer_times = 0;
+
+static
+void check_histogram(void)
+{
+    histogram_t histogram;
+    histogram_t other;
+    unsigned long long value;
+    unsigned long long p;
+
+    histogram_reset(&histogram);
+    CHECK(0 == histogram_percentile(&histogram, 50));
+
+    for (value = 1; value <= 10000; ++value)
+    {
+        histogram_record(&histogram, value);
+    }
+    CHECK(10000 == histogram.count);
+    CHECK(1 == histogram.min && 10000 == histogram.max);
+
+    /* 桶的上界与真实值的相对误差不超过 1/8 */
+    p = histogram_percentile(&histogram, 50);
+    CHECK(p >= 5000 && p <= 5000 + 5000 / 8);
+    p = histogram_percentile(&histogram, 99);
+    CHECK(p >= 9900 && p <= 10000);
+    CHECK(1 == histogram_percentile(&histogram, 0));
+    CHECK(10000 == histogram_percentile(&histogram, 100));
+
+    /* 小于16的值精确记录，超出范围的值计入最后一个桶 */
+    histogram_reset(&other);
+    histogram_record(&other, 7);
+    CHECK(7 == histogram_percentile(&other, 50));
+    histogram_record(&other, ~0ULL);
+    CHECK(~0ULL == histogram_percentile(&other, 100));
+    CHECK(1 == other.buckets[HISTOGRAM_BUCKETS - 1]);
+
+    histogram_merge(&histogram, &other);
+    CHECK(10002 == histogram.count);
+    CHECK(1 == histogram.min && ~0ULL == histogram.max);
+
+    printf("histogram: p50 %llu, p99 %llu of 1..10000\n", histogram_percentile(&histogram, 50), histogram_percentile(&histogram, 99));
+
+    return;
+}
+
+static
+void server_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    tcp_connection_send(connection, buffer_peek(buffer), buffer_readablebytes(buffer));
+    buffer_retrieveall(buffer);
+    return;
+}
+
+static
+void server_onclose(tcp_connection_t* connection, void* userdata)
+{
+    tcp_connection_destroy(connection);
+    return;
+}
+
+static
+void server_onconnection(tcp_connection_t* connection, void* userdata, const inetaddr_t* peer_addr)
+{
+    tcp_connection_setcalback(connection, server_ondata, server_onclose, NULL);
+    return;
+}
+
+static
+void client_onconnected(tcp_connection_t* connection, void *userdata)
+{
+    char *payload;
+
+    CHECK(connection);
+    payload = (char*)malloc(PAYLOAD_SIZE);
+    memset(payload, 'x', PAYLOAD_SIZE);
+    tcp_connection_send(connection, payload, PAYLOAD_SIZE);
+    free(payload);
+
+    return;
+}
+
+static
+void client_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    g_tcp_received += buffer_readablebytes(buffer);
+    buffer_retrieveall(buffer);
+    return;
+}
+
+static
+void client_onclose(tcp_connection_t* connection, void* userdata)
+{
+    return;
+}
+
+static
+void receiver_onmessage(udp_peer_t *peer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    CHECK(UDP_PACKET_SIZE == size);
+    g_udp_received++;
+    return;
+}
+
+static
+void onexpire(void *userdata)
+{
+    g_timer_times++;
+    if (TIMER_TIMES == g_timer_times)
+    {
+        loop_cancel(g_loop, g_timer);
+    }
+
+    return;
+}
+
+static
+void async_task(void *userdata)
+{
+    g_async_done++;
+    return;
+}
+
+static
+void setup(void *userdata)
+{
+    char message[UDP_PACKET_SIZE];
+    inetaddr_t addr;
+    int i;
+
+    g_server = tcp_server_new(g_loop, server_onconnection, NULL, TCP_PORT, "127.0.0.1");
+    CHECK(g_server && 0 == tcp_server_start(g_server));
+    g_client = tcp_client_new(g_loop, "127.0.0.1", TCP_PORT, client_onconnected, client_ondata, client_onclose, NULL);
+    CHECK(g_client && 0 == tcp_client_connect(g_client));
+
+    g_receiver = udp_peer_new(g_loop, "127.0.0.1", UDP_PORT, receiver_onmessage, NULL, NULL);
+    g_sender = udp_peer_new(g_loop, "127.0.0.1", 0, receiver_onmessage, NULL, NULL);
+    CHECK(g_receiver && g_sender);
+    memset(message, 'u', sizeof(message));
+    inetaddr_initbyipport(&addr, "127.0.0.1", UDP_PORT);
+    for (i = 0; i < UDP_PACKETS; ++i)
+    {
+        CHECK(0 == udp_peer_send(g_sender, message, sizeof(message), &addr));
+    }
+
+    g_timer = loop_runevery(g_loop, 10, onexpire, NULL);
+
+    return;
+}
+
+static
+void quit(void *userdata)
+{
+    loop_quit(g_loop);
+    return;
+}
+
+static
+void teardown(void *userdata)
+{
+    tcp_client_destroy(g_client);
+    tcp_server_destroy(g_server);
+    udp_peer_destroy(g_receiver);
+    udp_peer_destroy(g_sender);
+
+    /* 等待服务端的连接收到关闭 */
+    loop_runafter(g_loop, 50, quit, NULL);
+
+    return;
+}
+
+static
+void* loop_entry(void *arg)
+{
+    loop_loop(g_loop);
+    return NULL;
+}
+
+static
+void wait_for(volatile unsigned *value, unsigned expected)
+{
+    int i;
+
+    for (i = 0; i < 500 && *value < expected; ++i)
+    {
+        usleep(10 * 1000);
+    }
+    CHECK(*value == expected);
+
+    return;
+}
+
+static
+void print_histogram(const char *name, const histogram_t *histogram)
+{
+    printf("  %-20s count %llu, p50 %llu, p99 %llu, max %llu\n", name, histogram->count,
+        histogram_percentile(histogram, 50), histogram_percentile(histogram, 99), histogram->max);
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t thread;
+    metrics_t metrics;
+    metrics_t total;
+    char message[UDP_PACKET_SIZE];
+    inetaddr_t addr;
+    int i;
+
+    log_setlevel(LOG_LEVEL_WARN);
+    check_histogram();
+
+    g_loop = loop_new(64);
+    CHECK(g_loop);
+    CHECK(-1 == loop_getmetrics(g_loop, &metrics));
+
+    pthread_create(&thread, NULL, loop_entry, NULL);
+    loop_async(g_loop, setup, NULL);
+    for (i = 0; i < ASYNC_TASKS; ++i)
+    {
+        loop_async(g_loop, async_task, NULL);
+    }
+
+    wait_for(&g_tcp_received, PAYLOAD_SIZE);
+    wait_for(&g_udp_received, UDP_PACKETS);
+    wait_for(&g_async_done, ASYNC_TASKS);
+    wait_for(&g_timer_times, TIMER_TIMES);
+
+    /* 本线程直接发送的 udp 报文计入本线程，不计入 loop 线程 */
+    memset(message, 'u', sizeof(message));
+    inetaddr_initbyipport(&addr, "127.0.0.1", UDP_PORT);
+    for (i = 0; i < UDP_PACKETS_FOREIGN; ++i)
+    {
+        CHECK(0 == udp_peer_send(g_sender, message, sizeof(message), &addr));
+    }
+    wait_for(&g_udp_received, UDP_PACKETS + UDP_PACKETS_FOREIGN);
+
+    CHECK(0 == loop_getmetrics(g_loop, &metrics));
+    printf("loop: %llu iterations, %llu events\n", metrics.loop_iterations, metrics.loop_events);
+    print_histogram("wakeup events", &metrics.loop_wakeup_events);
+    print_histogram("iteration us", &metrics.loop_iteration_us);
+    print_histogram("callback us", &metrics.loop_callback_us);
+    print_histogram("timer lag us", &metrics.timer_lag_us);
+    print_histogram("async depth", &metrics.async_depth);
+    print_histogram("async latency us", &metrics.async_latency_us);
+    printf("tcp: %llu accepts, %llu connects, in %llu bytes/%llu reads, out %llu bytes/%llu writes, buffer max in %llu out %llu\n",
+        metrics.tcp_accepts, metrics.tcp_connects, metrics.tcp_bytes_in, metrics.tcp_reads, metrics.tcp_bytes_out, metrics.tcp_writes,
+        metrics.tcp_in_buffer_max, metrics.tcp_out_buffer_max);
+    printf("udp: in %llu packets/%llu bytes, out %llu packets/%llu bytes\n",
+        metrics.udp_packets_in, metrics.udp_bytes_in, metrics.udp_packets_out, metrics.udp_bytes_out);
+
+    CHECK(metrics.loop_iterations > 0 && metrics.loop_events > 0);
+    CHECK(metrics.loop_iterations == metrics.loop_wakeup_events.count);
+    CHECK(metrics.loop_events == metrics.loop_wakeup_events.sum);
+  #if METRICS_TIMING
+    CHECK(metrics.loop_iterations >= metrics.loop_iteration_us.count);
+    CHECK(metrics.loop_events == metrics.loop_callback_us.count);
+  #else
+    CHECK(0 == metrics.loop_iteration_us.count && 0 == metrics.loop_callback_us.count);
+  #endif
+    CHECK(0 != metrics.loop_heartbeat_ms && ts_ms() - metrics.loop_heartbeat_ms < 1000);
+
+    CHECK(TIMER_TIMES == metrics.timer_expired && TIMER_TIMES == metrics.timer_lag_us.count);
+    CHECK(metrics.async_tasks >= ASYNC_TASKS + 1);
+  #if METRICS_TIMING
+    CHECK(metrics.async_tasks == metrics.async_latency_us.count);
+  #else
+    CHECK(0 == metrics.async_latency_us.count);
+  #endif
+    CHECK(metrics.async_tasks == metrics.async_depth.sum);
+
+    /* 服务端与客户端在同一个 loop 中，回显的数据收发各两次 */
+    CHECK(1 == metrics.tcp_accepts && 1 == metrics.tcp_connects);
+    CHECK(2 * PAYLOAD_SIZE == metrics.tcp_bytes_in && 2 * PAYLOAD_SIZE == metrics.tcp_bytes_out);
+    CHECK(metrics.tcp_reads > 0 && metrics.tcp_writes > 0);
+    CHECK(metrics.tcp_in_buffer_max > 0 && metrics.tcp_in_buffer_max <= PAYLOAD_SIZE);
+
+    CHECK(UDP_PACKETS + UDP_PACKETS_FOREIGN == metrics.udp_packets_in);
+    CHECK((UDP_PACKETS + UDP_PACKETS_FOREIGN) * UDP_PACKET_SIZE == metrics.udp_bytes_in);
+    CHECK(UDP_PACKETS == metrics.udp_packets_out);
+
+    metrics_collect(&total);
+    CHECK(UDP_PACKETS + UDP_PACKETS_FOREIGN == total.udp_packets_out);
+    CHECK(total.loop_iterations >= metrics.loop_iterations);
+
+    /* loop 线程退出之后，其计数并入汇总，心跳清零 */
+    loop_async(g_loop, teardown, NULL);
+    pthread_join(thread, NULL);
+    CHECK(-1 == loop_getmetrics(g_loop, &metrics));
+
+    metrics_collect(&total);
+    CHECK(1 == total.tcp_accepts && 1 == total.tcp_connects);
+    CHECK(2 * PAYLOAD_SIZE == total.tcp_bytes_in);
+    CHECK(UDP_PACKETS + UDP_PACKETS_FOREIGN == total.udp_packets_in);
+    CHECK(0 == total.loop_heartbeat_ms);
+
+    loop_destroy(g_loop);
+
+    printf("all checks passed\n");
+
+    return 0;
+}
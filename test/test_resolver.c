@@ -0,0 +1,246 @@
+
+#include "tinylib/net/resolver.h"
+#include "tinylib/net/udp_peer.h"
+#include "tinylib/net/tcp_server.h"
+#include "tinylib/net/tcp_client.h"
+#include "tinylib/util/log.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+/* 本地模拟的 DNS 服务器: test.local -> 127.0.0.1/::1, multi.local -> 127.0.0.2, 127.0.0.1，其余均返回 NXDOMAIN */
+#define DNS_PORT 15353
+#define TCP_PORT 15354
+
+static loop_t *g_loop;
+static udp_peer_t *g_dns_server;
+static resolver_t *g_resolver;
+static tcp_server_t *g_tcp_server;
+static tcp_client_t *g_tcp_client;
+static int g_dns_hits = 0;
+static int g_step = 0;
+
+static
+unsigned append_answer(unsigned char *packet, unsigned offset, unsigned short type, const unsigned char *rdata, unsigned rdlen)
+{
+    packet[offset++] = 0xc0;  /* 指向问题部分中的名字 */
+    packet[offset++] = 12;
+    packet[offset++] = 0;
+    packet[offset++] = (unsigned char)type;
+    packet[offset++] = 0;
+    packet[offset++] = 1;
+    packet[offset++] = 0;
+    packet[offset++] = 0;
+    packet[offset++] = 0;
+    packet[offset++] = 60;
+    packet[offset++] = 0;
+    packet[offset++] = (unsigned char)rdlen;
+    memcpy(packet+offset, rdata, rdlen);
+
+    return offset + rdlen;
+}
+
+static
+void dns_server_onmessage(udp_peer_t *peer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    static const unsigned char localhost4[4] = {127, 0, 0, 1};
+    static const unsigned char localhost4_2[4] = {127, 0, 0, 2};
+    static const unsigned char localhost6[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+
+    unsigned char packet[512];
+    char name[256];
+    unsigned name_len;
+    unsigned offset;
+    unsigned short type;
+    unsigned ancount;
+
+    if (size < 17 || size > sizeof(packet))
+    {
+        return;
+    }
+    memcpy(packet, message, size);
+    g_dns_hits++;
+
+    name_len = 0;
+    offset = 12;
+    while (packet[offset] != 0 && offset < size)
+    {
+        if (name_len > 0)
+        {
+            name[name_len++] = '.';
+        }
+        memcpy(name+name_len, packet+offset+1, packet[offset]);
+        name_len += packet[offset];
+        offset += packet[offset] + 1;
+    }
+    name[name_len] = '\0';
+    offset++;
+    type = (unsigned short)((packet[offset] << 8) | packet[offset+1]);
+    offset += 4;
+
+    ancount = 0;
+    if (strcmp(name, "test.local") == 0 && type == 1)
+    {
+        offset = append_answer(packet, offset, type, localhost4, 4);
+        ancount = 1;
+    }
+    else if (strcmp(name, "test.local") == 0 && type == 28)
+    {
+        offset = append_answer(packet, offset, type, localhost6, 16);
+        ancount = 1;
+    }
+    else if (strcmp(name, "multi.local") == 0 && type == 1)
+    {
+        offset = append_answer(packet, offset, type, localhost4_2, 4);
+        offset = append_answer(packet, offset, type, localhost4, 4);
+        ancount = 2;
+    }
+
+    packet[2] = 0x81;
+    packet[3] = (ancount > 0) ? 0x80 : 0x83;
+    packet[7] = (unsigned char)ancount;
+
+    udp_peer_send(peer, packet, offset, peer_addr);
+
+    return;
+}
+
+static void next_step(void);
+
+static
+void on_resolved(const char *name, const resolver_addr_t *addrs, int count, void *userdata)
+{
+    int i;
+
+    printf("step %d: %s resolved to %d address(es), dns hits: %d\n", g_step, name, count, g_dns_hits);
+    for (i = 0; i < count; ++i)
+    {
+        printf("    %s %s\n", (addrs[i].family == AF_INET ? "A   " : "AAAA"), addrs[i].ip);
+    }
+
+    next_step();
+
+    return;
+}
+
+static
+void client_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    return;
+}
+
+static
+void client_onclose(tcp_connection_t* connection, void* userdata)
+{
+    return;
+}
+
+static
+void client_onconnected(tcp_connection_t* connection, void *userdata)
+{
+    if (NULL == connection)
+    {
+        printf("step %d: tcp_client failed to connect multi.local\n", g_step);
+    }
+    else
+    {
+        printf("step %d: tcp_client connected to multi.local at %s:%u\n", g_step,
+            tcp_connection_getpeeraddr(connection)->ip, tcp_connection_getpeeraddr(connection)->port);
+    }
+
+    loop_quit(g_loop);
+
+    return;
+}
+
+static
+void server_onconnection(tcp_connection_t* connection, void* userdata, const inetaddr_t* peer_addr)
+{
+    tcp_connection_destroy(connection);
+    return;
+}
+
+static
+void next_step(void)
+{
+    g_step++;
+
+    switch (g_step)
+    {
+        case 1:
+        {
+            resolver_resolve(g_resolver, "test.local", AF_INET, on_resolved, NULL);
+            break;
+        }
+        case 2:
+        {
+            /* 命中缓存，不会再访问服务器 */
+            resolver_resolve(g_resolver, "TEST.local.", AF_INET, on_resolved, NULL);
+            break;
+        }
+        case 3:
+        {
+            resolver_resolve(g_resolver, "test.local", AF_UNSPEC, on_resolved, NULL);
+            break;
+        }
+        case 4:
+        {
+            resolver_resolve(g_resolver, "nonexist.local", AF_INET, on_resolved, NULL);
+            break;
+        }
+        case 5:
+        {
+            resolver_resolve(g_resolver, "127.0.0.1", AF_INET, on_resolved, NULL);
+            break;
+        }
+        case 6:
+        {
+            /* 127.0.0.2 上无监听，连接失败后自动尝试 127.0.0.1 */
+            g_tcp_client = tcp_client_new(g_loop, "multi.local", TCP_PORT, client_onconnected, client_ondata, client_onclose, NULL);
+            tcp_client_set_resolver(g_tcp_client, g_resolver);
+            tcp_client_connect(g_tcp_client);
+            break;
+        }
+        default:
+        {
+            loop_quit(g_loop);
+            break;
+        }
+    }
+
+    return;
+}
+
+static
+void start(void *userdata)
+{
+    next_step();
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    log_setlevel(LOG_LEVEL_INFO);
+
+    g_loop = loop_new(64);
+
+    g_dns_server = udp_peer_new(g_loop, "127.0.0.1", DNS_PORT, dns_server_onmessage, NULL, NULL);
+    g_tcp_server = tcp_server_new(g_loop, server_onconnection, NULL, TCP_PORT, "127.0.0.1");
+    tcp_server_start(g_tcp_server);
+
+    g_resolver = resolver_new(g_loop, "127.0.0.1", DNS_PORT);
+    resolver_set_timeout(g_resolver, 500, 1);
+
+    loop_async(g_loop, start, NULL);
+    loop_loop(g_loop);
+
+    tcp_client_destroy(g_tcp_client);
+    resolver_destroy(g_resolver);
+    tcp_server_destroy(g_tcp_server);
+    udp_peer_destroy(g_dns_server);
+    loop_destroy(g_loop);
+
+    return 0;
+}
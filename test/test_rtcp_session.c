@@ -0,0 +1,188 @@
+
+/* rtcp_session 的测试
+ * 两个 rtp_peer 经由本机 UDP 互连，A 发送 RTP(每10个序号丢弃1个)，B 只接收
+ * 双方的 rtcp_session 定时交换 SR/RR，最后检查 B 统计的丢包、A 收到的报告及往返时延，以及 BYE
+ */
+
+#include "tinylib/rtp/rtp_peer.h"
+#include "tinylib/rtp/rtcp_session.h"
+#include "tinylib/util/log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define SEND_INTERVAL 10
+#define LOSS_PERIOD 10
+#define TOTAL_PACKETS 150
+
+struct endpoint
+{
+    const char *name;
+    rtp_peer_t *peer;
+    rtcp_session_t *session;
+    inetaddr_t remote_rtp;
+    inetaddr_t remote_rtcp;
+};
+
+static loop_t *g_loop = NULL;
+static struct endpoint g_a;
+static struct endpoint g_b;
+static uint16_t g_seq = 0;
+static int g_sent = 0;
+
+static
+void onrtp(udp_peer_t *peer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    return;
+}
+
+static
+void onrtcp(udp_peer_t *peer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    struct endpoint *endpoint = (struct endpoint*)userdata;
+
+    printf("%s: rtcp %u bytes, first type %u\n", endpoint->name, size, ((unsigned char*)message)[1]);
+    return;
+}
+
+static
+void send_rtcp(rtcp_session_t *session, const void *packet, unsigned size, void *userdata)
+{
+    struct endpoint *endpoint = (struct endpoint*)userdata;
+
+    udp_peer_send(rtp_peer_get_rtcp_udppeer(endpoint->peer), packet, size, &endpoint->remote_rtcp);
+    return;
+}
+
+static
+void endpoint_init(struct endpoint *endpoint, const char *name)
+{
+    memset(endpoint, 0, sizeof(*endpoint));
+    endpoint->name = name;
+    endpoint->peer = rtp_peer_alloc(g_loop, "127.0.0.1", onrtp, NULL, onrtcp, NULL, endpoint);
+    assert(endpoint->peer);
+    endpoint->session = rtcp_session_new(g_loop, 0, name, 90000, send_rtcp, endpoint);
+    assert(endpoint->session);
+    rtcp_session_set_min_interval(endpoint->session, 200);
+    rtp_peer_set_rtcp_session(endpoint->peer, endpoint->session);
+
+    return;
+}
+
+static
+void send_rtp(void *userdata)
+{
+    unsigned char packet[172];
+    uint32_t ssrc;
+    uint32_t ts;
+
+    if (g_sent >= TOTAL_PACKETS)
+    {
+        return;
+    }
+
+    memset(packet, 0, sizeof(packet));
+    ssrc = rtcp_session_get_ssrc(g_a.session);
+    ts = g_seq * 900;
+    packet[0] = 0x80;
+    packet[1] = 96;
+    packet[2] = (unsigned char)(g_seq >> 8);
+    packet[3] = (unsigned char)(g_seq & 0xff);
+    packet[4] = (unsigned char)(ts >> 24);
+    packet[5] = (unsigned char)(ts >> 16);
+    packet[6] = (unsigned char)(ts >> 8);
+    packet[7] = (unsigned char)(ts & 0xff);
+    packet[8] = (unsigned char)(ssrc >> 24);
+    packet[9] = (unsigned char)(ssrc >> 16);
+    packet[10] = (unsigned char)(ssrc >> 8);
+    packet[11] = (unsigned char)(ssrc & 0xff);
+
+    /* 模拟网络丢包: 序号照常递增，但不发出 */
+    if (LOSS_PERIOD / 2 != g_seq % LOSS_PERIOD)
+    {
+        udp_peer_send(rtp_peer_get_rtp_udppeer(g_a.peer), packet, sizeof(packet), &g_a.remote_rtp);
+        rtcp_session_on_rtp_sent(g_a.session, packet, sizeof(packet));
+    }
+    g_seq++;
+    g_sent++;
+
+    return;
+}
+
+static
+void send_bye(void *userdata)
+{
+    rtcp_session_bye(g_a.session);
+    return;
+}
+
+static
+void quit(void *userdata)
+{
+    loop_quit(g_loop);
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    rtcp_session_stats_t stats;
+    rtcp_source_stats_t source;
+    uint32_t ssrcs[4];
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+    g_loop = loop_new(64);
+    rtp_peer_pool_init(43000, 4);
+
+    endpoint_init(&g_a, "A");
+    endpoint_init(&g_b, "B");
+    inetaddr_initbyipport(&g_a.remote_rtp, "127.0.0.1", rtp_peer_rtpport(g_b.peer));
+    inetaddr_initbyipport(&g_a.remote_rtcp, "127.0.0.1", rtp_peer_rtcpport(g_b.peer));
+    inetaddr_initbyipport(&g_b.remote_rtp, "127.0.0.1", rtp_peer_rtpport(g_a.peer));
+    inetaddr_initbyipport(&g_b.remote_rtcp, "127.0.0.1", rtp_peer_rtcpport(g_a.peer));
+
+    rtcp_session_start(g_a.session);
+    rtcp_session_start(g_b.session);
+
+    loop_runevery(g_loop, SEND_INTERVAL, send_rtp, NULL);
+    loop_runafter(g_loop, SEND_INTERVAL * TOTAL_PACKETS + 200, send_bye, NULL);
+    loop_runafter(g_loop, SEND_INTERVAL * TOTAL_PACKETS + 400, quit, NULL);
+    loop_loop(g_loop);
+
+    /* B 对 A 的接收统计: 序号0 在试用期内不计入，之后每10个丢1个 */
+    assert(1 == rtcp_session_get_sources(g_b.session, ssrcs, 4));
+    assert(ssrcs[0] == rtcp_session_get_ssrc(g_a.session));
+    assert(0 == rtcp_session_get_source_stats(g_b.session, ssrcs[0], &source));
+    printf("B <- A: received %llu, bytes %llu, highest %u, lost %d, fraction %u/256, jitter %u(%ums), sender packets %llu, bye %d\n",
+        source.packets_received, source.bytes_received, source.extended_highest_seq, source.cumulative_lost,
+        source.fraction_lost, source.jitter, source.jitter_ms, source.sender_packets, source.is_bye);
+    assert(source.extended_highest_seq == TOTAL_PACKETS - 1);
+    assert(source.cumulative_lost == TOTAL_PACKETS / LOSS_PERIOD);
+    assert(source.packets_received + source.cumulative_lost == TOTAL_PACKETS - 1);
+    assert(source.has_sender_report && source.sender_packets > 0);
+    assert(source.is_bye);
+
+    /* A 收到的 B 的报告 */
+    assert(0 == rtcp_session_get_source_stats(g_a.session, rtcp_session_get_ssrc(g_b.session), &source));
+    printf("A <- B report: fraction %u/256, lost %d, jitter %u, rtt %dms\n",
+        source.remote_fraction_lost, source.remote_cumulative_lost, source.remote_jitter, source.rtt_ms);
+    assert(source.has_remote_report && source.remote_cumulative_lost > 0);
+    assert(source.rtt_ms >= 0 && source.rtt_ms < 100);
+
+    rtcp_session_get_stats(g_a.session, &stats);
+    printf("A: ssrc %u, sent %llu packets %llu bytes, reports sent %llu received %llu, interval %ums\n",
+        stats.ssrc, stats.packets_sent, stats.bytes_sent, stats.reports_sent, stats.reports_received, stats.interval_ms);
+    assert(stats.reports_sent >= 3 && stats.reports_received >= 3);
+    assert(stats.bytes_sent == stats.packets_sent * (172 - 12));
+
+    rtp_peer_free(g_a.peer);
+    rtp_peer_free(g_b.peer);
+    rtcp_session_destroy(g_a.session);
+    rtcp_session_destroy(g_b.session);
+    rtp_peer_pool_uninit();
+    loop_destroy(g_loop);
+
+    printf("all checks passed\n");
+
+    return 0;
+}
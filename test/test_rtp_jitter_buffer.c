@@ -0,0 +1,201 @@
+
+/* rtp_jitter_buffer 的测试
+ *   1. 直接输入一组跨越序号回绕、乱序、重复、缺失及迟到的包，检查交付顺序及统计
+ *   2. 序号大幅跳变，连续两个包之后重新同步
+ *   3. 挂接到 rtp_peer，经由 UDP 乱序发送，检查按序交付
+ */
+
+#include "tinylib/rtp/rtp_peer.h"
+#include "tinylib/rtp/rtp_jitter_buffer.h"
+#include "tinylib/util/log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define LATENCY 50
+
+static loop_t *g_loop = NULL;
+static rtp_jitter_buffer_t *g_jitter_buffer = NULL;
+
+static rtp_peer_t *g_peer = NULL;
+static udp_peer_t *g_sender = NULL;
+
+static int g_out[64];
+static unsigned g_out_lost[64];
+static int g_out_count = 0;
+
+static
+void build_packet(unsigned char *packet, uint16_t sn, uint32_t ssrc)
+{
+    memset(packet, 0, 20);
+    packet[0] = 0x80;
+    packet[1] = 96;
+    packet[2] = (unsigned char)(sn >> 8);
+    packet[3] = (unsigned char)(sn & 0xff);
+    packet[8] = (unsigned char)(ssrc >> 24);
+    packet[9] = (unsigned char)(ssrc >> 16);
+    packet[10] = (unsigned char)(ssrc >> 8);
+    packet[11] = (unsigned char)(ssrc & 0xff);
+
+    return;
+}
+
+static
+int push(uint16_t sn, uint32_t ssrc)
+{
+    unsigned char packet[20];
+
+    build_packet(packet, sn, ssrc);
+    return rtp_jitter_buffer_push(g_jitter_buffer, packet, sizeof(packet));
+}
+
+static
+void onpacket(rtp_jitter_buffer_t *jitter_buffer, uint32_t ssrc, const void *packet, unsigned short size, unsigned lost, void *userdata)
+{
+    const unsigned char *data = (const unsigned char*)packet;
+
+    assert(size == 20);
+    printf("ssrc %u: sn %u, lost %u\n", ssrc, (data[2] << 8) | data[3], lost);
+    g_out[g_out_count] = (data[2] << 8) | data[3];
+    g_out_lost[g_out_count] = lost;
+    g_out_count++;
+
+    return;
+}
+
+static
+void onrtp(udp_peer_t *peer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    /* 挂接 jitter buffer 之后不应再收到 */
+    assert(0);
+    return;
+}
+
+static
+void onrtcp(udp_peer_t *peer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    return;
+}
+
+static
+void step_late(void *userdata)
+{
+    /* 65533 已被判定为丢失，此时到达只能丢弃 */
+    assert(-1 == push(65533, 1));
+    assert(0 == push(4, 1));
+    assert(0 == push(5, 1));
+
+    return;
+}
+
+static
+void step_resync(void *userdata)
+{
+    assert(-1 == push(40000, 1));
+    assert(0 == push(40001, 1));
+    assert(0 == push(40002, 1));
+
+    return;
+}
+
+/* 检查第1、2步的结果，之后经由 rtp_peer 乱序发送另一个 SSRC */
+static
+void step_udp(void *userdata)
+{
+    static const int expect[] = {65530, 65531, 65532, 65534, 65535, 0, 1, 2, 3, 4, 5, 40001, 40002};
+    static const uint16_t udp_sequence[] = {103, 101, 102, 105, 104, 101};
+    rtp_jitter_buffer_stats_t stats;
+    inetaddr_t addr;
+    unsigned char packet[20];
+    unsigned i;
+
+    assert(g_out_count == sizeof(expect)/sizeof(expect[0]));
+    for (i = 0; i < sizeof(expect)/sizeof(expect[0]); ++i)
+    {
+        assert(g_out[i] == expect[i]);
+        assert(g_out_lost[i] == (expect[i] == 65534 ? 1 : 0));
+    }
+
+    rtp_jitter_buffer_get_stats(g_jitter_buffer, &stats);
+    printf("in %llu, out %llu, duplicates %llu, late %llu, reordered %llu, lost %llu, resyncs %llu, invalid %llu\n",
+        stats.packets_in, stats.packets_out, stats.duplicates, stats.late, stats.reordered, stats.lost, stats.resyncs, stats.invalid);
+    assert(1 == stats.duplicates && 1 == stats.late && 2 == stats.reordered);
+    assert(1 == stats.lost && 1 == stats.resyncs && 1 == stats.invalid);
+    assert(0 == stats.buffered && 1 == stats.streams);
+
+    /* 3. 经由 rtp_peer 乱序接收另一个 SSRC，101 重复 */
+    g_out_count = 0;
+    rtp_peer_pool_init(42000, 4);
+    g_peer = rtp_peer_alloc(g_loop, "127.0.0.1", onrtp, NULL, onrtcp, NULL, NULL);
+    assert(g_peer);
+    rtp_peer_set_jitter_buffer(g_peer, g_jitter_buffer);
+
+    g_sender = udp_peer_new(g_loop, "127.0.0.1", 0, onrtcp, NULL, NULL);
+    assert(g_sender);
+    inetaddr_initbyipport(&addr, "127.0.0.1", rtp_peer_rtpport(g_peer));
+    for (i = 0; i < sizeof(udp_sequence)/sizeof(udp_sequence[0]); ++i)
+    {
+        build_packet(packet, udp_sequence[i], 2);
+        udp_peer_send(g_sender, packet, sizeof(packet), &addr);
+    }
+
+    return;
+}
+
+static
+void step_quit(void *userdata)
+{
+    loop_quit(g_loop);
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint16_t sequence[] = {65530, 65532, 65531, 65531, 65534, 65535, 0, 2, 1, 3};
+    rtp_jitter_buffer_stats_t stats;
+    unsigned i;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+    g_loop = loop_new(64);
+    g_jitter_buffer = rtp_jitter_buffer_new(g_loop, LATENCY, 64, onpacket, NULL);
+    assert(g_jitter_buffer);
+
+    /* 1. 65533 缺失，65531、1 乱序，65531 重复 */
+    for (i = 0; i < sizeof(sequence)/sizeof(sequence[0]); ++i)
+    {
+        (void)push(sequence[i], 1);
+    }
+    assert(0 == g_out_count);
+
+    loop_runafter(g_loop, LATENCY*3, step_late, NULL);
+    loop_runafter(g_loop, LATENCY*6, step_resync, NULL);
+    loop_runafter(g_loop, LATENCY*9, step_udp, NULL);
+    loop_runafter(g_loop, LATENCY*12, step_quit, NULL);
+    loop_loop(g_loop);
+
+    assert(5 == g_out_count);
+    for (i = 0; i < 5; ++i)
+    {
+        assert(g_out[i] == (int)(101 + i) && 0 == g_out_lost[i]);
+    }
+    rtp_jitter_buffer_get_stats(g_jitter_buffer, &stats);
+    assert(2 == stats.duplicates && 2 == stats.streams);
+
+    /* 4. SSRC 数已达上限，新的 SSRC 被拒绝，已有的不受影响 */
+    rtp_jitter_buffer_set_max_streams(g_jitter_buffer, 2);
+    assert(-1 == push(1000, 3));
+    assert(0 == push(106, 2));
+    rtp_jitter_buffer_get_stats(g_jitter_buffer, &stats);
+    assert(1 == stats.rejected && 2 == stats.streams);
+
+    udp_peer_destroy(g_sender);
+    rtp_peer_free(g_peer);
+    rtp_peer_pool_uninit();
+    rtp_jitter_buffer_destroy(g_jitter_buffer);
+    loop_destroy(g_loop);
+
+    printf("all checks passed\n");
+
+    return 0;
+}
@@ -0,0 +1,287 @@
+
+/* rtsp 请求解析的性能测试
+ * 以一段模拟摄像机会话的 rtsp 请求流为输入，比较
+ *   1. 基于状态机的 rtsp_request_msg_decode()
+ *   2. 基于 slice 的 rtsp_request_slice_decode()
+ *   3. 查找 head 结束处空行的逐字节实现与向量化实现
+ * 的吞吐量，并先以逐字节追加数据的方式校验两种解析的结果一致
+ */
+
+#include "tinylib/rtsp/rtsp_message_codec.h"
+#include "tinylib/util/text_scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+static const char* captured_msgs[] = {
+    "OPTIONS rtsp://192.168.1.64:554/Streaming/Channels/101 RTSP/1.0\r\n"
+    "CSeq: 2\r\n"
+    "User-Agent: LibVLC/3.0.11 (LIVE555 Streaming Media v2016.11.28)\r\n"
+    "\r\n",
+
+    "DESCRIBE rtsp://192.168.1.64:554/Streaming/Channels/101 RTSP/1.0\r\n"
+    "CSeq: 3\r\n"
+    "User-Agent: LibVLC/3.0.11 (LIVE555 Streaming Media v2016.11.28)\r\n"
+    "Accept: application/sdp\r\n"
+    "Authorization: Digest username=\"admin\", realm=\"IP Camera(C6428)\", nonce=\"4e6a41794e6a59324f5459364e7a41344e7a45344e54413d\", uri=\"rtsp://192.168.1.64:554/Streaming/Channels/101\", response=\"0d2b2d3bb1b3a1a8c3f5f6a6b2d46f0c\"\r\n"
+    "\r\n",
+
+    "SETUP rtsp://192.168.1.64:554/Streaming/Channels/101/trackID=1 RTSP/1.0\r\n"
+    "CSeq: 4\r\n"
+    "User-Agent: LibVLC/3.0.11 (LIVE555 Streaming Media v2016.11.28)\r\n"
+    "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n"
+    "\r\n",
+
+    "PLAY rtsp://192.168.1.64:554/Streaming/Channels/101/ RTSP/1.0\r\n"
+    "CSeq: 5\r\n"
+    "User-Agent: LibVLC/3.0.11 (LIVE555 Streaming Media v2016.11.28)\r\n"
+    "Session: 1273222592\r\n"
+    "Range: npt=0.000-\r\n"
+    "\r\n",
+
+    "GET_PARAMETER rtsp://192.168.1.64:554/Streaming/Channels/101/ RTSP/1.0\r\n"
+    "CSeq: 6\r\n"
+    "User-Agent: LibVLC/3.0.11 (LIVE555 Streaming Media v2016.11.28)\r\n"
+    "Session: 1273222592\r\n"
+    "\r\n",
+
+    "SET_PARAMETER rtsp://192.168.1.64:554/Streaming/Channels/101/ RTSP/1.0\r\n"
+    "CSeq: 7\r\n"
+    "Session: 1273222592\r\n"
+    "Content-Type: text/parameters\r\n"
+    "Content-Length: 19\r\n"
+    "\r\n"
+    "barparam: barstuff\n",
+};
+
+/* 会话中 GET_PARAMETER 保活消息占绝大多数 */
+static const int msg_weights[] = {1, 1, 1, 1, 20, 2};
+
+#define ROUNDS 200
+
+static
+double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+static
+char* build_stream(int *size, int *count)
+{
+    char *stream;
+    int capacity;
+    int len;
+    int i;
+    int j;
+    int k;
+
+    capacity = 1024 * 1024;
+    stream = (char*)malloc(capacity);
+    *size = 0;
+    *count = 0;
+
+    for (k = 0; k < 100; ++k)
+    {
+        for (i = 0; i < (int)(sizeof(captured_msgs)/sizeof(captured_msgs[0])); ++i)
+        {
+            len = strlen(captured_msgs[i]);
+            for (j = 0; j < msg_weights[i]; ++j)
+            {
+                assert((*size + len) <= capacity);
+                memcpy(stream + *size, captured_msgs[i], len);
+                *size += len;
+                *count += 1;
+            }
+        }
+    }
+
+    return stream;
+}
+
+static
+void verify(void)
+{
+    rtsp_request_msg_t *request_msg;
+    rtsp_request_slice_t request;
+    rtsp_head_slice_t heads[16];
+    int parsed_bytes;
+    int slice_parsed_bytes;
+    int ret;
+    int size;
+    int i;
+    int j;
+
+    rtsp_request_slice_init(&request, heads, 16);
+
+    for (i = 0; i < (int)(sizeof(captured_msgs)/sizeof(captured_msgs[0])); ++i)
+    {
+        size = strlen(captured_msgs[i]);
+
+        request_msg = rtsp_request_msg_new();
+        ret = 1;
+        for (j = 1; j <= size && ret == 1; ++j)
+        {
+            ret = rtsp_request_msg_decode(request_msg, captured_msgs[i], j, &parsed_bytes);
+        }
+        assert(0 == ret);
+
+        rtsp_request_slice_reset(&request);
+        ret = 1;
+        for (j = 1; j <= size && ret == 1; ++j)
+        {
+            ret = rtsp_request_slice_decode(&request, captured_msgs[i], j, &slice_parsed_bytes);
+        }
+        assert(0 == ret);
+
+        assert(parsed_bytes == size && slice_parsed_bytes == size);
+        assert(request_msg->method == request.method);
+        assert(request_msg->cseq == request.cseq);
+        assert(request_msg->body_len == request.body.len);
+        assert((int)strlen(request_msg->url) == request.url.len);
+
+        rtsp_request_msg_destroy(request_msg);
+    }
+
+    printf("verify: both decoders agree on %d messages\n", i);
+
+    return;
+}
+
+static
+void bench_msg_decode(const char *stream, int size, int count)
+{
+    rtsp_request_msg_t *request_msg;
+    int parsed_bytes;
+    int offset;
+    int decoded;
+    double start;
+    double cost;
+    int i;
+
+    decoded = 0;
+    start = now_seconds();
+    for (i = 0; i < ROUNDS; ++i)
+    {
+        offset = 0;
+        while (offset < size)
+        {
+            request_msg = rtsp_request_msg_new();
+            if (rtsp_request_msg_decode(request_msg, stream + offset, size - offset, &parsed_bytes) != 0)
+            {
+                rtsp_request_msg_destroy(request_msg);
+                break;
+            }
+            rtsp_request_msg_destroy(request_msg);
+            offset += parsed_bytes;
+            decoded++;
+        }
+    }
+    cost = now_seconds() - start;
+
+    assert(decoded == count * ROUNDS);
+    printf("rtsp_request_msg_decode:   %8.1f MB/s, %10.0f msg/s\n", (double)size * ROUNDS / cost / 1e6, decoded / cost);
+
+    return;
+}
+
+static
+void bench_slice_decode(const char *stream, int size, int count)
+{
+    rtsp_request_slice_t request;
+    rtsp_head_slice_t heads[16];
+    int parsed_bytes;
+    int offset;
+    int decoded;
+    double start;
+    double cost;
+    int i;
+
+    rtsp_request_slice_init(&request, heads, 16);
+
+    decoded = 0;
+    start = now_seconds();
+    for (i = 0; i < ROUNDS; ++i)
+    {
+        offset = 0;
+        while (offset < size)
+        {
+            if (rtsp_request_slice_decode(&request, stream + offset, size - offset, &parsed_bytes) != 0)
+            {
+                break;
+            }
+            rtsp_request_slice_reset(&request);
+            offset += parsed_bytes;
+            decoded++;
+        }
+    }
+    cost = now_seconds() - start;
+
+    assert(decoded == count * ROUNDS);
+    printf("rtsp_request_slice_decode: %8.1f MB/s, %10.0f msg/s\n", (double)size * ROUNDS / cost / 1e6, decoded / cost);
+
+    return;
+}
+
+static
+void bench_scan(const char *stream, int size, int vectorized)
+{
+    const char *pos;
+    const char *end;
+    int found;
+    double start;
+    double cost;
+    int i;
+
+    end = stream + size;
+    found = 0;
+    start = now_seconds();
+    for (i = 0; i < ROUNDS; ++i)
+    {
+        pos = stream;
+        while (NULL != pos)
+        {
+            pos = vectorized ? text_scan_head_end(pos, end) : text_scan_head_end_scalar(pos, end);
+            if (NULL != pos)
+            {
+                found++;
+            }
+        }
+    }
+    cost = now_seconds() - start;
+
+    printf("head end scan (%s): %8.1f MB/s, %d found\n", vectorized ? "vector" : "scalar", (double)size * ROUNDS / cost / 1e6, found / ROUNDS);
+
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    char *stream;
+    int size;
+    int count;
+
+    verify();
+
+    stream = build_stream(&size, &count);
+    printf("stream: %d bytes, %d messages, scan width: %d\n", size, count,
+    #if defined(TEXT_SCAN_WIDTH)
+        TEXT_SCAN_WIDTH
+    #else
+        1
+    #endif
+    );
+
+    bench_msg_decode(stream, size, count);
+    bench_slice_decode(stream, size, count);
+    bench_scan(stream, size, 0);
+    bench_scan(stream, size, 1);
+
+    free(stream);
+
+    return 0;
+}
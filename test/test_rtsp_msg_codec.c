@@ -33,6 +33,23 @@ const char* rtsp_request_msgs[] = {
     "CSeq: 4\r\n"
     "Session: 00003633\r\n"
     "User-Agent: MPlayer (LIVE555 Streaming Media v2010.01.22)\r\n"
+    "\r\n",
+
+    "SET_PARAMETER rtsp://127.0.0.1:8554/home.mp3 RTSP/1.0\r\n"
+    "CSeq: 5\r\n"
+    "Session: 00003633\r\n"
+    "X-Camera-Id: 1024\r\n"
+    "Content-Type: text/parameters\r\n"
+    "Content-Length: 10\r\n"
+    "\r\n"
+    "barparam\r\n",
+
+    /* 部分摄像机发出的 head 名称大小写不规范 */
+    "SETUP rtsp://127.0.0.1:8554/home.mp3/track1 RTSP/1.0\r\n"
+    "cseq: 6\r\n"
+    "TRANSPORT: RTP/AVP/TCP;unicast;interleaved=0-1\r\n"
+    "user-agent: IPCamera\r\n"
+    "www-authenticate: Digest realm=\"IP Camera\"\r\n"
     "\r\n"
 };
 
@@ -111,15 +128,59 @@ const char* rtsp_response_msgs[] = {
 #include <stdlib.h>
 #include <string.h>
 
+/* 比较 slice 转换得到的消息与 rtsp_request_msg_decode() 的结果 */
+static
+int same_request_msg(const rtsp_request_msg_t *a, const rtsp_request_msg_t *b)
+{
+    const rtsp_head_t *ha;
+    const rtsp_head_t *hb;
+
+    if (a->method != b->method || a->version != b->version || a->cseq != b->cseq 
+        || strcmp(a->url, b->url) != 0 || a->body_len != b->body_len)
+    {
+        return 0;
+    }
+    if (a->body_len > 0 && memcmp(a->body, b->body, a->body_len) != 0)
+    {
+        return 0;
+    }
+
+    for (ha = a->head, hb = b->head; NULL != ha && NULL != hb; ha = ha->next, hb = hb->next)
+    {
+        if (ha->key != hb->key || strcmp(ha->value, hb->value) != 0)
+        {
+            return 0;
+        }
+    }
+
+    return (NULL == ha && NULL == hb);
+}
+
 int main(int argc, char *argv[])
 {
     rtsp_request_msg_t *request_msg;
+    rtsp_request_msg_t *converted_msg;
     rtsp_response_msg_t *response_msg;
     const rtsp_head_t *head;
     const rtsp_head_t *node;
     rtsp_transport_head_t *trans;
     
-    unsigned parsed_bytes;
+    rtsp_request_slice_t request;
+    rtsp_head_slice_t heads[16];
+    char text[256];
+    char msg[1024];
+    rtsp_msg_builder_t builder;
+    rtsp_interleaved_frame_t frames[4];
+    const char *sdp = "v=0\r\n"
+                      "o=- 1407052847060393 1 IN IP4 10.0.0.2\r\n"
+                      "s=MPEG-1 or 2 Audio\r\n"
+                      "m=audio 0 RTP/AVP 14\r\n"
+                      "a=control:track1\r\n";
+    int parsed_bytes;
+    int ret;
+    int size;
+    int j;
+    int k;
 
     int i;
 
@@ -186,6 +247,57 @@ int main(int argc, char *argv[])
 
     printf("\n\n==============================\n\n");
 
+    /* slice 方式解析，逐字节追加数据，模拟消息分多次到达 */
+    rtsp_request_slice_init(&request, heads, sizeof(heads)/sizeof(heads[0]));
+    for (i = 0; i < (sizeof(rtsp_request_msgs)/sizeof(rtsp_request_msgs[0])); ++i)
+    {
+        size = strlen(rtsp_request_msgs[i]);
+        ret = 1;
+        for (j = 1; j <= size && ret == 1; ++j)
+        {
+            ret = rtsp_request_slice_decode(&request, rtsp_request_msgs[i], j, &parsed_bytes);
+        }
+
+        rtsp_slice_copy(&request.url, text, sizeof(text));
+        printf(
+            "Slice Decoded: ret => %d, parsed => %d/%d\n"
+            "CSeq => %d\n"
+            "method => %d\n"
+            "url => %s\n"
+            "version => 0x%x\n",
+            ret, parsed_bytes, size,
+            request.cseq,
+            request.method,
+            text,
+            request.version
+        );
+        for (k = 0; k < request.head_count; ++k)
+        {
+            printf("%d => %.*s: %.*s\n", request.heads[k].key, 
+                request.heads[k].name.len, request.heads[k].name.data, 
+                request.heads[k].value.len, request.heads[k].value.data);
+        }
+        if (request.body.len > 0)
+        {
+            printf("body => %.*s\n", request.body.len, request.body.data);
+        }
+
+        if (ret == 0)
+        {
+            request_msg = rtsp_request_msg_new();
+            (void)rtsp_request_msg_decode(request_msg, rtsp_request_msgs[i], size, &parsed_bytes);
+            converted_msg = rtsp_request_slice_to_msg(&request);
+            printf("to msg => %s\n", same_request_msg(request_msg, converted_msg) ? "same" : "DIFFERENT");
+            rtsp_request_msg_unref(converted_msg);
+            rtsp_request_msg_destroy(request_msg);
+        }
+
+        printf("\n\n==============================\n\n");
+        rtsp_request_slice_reset(&request);
+    }
+
+    printf("\n\n==============================\n\n");
+
     for (i = 0; i < (sizeof(rtsp_response_msgs)/sizeof(rtsp_response_msgs[0])); ++i)
     {
         response_msg = rtsp_response_msg_new();
@@ -244,5 +356,57 @@ int main(int argc, char *argv[])
 
     }
 
+    printf("\n\n==============================\n\n");
+
+    /* builder 构建的响应消息，head 与 body 分开存放，拼接之后应能被正确解析 */
+    rtsp_msg_builder_init(&builder, text, sizeof(text));
+    rtsp_msg_builder_response(&builder, 3, 200);
+    rtsp_msg_builder_head(&builder, RTSP_HEAD_CONTENT_TYPE, "application/sdp", -1);
+    rtsp_msg_builder_head(&builder, RTSP_HEAD_SESSION, "00003633;timeout=60", 8);
+    size = rtsp_msg_builder_finish(&builder, sdp, strlen(sdp));
+    printf("Built head(%d bytes):\n%.*s", size, builder.len, builder.data);
+
+    memcpy(msg, builder.data, builder.len);
+    memcpy(msg + builder.len, builder.body, builder.body_len);
+    response_msg = rtsp_response_msg_new();
+    ret = rtsp_response_msg_decode(response_msg, msg, (builder.len + builder.body_len), &parsed_bytes);
+    printf("Decoded: ret => %d, CSeq => %d, code => %d, body len => %d\n", 
+        ret, response_msg->cseq, response_msg->code, response_msg->body_len);
+    rtsp_response_msg_destroy(response_msg);
+
+    /* 内存不足时 finish 返回-1，rtsp_msg_build_response 返回0 */
+    rtsp_msg_builder_init(&builder, text, 32);
+    rtsp_msg_builder_response(&builder, 4, 200);
+    printf("overflow: finish => %d, build_response => %d\n", 
+        rtsp_msg_builder_finish(&builder, NULL, 0), 
+        rtsp_msg_build_response(msg, 64, 4, 200, NULL, sdp, strlen(sdp)));
+
+    printf("\n\n==============================\n\n");
+
+    /* 三个完整的 interleaved 帧之后跟着一则不完整的帧，再之后是一则 rtsp 消息 */
+    size = 0;
+    for (i = 0; i < 4; ++i)
+    {
+        rtsp_interleaved_head_encode((unsigned char*)&msg[size], (unsigned char)i, (unsigned short)(100 + i));
+        memset(&msg[size+4], 'a' + i, 100 + i);
+        size += 4 + 100 + i;
+    }
+    for (j = 103; j <= 104; ++j)
+    {
+        ret = rtsp_interleaved_frames_decode(msg, j, frames, 4, &parsed_bytes);
+        printf("interleaved(%d bytes): frames => %d, parsed => %d\n", j, ret, parsed_bytes);
+    }
+    ret = rtsp_interleaved_frames_decode(msg, size - 1, frames, 4, &parsed_bytes);
+    printf("interleaved(%d bytes): frames => %d, parsed => %d\n", size - 1, ret, parsed_bytes);
+    for (k = 0; k < ret; ++k)
+    {
+        printf("\tchannel => %u, size => %u, data => %c\n", frames[k].channel, frames[k].size, frames[k].data[0]);
+    }
+    ret = rtsp_interleaved_frames_decode(msg, size, frames, 2, &parsed_bytes);
+    printf("interleaved(max 2): frames => %d, parsed => %d\n", ret, parsed_bytes);
+    strcpy(&msg[208], "OPTIONS * RTSP/1.0\r\n");
+    ret = rtsp_interleaved_frames_decode(msg, size, frames, 4, &parsed_bytes);
+    printf("interleaved(then rtsp msg): frames => %d, parsed => %d\n", ret, parsed_bytes);
+
     return 0;
 }
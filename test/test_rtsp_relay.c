@@ -0,0 +1,348 @@
+
+/* rtsp_relay 的测试
+ * 以一路模拟的 H264 + 音频 RTP 流输入 relay，三个经由 socketpair 连接的 TCP 观看者:
+ *   A: 一开始就加入且及时接收，应收到全部包
+ *   B: 在一组 GOP 的中间加入，应先收到缓存的关键帧，从 SPS 开始
+ *   C: 很少接收，积压超过上限之后应跳至下一个关键帧，每次中断之后都从 SPS 恢复
+ *   D: 与 B 同时只加入视频，之后才加入音频，视频不应因此重复补发
+ */
+
+#include "tinylib/rtsp/rtsp_relay.h"
+#include "tinylib/util/log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#define GOP_FRAMES 10
+#define TOTAL_FRAMES 60
+#define B_JOIN_FRAME 14
+#define C_READ_INTERVAL 15
+#define D_AUDIO_FRAME 17
+
+#define VIDEO_CHANNEL 0
+#define AUDIO_CHANNEL 2
+
+struct viewer
+{
+    const char *name;
+    int fd;                         /* 测试读取的一端 */
+    tcp_connection_t *connection;   /* relay 发送的一端 */
+    rtsp_relay_viewer_t *handle;
+    unsigned char *data;
+    int size;
+};
+
+static loop_t *g_loop = NULL;
+static rtsp_relay_t *g_relay = NULL;
+static int g_video_track;
+static int g_audio_track;
+static int g_frame = 0;
+static unsigned short g_seq = 0;
+static struct viewer g_viewers[4];
+
+static
+void viewer_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    buffer_retrieveall(buffer);
+    return;
+}
+
+static
+void viewer_onclose(tcp_connection_t* connection, void* userdata)
+{
+    return;
+}
+
+static
+void viewer_init(struct viewer *viewer, const char *name, int sndbuf)
+{
+    inetaddr_t addr;
+    int fds[2];
+
+    memset(viewer, 0, sizeof(*viewer));
+    viewer->name = name;
+    viewer->data = (unsigned char*)malloc(4*1024*1024);
+
+    assert(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    if (sndbuf > 0)
+    {
+        setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    }
+
+    viewer->fd = fds[0];
+    memset(&addr, 0, sizeof(addr));
+    viewer->connection = tcp_connection_new(g_loop, fds[1], viewer_ondata, viewer_onclose, NULL, &addr);
+
+    return;
+}
+
+static
+void viewer_add_video(struct viewer *viewer)
+{
+    rtsp_relay_target_t target;
+
+    memset(&target, 0, sizeof(target));
+    target.rtp_channel = 0;
+    target.rtcp_channel = 1;
+    rtsp_relay_viewer_add_track(viewer->handle, g_video_track, &target);
+
+    return;
+}
+
+static
+void viewer_add_audio(struct viewer *viewer)
+{
+    rtsp_relay_target_t target;
+
+    memset(&target, 0, sizeof(target));
+    target.rtp_channel = 2;
+    target.rtcp_channel = 3;
+    rtsp_relay_viewer_add_track(viewer->handle, g_audio_track, &target);
+
+    return;
+}
+
+static
+void viewer_join(struct viewer *viewer)
+{
+    viewer->handle = rtsp_relay_add_viewer(g_relay, viewer->connection);
+    viewer_add_video(viewer);
+    viewer_add_audio(viewer);
+
+    return;
+}
+
+static
+void viewer_read(struct viewer *viewer)
+{
+    int ret;
+
+    for (;;)
+    {
+        ret = read(viewer->fd, viewer->data + viewer->size, 4*1024*1024 - viewer->size);
+        if (ret <= 0)
+        {
+            break;
+        }
+        viewer->size += ret;
+    }
+
+    return;
+}
+
+static
+void feed(int track, unsigned char channel, unsigned ts, const unsigned char *nal, int nal_len, int size)
+{
+    unsigned char packet[1500];
+
+    memset(packet, 0, sizeof(packet));
+    packet[0] = 0x80;
+    packet[1] = (track == g_video_track) ? 96 : 97;
+    packet[2] = (unsigned char)(g_seq >> 8);
+    packet[3] = (unsigned char)(g_seq & 0xff);
+    packet[4] = (unsigned char)(ts >> 24);
+    packet[5] = (unsigned char)(ts >> 16);
+    packet[6] = (unsigned char)(ts >> 8);
+    packet[7] = (unsigned char)(ts & 0xff);
+    memcpy(&packet[12], nal, nal_len);
+    g_seq++;
+
+    /* 经由 interleaved channel 输入，与在 rtsp_request 的 interleaved 回调中一样 */
+    rtsp_relay_feed_interleaved(g_relay, channel, packet, size);
+
+    return;
+}
+
+static
+void feed_frame(void *userdata)
+{
+    static const unsigned char sps[] = {0x67, 0x42, 0x00, 0x1f};
+    static const unsigned char pps[] = {0x68, 0xce, 0x3c, 0x80};
+    static const unsigned char idr_start[] = {0x7c, 0x85};
+    static const unsigned char idr_middle[] = {0x7c, 0x05};
+    static const unsigned char idr_end[] = {0x7c, 0x45};
+    static const unsigned char p_slice[] = {0x41, 0x9a};
+    static const unsigned char audio[] = {0xff, 0xf1};
+    unsigned ts;
+    int i;
+
+    ts = g_frame * 3600;
+    if (0 == g_frame % GOP_FRAMES)
+    {
+        feed(g_video_track, VIDEO_CHANNEL, ts, sps, sizeof(sps), 16);
+        feed(g_video_track, VIDEO_CHANNEL, ts, pps, sizeof(pps), 16);
+        feed(g_video_track, VIDEO_CHANNEL, ts, idr_start, sizeof(idr_start), 1400);
+        feed(g_video_track, VIDEO_CHANNEL, ts, idr_middle, sizeof(idr_middle), 1400);
+        feed(g_video_track, VIDEO_CHANNEL, ts, idr_end, sizeof(idr_end), 1400);
+    }
+    else
+    {
+        for (i = 0; i < 2; ++i)
+        {
+            feed(g_video_track, VIDEO_CHANNEL, ts, p_slice, sizeof(p_slice), 1000);
+        }
+    }
+    feed(g_audio_track, AUDIO_CHANNEL, ts, audio, sizeof(audio), 200);
+
+    g_frame++;
+    if (B_JOIN_FRAME == g_frame)
+    {
+        viewer_join(&g_viewers[1]);
+        g_viewers[3].handle = rtsp_relay_add_viewer(g_relay, g_viewers[3].connection);
+        viewer_add_video(&g_viewers[3]);
+    }
+    else if (D_AUDIO_FRAME == g_frame)
+    {
+        viewer_add_audio(&g_viewers[3]);
+    }
+
+    viewer_read(&g_viewers[0]);
+    viewer_read(&g_viewers[1]);
+    viewer_read(&g_viewers[3]);
+    if (0 == g_frame % C_READ_INTERVAL)
+    {
+        viewer_read(&g_viewers[2]);
+    }
+
+    if (TOTAL_FRAMES == g_frame)
+    {
+        loop_quit(g_loop);
+    }
+
+    return;
+}
+
+/* 解析收到的 interleaved 数据，返回收到的视频包数
+ * 校验: 第一个视频包及每次序号中断之后的第一个视频包都是 SPS，视频包的序号只增不减(没有重复)
+ * 音视频 track 不是同时加入的观看者，序号中断是正常的，check_gaps 为0时不检查中断
+ */
+static
+int viewer_verify(struct viewer *viewer, int check_gaps, int *gaps)
+{
+    unsigned char *pos;
+    unsigned char *end;
+    unsigned short len;
+    unsigned short seq;
+    int last_seq;
+    int last_video_seq;
+    int video_packets;
+    int expect_keyframe;
+
+    pos = viewer->data;
+    end = viewer->data + viewer->size;
+    last_seq = -1;
+    last_video_seq = -1;
+    video_packets = 0;
+    expect_keyframe = 1;
+    *gaps = 0;
+
+    while ((end - pos) >= 4)
+    {
+        assert(pos[0] == 0x24);
+        len = (pos[2] << 8) | pos[3];
+        if ((end - pos) < (4 + len))
+        {
+            break;
+        }
+
+        if (pos[1] == 0)
+        {
+            seq = (pos[4+2] << 8) | pos[4+3];
+            if (expect_keyframe)
+            {
+                assert((pos[4+12] & 0x1f) == 7);
+                expect_keyframe = 0;
+            }
+            assert(last_video_seq < 0 || (short)(seq - last_video_seq) > 0);
+            last_video_seq = seq;
+            video_packets++;
+        }
+        else
+        {
+            assert(pos[1] == 2);
+            seq = (pos[4+2] << 8) | pos[4+3];
+        }
+
+        /* 视频与音频共用一个序号空间，任何中断都说明有丢弃 */
+        if (check_gaps && last_seq >= 0 && seq != (unsigned short)(last_seq + 1))
+        {
+            (*gaps)++;
+            if (pos[1] == 0)
+            {
+                assert((pos[4+12] & 0x1f) == 7);
+            }
+            else
+            {
+                expect_keyframe = 1;
+            }
+        }
+        last_seq = seq;
+
+        pos += 4 + len;
+    }
+
+    return video_packets;
+}
+
+int main(int argc, char *argv[])
+{
+    rtsp_relay_stats_t stats;
+    int video_packets[4];
+    int gaps[4];
+    int i;
+
+    g_loop = loop_new(1);
+    g_relay = rtsp_relay_new(g_loop);
+    g_video_track = rtsp_relay_add_track(g_relay, VIDEO_CHANNEL, RTSP_RELAY_CODEC_H264);
+    g_audio_track = rtsp_relay_add_track(g_relay, AUDIO_CHANNEL, RTSP_RELAY_CODEC_OTHER);
+    rtsp_relay_set_max_backlog(g_relay, 8*1024);
+
+    viewer_init(&g_viewers[0], "A", 0);
+    viewer_init(&g_viewers[1], "B", 0);
+    viewer_init(&g_viewers[2], "C", 4096);
+    viewer_init(&g_viewers[3], "D", 0);
+    viewer_join(&g_viewers[0]);
+    viewer_join(&g_viewers[2]);
+
+    loop_runevery(g_loop, 5, feed_frame, NULL);
+    loop_loop(g_loop);
+
+    for (i = 0; i < 4; ++i)
+    {
+        viewer_read(&g_viewers[i]);
+        video_packets[i] = viewer_verify(&g_viewers[i], (i != 3), &gaps[i]);
+        printf("viewer %s: %d bytes, %d video packets, %d gaps\n", g_viewers[i].name, g_viewers[i].size, video_packets[i], gaps[i]);
+    }
+
+    rtsp_relay_get_stats(g_relay, &stats);
+    printf("relay: viewers %u, in %llu, out %llu, dropped %llu, skips %llu, cached %u\n",
+        stats.viewers, stats.packets_in, stats.packets_out, stats.packets_dropped, stats.viewer_skips, stats.cached_packets);
+
+    /* A 全部收到，B 从缓存的关键帧开始之后不再中断，C 至少跳过一次，D 收到的视频与 B 相同 */
+    assert(0 == gaps[0]);
+    assert(video_packets[0] == (TOTAL_FRAMES/GOP_FRAMES) * (5 + (GOP_FRAMES-1) * 2));
+    assert(0 == gaps[1] && video_packets[1] > 0 && video_packets[1] < video_packets[0]);
+    assert(stats.viewer_skips > 0 && gaps[2] > 0);
+    assert(video_packets[3] == video_packets[1]);
+
+    for (i = 0; i < 4; ++i)
+    {
+        rtsp_relay_remove_viewer(g_relay, g_viewers[i].handle);
+        tcp_connection_abort(g_viewers[i].connection);
+        close(g_viewers[i].fd);
+        free(g_viewers[i].data);
+    }
+    rtsp_relay_destroy(g_relay);
+    loop_destroy(g_loop);
+
+    printf("all checks passed\n");
+
+    return 0;
+}
@@ -11,93 +11,135 @@
 #endif
 
 static loop_t *g_loop = NULL;
+static rtsp_server_t *g_server = NULL;
+
+static const char *g_sdp = 
+    "v=0\r\n"
+    "o=- 1408281261003656 1408281261003656 IN IP4 127.0.0.1\r\n"
+    "s=Media Presentation\r\n"
+    "e=NONE\r\n"
+    "b=AS:5050\r\n"
+    "t=0 0\r\n"
+    "a=control:rtsp://127.0.0.1:554/\r\n"
+    "m=video 0 RTP/AVP 96\r\n"
+    "b=AS:5000\r\n"
+    "a=control:rtsp://127.0.0.1:554/trackID=1\r\n"
+    "a=rtpmap:96 H264/90000\r\n"
+    "a=fmtp:96 profile-level-id=420029; packetization-mode=1; sprop-parameter-sets=Z00AH5pmAoAt/zUBAQFAAAD6AAAw1AE=,aO48gA==,\r\n";
+
+struct describe_task
+{
+    rtsp_session_t* session;
+    int cseq;
+};
+
+/* 模拟耗时的媒体信息查询，在定时器中完成 DESCRIBE 的响应 */
+static
+void describe_done(void *userdata)
+{
+    struct describe_task *task = (struct describe_task*)userdata;
+    rtsp_msg_builder_t builder;
+    char response[512];
+
+    rtsp_msg_builder_init(&builder, response, sizeof(response));
+    rtsp_msg_builder_response(&builder, task->cseq, 200);
+    rtsp_msg_builder_head(&builder, RTSP_HEAD_CONTENT_TYPE, "application/sdp", -1);
+    rtsp_msg_builder_finish(&builder, g_sdp, strlen(g_sdp));
+    rtsp_session_send_message(task->session, &builder);
+
+    printf("\nDeferred Response: \n%.*s%s\n", builder.len, response, g_sdp);
+    free(task);
+
+    return;
+}
 
 static 
 void session_hander
 (
     rtsp_session_t* session, 
     tcp_connection_t* connection, 
-    rtsp_request_msg_t *request_msg, 
+    rtsp_request_slice_t *request_msg, 
     void *userdata
 )
 {
     char response[1024];
-    size_t size;
+    char text[512];
+    rtsp_msg_builder_t builder;
     rtsp_head_t *head;
-    rtsp_head_t *node;
+    const rtsp_head_slice_t *head_slice;
+    int i;
 
     rtsp_head_t public_head;
 
     rtsp_transport_head_t *transport;
-    rtsp_head_t content_type_head;
+    struct describe_task *task;
+    rtsp_server_stats_t stats;
     
     rtsp_head_t transport_head;
-    rtsp_head_t session_head;
     const char *body;
-    size_t body_len;
+    int body_len;
 
     if (NULL == request_msg)
     {
+        /* 连接断开或消息非法 */
         if (tcp_connection_connected(connection) == 0)
         {
             rtsp_session_end(session);
             return;
         }
 
+        /* 新的 session，客户端在此时间内没有任何请求时将被回收 */
+        rtsp_session_set_timeout(session, 30);
+
         return;
     }
     
     printf("new request arrived:\n"
         "method: %d\n"
-        "url: %s\n"
+        "url: %.*s\n"
         "version: 0x%x\n"
         "cseq: %d\n",
-        request_msg->method, request_msg->url, request_msg->version, request_msg->cseq);
+        request_msg->method, request_msg->url.len, request_msg->url.data, request_msg->version, request_msg->cseq);
 
-    if (NULL != request_msg->head)
+    for (i = 0; i < request_msg->head_count; ++i)
     {
-        head = request_msg->head;
-        while (NULL != head)
+        head_slice = &request_msg->heads[i];
+        printf("%d => %.*s: %.*s\n", head_slice->key, head_slice->name.len, head_slice->name.data, head_slice->value.len, head_slice->value.data);
+        if (head_slice->key == RTSP_HEAD_TRANSPORT)
         {
-            node = head->next;
-            printf("%d => %s\n", head->key, head->value);
-            if (head->key == RTSP_HEAD_TRANSPORT)
-            {
-                transport = rtsp_transport_head_decode(head->value);
-                printf("\tmode: %s\n"
-                       "\tcast: %s\n"
-                       "\tdestination: %s\n"
-                       "\tsource: %s\n"
-                       "\tclient_rtp: %u\n"
-                       "\tclient_rtcp: %u\n"
-                       "\tserver_rtp: %u\n"
-                       "\tserver_rcp: %u\n"
-                       "\tssrc: %s\n"
-                       "\tinterleaved: %d\n"
-                       "\trtp_channel: %d\n"
-                       "\trtcp_channel: %d\n", 
-                    transport->trans,
-                    transport->cast,
-                    transport->destination,
-                    transport->source,
-                    transport->client_rtp_port,
-                    transport->client_rtcp_port,
-                    transport->server_rtp_port,
-                    transport->server_rtcp_port,
-                    transport->ssrc,
-                    transport->interleaved,
-                    transport->rtp_channel,
-                    transport->rtcp_channel);
-                rtsp_transport_head_destroy(transport);
-            }
-            
-            head = node;
+            rtsp_slice_copy(&head_slice->value, text, sizeof(text));
+            transport = rtsp_transport_head_decode(text);
+            printf("\tmode: %s\n"
+                   "\tcast: %s\n"
+                   "\tdestination: %s\n"
+                   "\tsource: %s\n"
+                   "\tclient_rtp: %u\n"
+                   "\tclient_rtcp: %u\n"
+                   "\tserver_rtp: %u\n"
+                   "\tserver_rcp: %u\n"
+                   "\tssrc: %s\n"
+                   "\tinterleaved: %d\n"
+                   "\trtp_channel: %d\n"
+                   "\trtcp_channel: %d\n", 
+                transport->trans,
+                transport->cast,
+                transport->destination,
+                transport->source,
+                transport->client_rtp_port,
+                transport->client_rtcp_port,
+                transport->server_rtp_port,
+                transport->server_rtcp_port,
+                transport->ssrc,
+                transport->interleaved,
+                transport->rtp_channel,
+                transport->rtcp_channel);
+            rtsp_transport_head_destroy(transport);
         }
     }
 
-    if (request_msg->body != NULL && request_msg->body_len > 0)
+    if (request_msg->body.len > 0)
     {
-        printf("body len: %u\n", request_msg->body_len);
+        printf("body len: %d\n", request_msg->body.len);
     }
 
     printf("========================================\n");
@@ -116,24 +158,14 @@ void session_hander
     }
     else if (RTSP_METHOD_DESCRIBE == request_msg->method)
     {
-        content_type_head.key = RTSP_HEAD_CONTENT_TYPE;
-        content_type_head.value = "application/sdp";
-        content_type_head.next = NULL;
-        head = &content_type_head;
-    
-        body = "v=0\r\n"
-               "o=- 1408281261003656 1408281261003656 IN IP4 127.0.0.1\r\n"
-               "s=Media Presentation\r\n"
-               "e=NONE\r\n"
-               "b=AS:5050\r\n"
-               "t=0 0\r\n"
-               "a=control:rtsp://127.0.0.1:554/\r\n"
-               "m=video 0 RTP/AVP 96\r\n"
-               "b=AS:5000\r\n"
-               "a=control:rtsp://127.0.0.1:554/trackID=1\r\n"
-               "a=rtpmap:96 H264/90000\r\n"
-               "a=fmtp:96 profile-level-id=420029; packetization-mode=1; sprop-parameter-sets=Z00AH5pmAoAt/zUBAQFAAAD6AAAw1AE=,aO48gA==,\r\n";
-        body_len = strlen(body);
+        /* DESCRIBE 延迟响应，其后流水线发来的请求照常处理，响应由 session 按请求顺序发出 */
+        task = (struct describe_task*)malloc(sizeof(struct describe_task));
+        task->session = session;
+        task->cseq = request_msg->cseq;
+        rtsp_session_defer_reply(session);
+        loop_runafter(g_loop, 100, describe_done, task);
+
+        return;
     }
     else if (RTSP_METHOD_SETUP == request_msg->method)
     {
@@ -142,29 +174,48 @@ void session_hander
         transport_head.value = "RTP/AVP/TCP;unicast;interleaved=0-1";
         transport_head.next = NULL;
 
-        session_head.key = RTSP_HEAD_SESSION;
-        session_head.value = "9580441;timeout=1";
-        session_head.next = NULL;
-
-        transport_head.next = &session_head;
+        transport_head.next = NULL;
         head = &transport_head;
         body = NULL;
         body_len = 0;
     }
         
-    size = rtsp_msg_build_response(response, sizeof(response)-1, request_msg->cseq, 200, head, body, body_len);
-    tcp_connection_send(connection, response, size);
+    /* head 写入 response，body(SDP) 直接引用，由 rtsp_session_send_message() 一并发出 */
+    rtsp_msg_builder_init(&builder, response, sizeof(response));
+    rtsp_msg_builder_response(&builder, request_msg->cseq, 200);
+    for (; NULL != head; head = head->next)
+    {
+        rtsp_msg_builder_head(&builder, head->key, head->value, -1);
+    }
+    if (RTSP_METHOD_SETUP == request_msg->method)
+    {
+        /* Session head 带上 session 的超时时间，超时未活动的 session 由 rtsp_server 回收 */
+        rtsp_session_head(session, &builder);
+    }
+    rtsp_msg_builder_finish(&builder, body, body_len);
+    rtsp_session_send_message(session, &builder);
 
-    printf("\nResponse: \n%s\n", response);
+    printf("\nResponse: \n%.*s%s\n", builder.len, response, (NULL == body ? "" : body));
 
     if (RTSP_METHOD_TEARDOWN == request_msg->method)
     {
-        /* nothing to do */
+        rtsp_server_get_stats(g_server, &stats);
+        printf("sessions: %u, peak: %u, total: %llu, expired: %llu\n", 
+            stats.sessions, stats.peak_sessions, stats.total_sessions, stats.expired_sessions);
     }
 
     return;
 }
 
+/* 超时未活动的 session，回调返回之后 server 即将其结束 */
+static
+void session_expire(rtsp_session_t* session, void *userdata)
+{
+    printf("session(%s) expired\n\n", rtsp_session_get_id(session));
+
+    return;
+}
+
 static
 void interleaved_sink
 (
@@ -179,10 +230,30 @@ void interleaved_sink
     return;
 }
 
-int main()
+/* 一次收到的全部 interleaved 帧，原样回显给客户端 */
+static
+void interleaved_batch_sink
+(
+    rtsp_session_t* session, 
+    const rtsp_interleaved_frame_t *frames, int count,
+    void *userdata
+)
 {
-    rtsp_server_t *server;
+    int i;
+
+    printf("interleaved batch: %d packets\n", count);
+    for (i = 0; i < count; ++i)
+    {
+        printf("\tchannel: %u, size: %u\n", frames[i].channel, frames[i].size);
+        rtsp_session_send_interleaved(session, frames[i].channel, frames[i].data, frames[i].size);
+    }
+    printf("\n");
 
+    return;
+}
+
+int main()
+{
     #ifdef WIN32
     WSADATA wsa_data;
     WSAStartup(MAKEWORD(2, 2), &wsa_data);
@@ -190,14 +261,16 @@ int main()
     
     g_loop = loop_new(1);
     assert(g_loop);
-    server = rtsp_server_new(g_loop, session_hander, interleaved_sink, NULL, 554, "0.0.0.0");
-    assert(server);
-    rtsp_server_start(server);
+    g_server = rtsp_server_new(g_loop, session_hander, interleaved_sink, NULL, 554, "0.0.0.0");
+    assert(g_server);
+    rtsp_server_set_interleaved_batch_sink(g_server, interleaved_batch_sink);
+    rtsp_server_set_expire_callback(g_server, session_expire);
+    rtsp_server_start(g_server);
 
     loop_loop(g_loop);
 
-    rtsp_server_stop(server);
-    rtsp_server_destroy(server);
+    rtsp_server_stop(g_server);
+    rtsp_server_destroy(g_server);
     loop_destroy(g_loop);
 
     #ifdef WIN32
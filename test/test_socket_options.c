@@ -0,0 +1,155 @@
+
+#include "tinylib/net/tcp_server.h"
+#include "tinylib/net/tcp_client.h"
+#include "tinylib/linux/net/socket.h"
+#include "tinylib/util/log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define SERVER_PORT 15380
+
+static loop_t *g_loop = NULL;
+
+static
+void show_options(void)
+{
+    socket_options_t options;
+    struct linger linger_info;
+    socklen_t len;
+    int fd;
+    int value;
+
+    socket_options_init(&options);
+    options.nodelay = 1;
+    options.keepalive_idle = 30;
+    options.keepalive_interval = 5;
+    options.keepalive_count = 3;
+    options.linger = -1;
+    options.notsent_lowat = 16384;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    set_socket_options(fd, &options);
+
+    len = sizeof(value);
+    getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, &len);
+    printf("TCP_NODELAY: %d\n", value);
+    getsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &value, &len);
+    printf("TCP_KEEPIDLE: %d\n", value);
+    getsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &value, &len);
+    printf("TCP_KEEPINTVL: %d\n", value);
+    getsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &value, &len);
+    printf("TCP_KEEPCNT: %d\n", value);
+    #ifdef TCP_NOTSENT_LOWAT
+    getsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &value, &len);
+    printf("TCP_NOTSENT_LOWAT: %d\n", value);
+    #endif
+
+    len = sizeof(linger_info);
+    getsockopt(fd, SOL_SOCKET, SO_LINGER, &linger_info, &len);
+    printf("SO_LINGER: %d\n", linger_info.l_onoff);
+
+    close(fd);
+
+    return;
+}
+
+static
+void server_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    /* 开启 auto_cork 时，多次发送在回调返回之后合并发出 */
+    tcp_connection_send(connection, "RTSP/1.0 200 OK\r\n", 17);
+    tcp_connection_send(connection, "CSeq: 1\r\n\r\n", 11);
+    buffer_retrieveall(buffer);
+
+    return;
+}
+
+static
+void server_onclose(tcp_connection_t* connection, void* userdata)
+{
+    tcp_connection_destroy(connection);
+    return;
+}
+
+static
+void server_onconnection(tcp_connection_t* connection, void* userdata, const inetaddr_t* addr)
+{
+    tcp_connection_setcalback(connection, server_ondata, server_onclose, NULL);
+    return;
+}
+
+static
+void client_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    if (buffer_readablebytes(buffer) >= 28)
+    {
+        printf("response received: %u bytes\n", buffer_readablebytes(buffer));
+        buffer_retrieveall(buffer);
+        loop_quit(g_loop);
+    }
+
+    return;
+}
+
+static
+void client_onclose(tcp_connection_t* connection, void* userdata)
+{
+    return;
+}
+
+static
+void client_onconnected(tcp_connection_t* connection, void *userdata)
+{
+    const char request[] = "OPTIONS * RTSP/1.0\r\nCSeq: 1\r\n\r\n";
+
+    assert(NULL != connection);
+    tcp_connection_send(connection, request, sizeof(request)-1);
+
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    tcp_server_t *server;
+    tcp_client_t *client;
+    socket_options_t options;
+
+    log_setlevel(LOG_LEVEL_INFO);
+
+    show_options();
+
+    g_loop = loop_new(64);
+    assert(g_loop);
+
+    socket_options_init(&options);
+    options.nodelay = 1;
+    options.fastopen = 16;
+    options.defer_accept = 5;
+    options.auto_cork = 1;
+
+    server = tcp_server_new(g_loop, server_onconnection, NULL, SERVER_PORT, "127.0.0.1");
+    tcp_server_set_options(server, &options);
+    tcp_server_start(server);
+
+    socket_options_init(&options);
+    options.nodelay = 1;
+    options.fastopen = 1;
+
+    client = tcp_client_new(g_loop, "127.0.0.1", SERVER_PORT, client_onconnected, client_ondata, client_onclose, NULL);
+    tcp_client_set_options(client, &options);
+    tcp_client_connect(client);
+
+    loop_loop(g_loop);
+
+    tcp_client_destroy(client);
+    tcp_server_destroy(server);
+    loop_destroy(g_loop);
+
+    return 0;
+}
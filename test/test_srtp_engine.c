@@ -0,0 +1,515 @@
+
+/* srtp_engine 的测试
+ *   1. RFC 3711 B.3 的密钥派生向量
+ *   2. 各 profile 下 RTP/RTCP 的往返加解密，含 CSRC 及扩展头、SEQ 翻转(ROC 加1)及乱序到达
+ *   3. 篡改、重放及密钥不符的报文应被拒绝，且不影响之后正常报文的处理
+ *   4. udp_peer 一次收到的一批 SRTP 报文，在其接收缓冲区中以 srtp_engine_unprotect_rtp_batch() 一次解保护
+ *   5. DTLS 握手(内存 BIO)协商 use_srtp 之后，双方以 srtp_engine_new_from_ssl() 导出的密钥互通
+ *
+ * usage: test_srtp_engine <cert file> <key file>
+ */
+
+#include "tinylib/ssl/srtp_engine.h"
+#include "tinylib/net/udp_peer.h"
+#include "tinylib/util/log.h"
+#include "test/test_check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+#include <openssl/rand.h>
+
+#define TEST_SSRC 0x11223344
+#define BATCH_COUNT 16
+
+static const unsigned long g_profiles[] =
+{
+    SRTP_AES128_CM_SHA1_80,
+    SRTP_AES128_CM_SHA1_32,
+    SRTP_AEAD_AES_128_GCM,
+    SRTP_AEAD_AES_256_GCM,
+};
+
+static loop_t *g_loop = NULL;
+static srtp_engine_t *g_receiver = NULL;
+static int g_received = 0;
+static int g_rejected = 0;
+
+static
+void hex_decode(const char *hex, unsigned char *out)
+{
+    unsigned value;
+
+    while (*hex)
+    {
+        sscanf(hex, "%2x", &value);
+        *out++ = (unsigned char)value;
+        hex += 2;
+    }
+
+    return;
+}
+
+static
+void test_kdf(void)
+{
+    unsigned char master_key[16];
+    unsigned char master_salt[14];
+    unsigned char expected[20];
+    unsigned char out[20];
+
+    hex_decode("E1F97A0D3E018BE0D64FA32C06DE4139", master_key);
+    hex_decode("0EC675AD498AFEEBB6960B3AABE6", master_salt);
+
+    CHECK(0 == srtp_kdf(master_key, 16, master_salt, 14, 0x00, out, 16));
+    hex_decode("C61E7A93744F39EE10734AFE3FF7A087", expected);
+    CHECK(0 == memcmp(out, expected, 16));
+
+    CHECK(0 == srtp_kdf(master_key, 16, master_salt, 14, 0x02, out, 14));
+    hex_decode("30CBBC08863D8C85D49DB34A9AE1", expected);
+    CHECK(0 == memcmp(out, expected, 14));
+
+    CHECK(0 == srtp_kdf(master_key, 16, master_salt, 14, 0x01, out, 20));
+    hex_decode("CEBE321F6FF7716B6FD4AB49AF256A156D38BAA4", expected);
+    CHECK(0 == memcmp(out, expected, 20));
+
+    printf("kdf: RFC 3711 B.3 vectors ok\n");
+    return;
+}
+
+/* 构造一个 RTP 报文，with_extension 时带一个 CSRC 及一个4字节的扩展头 */
+static
+unsigned make_rtp(unsigned char *packet, unsigned short seq, unsigned ssrc, int with_extension, unsigned payload_size)
+{
+    unsigned size = 12;
+    unsigned i;
+
+    packet[0] = 0x80;
+    packet[1] = 96;
+    packet[2] = (unsigned char)(seq >> 8);
+    packet[3] = (unsigned char)seq;
+    packet[4] = 0;
+    packet[5] = 0;
+    packet[6] = (unsigned char)(seq >> 8);
+    packet[7] = (unsigned char)seq;
+    packet[8] = (unsigned char)(ssrc >> 24);
+    packet[9] = (unsigned char)(ssrc >> 16);
+    packet[10] = (unsigned char)(ssrc >> 8);
+    packet[11] = (unsigned char)ssrc;
+
+    if (with_extension)
+    {
+        packet[0] |= 0x11;
+        memset(packet + size, 0x55, 4);
+        size += 4;
+        packet[size] = 0xbe;
+        packet[size + 1] = 0xde;
+        packet[size + 2] = 0;
+        packet[size + 3] = 1;
+        memset(packet + size + 4, 0x66, 4);
+        size += 8;
+    }
+
+    for (i = 0; i < payload_size; ++i)
+    {
+        packet[size + i] = (unsigned char)(seq + i);
+    }
+
+    return size + payload_size;
+}
+
+/* 构造一个不含报告块的 SR */
+static
+unsigned make_rtcp(unsigned char *packet, unsigned ssrc, unsigned count)
+{
+    memset(packet, 0, 28);
+    packet[0] = 0x80;
+    packet[1] = 200;
+    packet[3] = 6;
+    packet[4] = (unsigned char)(ssrc >> 24);
+    packet[5] = (unsigned char)(ssrc >> 16);
+    packet[6] = (unsigned char)(ssrc >> 8);
+    packet[7] = (unsigned char)ssrc;
+    packet[27] = (unsigned char)count;
+
+    return 28;
+}
+
+static
+void new_engine_pair(unsigned long profile, srtp_engine_t **a, srtp_engine_t **b)
+{
+    unsigned char key_a[32];
+    unsigned char salt_a[14];
+    unsigned char key_b[32];
+    unsigned char salt_b[14];
+
+    CHECK(1 == RAND_bytes(key_a, sizeof(key_a)));
+    CHECK(1 == RAND_bytes(salt_a, sizeof(salt_a)));
+    CHECK(1 == RAND_bytes(key_b, sizeof(key_b)));
+    CHECK(1 == RAND_bytes(salt_b, sizeof(salt_b)));
+
+    *a = srtp_engine_new(profile, key_a, salt_a, key_b, salt_b);
+    *b = srtp_engine_new(profile, key_b, salt_b, key_a, salt_a);
+    CHECK(*a && *b);
+    CHECK(srtp_engine_get_profile(*a) == profile);
+
+    return;
+}
+
+/* a 保护的报文交给 b 解保护，应还原出明文 */
+static
+void rtp_round_trip(srtp_engine_t *a, srtp_engine_t *b, unsigned short seq, int with_extension)
+{
+    unsigned char packet[1500];
+    unsigned char plain[1500];
+    unsigned char saved[1500];
+    unsigned size;
+    int ret;
+
+    size = make_rtp(packet, seq, TEST_SSRC, with_extension, 160);
+    memcpy(plain, packet, size);
+
+    ret = srtp_engine_protect_rtp(a, packet, size, sizeof(packet));
+    CHECK(ret > (int)size && ret <= (int)size + SRTP_ENGINE_MAX_OVERHEAD);
+    CHECK(0 != memcmp(packet, plain, size));
+    memcpy(saved, packet, ret);
+
+    CHECK((int)size == srtp_engine_unprotect_rtp(b, packet, ret));
+    CHECK(0 == memcmp(packet, plain, size));
+
+    CHECK(SRTP_ENGINE_ERR_REPLAY == srtp_engine_unprotect_rtp(b, saved, ret));
+
+    return;
+}
+
+static
+void test_profile(unsigned long profile)
+{
+    srtp_engine_t *a;
+    srtp_engine_t *b;
+    srtp_engine_t *c;
+    srtp_engine_t *d;
+    unsigned char packets[4][1500];
+    unsigned char packet[1500];
+    unsigned char plain[1500];
+    int sizes[4];
+    unsigned size;
+    unsigned n;
+    int ret;
+
+    new_engine_pair(profile, &a, &b);
+
+    /* SEQ 从 65530 翻转到 9，ROC 随之加1 */
+    for (n = 0; n < 16; ++n)
+    {
+        rtp_round_trip(a, b, (unsigned short)(65530 + n), n & 1);
+    }
+    rtp_round_trip(b, a, 1, 0);
+
+    /* 窗口之内乱序到达 */
+    for (n = 0; n < 4; ++n)
+    {
+        size = make_rtp(packets[n], (unsigned short)(20 + n), TEST_SSRC, 0, 100);
+        sizes[n] = srtp_engine_protect_rtp(a, packets[n], size, sizeof(packets[n]));
+        CHECK(sizes[n] > 0);
+    }
+    CHECK(0 < srtp_engine_unprotect_rtp(b, packets[3], sizes[3]));
+    CHECK(0 < srtp_engine_unprotect_rtp(b, packets[1], sizes[1]));
+    CHECK(0 < srtp_engine_unprotect_rtp(b, packets[0], sizes[0]));
+    CHECK(0 < srtp_engine_unprotect_rtp(b, packets[2], sizes[2]));
+
+    /* 篡改的报文被拒绝之后，原报文仍可正常解保护 */
+    size = make_rtp(packet, 30, TEST_SSRC, 0, 100);
+    memcpy(plain, packet, size);
+    ret = srtp_engine_protect_rtp(a, packet, size, sizeof(packet));
+    memcpy(packets[0], packet, ret);
+    packets[0][size - 1] ^= 0x01;
+    CHECK(SRTP_ENGINE_ERR_AUTH == srtp_engine_unprotect_rtp(b, packets[0], ret));
+    CHECK((int)size == srtp_engine_unprotect_rtp(b, packet, ret));
+    CHECK(0 == memcmp(packet, plain, size));
+
+    /* 密钥不符 */
+    new_engine_pair(profile, &c, &d);
+    size = make_rtp(packet, 31, TEST_SSRC, 0, 100);
+    ret = srtp_engine_protect_rtp(a, packet, size, sizeof(packet));
+    CHECK(SRTP_ENGINE_ERR_AUTH == srtp_engine_unprotect_rtp(d, packet, ret));
+    srtp_engine_destroy(c);
+    srtp_engine_destroy(d);
+
+    /* 缓冲区不足以容纳认证标签 */
+    size = make_rtp(packet, 32, TEST_SSRC, 0, 100);
+    CHECK(SRTP_ENGINE_ERR_BAD_PACKET == srtp_engine_protect_rtp(a, packet, size, size));
+
+    /* SRTCP */
+    for (n = 0; n < 8; ++n)
+    {
+        size = make_rtcp(packet, TEST_SSRC, n);
+        memcpy(plain, packet, size);
+        ret = srtp_engine_protect_rtcp(a, packet, size, sizeof(packet));
+        CHECK(ret > (int)size && ret <= (int)size + SRTP_ENGINE_MAX_OVERHEAD);
+        memcpy(packets[0], packet, ret);
+        memcpy(packets[1], packet, ret);
+        packets[1][10] ^= 0x80;
+
+        CHECK(SRTP_ENGINE_ERR_AUTH == srtp_engine_unprotect_rtcp(b, packets[1], ret));
+        CHECK((int)size == srtp_engine_unprotect_rtcp(b, packet, ret));
+        CHECK(0 == memcmp(packet, plain, size));
+        CHECK(SRTP_ENGINE_ERR_REPLAY == srtp_engine_unprotect_rtcp(b, packets[0], ret));
+    }
+
+    srtp_engine_destroy(a);
+    srtp_engine_destroy(b);
+
+    return;
+}
+
+static
+void on_message(udp_peer_t *peer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    /* 设置了 batchcb 之后不应再逐个回调 */
+    CHECK(0);
+    return;
+}
+
+static
+void on_batch(udp_peer_t *peer, udp_message_t *messages, unsigned count, void* userdata)
+{
+    srtp_packet_t packets[BATCH_COUNT];
+    unsigned succeeded;
+    unsigned i;
+
+    for (i = 0; i < count; ++i)
+    {
+        packets[i].data = messages[i].data;
+        packets[i].size = messages[i].size;
+        packets[i].capacity = messages[i].capacity;
+        packets[i].result = 0;
+    }
+
+    succeeded = srtp_engine_unprotect_rtp_batch(g_receiver, packets, count);
+    for (i = 0; i < count; ++i)
+    {
+        if (packets[i].result > 0)
+        {
+            /* 明文就在 udp_peer 的接收缓冲区中 */
+            CHECK(172 == packets[i].result);
+            CHECK(((unsigned char*)messages[i].data)[12] == ((unsigned char*)messages[i].data)[3]);
+            g_received++;
+        }
+        else
+        {
+            CHECK(SRTP_ENGINE_ERR_AUTH == packets[i].result);
+            g_rejected++;
+        }
+    }
+    CHECK((int)succeeded <= (int)count);
+
+    if (g_received + g_rejected == BATCH_COUNT)
+    {
+        loop_quit(g_loop);
+    }
+
+    return;
+}
+
+struct batch_sender
+{
+    srtp_engine_t *sender;
+    unsigned short port;
+};
+
+/* 在 batchcb 生效之后再发出报文 */
+static
+void send_batch(void *userdata)
+{
+    struct batch_sender *batch_sender = (struct batch_sender*)userdata;
+    struct sockaddr_in addr;
+    unsigned char packet[1500];
+    unsigned size;
+    int fd;
+    int ret;
+    int i;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(batch_sender->port);
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    for (i = 0; i < BATCH_COUNT; ++i)
+    {
+        size = make_rtp(packet, (unsigned short)(1000 + i), TEST_SSRC, 0, 160);
+        ret = srtp_engine_protect_rtp(batch_sender->sender, packet, size, sizeof(packet));
+        CHECK(ret > 0);
+        if (5 == i)
+        {
+            packet[ret - 1] ^= 0xff;
+        }
+        CHECK(ret == sendto(fd, packet, ret, 0, (struct sockaddr*)&addr, sizeof(addr)));
+    }
+    close(fd);
+
+    return;
+}
+
+static
+void on_timeout(void *userdata)
+{
+    printf("timed out\n");
+    CHECK(0);
+    return;
+}
+
+static
+void test_batch(void)
+{
+    struct batch_sender batch_sender;
+    udp_peer_t *peer;
+    loop_timer_t *timer;
+
+    new_engine_pair(SRTP_AES128_CM_SHA1_80, &batch_sender.sender, &g_receiver);
+
+    g_loop = loop_new(64);
+    peer = udp_peer_new(g_loop, "127.0.0.1", 0, on_message, NULL, NULL);
+    CHECK(peer);
+    udp_peer_onbatch(peer, on_batch, NULL);
+    batch_sender.port = udp_peer_getport(peer);
+    loop_run_inloop(g_loop, send_batch, &batch_sender);
+
+    timer = loop_runafter(g_loop, 5000, on_timeout, NULL);
+    loop_loop(g_loop);
+    loop_cancel(g_loop, timer);
+
+    printf("batch: %d packets unprotected in place, %d rejected\n", g_received, g_rejected);
+    CHECK(BATCH_COUNT - 1 == g_received);
+    CHECK(1 == g_rejected);
+
+    udp_peer_destroy(peer);
+    loop_destroy(g_loop);
+    srtp_engine_destroy(batch_sender.sender);
+    srtp_engine_destroy(g_receiver);
+
+    return;
+}
+
+static
+SSL* new_mem_ssl(SSL_CTX *ssl_ctx)
+{
+    SSL *ssl;
+    BIO *in;
+    BIO *out;
+
+    ssl = SSL_new(ssl_ctx);
+    in = BIO_new(BIO_s_mem());
+    out = BIO_new(BIO_s_mem());
+    BIO_set_mem_eof_return(in, -1);
+    BIO_set_mem_eof_return(out, -1);
+    SSL_set_bio(ssl, in, out);
+    SSL_set_options(ssl, SSL_OP_NO_QUERY_MTU);
+    DTLS_set_link_mtu(ssl, 1500);
+
+    return ssl;
+}
+
+/* 把 from 发出的全部数据交给 to */
+static
+void transfer(SSL *from, SSL *to)
+{
+    unsigned char data[16384];
+    int ret;
+
+    ret = BIO_read(SSL_get_wbio(from), data, sizeof(data));
+    if (ret > 0)
+    {
+        CHECK(ret == BIO_write(SSL_get_rbio(to), data, ret));
+    }
+
+    return;
+}
+
+static
+void test_dtls_srtp(const char *cert_file, const char *key_file)
+{
+    SSL_CTX *client_ctx;
+    SSL_CTX *server_ctx;
+    SSL *client;
+    SSL *server;
+    srtp_engine_t *client_engine;
+    srtp_engine_t *server_engine;
+    int i;
+
+    server_ctx = SSL_CTX_new(DTLS_server_method());
+    CHECK(1 == SSL_CTX_use_certificate_file(server_ctx, cert_file, SSL_FILETYPE_PEM));
+    CHECK(1 == SSL_CTX_use_PrivateKey_file(server_ctx, key_file, SSL_FILETYPE_PEM));
+    CHECK(0 == SSL_CTX_set_tlsext_use_srtp(server_ctx, "SRTP_AEAD_AES_128_GCM:SRTP_AES128_CM_SHA1_80"));
+    client_ctx = SSL_CTX_new(DTLS_client_method());
+    CHECK(0 == SSL_CTX_set_tlsext_use_srtp(client_ctx, "SRTP_AES128_CM_SHA1_80:SRTP_AEAD_AES_128_GCM"));
+
+    client = new_mem_ssl(client_ctx);
+    server = new_mem_ssl(server_ctx);
+    SSL_set_connect_state(client);
+    SSL_set_accept_state(server);
+
+    for (i = 0; i < 20 && (!SSL_is_init_finished(client) || !SSL_is_init_finished(server)); ++i)
+    {
+        SSL_do_handshake(client);
+        transfer(client, server);
+        SSL_do_handshake(server);
+        transfer(server, client);
+    }
+    CHECK(SSL_is_init_finished(client) && SSL_is_init_finished(server));
+
+    client_engine = srtp_engine_new_from_ssl(client);
+    server_engine = srtp_engine_new_from_ssl(server);
+    CHECK(client_engine && server_engine);
+    CHECK(srtp_engine_get_profile(client_engine) == srtp_engine_get_profile(server_engine));
+    CHECK(srtp_engine_get_profile(client_engine) == SSL_get_selected_srtp_profile(client)->id);
+    printf("dtls-srtp: negotiated %s\n", SSL_get_selected_srtp_profile(client)->name);
+
+    rtp_round_trip(client_engine, server_engine, 1, 0);
+    rtp_round_trip(server_engine, client_engine, 1, 1);
+
+    srtp_engine_destroy(client_engine);
+    srtp_engine_destroy(server_engine);
+    SSL_free(client);
+    SSL_free(server);
+    SSL_CTX_free(client_ctx);
+    SSL_CTX_free(server_ctx);
+
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned i;
+
+    if (argc < 3)
+    {
+        printf("usage: %s <cert file> <key file>\n", argv[0]);
+        return 0;
+    }
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    test_kdf();
+
+    for (i = 0; i < sizeof(g_profiles)/sizeof(g_profiles[0]); ++i)
+    {
+        test_profile(g_profiles[i]);
+        printf("profile %lu: round trip, roc rollover, reorder, tamper, replay ok\n", g_profiles[i]);
+    }
+
+    test_batch();
+
+    test_dtls_srtp(argv[1], argv[2]);
+
+    printf("all checks passed\n");
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+
+#include "tinylib/net/tcp_client_pool.h"
+#include "tinylib/net/tcp_server.h"
+#include "tinylib/util/log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#define ECHO_PORT 15360
+
+static loop_t *g_loop = NULL;
+static tcp_client_pool_t *g_pool = NULL;
+static int g_accepted = 0;
+static int g_round = 0;
+static int g_concurrent = 0;
+
+static void next_round(void);
+
+static
+void server_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    tcp_connection_send(connection, buffer_peek(buffer), buffer_readablebytes(buffer));
+    buffer_retrieveall(buffer);
+
+    return;
+}
+
+static
+void server_onclose(tcp_connection_t* connection, void* userdata)
+{
+    tcp_connection_destroy(connection);
+    return;
+}
+
+static
+void server_onconnection(tcp_connection_t* connection, void* userdata, const inetaddr_t* addr)
+{
+    g_accepted++;
+    tcp_connection_setcalback(connection, server_ondata, server_onclose, NULL);
+
+    return;
+}
+
+static
+void client_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    buffer_retrieveall(buffer);
+
+    /* 收到完整应答之后归还连接 */
+    tcp_client_pool_release(g_pool, connection, 1);
+
+    if (userdata == NULL)
+    {
+        next_round();
+    }
+    else
+    {
+        g_concurrent--;
+        if (0 == g_concurrent)
+        {
+            printf("3 queued borrows done, accepted connections: %d\n", g_accepted);
+        }
+    }
+
+    return;
+}
+
+static
+void client_onclose(tcp_connection_t* connection, void* userdata)
+{
+    printf("pooled connection closed by peer\n");
+    return;
+}
+
+static
+void on_borrowed(tcp_connection_t* connection, void *userdata)
+{
+    const char request[] = "ping";
+
+    assert(NULL != connection);
+    tcp_connection_send(connection, request, sizeof(request));
+
+    return;
+}
+
+static
+void on_check_idle(void *userdata)
+{
+    unsigned idle_count = 0;
+    unsigned total_count = 0;
+
+    tcp_client_pool_stat(g_pool, &idle_count, &total_count);
+    printf("after idle timeout: idle %u, total %u\n", idle_count, total_count);
+
+    loop_quit(g_loop);
+
+    return;
+}
+
+static
+void next_round(void)
+{
+    unsigned idle_count = 0;
+    unsigned total_count = 0;
+
+    g_round++;
+    if (g_round <= 10)
+    {
+        tcp_client_pool_borrow(g_pool, "127.0.0.1", ECHO_PORT, on_borrowed, client_ondata, client_onclose, NULL);
+        return;
+    }
+
+    tcp_client_pool_stat(g_pool, &idle_count, &total_count);
+    printf("10 sequential rounds done, accepted connections: %d, idle %u, total %u\n", g_accepted, idle_count, total_count);
+
+    /* 每个对端最多2个连接，第3个借用请求排队等待归还 */
+    g_concurrent = 3;
+    tcp_client_pool_borrow(g_pool, "127.0.0.1", ECHO_PORT, on_borrowed, client_ondata, client_onclose, &g_concurrent);
+    tcp_client_pool_borrow(g_pool, "127.0.0.1", ECHO_PORT, on_borrowed, client_ondata, client_onclose, &g_concurrent);
+    tcp_client_pool_borrow(g_pool, "127.0.0.1", ECHO_PORT, on_borrowed, client_ondata, client_onclose, &g_concurrent);
+
+    loop_runafter(g_loop, 1000, on_check_idle, NULL);
+
+    return;
+}
+
+static
+void start(void *userdata)
+{
+    next_round();
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    tcp_server_t *server;
+
+    log_setlevel(LOG_LEVEL_INFO);
+
+    g_loop = loop_new(64);
+    assert(g_loop);
+
+    server = tcp_server_new(g_loop, server_onconnection, NULL, ECHO_PORT, "127.0.0.1");
+    tcp_server_start(server);
+
+    g_pool = tcp_client_pool_new(g_loop, 2, 2, 300);
+
+    loop_async(g_loop, start, NULL);
+    loop_loop(g_loop);
+
+    tcp_client_pool_destroy(g_pool);
+    tcp_server_destroy(server);
+    loop_destroy(g_loop);
+
+    return 0;
+}
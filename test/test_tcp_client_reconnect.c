@@ -0,0 +1,96 @@
+
+#include "tinylib/net/tcp_client.h"
+#include "tinylib/net/tcp_server.h"
+#include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
+
+#include <stdio.h>
+#include <assert.h>
+
+#define SERVER_PORT 15370
+
+static loop_t *g_loop = NULL;
+static tcp_server_t *g_server = NULL;
+static tcp_client_t *g_client = NULL;
+static tcp_client_t *g_blackhole_client = NULL;
+static unsigned long long g_start;
+
+static
+void on_data(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    buffer_retrieveall(buffer);
+    return;
+}
+
+static
+void on_close(tcp_connection_t* connection, void* userdata)
+{
+    return;
+}
+
+static
+void server_onconnection(tcp_connection_t* connection, void* userdata, const inetaddr_t* addr)
+{
+    tcp_connection_destroy(connection);
+    return;
+}
+
+static
+void on_blackhole_connected(tcp_connection_t* connection, void *userdata)
+{
+    printf("connect to blackhole %s after %llu ms\n", (NULL == connection ? "failed" : "succeeded"), ts_ms() - g_start);
+    loop_quit(g_loop);
+
+    return;
+}
+
+static
+void on_connected(tcp_connection_t* connection, void *userdata)
+{
+    printf("connect to 127.0.0.1:%u %s after %llu ms\n", SERVER_PORT, (NULL == connection ? "failed" : "succeeded"), ts_ms() - g_start);
+
+    /* 不可路由的地址，由连接超时结束 */
+    g_start = ts_ms();
+    g_blackhole_client = tcp_client_new(g_loop, "10.255.255.1", 80, on_blackhole_connected, on_data, on_close, NULL);
+    tcp_client_set_connect_timeout(g_blackhole_client, 300, 0);
+    tcp_client_connect(g_blackhole_client);
+
+    return;
+}
+
+static
+void start_server(void *userdata)
+{
+    printf("server started after %llu ms\n", ts_ms() - g_start);
+
+    g_server = tcp_server_new(g_loop, server_onconnection, NULL, SERVER_PORT, "127.0.0.1");
+    tcp_server_start(g_server);
+
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    log_setlevel(LOG_LEVEL_WARN);
+
+    g_loop = loop_new(64);
+    assert(g_loop);
+
+    /* 服务端延后启动，客户端在此之前的连接都会被拒绝，依靠退避重试最终连上 */
+    g_start = ts_ms();
+    g_client = tcp_client_new(g_loop, "127.0.0.1", SERVER_PORT, on_connected, on_data, on_close, NULL);
+    tcp_client_set_connect_timeout(g_client, 1000, 250);
+    tcp_client_set_reconnect(g_client, 50, 400, 0);
+    tcp_client_connect(g_client);
+
+    loop_runafter(g_loop, 600, start_server, NULL);
+
+    loop_loop(g_loop);
+
+    tcp_client_destroy(g_client);
+    tcp_client_destroy(g_blackhole_client);
+    tcp_server_destroy(g_server);
+    loop_destroy(g_loop);
+
+    return 0;
+}
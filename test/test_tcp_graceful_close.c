@@ -0,0 +1,194 @@
+
+#include "tinylib/net/tcp_server.h"
+#include "tinylib/net/tcp_client.h"
+#include "tinylib/util/log.h"
+#include "test/test_check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define SERVER_PORT 15390
+#define PAYLOAD_SIZE (4*1024*1024)
+
+static loop_t *g_loop = NULL;
+static int g_step = 0;
+static unsigned g_received = 0;
+static int g_raw_fd = -1;
+static tcp_client_t *g_client = NULL;
+
+/* step 1: 服务端以 sendv 分4段发出大量数据后立即 destroy，客户端应按序完整收到全部数据再收到 FIN
+ * step 2: 服务端 abort，客户端应收到 RST
+ * step 3: 对端既不读也不关闭，服务端在关闭超时之后以 RST 中止
+ */
+
+static
+void server_onclose(tcp_connection_t* connection, void* userdata)
+{
+    tcp_connection_destroy(connection);
+    return;
+}
+
+static
+void server_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    buffer_retrieveall(buffer);
+    return;
+}
+
+static
+void server_onconnection(tcp_connection_t* connection, void* userdata, const inetaddr_t* addr)
+{
+    char *payload;
+    struct iovec vecs[4];
+    int i;
+
+    tcp_connection_setcalback(connection, server_ondata, server_onclose, NULL);
+
+    if (1 == g_step)
+    {
+        /* 每段以不同的字符填充，客户端据此校验数据的先后次序 */
+        payload = (char*)malloc(PAYLOAD_SIZE);
+        for (i = 0; i < 4; ++i)
+        {
+            vecs[i].iov_base = payload + i * (PAYLOAD_SIZE/4);
+            vecs[i].iov_len = PAYLOAD_SIZE/4;
+            memset(vecs[i].iov_base, ('a' + i), vecs[i].iov_len);
+        }
+        tcp_connection_sendv(connection, vecs, 4);
+        free(payload);
+        tcp_connection_destroy(connection);
+    }
+    else if (2 == g_step)
+    {
+        tcp_connection_send(connection, "discarded", 9);
+        tcp_connection_abort(connection);
+    }
+    else
+    {
+        tcp_connection_set_close_timeout(connection, 200);
+        tcp_connection_send(connection, "bye", 3);
+        tcp_connection_destroy(connection);
+    }
+
+    return;
+}
+
+static
+void client_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    const char *data;
+    int size;
+    int i;
+
+    data = (const char*)buffer_peek(buffer);
+    size = buffer_readablebytes(buffer);
+    for (i = 0; i < size; ++i)
+    {
+        CHECK(data[i] == ('a' + (g_received + i) / (PAYLOAD_SIZE/4)));
+    }
+
+    g_received += size;
+    buffer_retrieveall(buffer);
+
+    return;
+}
+
+static
+void check_raw_client(void *userdata)
+{
+    struct tcp_info info;
+    socklen_t len;
+
+    len = sizeof(info);
+    memset(&info, 0, len);
+    getsockopt(g_raw_fd, IPPROTO_TCP, TCP_INFO, &info, &len);
+    printf("step 3: raw client tcp state: %u\n", info.tcpi_state);
+    CHECK(TCP_CLOSE == info.tcpi_state);
+    close(g_raw_fd);
+
+    loop_quit(g_loop);
+
+    return;
+}
+
+static
+void start_raw_client(void)
+{
+    struct sockaddr_in addr;
+
+    g_step = 3;
+    g_raw_fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SERVER_PORT);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    connect(g_raw_fd, (struct sockaddr*)&addr, sizeof(addr));
+
+    loop_runafter(g_loop, 1000, check_raw_client, NULL);
+
+    return;
+}
+
+static
+void client_onclose(tcp_connection_t* connection, void* userdata)
+{
+    if (1 == g_step)
+    {
+        printf("step 1: received %u bytes before close\n", g_received);
+        CHECK(PAYLOAD_SIZE == g_received);
+
+        g_step = 2;
+        g_received = 0;
+        tcp_client_connect(g_client);
+    }
+    else if (2 == g_step)
+    {
+        printf("step 2: connection reset, received %u bytes\n", g_received);
+        CHECK(0 == g_received);
+        start_raw_client();
+    }
+
+    return;
+}
+
+static
+void client_onconnected(tcp_connection_t* connection, void *userdata)
+{
+    CHECK(NULL != connection);
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    tcp_server_t *server;
+
+    signal(SIGPIPE, SIG_IGN);
+    log_setlevel(LOG_LEVEL_INFO);
+
+    g_loop = loop_new(64);
+    CHECK(g_loop);
+
+    server = tcp_server_new(g_loop, server_onconnection, NULL, SERVER_PORT, "127.0.0.1");
+    tcp_server_start(server);
+
+    g_step = 1;
+    g_client = tcp_client_new(g_loop, "127.0.0.1", SERVER_PORT, client_onconnected, client_ondata, client_onclose, NULL);
+    tcp_client_connect(g_client);
+
+    loop_loop(g_loop);
+
+    tcp_client_destroy(g_client);
+    tcp_server_destroy(server);
+    loop_destroy(g_loop);
+
+    printf("all steps passed\n");
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 
 #include "tinylib/ssl/tls_client.h"
 #include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
 
 #if defined(WIN32)
   #include <winsock2.h>
@@ -8,6 +9,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <openssl/ssl.h>
 
@@ -86,6 +88,155 @@ void on_close(tls_client_t* tls_client, void* userdata)
     return;
 }
 
+/* 握手速率测试: 同时保持 concurrency 个连接，各自反复建立连接，发出一行请求并收到应答之后即断开
+ * 服务端可使用 openssl s_server -rev -early_data -accept <port> -cert <cert> -key <key>
+ * 期间以 1ms 的周期性 timer 探测 loop 的最大停顿，比较握手在 loop 线程与工作线程中执行时的差异
+ */
+static tls_context_t *bench_context = NULL;
+static tls_worker_pool_t *bench_pool = NULL;
+static int bench_concurrency = 1;
+static int bench_active = 0;
+static unsigned long long bench_last_tick = 0;
+static unsigned long long bench_max_stall = 0;
+static const char *bench_ip = NULL;
+static unsigned short bench_port = 0;
+static unsigned long long bench_end = 0;
+static int bench_handshakes = 0;
+static int bench_reused = 0;
+static int bench_early_data = 0;
+
+static void bench_connect(void);
+
+static
+void bench_on_connect(tls_client_t* tls_client, int ok, void* userdata)
+{
+    if (!ok)
+    {
+        log_error("bench_on_connect: handshake failed");
+        tls_client_destroy(tls_client);
+        bench_active--;
+        loop_quit(loop);
+        return;
+    }
+
+    bench_handshakes++;
+    bench_reused += tls_client_session_reused(tls_client);
+
+    return;
+}
+
+static
+void bench_on_data(tls_client_t* tls_client, buffer_t* buffer, void* userdata)
+{
+    /* 收到应答时 TLSv1.3 的 ticket 也已处理完毕，可供下次连接恢复会话 */
+    if (memchr(buffer_peek(buffer), '\n', buffer_readablebytes(buffer)) == NULL)
+    {
+        return;
+    }
+    buffer_retrieveall(buffer);
+    tls_client_destroy(tls_client);
+    bench_active--;
+
+    if (ts_ms() < bench_end)
+    {
+        bench_connect();
+    }
+    else if (bench_active == 0)
+    {
+        loop_quit(loop);
+    }
+
+    return;
+}
+
+static
+void bench_on_close(tls_client_t* tls_client, void* userdata)
+{
+    log_error("bench_on_close: connection closed by server");
+    tls_client_destroy(tls_client);
+    loop_quit(loop);
+    return;
+}
+
+static
+void bench_connect(void)
+{
+    const char *request = "ping\n";
+    tls_client_t *tls_client;
+
+    tls_client = tls_client_new(loop, bench_ip, bench_port, bench_on_connect, bench_on_data, bench_on_close, NULL);
+    tls_client_set_context(tls_client, bench_context);
+    tls_client_set_handshake_pool(tls_client, bench_pool);
+    /* 先行提交请求，可以 early data 发出时随 ClientHello 一起发送，否则握手完成之后再发 */
+    tls_client_send_early(tls_client, request, strlen(request));
+    tls_client_connect(tls_client);
+    bench_active++;
+
+    return;
+}
+
+static
+void bench_on_tick(void *userdata)
+{
+    unsigned long long now = ts_ms();
+
+    if (now - bench_last_tick > bench_max_stall)
+    {
+        bench_max_stall = now - bench_last_tick;
+    }
+    bench_last_tick = now;
+
+    return;
+}
+
+static
+void bench_handshake(int resume, int seconds)
+{
+    unsigned long long start;
+    unsigned long long elapsed;
+    loop_timer_t *tick_timer;
+    int i;
+
+    bench_context = tls_context_new(TLS_CONTEXT_MODE_CLIENT);
+    if (!resume)
+    {
+        /* 不缓存会话，每次都是完整握手 */
+        SSL_CTX_set_session_cache_mode(tls_context_get_ssl_ctx(bench_context), SSL_SESS_CACHE_OFF);
+    }
+    if (bench_early_data)
+    {
+        tls_context_set_max_early_data(bench_context, 16384);
+    }
+
+    bench_handshakes = 0;
+    bench_reused = 0;
+    bench_active = 0;
+    bench_max_stall = 0;
+    start = ts_ms();
+    bench_end = start + seconds * 1000;
+    bench_last_tick = start;
+
+    loop = loop_new(64);
+    tick_timer = loop_runevery(loop, 1, bench_on_tick, NULL);
+    for (i = 0; i < bench_concurrency; ++i)
+    {
+        bench_connect();
+    }
+    loop_loop(loop);
+    loop_cancel(loop, tick_timer);
+    loop_destroy(loop);
+
+    elapsed = ts_ms() - start;
+    printf("%s: %d handshakes(%d resumed) in %lld ms, %.1f handshakes/s, max loop stall: %llu ms\n",
+        resume ? "with resumption" : "without resumption", bench_handshakes, bench_reused, (long long)elapsed,
+        elapsed > 0 ? bench_handshakes * 1000.0 / elapsed : 0.0, bench_max_stall);
+
+    tls_context_destroy(bench_context);
+    bench_context = NULL;
+
+    return;
+}
+
 void fill_random_packet(void)
 {
     int i;
@@ -104,6 +255,26 @@ int main(int argc, char *argv[])
     if (argc < 5)
     {
         printf("usage: %s <ssl echo server ip> <ssl echo server port> <input file> <out file>\n", argv[0]);
+        printf("       %s <ssl server ip> <ssl server port> -handshake <seconds> [early data(0/1)] [concurrency] [worker threads]\n", argv[0]);
+        return 0;
+    }
+
+    if (strcmp(argv[3], "-handshake") == 0)
+    {
+        SSL_library_init();
+        SSL_load_error_strings();
+
+        bench_ip = argv[1];
+        bench_port = (unsigned short)atoi(argv[2]);
+        bench_early_data = (argc > 5 && atoi(argv[5]) != 0);
+        bench_concurrency = (argc > 6 && atoi(argv[6]) > 0) ? atoi(argv[6]) : 1;
+        if (argc > 7 && atoi(argv[7]) > 0)
+        {
+            bench_pool = tls_worker_pool_new((unsigned)atoi(argv[7]));
+        }
+        bench_handshake(0, atoi(argv[4]));
+        bench_handshake(1, atoi(argv[4]));
+        tls_worker_pool_destroy(bench_pool);
         return 0;
     }
 
@@ -0,0 +1,399 @@
+
+/* tls_server 与 tls_connection 的测试
+ *   1. 多个客户端共用一个客户端 tls_context，握手完成之前即提交数据，之后再以 sendv 分段发送一大块数据，
+ *      服务端原样回显，客户端校验收到的全部数据；另有一个明文客户端，其握手应失败并被服务端关闭
+ *   2. 再以同一 context 连接一次，应恢复之前的会话
+ *   3. tls_client 先完整握手一次取得 ticket，再次连接时恢复会话，并以 0-RTT 发出请求，握手均在工作线程中进行
+ *
+ * usage: test_tls_server <cert file> <key file>
+ */
+
+#include "tinylib/ssl/tls_server.h"
+#include "tinylib/ssl/tls_client.h"
+#include "tinylib/util/log.h"
+#include "test/test_check.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+
+#define SERVER_PORT 15443
+#define CLIENT_COUNT 8
+#define PAYLOAD_SIZE (256*1024)
+#define EARLY_REQUEST "early request\n"
+
+struct client
+{
+    int index;
+    tls_connection_t *tls_connection;
+    unsigned received;
+    int is_done;
+};
+
+static loop_t *g_loop = NULL;
+static tls_context_t *g_client_context = NULL;
+static struct client g_clients[CLIENT_COUNT];
+static char *g_payload = NULL;
+static int g_accepted = 0;
+static int g_done = 0;
+static int g_plain_closed = 0;
+
+static struct client g_resumed_client;
+static tls_context_t *g_early_context = NULL;
+static tls_worker_pool_t *g_pool = NULL;
+static int g_early_round = 0;
+static int g_early_accepted = 0;
+static int g_early_reused = 0;
+
+static
+void quit(void *userdata)
+{
+    loop_quit(g_loop);
+    return;
+}
+
+static void start_resumed_client(void *userdata);
+
+static
+void check_quit(void)
+{
+    /* 稍候片刻，让服务端处理完对端的关闭 */
+    if (g_done == CLIENT_COUNT && g_plain_closed)
+    {
+        loop_runafter(g_loop, 100, start_resumed_client, NULL);
+    }
+
+    return;
+}
+
+static
+void server_ondata(tls_connection_t* tls_connection, buffer_t* buffer, void* userdata)
+{
+    tls_connection_send(tls_connection, buffer_peek(buffer), buffer_readablebytes(buffer));
+    buffer_retrieveall(buffer);
+    return;
+}
+
+static
+void server_onclose(tls_connection_t* tls_connection, void* userdata)
+{
+    tls_connection_destroy(tls_connection);
+    return;
+}
+
+static
+void server_onconnection(tls_connection_t* tls_connection, void* userdata, const inetaddr_t* peer_addr)
+{
+    SSL *ssl = tls_connection_getssl(tls_connection);
+
+    printf("server: connection from %s:%u, %s, resumed: %d, early data: %d\n", peer_addr->ip, peer_addr->port,
+        SSL_get_version(ssl), SSL_session_reused(ssl), SSL_get_early_data_status(ssl));
+    if (SSL_get_early_data_status(ssl) == SSL_EARLY_DATA_ACCEPTED)
+    {
+        g_early_accepted++;
+    }
+    g_accepted++;
+    tls_connection_setcallback(tls_connection, NULL, server_ondata, server_onclose, NULL);
+    return;
+}
+
+static
+void client_onhandshake(tls_connection_t* tls_connection, int ok, void* userdata)
+{
+    struct client *client = (struct client*)userdata;
+    struct iovec vecs[3];
+
+    CHECK(ok);
+    if (client == &g_resumed_client)
+    {
+        CHECK(SSL_session_reused(tls_connection_getssl(tls_connection)));
+    }
+
+    /* 分三段发送，加密之后一并交给 tcp_connection */
+    vecs[0].iov_base = g_payload;
+    vecs[0].iov_len = 1000;
+    vecs[1].iov_base = g_payload + 1000;
+    vecs[1].iov_len = PAYLOAD_SIZE/2 - 1000;
+    vecs[2].iov_base = g_payload + PAYLOAD_SIZE/2;
+    vecs[2].iov_len = PAYLOAD_SIZE/2;
+    CHECK(0 == tls_connection_sendv(client->tls_connection, vecs, 3));
+
+    return;
+}
+
+static void start_early_client(void *userdata);
+
+static
+void client_ondata(tls_connection_t* tls_connection, buffer_t* buffer, void* userdata)
+{
+    struct client *client = (struct client*)userdata;
+    char hello[32];
+    int hello_len;
+    const char *data;
+    int size;
+
+    hello_len = snprintf(hello, sizeof(hello), "hello %d", client->index);
+    data = (const char*)buffer_peek(buffer);
+    size = buffer_readablebytes(buffer);
+
+    /* 先是握手之前提交的 hello，之后是 payload */
+    if (client->received < (unsigned)hello_len)
+    {
+        if (size < hello_len)
+        {
+            return;
+        }
+        CHECK(0 == memcmp(data, hello, hello_len));
+        buffer_retrieve(buffer, hello_len);
+        client->received += hello_len;
+        data += hello_len;
+        size -= hello_len;
+    }
+
+    CHECK(client->received - hello_len + size <= PAYLOAD_SIZE);
+    CHECK(0 == memcmp(data, g_payload + client->received - hello_len, size));
+    client->received += size;
+    buffer_retrieveall(buffer);
+
+    if (client->received == (unsigned)hello_len + PAYLOAD_SIZE)
+    {
+        client->is_done = 1;
+        tls_connection_destroy(tls_connection);
+        client->tls_connection = NULL;
+        g_done++;
+        if (client == &g_resumed_client)
+        {
+            loop_runafter(g_loop, 10, start_early_client, NULL);
+        }
+        else
+        {
+            check_quit();
+        }
+    }
+
+    return;
+}
+
+static
+void client_onclose(tls_connection_t* tls_connection, void* userdata)
+{
+    CHECK(0);
+    return;
+}
+
+static
+int connect_server(void)
+{
+    struct sockaddr_in addr;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(SERVER_PORT);
+    CHECK(0 == connect(fd, (struct sockaddr*)&addr, sizeof(addr)));
+    set_socket_onblock(fd, 1);
+
+    return fd;
+}
+
+static
+void plain_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    buffer_retrieveall(buffer);
+    return;
+}
+
+static
+void plain_onclose(tcp_connection_t* connection, void* userdata)
+{
+    printf("plain client: closed by server\n");
+    tcp_connection_destroy(connection);
+    g_plain_closed = 1;
+    check_quit();
+    return;
+}
+
+static
+void start_clients(void *userdata)
+{
+    const char *request = "GET / HTTP/1.0\r\n\r\n";
+    tcp_connection_t *connection;
+    inetaddr_t addr;
+    char hello[32];
+    int i;
+
+    inetaddr_initbyipport(&addr, "127.0.0.1", SERVER_PORT);
+
+    for (i = 0; i < CLIENT_COUNT; ++i)
+    {
+        g_clients[i].index = i;
+        connection = tcp_connection_new(g_loop, connect_server(), plain_ondata, plain_onclose, NULL, &addr);
+        g_clients[i].tls_connection = tls_connection_new(connection, g_client_context,
+            client_onhandshake, client_ondata, client_onclose, &g_clients[i]);
+        CHECK(g_clients[i].tls_connection);
+
+        /* 握手完成之前提交的数据 */
+        snprintf(hello, sizeof(hello), "hello %d", i);
+        CHECK(0 == tls_connection_send(g_clients[i].tls_connection, hello, strlen(hello)));
+    }
+
+    connection = tcp_connection_new(g_loop, connect_server(), plain_ondata, plain_onclose, NULL, &addr);
+    tcp_connection_send(connection, request, strlen(request));
+
+    return;
+}
+
+static
+void early_on_connect(tls_client_t* tls_client, int ok, void* userdata)
+{
+    CHECK(ok);
+    g_early_reused += tls_client_session_reused(tls_client);
+    return;
+}
+
+static
+void early_on_data(tls_client_t* tls_client, buffer_t* buffer, void* userdata)
+{
+    if (buffer_readablebytes(buffer) < (int)strlen(EARLY_REQUEST))
+    {
+        return;
+    }
+    CHECK(0 == memcmp(buffer_peek(buffer), EARLY_REQUEST, strlen(EARLY_REQUEST)));
+    buffer_retrieveall(buffer);
+    tls_client_destroy(tls_client);
+
+    /* 第一次完整握手之后已收到 ticket，第二次连接时恢复会话并发出 0-RTT 数据 */
+    g_early_round++;
+    if (g_early_round < 2)
+    {
+        loop_runafter(g_loop, 10, start_early_client, NULL);
+    }
+    else
+    {
+        loop_runafter(g_loop, 100, quit, NULL);
+    }
+
+    return;
+}
+
+static
+void early_on_close(tls_client_t* tls_client, void* userdata)
+{
+    CHECK(0);
+    return;
+}
+
+static
+void start_early_client(void *userdata)
+{
+    tls_client_t *tls_client;
+
+    tls_client = tls_client_new(g_loop, "127.0.0.1", SERVER_PORT, early_on_connect, early_on_data, early_on_close, NULL);
+    CHECK(tls_client);
+    CHECK(0 == tls_client_set_context(tls_client, g_early_context));
+    CHECK(0 == tls_client_set_handshake_pool(tls_client, g_pool));
+    CHECK(0 == tls_client_send_early(tls_client, EARLY_REQUEST, strlen(EARLY_REQUEST)));
+    CHECK(0 == tls_client_connect(tls_client));
+
+    return;
+}
+
+static
+void start_resumed_client(void *userdata)
+{
+    tcp_connection_t *connection;
+    inetaddr_t addr;
+    char hello[32];
+
+    inetaddr_initbyipport(&addr, "127.0.0.1", SERVER_PORT);
+    g_resumed_client.index = CLIENT_COUNT;
+    connection = tcp_connection_new(g_loop, connect_server(), plain_ondata, plain_onclose, NULL, &addr);
+    g_resumed_client.tls_connection = tls_connection_new(connection, g_client_context,
+        client_onhandshake, client_ondata, client_onclose, &g_resumed_client);
+    CHECK(g_resumed_client.tls_connection);
+
+    snprintf(hello, sizeof(hello), "hello %d", CLIENT_COUNT);
+    CHECK(0 == tls_connection_send(g_resumed_client.tls_connection, hello, strlen(hello)));
+
+    return;
+}
+
+static
+void on_timeout(void *userdata)
+{
+    printf("timed out\n");
+    CHECK(0);
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    tls_context_t *server_context;
+    tls_server_t *server;
+    loop_timer_t *timer;
+    int i;
+
+    if (argc < 3)
+    {
+        printf("usage: %s <cert file> <key file>\n", argv[0]);
+        return 0;
+    }
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    g_payload = (char*)malloc(PAYLOAD_SIZE);
+    for (i = 0; i < PAYLOAD_SIZE; ++i)
+    {
+        g_payload[i] = (char)(i * 7 + i / 251);
+    }
+
+    server_context = tls_context_new(TLS_CONTEXT_MODE_SERVER);
+    CHECK(server_context);
+    CHECK(0 == tls_context_use_certificate(server_context, argv[1], argv[2], NULL));
+    tls_context_set_max_early_data(server_context, 16384);
+    g_client_context = tls_context_new(TLS_CONTEXT_MODE_CLIENT);
+    CHECK(g_client_context);
+    g_early_context = tls_context_new(TLS_CONTEXT_MODE_CLIENT);
+    CHECK(g_early_context);
+    tls_context_set_max_early_data(g_early_context, 16384);
+    g_pool = tls_worker_pool_new(2);
+    CHECK(g_pool);
+
+    g_loop = loop_new(64);
+    server = tls_server_new(g_loop, server_context, server_onconnection, NULL, SERVER_PORT, "127.0.0.1");
+    CHECK(server);
+    CHECK(0 == tls_server_start(server));
+
+    loop_runafter(g_loop, 10, start_clients, NULL);
+    timer = loop_runafter(g_loop, 10000, on_timeout, NULL);
+    loop_loop(g_loop);
+    loop_cancel(g_loop, timer);
+
+    CHECK(g_accepted == CLIENT_COUNT + 3);
+    for (i = 0; i < CLIENT_COUNT; ++i)
+    {
+        CHECK(g_clients[i].is_done);
+    }
+    CHECK(g_resumed_client.is_done);
+    CHECK(g_early_round == 2 && g_early_reused == 1 && g_early_accepted == 1);
+
+    tls_server_destroy(server);
+    loop_destroy(g_loop);
+    tls_context_destroy(server_context);
+    tls_context_destroy(g_client_context);
+    tls_context_destroy(g_early_context);
+    tls_worker_pool_destroy(g_pool);
+    free(g_payload);
+
+    printf("all checks passed\n");
+
+    return 0;
+}
@@ -1,7 +1,11 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/async_task_queue.h"
 #include "tinylib/util/log.h"
 #include "tinylib/util/lock.h"
+#include "tinylib/util/util.h"
+#include "tinylib/util/metrics.h"
 
 #include <stdlib.h>        /* for NULL */
 #include <string.h>        /* for memset() */
@@ -14,6 +18,9 @@ struct async_task
 {
     void (*callback)(void *userdata);
     void *userdata;
+  #if METRICS_TIMING
+    unsigned long long submit_us;   /* 提交时刻，用于统计排队时延 */
+  #endif
 
     struct async_task *next;
 };
@@ -104,6 +111,9 @@ void async_task_queue_submit(async_task_queue_t *task_queue, void(*callback)(voi
 
     task->callback = callback;
     task->userdata = userdata;
+  #if METRICS_TIMING
+    task->submit_us = ts_us();
+  #endif
     task->next = NULL;
 
     lock_it(&task_queue->task_lock);
@@ -129,6 +139,11 @@ void async_task_queue_process(async_task_queue_t *task_queue)
 {
     struct async_task *task;
     struct async_task *t_iter;
+    metrics_t *metrics;
+  #if METRICS_TIMING
+    unsigned long long now_us;
+  #endif
+    unsigned depth;
 
     lock_it(&task_queue->task_lock);
     task = task_queue->async_task;
@@ -136,10 +151,30 @@ void async_task_queue_process(async_task_queue_t *task_queue)
     task_queue->async_task_end = NULL;
     unlock_it(&task_queue->task_lock);
 
+    if (NULL == task)
+    {
+        return;
+    }
+
+    depth = 0;
+    for (t_iter = task; NULL != t_iter; t_iter = t_iter->next)
+    {
+        depth++;
+    }
+    metrics = metrics_thread();
+    metrics->async_tasks += depth;
+    histogram_record(&metrics->async_depth, depth);
+
     while (NULL != task)
     {
         t_iter = task->next;
 
+      #if METRICS_TIMING
+        /* 前面任务的执行时间同样计入后面任务的时延 */
+        now_us = ts_us();
+        histogram_record(&metrics->async_latency_us, (now_us > task->submit_us) ? (now_us - task->submit_us) : 0);
+      #endif
+
         task->callback(task->userdata);
         free(task);
 
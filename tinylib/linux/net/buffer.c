@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/buffer.h"
 #include "tinylib/util/log.h"
 
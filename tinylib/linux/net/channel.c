@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/channel.h"
 #include "tinylib/util/util.h"
 #include "tinylib/util/log.h"
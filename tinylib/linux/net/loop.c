@@ -1,5 +1,7 @@
 
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/loop.h"
 #include "tinylib/linux/net/timer_queue.h"
 #include "tinylib/linux/net/async_task_queue.h"
@@ -13,6 +15,7 @@
 #include <errno.h>
 #include <assert.h>
 #include <sys/resource.h>
+#include <time.h>
 
 struct loop
 {
@@ -26,11 +29,30 @@ struct loop
 
     async_task_queue_t *task_queue;
     timer_queue_t *timer_queue;
+
+    int coarse_clock;
+    unsigned long long now_us;
+
+    metrics_t *metrics;     /* loop 线程的计数块，loop_loop() 开始时取得 */
 };
 
 static
 int s_max_open_files = 0;
 
+static inline
+unsigned long long clock_now_us(int coarse)
+{
+    struct timespec tspec;
+
+  #ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(coarse ? CLOCK_MONOTONIC_COARSE : CLOCK_MONOTONIC, &tspec);
+  #else
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+  #endif
+
+    return (unsigned long long)tspec.tv_sec * 1000000 + tspec.tv_nsec / 1000;
+}
+
 static
 void get_max_open_files(void)
 {
@@ -208,14 +230,23 @@ void loop_loop(loop_t *loop)
     struct epoll_event *event;
     channel_t* channel;
     int error;
+    metrics_t *metrics;
+  #if METRICS_TIMING
+    unsigned long long begin_us;
+    unsigned long long start_us;
+    unsigned long long end_us;
+  #endif
 
     if (NULL == loop)
     {
         return;
     }
 
+    metrics = metrics_thread();
+    loop->metrics = metrics;
     loop->threadId = current_tid();
     loop->started = 1;
+    loop->now_us = clock_now_us(loop->coarse_clock);
 
     while (loop->quited == 0)
     {
@@ -223,9 +254,22 @@ void loop_loop(loop_t *loop)
         memset(loop->events, 0, loop->max_event_count * sizeof(struct epoll_event));
         result = epoll_wait(loop->epfd, loop->events, loop->max_event_count, timeout);
         error = errno;
+        /* 本轮迭代中的回调、timer 及日志、rtsp Date 等共用此刻缓存的时间 */
+        loop->now_us = clock_now_us(loop->coarse_clock);
+        time_cache_update();
+
+        metrics->loop_iterations++;
+        metrics->loop_heartbeat_ms = loop->now_us / 1000;
+      #if METRICS_TIMING
+        begin_us = loop->now_us;
+        start_us = begin_us;
+      #endif
 
         if (result > 0)
         {
+            metrics->loop_events += result;
+            histogram_record(&metrics->loop_wakeup_events, result);
+
             for (i = 0; i < result; ++i)
             {
                 event = &(loop->events[i]);
@@ -237,8 +281,23 @@ void loop_loop(loop_t *loop)
                 event = &(loop->events[i]);
                 channel = (channel_t*)event->data.ptr;
                 channel_onevent(channel);
+
+              #if METRICS_TIMING
+                end_us = clock_now_us(loop->coarse_clock);
+                histogram_record(&metrics->loop_callback_us, end_us - start_us);
+                start_us = end_us;
+              #endif
             }
 
+            /* IO 回调可能耗时较长，处理 timer 之前刷新缓存的时间，以免已到期的 timer 被推迟到下一轮；
+             * 统计回调耗时时直接沿用最后一个回调结束的时刻，不再另外读取时钟
+             */
+          #if METRICS_TIMING
+            loop->now_us = end_us;
+          #else
+            loop->now_us = clock_now_us(loop->coarse_clock);
+          #endif
+
             if (result == loop->max_event_count)
             {
                 if (result < s_max_open_files)
@@ -258,10 +317,25 @@ void loop_loop(loop_t *loop)
         {
             log_error("loop_loop: epoll_wait() failed, errno: %d", error);
         }
+        else if (0 == result)
+        {
+            histogram_record(&metrics->loop_wakeup_events, 0);
+        }
 
         timer_queue_process_inloop(loop->timer_queue);
+
+      #if METRICS_TIMING
+        /* 迭代结束的时刻同时用于计算下一轮的等待时间，超时回调耗时较长时不会多等 */
+        end_us = clock_now_us(loop->coarse_clock);
+        histogram_record(&metrics->loop_iteration_us, end_us - begin_us);
+        loop->now_us = end_us;
+      #endif
     }
 
+    /* 已结束的 loop 不应被当作卡住 */
+    metrics->loop_heartbeat_ms = 0;
+    time_cache_invalidate();
+
     return;
 }
 
@@ -295,7 +369,7 @@ loop_timer_t* loop_runafter(loop_t* loop, unsigned interval, onexpire_f expirecb
         return NULL;
     }
 
-    timestamp = ts_ms() + interval;
+    timestamp = loop_now_ms(loop) + interval;
     return timer_queue_add(loop->timer_queue, timestamp, 0, expirecb, userdata);
 }
 
@@ -309,7 +383,7 @@ loop_timer_t* loop_runevery(loop_t* loop, unsigned interval, onexpire_f expirecb
         return NULL;
     }
 
-    timestamp = ts_ms() + interval;
+    timestamp = loop_now_ms(loop) + interval;
     return timer_queue_add(loop->timer_queue, timestamp, interval, expirecb, userdata);
 }
 
@@ -332,3 +406,43 @@ void loop_refresh(loop_t* loop, loop_timer_t *timer)
 
     return;
 }
+
+unsigned long long loop_now_us(loop_t* loop)
+{
+    if (NULL == loop)
+    {
+        return 0;
+    }
+
+    if (loop_inloopthread(loop))
+    {
+        return loop->now_us;
+    }
+
+    return clock_now_us(loop->coarse_clock);
+}
+
+unsigned long long loop_now_ms(loop_t* loop)
+{
+    return loop_now_us(loop) / 1000;
+}
+
+int loop_getmetrics(loop_t* loop, metrics_t *metrics)
+{
+    if (NULL == loop || NULL == metrics || NULL == loop->metrics)
+    {
+        return -1;
+    }
+
+    return metrics_snapshot(loop->metrics, metrics);
+}
+
+void loop_usecoarseclock(loop_t* loop, int enable)
+{
+    if (NULL != loop)
+    {
+        loop->coarse_clock = enable;
+    }
+
+    return;
+}
@@ -9,6 +9,7 @@ typedef struct loop loop_t;
 
 #include "tinylib/linux/net/timer.h"
 #include "tinylib/linux/net/channel.h"
+#include "tinylib/util/metrics.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -68,6 +69,22 @@ void loop_cancel(loop_t* loop, loop_timer_t *timer);
  */
 void loop_refresh(loop_t* loop, loop_timer_t *timer);
 
+/* loop 缓存的单调时间戳，与 ts_ms() 同源
+ * loop 线程中返回本轮迭代缓存的值: epoll_wait() 返回时刷新，处理完IO事件、执行 timer 之前再刷新一次，回调中不再读取时钟；其他线程中读取当前时间
+ */
+unsigned long long loop_now_ms(loop_t* loop);
+unsigned long long loop_now_us(loop_t* loop);
+
+/* 以 CLOCK_MONOTONIC_COARSE 取时间，开销更小，但精度仅为时钟节拍(通常1~4ms)，只在毫秒级精度即可满足时使用
+ * 应在 loop_loop() 之前设置
+ */
+void loop_usecoarseclock(loop_t* loop, int enable);
+
+/* 取得 loop 线程的运行指标，见 tinylib/util/metrics.h
+ * loop 尚未启动或其线程已退出时返回-1
+ */
+int loop_getmetrics(loop_t* loop, metrics_t *metrics);
+
 #ifdef __cplusplus
 }
 #endif
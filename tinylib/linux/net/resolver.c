@@ -0,0 +1,1118 @@
+
+#define LOG_MODULE LOG_MODULE_NET
+
+#include "tinylib/linux/net/resolver.h"
+#include "tinylib/linux/net/udp_peer.h"
+
+#include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define RESOLVER_MAX_NAMESERVERS 3
+#define RESOLVER_REQUEST_BUCKETS 64
+#define RESOLVER_CACHE_BUCKETS 256
+#define RESOLVER_CACHE_MAX_ENTRIES 4096
+#define RESOLVER_MAX_CACHE_TTL 3600
+#define RESOLVER_HOSTS_CHECK_INTERVAL 5000
+
+#define RESOLVER_DEFAULT_TIMEOUT 2000
+#define RESOLVER_DEFAULT_RETRIES 2
+
+#define DNS_HEAD_SIZE 12
+#define DNS_MAX_PACKET_SIZE 512
+#define DNS_TYPE_A 1
+#define DNS_TYPE_CNAME 5
+#define DNS_TYPE_AAAA 28
+#define DNS_CLASS_IN 1
+
+struct cache_entry
+{
+    char name[256];
+    int family;
+    int count;
+    resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+    unsigned long long expire;          /* 过期时戳，hosts 表中的记录为0，表示不过期 */
+
+    struct cache_entry *next;
+};
+
+struct dns_request
+{
+    struct resolver_query *query;
+    unsigned short id;
+    unsigned short type;
+    int is_done;
+
+    struct dns_request *next;
+};
+
+struct resolver_query
+{
+    resolver_t *resolver;
+    char name[256];
+    int family;
+    on_resolved_f resolvedcb;
+    void *userdata;
+
+    /* AF_UNSPEC 时同时发出 A 与 AAAA 两个请求 */
+    struct dns_request requests[2];
+    int request_count;
+    int pending;
+
+    resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+    int count;
+    unsigned min_ttl;
+
+    unsigned tries;
+    unsigned server_index;
+    loop_timer_t *timer;
+
+    int is_canceled;
+
+    struct resolver_query *prev;
+    struct resolver_query *next;
+};
+
+struct resolver
+{
+    loop_t *loop;
+    udp_peer_t *udp_peer;
+
+    inetaddr_t nameservers[RESOLVER_MAX_NAMESERVERS];
+    unsigned nameserver_count;
+
+    unsigned timeout;
+    unsigned retries;
+    unsigned seed;
+
+    struct dns_request *requests[RESOLVER_REQUEST_BUCKETS];
+    struct resolver_query *queries;
+
+    struct cache_entry *cache[RESOLVER_CACHE_BUCKETS];
+    unsigned cache_count;
+
+    struct cache_entry *hosts[RESOLVER_CACHE_BUCKETS];
+    time_t hosts_mtime;
+    unsigned long long hosts_checked;
+
+    int is_in_callback;
+    int is_alive;
+};
+
+static inline
+unsigned name_hash(const char *name)
+{
+    unsigned hash = 5381;
+
+    while (*name)
+    {
+        hash = ((hash << 5) + hash) + (unsigned char)*name;
+        name++;
+    }
+
+    return hash;
+}
+
+/* 统一转为小写并去掉末尾的'.'，返回 0 表示名字合法 */
+static
+int normalize_name(const char *name, char *out, unsigned len)
+{
+    unsigned i;
+
+    for (i = 0; name[i] != '\0'; ++i)
+    {
+        if (i >= (len-1))
+        {
+            return -1;
+        }
+        out[i] = (char)tolower((unsigned char)name[i]);
+    }
+    if (i > 0 && out[i-1] == '.')
+    {
+        i--;
+    }
+    out[i] = '\0';
+
+    return (i == 0) ? -1 : 0;
+}
+
+static inline
+unsigned short next_id(resolver_t *resolver)
+{
+    /* xorshift，避免使用可预测的递增 id */
+    unsigned x = resolver->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    resolver->seed = x;
+
+    return (unsigned short)(x >> 8);
+}
+
+/***************************** 缓存与 hosts *****************************/
+
+static
+struct cache_entry* cache_find(struct cache_entry **table, const char *name, int family)
+{
+    struct cache_entry *entry;
+
+    entry = table[name_hash(name) % RESOLVER_CACHE_BUCKETS];
+    while (NULL != entry)
+    {
+        if (entry->family == family && strcmp(entry->name, name) == 0)
+        {
+            return entry;
+        }
+        entry = entry->next;
+    }
+
+    return NULL;
+}
+
+static
+void cache_clear(struct cache_entry **table)
+{
+    unsigned i;
+    struct cache_entry *entry;
+
+    for (i = 0; i < RESOLVER_CACHE_BUCKETS; ++i)
+    {
+        while (NULL != table[i])
+        {
+            entry = table[i];
+            table[i] = entry->next;
+            free(entry);
+        }
+    }
+
+    return;
+}
+
+static
+void cache_purge_expired(resolver_t *resolver, unsigned long long now)
+{
+    unsigned i;
+    struct cache_entry **link;
+    struct cache_entry *entry;
+
+    for (i = 0; i < RESOLVER_CACHE_BUCKETS; ++i)
+    {
+        link = &resolver->cache[i];
+        while (NULL != *link)
+        {
+            entry = *link;
+            if (entry->expire <= now)
+            {
+                *link = entry->next;
+                free(entry);
+                resolver->cache_count--;
+            }
+            else
+            {
+                link = &entry->next;
+            }
+        }
+    }
+
+    return;
+}
+
+static
+void cache_insert(resolver_t *resolver, struct resolver_query *query)
+{
+    struct cache_entry *entry;
+    unsigned long long now;
+    unsigned ttl;
+    unsigned index;
+
+    ttl = query->min_ttl;
+    if (0 == ttl || 0 == query->count)
+    {
+        return;
+    }
+    if (ttl > RESOLVER_MAX_CACHE_TTL)
+    {
+        ttl = RESOLVER_MAX_CACHE_TTL;
+    }
+
+    now = ts_ms();
+    entry = cache_find(resolver->cache, query->name, query->family);
+    if (NULL == entry)
+    {
+        if (resolver->cache_count >= RESOLVER_CACHE_MAX_ENTRIES)
+        {
+            cache_purge_expired(resolver, now);
+            if (resolver->cache_count >= RESOLVER_CACHE_MAX_ENTRIES)
+            {
+                return;
+            }
+        }
+
+        entry = (struct cache_entry*)malloc(sizeof(*entry));
+        memset(entry, 0, sizeof(*entry));
+        strcpy(entry->name, query->name);
+        entry->family = query->family;
+
+        index = name_hash(entry->name) % RESOLVER_CACHE_BUCKETS;
+        entry->next = resolver->cache[index];
+        resolver->cache[index] = entry;
+        resolver->cache_count++;
+    }
+
+    entry->count = query->count;
+    memcpy(entry->addrs, query->addrs, sizeof(resolver_addr_t) * query->count);
+    entry->expire = now + ttl * 1000ULL;
+
+    return;
+}
+
+static
+void hosts_load(resolver_t *resolver)
+{
+    FILE *fp;
+    char line[512];
+    char name[256];
+    char *token;
+    char *saveptr;
+    char *ip;
+    int family;
+    unsigned char addr[16];
+    struct cache_entry *entry;
+    unsigned index;
+
+    cache_clear(resolver->hosts);
+
+    fp = fopen("/etc/hosts", "r");
+    if (NULL == fp)
+    {
+        return;
+    }
+
+    while (NULL != fgets(line, sizeof(line), fp))
+    {
+        token = strchr(line, '#');
+        if (NULL != token)
+        {
+            *token = '\0';
+        }
+
+        ip = strtok_r(line, " \t\r\n", &saveptr);
+        if (NULL == ip)
+        {
+            continue;
+        }
+        if (inet_pton(AF_INET, ip, addr) == 1)
+        {
+            family = AF_INET;
+        }
+        else if (inet_pton(AF_INET6, ip, addr) == 1)
+        {
+            family = AF_INET6;
+        }
+        else
+        {
+            continue;
+        }
+
+        while (NULL != (token = strtok_r(NULL, " \t\r\n", &saveptr)))
+        {
+            if (normalize_name(token, name, sizeof(name)) != 0)
+            {
+                continue;
+            }
+
+            /* hosts 表中同一名字的 v4/v6 地址记录在同一个条目中，查询时再按 family 过滤 */
+            entry = cache_find(resolver->hosts, name, AF_UNSPEC);
+            if (NULL == entry)
+            {
+                entry = (struct cache_entry*)malloc(sizeof(*entry));
+                memset(entry, 0, sizeof(*entry));
+                strcpy(entry->name, name);
+                entry->family = AF_UNSPEC;
+
+                index = name_hash(entry->name) % RESOLVER_CACHE_BUCKETS;
+                entry->next = resolver->hosts[index];
+                resolver->hosts[index] = entry;
+            }
+
+            if (entry->count < RESOLVER_MAX_ADDRS)
+            {
+                entry->addrs[entry->count].family = family;
+                strncpy(entry->addrs[entry->count].ip, ip, sizeof(entry->addrs[entry->count].ip)-1);
+                entry->count++;
+            }
+        }
+    }
+
+    fclose(fp);
+
+    return;
+}
+
+static
+void hosts_check(resolver_t *resolver, unsigned long long now)
+{
+    struct stat st;
+
+    if (resolver->hosts_checked != 0 && (now - resolver->hosts_checked) < RESOLVER_HOSTS_CHECK_INTERVAL)
+    {
+        return;
+    }
+    resolver->hosts_checked = now;
+
+    memset(&st, 0, sizeof(st));
+    if (stat("/etc/hosts", &st) != 0)
+    {
+        return;
+    }
+
+    if (st.st_mtime != resolver->hosts_mtime)
+    {
+        resolver->hosts_mtime = st.st_mtime;
+        hosts_load(resolver);
+    }
+
+    return;
+}
+
+/* 按 family 从 hosts 或缓存中取结果，返回取到的地址个数 */
+static
+int local_lookup(resolver_t *resolver, struct resolver_query *query)
+{
+    struct cache_entry *entry;
+    unsigned long long now;
+    int i;
+
+    now = ts_ms();
+    hosts_check(resolver, now);
+
+    entry = cache_find(resolver->hosts, query->name, AF_UNSPEC);
+    if (NULL != entry)
+    {
+        query->count = 0;
+        for (i = 0; i < entry->count; ++i)
+        {
+            if (query->family == AF_UNSPEC || query->family == entry->addrs[i].family)
+            {
+                query->addrs[query->count] = entry->addrs[i];
+                query->count++;
+            }
+        }
+        if (query->count > 0)
+        {
+            return query->count;
+        }
+    }
+
+    entry = cache_find(resolver->cache, query->name, query->family);
+    if (NULL != entry && entry->expire > now)
+    {
+        query->count = entry->count;
+        memcpy(query->addrs, entry->addrs, sizeof(resolver_addr_t) * entry->count);
+        return query->count;
+    }
+
+    return 0;
+}
+
+/***************************** DNS 报文 *****************************/
+
+static
+int build_query_packet(unsigned char *packet, unsigned len, unsigned short id, const char *name, unsigned short type)
+{
+    unsigned offset;
+    const char *label;
+    const char *dot;
+    unsigned label_len;
+
+    if (len < (DNS_HEAD_SIZE + strlen(name) + 2 + 4))
+    {
+        return -1;
+    }
+
+    memset(packet, 0, DNS_HEAD_SIZE);
+    packet[0] = (unsigned char)(id >> 8);
+    packet[1] = (unsigned char)(id & 0xff);
+    packet[2] = 0x01;   /* RD */
+    packet[5] = 1;      /* QDCOUNT */
+
+    offset = DNS_HEAD_SIZE;
+    label = name;
+    while (*label != '\0')
+    {
+        dot = strchr(label, '.');
+        label_len = (NULL == dot) ? strlen(label) : (unsigned)(dot - label);
+        if (0 == label_len || label_len > 63)
+        {
+            return -1;
+        }
+
+        packet[offset++] = (unsigned char)label_len;
+        memcpy(packet+offset, label, label_len);
+        offset += label_len;
+
+        label += label_len;
+        if (*label == '.')
+        {
+            label++;
+        }
+    }
+    packet[offset++] = 0;
+
+    packet[offset++] = (unsigned char)(type >> 8);
+    packet[offset++] = (unsigned char)(type & 0xff);
+    packet[offset++] = 0;
+    packet[offset++] = DNS_CLASS_IN;
+
+    return (int)offset;
+}
+
+/* 读出 offset 处的域名(支持压缩指针)，返回名字之后的偏移，出错返回-1 */
+static
+int read_name(const unsigned char *msg, unsigned size, unsigned offset, char *name, unsigned len)
+{
+    unsigned pos;
+    unsigned name_len;
+    unsigned label_len;
+    int end;
+    int jumps;
+    unsigned i;
+
+    pos = offset;
+    name_len = 0;
+    end = -1;
+    jumps = 0;
+
+    while (1)
+    {
+        if (pos >= size)
+        {
+            return -1;
+        }
+
+        label_len = msg[pos];
+        if (0 == label_len)
+        {
+            if (end < 0)
+            {
+                end = (int)pos + 1;
+            }
+            break;
+        }
+        else if ((label_len & 0xc0) == 0xc0)
+        {
+            if ((pos + 1) >= size || ++jumps > 16)
+            {
+                return -1;
+            }
+            if (end < 0)
+            {
+                end = (int)pos + 2;
+            }
+            pos = ((label_len & 0x3f) << 8) | msg[pos+1];
+            continue;
+        }
+        else if (label_len > 63 || (pos + 1 + label_len) > size)
+        {
+            return -1;
+        }
+
+        if (NULL != name)
+        {
+            if ((name_len + label_len + 2) > len)
+            {
+                return -1;
+            }
+            if (name_len > 0)
+            {
+                name[name_len++] = '.';
+            }
+            for (i = 0; i < label_len; ++i)
+            {
+                name[name_len++] = (char)tolower(msg[pos+1+i]);
+            }
+        }
+        pos += 1 + label_len;
+    }
+
+    if (NULL != name)
+    {
+        name[name_len] = '\0';
+    }
+
+    return end;
+}
+
+/***************************** 查询过程 *****************************/
+
+static
+void request_link(resolver_t *resolver, struct dns_request *request)
+{
+    unsigned index = request->id % RESOLVER_REQUEST_BUCKETS;
+
+    request->next = resolver->requests[index];
+    resolver->requests[index] = request;
+
+    return;
+}
+
+static
+void request_unlink(resolver_t *resolver, struct dns_request *request)
+{
+    struct dns_request **link;
+
+    link = &resolver->requests[request->id % RESOLVER_REQUEST_BUCKETS];
+    while (NULL != *link)
+    {
+        if (*link == request)
+        {
+            *link = request->next;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    request->next = NULL;
+
+    return;
+}
+
+static
+struct dns_request* request_find(resolver_t *resolver, unsigned short id)
+{
+    struct dns_request *request;
+
+    request = resolver->requests[id % RESOLVER_REQUEST_BUCKETS];
+    while (NULL != request && request->id != id)
+    {
+        request = request->next;
+    }
+
+    return request;
+}
+
+static
+void query_link(resolver_t *resolver, struct resolver_query *query)
+{
+    query->prev = NULL;
+    query->next = resolver->queries;
+    if (NULL != resolver->queries)
+    {
+        resolver->queries->prev = query;
+    }
+    resolver->queries = query;
+
+    return;
+}
+
+static
+void query_unlink(resolver_t *resolver, struct resolver_query *query)
+{
+    if (NULL != query->prev)
+    {
+        query->prev->next = query->next;
+    }
+    else
+    {
+        resolver->queries = query->next;
+    }
+    if (NULL != query->next)
+    {
+        query->next->prev = query->prev;
+    }
+    query->prev = NULL;
+    query->next = NULL;
+
+    return;
+}
+
+static
+void query_release(resolver_t *resolver, struct resolver_query *query)
+{
+    int i;
+
+    for (i = 0; i < query->request_count; ++i)
+    {
+        request_unlink(resolver, &query->requests[i]);
+    }
+    if (NULL != query->timer)
+    {
+        loop_cancel(resolver->loop, query->timer);
+        query->timer = NULL;
+    }
+    query_unlink(resolver, query);
+
+    return;
+}
+
+static
+void query_finish(resolver_t *resolver, struct resolver_query *query)
+{
+    query_release(resolver, query);
+
+    if (query->count > 0)
+    {
+        cache_insert(resolver, query);
+    }
+    else
+    {
+        log_warn("resolver: failed to resolve %s", query->name);
+    }
+
+    resolver->is_in_callback = 1;
+    query->resolvedcb(query->name, query->addrs, query->count, query->userdata);
+    resolver->is_in_callback = 0;
+    free(query);
+
+    return;
+}
+
+static
+void query_send(resolver_t *resolver, struct resolver_query *query)
+{
+    unsigned char packet[DNS_MAX_PACKET_SIZE];
+    int len;
+    int i;
+    inetaddr_t *server;
+
+    server = &resolver->nameservers[query->server_index % resolver->nameserver_count];
+
+    for (i = 0; i < query->request_count; ++i)
+    {
+        if (query->requests[i].is_done)
+        {
+            continue;
+        }
+
+        len = build_query_packet(packet, sizeof(packet), query->requests[i].id, query->name, query->requests[i].type);
+        if (len < 0 || udp_peer_send(resolver->udp_peer, packet, (unsigned)len, server) != 0)
+        {
+            log_warn("resolver: failed to send query for %s to %s:%u", query->name, server->ip, server->port);
+        }
+    }
+
+    return;
+}
+
+static
+void query_onexpire(void *userdata)
+{
+    struct resolver_query *query = (struct resolver_query*)userdata;
+    resolver_t *resolver = query->resolver;
+
+    query->timer = NULL;
+
+    if (query->tries < resolver->retries)
+    {
+        /* 超时重试时轮换到下一个服务器 */
+        query->tries++;
+        query->server_index++;
+        query_send(resolver, query);
+        query->timer = loop_runafter(resolver->loop, resolver->timeout, query_onexpire, query);
+    }
+    else
+    {
+        /* AF_UNSPEC 时可能只有一类记录已返回，将已有的结果交给用户 */
+        query_finish(resolver, query);
+    }
+
+    return;
+}
+
+static
+void query_deliver_local(void *userdata)
+{
+    struct resolver_query *query = (struct resolver_query*)userdata;
+
+    if (0 == query->is_canceled)
+    {
+        query_unlink(query->resolver, query);
+        query->resolver->is_in_callback = 1;
+        query->resolvedcb(query->name, query->addrs, query->count, query->userdata);
+        query->resolver->is_in_callback = 0;
+    }
+    free(query);
+
+    return;
+}
+
+static
+void resolver_onmessage(udp_peer_t *peer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    resolver_t *resolver = (resolver_t*)userdata;
+    const unsigned char *msg = (const unsigned char*)message;
+
+    struct dns_request *request;
+    struct resolver_query *query;
+    char name[256];
+    unsigned short id;
+    unsigned short flags;
+    unsigned qdcount;
+    unsigned ancount;
+    unsigned i;
+    int offset;
+    unsigned type;
+    unsigned klass;
+    unsigned ttl;
+    unsigned rdlen;
+    resolver_addr_t *addr;
+
+    if (0 == resolver->is_alive || size < DNS_HEAD_SIZE)
+    {
+        return;
+    }
+
+    for (i = 0; i < resolver->nameserver_count; ++i)
+    {
+        if (resolver->nameservers[i].port == peer_addr->port && strcmp(resolver->nameservers[i].ip, peer_addr->ip) == 0)
+        {
+            break;
+        }
+    }
+    if (i == resolver->nameserver_count)
+    {
+        log_warn("resolver: drop dns message from unknown server %s:%u", peer_addr->ip, peer_addr->port);
+        return;
+    }
+
+    id = (unsigned short)((msg[0] << 8) | msg[1]);
+    flags = (unsigned short)((msg[2] << 8) | msg[3]);
+    qdcount = (msg[4] << 8) | msg[5];
+    ancount = (msg[6] << 8) | msg[7];
+
+    request = request_find(resolver, id);
+    if (NULL == request || request->is_done || 0 == (flags & 0x8000) || 1 != qdcount)
+    {
+        return;
+    }
+    query = request->query;
+
+    /* 校验问题部分与请求一致，防止错配/投毒的应答 */
+    offset = read_name(msg, size, DNS_HEAD_SIZE, name, sizeof(name));
+    if (offset < 0 || (unsigned)(offset + 4) > size || strcmp(name, query->name) != 0)
+    {
+        return;
+    }
+    type = (msg[offset] << 8) | msg[offset+1];
+    if (type != request->type)
+    {
+        return;
+    }
+    offset += 4;
+
+    if (flags & 0x0200)
+    {
+        log_warn("resolver: truncated answer for %s, only the records received will be used", query->name);
+    }
+
+    if ((flags & 0x000f) == 0)
+    {
+        for (i = 0; i < ancount; ++i)
+        {
+            offset = read_name(msg, size, (unsigned)offset, NULL, 0);
+            if (offset < 0 || (unsigned)(offset + 10) > size)
+            {
+                break;
+            }
+
+            type = (msg[offset] << 8) | msg[offset+1];
+            klass = (msg[offset+2] << 8) | msg[offset+3];
+            ttl = ((unsigned)msg[offset+4] << 24) | (msg[offset+5] << 16) | (msg[offset+6] << 8) | msg[offset+7];
+            rdlen = (msg[offset+8] << 8) | msg[offset+9];
+            offset += 10;
+            if ((unsigned)offset + rdlen > size)
+            {
+                break;
+            }
+
+            if (klass == DNS_CLASS_IN && query->count < RESOLVER_MAX_ADDRS &&
+                ((type == DNS_TYPE_A && rdlen == 4) || (type == DNS_TYPE_AAAA && rdlen == 16)))
+            {
+                addr = &query->addrs[query->count];
+                addr->family = (type == DNS_TYPE_A) ? AF_INET : AF_INET6;
+                if (inet_ntop(addr->family, msg+offset, addr->ip, sizeof(addr->ip)) != NULL)
+                {
+                    query->count++;
+                    if (ttl < query->min_ttl)
+                    {
+                        query->min_ttl = ttl;
+                    }
+                }
+            }
+
+            offset += rdlen;
+        }
+    }
+    else
+    {
+        log_debug("resolver: %s query for %s answered with rcode %u", (request->type == DNS_TYPE_A ? "A" : "AAAA"), query->name, (flags & 0x000f));
+    }
+
+    request->is_done = 1;
+    request_unlink(resolver, request);
+    query->pending--;
+
+    if (0 == query->pending)
+    {
+        query_finish(resolver, query);
+    }
+
+    return;
+}
+
+static
+void load_resolv_conf(resolver_t *resolver)
+{
+    FILE *fp;
+    char line[256];
+    char *token;
+    char *saveptr;
+    struct in_addr addr;
+
+    fp = fopen("/etc/resolv.conf", "r");
+    if (NULL == fp)
+    {
+        return;
+    }
+
+    while (resolver->nameserver_count < RESOLVER_MAX_NAMESERVERS && NULL != fgets(line, sizeof(line), fp))
+    {
+        token = strtok_r(line, " \t\r\n", &saveptr);
+        if (NULL == token || strcmp(token, "nameserver") != 0)
+        {
+            continue;
+        }
+
+        token = strtok_r(NULL, " \t\r\n", &saveptr);
+        /* udp_peer 仅支持 IPv4，故仅使用 IPv4 的服务器地址 */
+        if (NULL != token && inet_pton(AF_INET, token, &addr) == 1)
+        {
+            inetaddr_initbyipport(&resolver->nameservers[resolver->nameserver_count], token, 53);
+            resolver->nameserver_count++;
+        }
+    }
+
+    fclose(fp);
+
+    return;
+}
+
+resolver_t* resolver_new(loop_t *loop, const char *nameserver, unsigned short port)
+{
+    resolver_t *resolver;
+
+    if (NULL == loop)
+    {
+        log_error("resolver_new: bad loop");
+        return NULL;
+    }
+
+    resolver = (resolver_t*)malloc(sizeof(resolver_t));
+    memset(resolver, 0, sizeof(*resolver));
+
+    resolver->loop = loop;
+    resolver->is_alive = 1;
+    resolver->timeout = RESOLVER_DEFAULT_TIMEOUT;
+    resolver->retries = RESOLVER_DEFAULT_RETRIES;
+    resolver->seed = (unsigned)(ts_ms() ^ ((unsigned long)resolver) ^ (getpid() << 16));
+    if (0 == resolver->seed)
+    {
+        resolver->seed = 0x5eed;
+    }
+
+    if (NULL != nameserver)
+    {
+        inetaddr_initbyipport(&resolver->nameservers[0], nameserver, (0 == port ? 53 : port));
+        resolver->nameserver_count = 1;
+    }
+    else
+    {
+        load_resolv_conf(resolver);
+        if (0 == resolver->nameserver_count)
+        {
+            inetaddr_initbyipport(&resolver->nameservers[0], "127.0.0.1", 53);
+            resolver->nameserver_count = 1;
+        }
+    }
+
+    resolver->udp_peer = udp_peer_new(loop, "0.0.0.0", 0, resolver_onmessage, NULL, resolver);
+    if (NULL == resolver->udp_peer)
+    {
+        log_error("resolver_new: udp_peer_new() failed");
+        free(resolver);
+        return NULL;
+    }
+
+    return resolver;
+}
+
+static
+void delete_resolver(void *userdata)
+{
+    resolver_t *resolver = (resolver_t*)userdata;
+
+    udp_peer_destroy(resolver->udp_peer);
+    cache_clear(resolver->cache);
+    cache_clear(resolver->hosts);
+    free(resolver);
+
+    return;
+}
+
+void resolver_destroy(resolver_t *resolver)
+{
+    struct resolver_query *query;
+
+    if (NULL == resolver || 0 == resolver->is_alive)
+    {
+        return;
+    }
+
+    while (NULL != resolver->queries)
+    {
+        query = resolver->queries;
+        query_release(resolver, query);
+        if (query->request_count > 0)
+        {
+            free(query);
+        }
+        else
+        {
+            /* 已经通过 loop_async 投递的本地结果，由 query_deliver_local() 负责释放 */
+            query->is_canceled = 1;
+        }
+    }
+
+    /* 在解析回调中销毁时，udp_peer 可能仍在派发本轮收到的报文，推迟到本轮事件处理之后再释放 */
+    if (resolver->is_in_callback)
+    {
+        resolver->is_alive = 0;
+        loop_async(resolver->loop, delete_resolver, resolver);
+    }
+    else
+    {
+        delete_resolver(resolver);
+    }
+
+    return;
+}
+
+void resolver_set_timeout(resolver_t *resolver, unsigned timeout_ms, unsigned retries)
+{
+    if (NULL == resolver || 0 == timeout_ms)
+    {
+        return;
+    }
+
+    resolver->timeout = timeout_ms;
+    resolver->retries = retries;
+
+    return;
+}
+
+resolver_query_t* resolver_resolve(resolver_t *resolver, const char *name, int family, on_resolved_f resolvedcb, void *userdata)
+{
+    struct resolver_query *query;
+    unsigned char addr[16];
+    int i;
+
+    if (NULL == resolver || NULL == name || NULL == resolvedcb ||
+        (family != AF_INET && family != AF_INET6 && family != AF_UNSPEC))
+    {
+        log_error("resolver_resolve: bad resolver(%p) or bad name(%p) or bad resolvedcb(%p) or bad family(%d)",
+            resolver, name, resolvedcb, family);
+        return NULL;
+    }
+
+    query = (struct resolver_query*)malloc(sizeof(*query));
+    memset(query, 0, sizeof(*query));
+
+    if (normalize_name(name, query->name, sizeof(query->name)) != 0)
+    {
+        log_error("resolver_resolve: bad name: %s", name);
+        free(query);
+        return NULL;
+    }
+
+    query->resolver = resolver;
+    query->family = family;
+    query->resolvedcb = resolvedcb;
+    query->userdata = userdata;
+    query->min_ttl = (unsigned)-1;
+
+    /* 地址字面量、hosts 表和缓存命中时，不需要网络交互，结果异步投递 */
+    if (inet_pton(AF_INET, query->name, addr) == 1 || inet_pton(AF_INET6, query->name, addr) == 1)
+    {
+        query->addrs[0].family = (strchr(query->name, ':') != NULL) ? AF_INET6 : AF_INET;
+        memcpy(query->addrs[0].ip, query->name, strlen(query->name)+1);  /* 地址字面量不会超过 INET6_ADDRSTRLEN */
+        query->count = 1;
+    }
+    else
+    {
+        (void)local_lookup(resolver, query);
+    }
+
+    query_link(resolver, query);
+
+    if (query->count > 0)
+    {
+        loop_async(resolver->loop, query_deliver_local, query);
+        return query;
+    }
+
+    if (family == AF_INET || family == AF_UNSPEC)
+    {
+        query->requests[query->request_count].type = DNS_TYPE_A;
+        query->request_count++;
+    }
+    if (family == AF_INET6 || family == AF_UNSPEC)
+    {
+        query->requests[query->request_count].type = DNS_TYPE_AAAA;
+        query->request_count++;
+    }
+
+    for (i = 0; i < query->request_count; ++i)
+    {
+        query->requests[i].query = query;
+        do
+        {
+            query->requests[i].id = next_id(resolver);
+        } while (NULL != request_find(resolver, query->requests[i].id));
+        request_link(resolver, &query->requests[i]);
+    }
+    query->pending = query->request_count;
+
+    query_send(resolver, query);
+    query->timer = loop_runafter(resolver->loop, resolver->timeout, query_onexpire, query);
+
+    return query;
+}
+
+void resolver_cancel(resolver_t *resolver, resolver_query_t *query)
+{
+    if (NULL == resolver || NULL == query)
+    {
+        return;
+    }
+
+    query_release(resolver, query);
+    if (query->request_count > 0)
+    {
+        free(query);
+    }
+    else
+    {
+        query->is_canceled = 1;
+    }
+
+    return;
+}
@@ -0,0 +1,61 @@
+
+/** 基于 loop 的非阻塞 DNS 解析器
+ *
+ * 通过 udp_peer 直接构造/解析 DNS 报文，超时由 loop 的 timer 驱动，不会阻塞 loop 线程
+ * 查询之前先查 /etc/hosts 及按 TTL 维护的本地缓存，命中时不产生任何网络交互
+ */
+
+#ifndef TINYLIB_NET_RESOLVER_H
+#define TINYLIB_NET_RESOLVER_H
+
+struct resolver;
+typedef struct resolver resolver_t;
+
+struct resolver_query;
+typedef struct resolver_query resolver_query_t;
+
+#include "tinylib/linux/net/loop.h"
+
+/* 单次解析最多返回的地址个数 */
+#define RESOLVER_MAX_ADDRS 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct resolver_addr
+{
+    int family;         /* AF_INET 或 AF_INET6 */
+    char ip[46];        /* 文本形式的地址 */
+}resolver_addr_t;
+
+/* 解析结果回调，count 为0表示解析失败 */
+typedef void (*on_resolved_f)(const char *name, const resolver_addr_t *addrs, int count, void *userdata);
+
+/* 新建一个解析器
+ * nameserver 为NULL时，使用 /etc/resolv.conf 中配置的服务器，port 为0时默认为53
+ */
+resolver_t* resolver_new(loop_t *loop, const char *nameserver, unsigned short port);
+
+void resolver_destroy(resolver_t *resolver);
+
+/* 设置单次请求的超时时间(ms)及超时之后的重试次数，重试时会轮换使用所配置的各个服务器 */
+void resolver_set_timeout(resolver_t *resolver, unsigned timeout_ms, unsigned retries);
+
+/* 发起一次解析，family 可为 AF_INET/AF_INET6/AF_UNSPEC(同时查询A与AAAA记录)
+ * 结果总是异步通过 resolvedcb 返回，返回的 query 在回调执行之后即失效
+ *
+ * 只能在 loop 线程中调用
+ */
+resolver_query_t* resolver_resolve(resolver_t *resolver, const char *name, int family, on_resolved_f resolvedcb, void *userdata);
+
+/* 取消尚未返回结果的解析，取消之后回调不会再被执行
+ * 只能在 loop 线程中调用
+ */
+void resolver_cancel(resolver_t *resolver, resolver_query_t *query);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_NET_RESOLVER_H */
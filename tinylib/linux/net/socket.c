@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/socket.h"
 #include "tinylib/util/log.h"
 
@@ -127,6 +129,159 @@ void set_socket_nodelay(int fd, int on)
     return;
 }
 
+void socket_options_init(socket_options_t *options)
+{
+    if (NULL == options)
+    {
+        return;
+    }
+
+    memset(options, 0, sizeof(*options));
+    options->keepalive = 1;
+    options->linger = -1;
+
+    return;
+}
+
+static inline
+void set_int_option(int fd, int level, int name, int value, const char *desc)
+{
+    if (setsockopt(fd, level, name, &value, sizeof(value)) != 0)
+    {
+        log_warn("set_socket_options: failed to set %s(%d), errno: %d", desc, value, errno);
+    }
+
+    return;
+}
+
+void set_socket_options(int fd, const socket_options_t *options)
+{
+    struct linger linger_info;
+
+    if (fd < 0 || NULL == options)
+    {
+        log_error("set_socket_options: bad fd(%d) or bad options(%p)", fd, options);
+        return;
+    }
+
+    if (options->nodelay)
+    {
+        set_int_option(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    }
+
+    set_int_option(fd, SOL_SOCKET, SO_KEEPALIVE, (options->keepalive ? 1 : 0), "SO_KEEPALIVE");
+    if (options->keepalive)
+    {
+        if (options->keepalive_idle > 0)
+        {
+            set_int_option(fd, IPPROTO_TCP, TCP_KEEPIDLE, options->keepalive_idle, "TCP_KEEPIDLE");
+        }
+        if (options->keepalive_interval > 0)
+        {
+            set_int_option(fd, IPPROTO_TCP, TCP_KEEPINTVL, options->keepalive_interval, "TCP_KEEPINTVL");
+        }
+        if (options->keepalive_count > 0)
+        {
+            set_int_option(fd, IPPROTO_TCP, TCP_KEEPCNT, options->keepalive_count, "TCP_KEEPCNT");
+        }
+    }
+
+    if (options->linger >= 0)
+    {
+        memset(&linger_info, 0, sizeof(linger_info));
+        linger_info.l_onoff = 1;
+        linger_info.l_linger = options->linger;
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger_info, sizeof(linger_info));
+    }
+
+    if (options->rcvbuf > 0)
+    {
+        set_int_option(fd, SOL_SOCKET, SO_RCVBUF, options->rcvbuf, "SO_RCVBUF");
+    }
+    if (options->sndbuf > 0)
+    {
+        set_int_option(fd, SOL_SOCKET, SO_SNDBUF, options->sndbuf, "SO_SNDBUF");
+    }
+
+    #ifdef TCP_NOTSENT_LOWAT
+    if (options->notsent_lowat > 0)
+    {
+        set_int_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, options->notsent_lowat, "TCP_NOTSENT_LOWAT");
+    }
+    #endif
+
+    #ifdef SO_BUSY_POLL
+    if (options->busy_poll > 0)
+    {
+        set_int_option(fd, SOL_SOCKET, SO_BUSY_POLL, options->busy_poll, "SO_BUSY_POLL");
+    }
+    #endif
+
+    #ifdef TCP_FASTOPEN_CONNECT
+    if (options->fastopen)
+    {
+        set_int_option(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1, "TCP_FASTOPEN_CONNECT");
+    }
+    #endif
+
+    return;
+}
+
+void set_socket_listen_options(int fd, const socket_options_t *options)
+{
+    if (fd < 0 || NULL == options)
+    {
+        log_error("set_socket_listen_options: bad fd(%d) or bad options(%p)", fd, options);
+        return;
+    }
+
+    /* 缓冲区尺寸需在 listen() 之前设置，accept 出的连接继承之，窗口扩大因子才能据此协商 */
+    if (options->rcvbuf > 0)
+    {
+        set_int_option(fd, SOL_SOCKET, SO_RCVBUF, options->rcvbuf, "SO_RCVBUF");
+    }
+    if (options->sndbuf > 0)
+    {
+        set_int_option(fd, SOL_SOCKET, SO_SNDBUF, options->sndbuf, "SO_SNDBUF");
+    }
+
+    if (options->defer_accept > 0)
+    {
+        set_int_option(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, options->defer_accept, "TCP_DEFER_ACCEPT");
+    }
+
+    #ifdef TCP_FASTOPEN
+    if (options->fastopen > 0)
+    {
+        set_int_option(fd, IPPROTO_TCP, TCP_FASTOPEN, options->fastopen, "TCP_FASTOPEN");
+    }
+    #endif
+
+    #ifdef SO_BUSY_POLL
+    if (options->busy_poll > 0)
+    {
+        set_int_option(fd, SOL_SOCKET, SO_BUSY_POLL, options->busy_poll, "SO_BUSY_POLL");
+    }
+    #endif
+
+    return;
+}
+
+void set_socket_cork(int fd, int on)
+{
+    int value = on ? 1 : 0;
+
+    if (fd < 0)
+    {
+        log_error("set_socket_cork: bad fd");
+        return;
+    }
+
+    (void)setsockopt(fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+
+    return;
+}
+
 int create_udp_socket(unsigned short port, const char *ip)
 {
     int fd;
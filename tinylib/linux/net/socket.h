@@ -6,6 +6,36 @@
 extern "C" {
 #endif
 
+/* tcp socket 的可调选项，先以 socket_options_init() 取得默认值再按需修改 */
+typedef struct socket_options
+{
+    int nodelay;                /* TCP_NODELAY */
+    int keepalive;              /* SO_KEEPALIVE */
+    int keepalive_idle;         /* TCP_KEEPIDLE(s)，0 表示使用系统配置，下同 */
+    int keepalive_interval;     /* TCP_KEEPINTVL(s) */
+    int keepalive_count;        /* TCP_KEEPCNT */
+    int linger;                 /* 小于0时不开启 SO_LINGER，否则开启并以其为超时(s) */
+    int rcvbuf;                 /* SO_RCVBUF，0 表示使用系统配置，下同 */
+    int sndbuf;                 /* SO_SNDBUF */
+    int notsent_lowat;          /* TCP_NOTSENT_LOWAT */
+    int busy_poll;              /* SO_BUSY_POLL(us) */
+
+    int fastopen;               /* 服务端为 TCP_FASTOPEN 队列长度；客户端非0时开启 TCP_FASTOPEN_CONNECT，首个报文随SYN发出 */
+    int defer_accept;           /* 服务端 TCP_DEFER_ACCEPT(s)，连接上有数据到达时才 accept */
+    int auto_cork;              /* 数据回调期间开启 TCP_CORK，回调中的多次发送合并之后再发出 */
+}socket_options_t;
+
+/* 默认值: 开启 keepalive，不开启 linger(关闭过程由 tcp_connection 异步完成)，其余使用系统配置 */
+void socket_options_init(socket_options_t *options);
+
+/* 设置与单个连接相关的选项，客户端应在 connect() 之前设置 */
+void set_socket_options(int fd, const socket_options_t *options);
+
+/* 设置监听 socket 的选项，需在 listen() 之前设置 */
+void set_socket_listen_options(int fd, const socket_options_t *options);
+
+void set_socket_cork(int fd, int on);
+
 int create_server_socket(unsigned short port, const char* ip);
 
 int create_client_socket(void);
@@ -1,11 +1,16 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/tcp_connection.h"
 #include "tinylib/linux/net/tcp_client.h"
 #include "tinylib/linux/net/channel.h"
 #include "tinylib/linux/net/inetaddr.h"
 #include "tinylib/linux/net/socket.h"
+#include "tinylib/linux/net/resolver.h"
 
 #include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
+#include "tinylib/util/metrics.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -18,37 +23,130 @@
 #include <assert.h>
 #include <unistd.h>
 
+/* 首个地址未能及时连上时，并行尝试下一个地址之前的等待时间(ms) */
+#define DEFAULT_STAGGER_DELAY 250
+
+/* 对单个候选地址的一次连接尝试 */
+struct connect_attempt
+{
+    tcp_client_t *client;
+    int fd;
+    channel_t *channel;
+};
+
 struct tcp_client
 {
     loop_t *loop;
     inetaddr_t peer_addr;
 
+    /* 以域名指定对端时，每次连接之前都重新解析，并依次尝试解析出的各个地址 */
+    char host[256];
+    unsigned short port;
+    resolver_t *resolver;
+    int is_own_resolver;
+    resolver_query_t *query;
+    resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+    int addr_count;
+
+    /* 一轮连接: 依次错开启动对各个地址的尝试，最先连上的胜出，其余放弃 */
+    struct connect_attempt attempts[RESOLVER_MAX_ADDRS];
+    int next_addr;
+    int pending_attempts;
+    int is_connecting;
+    unsigned connect_timeout;
+    unsigned stagger_delay;
+    loop_timer_t *timeout_timer;
+    loop_timer_t *stagger_timer;
+
+    /* 一轮连接失败之后，按带抖动的指数退避自动重试 */
+    unsigned backoff_min;
+    unsigned backoff_max;
+    unsigned max_retries;
+    unsigned retries;
+    unsigned backoff;
+    unsigned seed;
+    loop_timer_t *retry_timer;
+
     on_connected_f connectedcb;
     on_data_f datacb;
     on_close_f closecb;
     void* userdata;
 
-    int fd;
-    channel_t *channel;
     tcp_connection_t *connection;
+    socket_options_t options;
 
     int is_in_callback;
     int is_alive;
 };
 
-static inline 
+static
+void abort_attempt(struct connect_attempt *attempt)
+{
+    if (NULL != attempt->channel)
+    {
+        channel_detach(attempt->channel);
+        channel_destroy(attempt->channel);
+        attempt->channel = NULL;
+    }
+    if (attempt->fd >= 0)
+    {
+        close(attempt->fd);
+        attempt->fd = -1;
+    }
+
+    return;
+}
+
+/* 结束当前一轮连接，放弃所有尚未完成的尝试 */
+static
+void finish_round(tcp_client_t* client)
+{
+    int i;
+
+    for (i = 0; i < client->addr_count; ++i)
+    {
+        abort_attempt(&client->attempts[i]);
+    }
+    client->pending_attempts = 0;
+
+    if (NULL != client->timeout_timer)
+    {
+        loop_cancel(client->loop, client->timeout_timer);
+        client->timeout_timer = NULL;
+    }
+    if (NULL != client->stagger_timer)
+    {
+        loop_cancel(client->loop, client->stagger_timer);
+        client->stagger_timer = NULL;
+    }
+    client->is_connecting = 0;
+
+    return;
+}
+
+static inline
 void delete_client(tcp_client_t* client)
 {
-    channel_detach(client->channel);
-    channel_destroy(client->channel);
+    if (NULL != client->query)
+    {
+        resolver_cancel(client->resolver, client->query);
+    }
+    if (client->is_own_resolver)
+    {
+        resolver_destroy(client->resolver);
+    }
+    finish_round(client);
+    if (NULL != client->retry_timer)
+    {
+        loop_cancel(client->loop, client->retry_timer);
+    }
     tcp_connection_destroy(client->connection);
-    close(client->fd);
     free(client);
 
     return;
 }
 
-static 
+static
 void client_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
 {
     tcp_client_t *client = (tcp_client_t *)userdata;
@@ -61,11 +159,11 @@ void client_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdat
     {
         delete_client(client);
     }
-    
+
     return;
 }
 
-static 
+static
 void client_onclose(tcp_connection_t* connection, void* userdata)
 {
     tcp_client_t *client = (tcp_client_t *)userdata;
@@ -82,42 +180,235 @@ void client_onclose(tcp_connection_t* connection, void* userdata)
     return;
 }
 
-static 
-void client_onevent(int fd, int event, void* userdata)
+static
+void client_notify_failure(tcp_client_t* client)
+{
+    client->retries = 0;
+    client->backoff = 0;
+
+    client->is_in_callback = 1;
+    client->connectedcb(NULL, client->userdata);
+    client->is_in_callback = 0;
+
+    if (0 == client->is_alive)
+    {
+        delete_client(client);
+    }
+
+    return;
+}
+
+static void do_tcp_client_connect(void *userdata);
+
+static
+void client_onretry(void *userdata)
+{
+    tcp_client_t* client = (tcp_client_t*)userdata;
+
+    client->retry_timer = NULL;
+    do_tcp_client_connect(client);
+
+    return;
+}
+
+/* 一轮连接全部失败，按退避策略安排重试，或者通知用户连接失败 */
+static
+void round_failed(tcp_client_t* client)
+{
+    unsigned delay;
+
+    finish_round(client);
+
+    if (0 == client->backoff_min || (client->max_retries > 0 && client->retries >= client->max_retries))
+    {
+        client_notify_failure(client);
+        return;
+    }
+
+    /* 退避上限逐轮翻倍，实际等待取上限的一半再加上随机抖动，避免大量客户端同时重连 */
+    if (0 == client->backoff)
+    {
+        client->backoff = client->backoff_min;
+    }
+    client->seed = client->seed * 1103515245 + 12345;
+    delay = client->backoff / 2 + (client->seed >> 8) % (client->backoff / 2 + 1);
+
+    client->retries++;
+    if (client->backoff < client->backoff_max)
+    {
+        client->backoff = (client->backoff * 2 > client->backoff_max) ? client->backoff_max : client->backoff * 2;
+    }
+
+    log_warn("connection to %s:%u failed, retry(%u) in %u ms",
+        (client->host[0] != '\0' ? client->host : client->peer_addr.ip), client->port, client->retries, delay);
+
+    client->retry_timer = loop_runafter(client->loop, delay, client_onretry, client);
+
+    return;
+}
+
+static
+void client_onattempt(int fd, int event, void* userdata);
+
+static
+void client_onstagger(void *userdata);
+
+/* 启动对下一个候选地址的尝试，立即失败的地址直接跳过 */
+static
+void start_next_attempt(tcp_client_t* client)
+{
+    struct connect_attempt *attempt;
+    struct sockaddr_in addr;
+    int fd;
+    int result;
+    int err;
+
+    while (client->next_addr < client->addr_count)
+    {
+        attempt = &client->attempts[client->next_addr];
+        client->next_addr++;
+
+        fd = create_client_socket();
+        if (fd < 0)
+        {
+            log_error("start_next_attempt: create_client_socket() failed, peer addr: %s:%u, errno: %d",
+                client->addrs[attempt - client->attempts].ip, client->port, errno);
+            continue;
+        }
+
+        set_socket_options(fd, &client->options);
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(client->port);
+        addr.sin_addr.s_addr = inet_addr(client->addrs[attempt - client->attempts].ip);
+        result = connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+        err = (result == 0) ? result : errno;
+
+        if (0 != err && EINPROGRESS != err && EINTR != err && EISCONN != err)
+        {
+            log_error("start_next_attempt: connect() failed, peer addr: %s:%u, errno: %d",
+                client->addrs[attempt - client->attempts].ip, client->port, err);
+            close(fd);
+            continue;
+        }
+
+        attempt->client = client;
+        attempt->fd = fd;
+        attempt->channel = channel_new(fd, client->loop, client_onattempt, attempt);
+        channel_setevent(attempt->channel, EPOLLOUT);
+        client->pending_attempts++;
+
+        if (client->next_addr < client->addr_count && client->stagger_delay > 0)
+        {
+            client->stagger_timer = loop_runafter(client->loop, client->stagger_delay, client_onstagger, client);
+        }
+
+        return;
+    }
+
+    if (0 == client->pending_attempts)
+    {
+        round_failed(client);
+    }
+
+    return;
+}
+
+static
+void client_onstagger(void *userdata)
+{
+    tcp_client_t* client = (tcp_client_t*)userdata;
+
+    client->stagger_timer = NULL;
+    start_next_attempt(client);
+
+    return;
+}
+
+static
+void client_ontimeout(void *userdata)
+{
+    tcp_client_t* client = (tcp_client_t*)userdata;
+
+    client->timeout_timer = NULL;
+    log_error("connection to %s:%u timed out after %u ms",
+        (client->host[0] != '\0' ? client->host : client->peer_addr.ip), client->port, client->connect_timeout);
+
+    round_failed(client);
+
+    return;
+}
+
+static
+void client_onattempt(int fd, int event, void* userdata)
 {
-    tcp_client_t* client;
+    struct connect_attempt *attempt = (struct connect_attempt*)userdata;
+    tcp_client_t* client = attempt->client;
     tcp_connection_t *connection;
+    int index;
+    int err;
+    socklen_t err_len;
 
-    client = (tcp_client_t*)userdata;
-    
-    channel_detach(client->channel);
-    channel_destroy(client->channel);
-    client->channel = NULL;
-    
-    log_debug("client_onevent: fd(%d), event(%d)", fd, event);
+    index = (int)(attempt - client->attempts);
+
+    log_debug("client_onattempt: fd(%d), event(%d)", fd, event);
 
     if ((EPOLLERR | EPOLLHUP) & event)
     {
-        log_error("failed to make connection to %s:%u, errno: %d", client->peer_addr.ip, client->peer_addr.port, errno);
+        err = 0;
+        err_len = sizeof(err);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+        log_error("failed to make connection to %s:%u, errno: %d", client->addrs[index].ip, client->port, err);
 
-        /* 通知用户连接失败了 */
-        client->is_in_callback = 1;
-        client->connectedcb(NULL, client->userdata);
-        client->is_in_callback = 0;
+        abort_attempt(attempt);
+        client->pending_attempts--;
 
-        if (0 == client->is_alive)
+        /* 不必等待错开的时间，立即尝试下一个地址 */
+        if (NULL != client->stagger_timer)
         {
-            delete_client(client);
+            loop_cancel(client->loop, client->stagger_timer);
+            client->stagger_timer = NULL;
         }
+        start_next_attempt(client);
 
         return;
     }
-    
+
     if (EPOLLOUT & event)
     {
+        inetaddr_initbyipport(&client->peer_addr, client->addrs[index].ip, client->port);
         log_debug("connection to %s:%u is ready", client->peer_addr.ip, client->peer_addr.port);
 
+        channel_detach(attempt->channel);
+        channel_destroy(attempt->channel);
+        attempt->channel = NULL;
+        attempt->fd = -1;
+
         connection = tcp_connection_new(client->loop, fd, client_ondata, client_onclose, client, &client->peer_addr);
+        if (NULL == connection)
+        {
+            log_error("client_onattempt: tcp_connection_new() failed, peer addr: %s:%u", client->peer_addr.ip, client->peer_addr.port);
+            close(fd);
+
+            /* 与连接出错的尝试一样处理，立即尝试其余的地址 */
+            client->pending_attempts--;
+            if (NULL != client->stagger_timer)
+            {
+                loop_cancel(client->loop, client->stagger_timer);
+                client->stagger_timer = NULL;
+            }
+            start_next_attempt(client);
+
+            return;
+        }
+        tcp_connection_set_autocork(connection, client->options.auto_cork);
+        metrics_thread()->tcp_connects++;
+
+        /* 胜出的 fd 已交由 connection 管理，其余的尝试全部放弃 */
+        finish_round(client);
+        client->retries = 0;
+        client->backoff = 0;
 
         client->connection = connection;
         client->is_in_callback = 1;
@@ -133,9 +424,34 @@ void client_onevent(int fd, int event, void* userdata)
     return;
 }
 
+static
+void start_round(tcp_client_t* client)
+{
+    int i;
+
+    for (i = 0; i < client->addr_count; ++i)
+    {
+        client->attempts[i].client = client;
+        client->attempts[i].fd = -1;
+        client->attempts[i].channel = NULL;
+    }
+    client->next_addr = 0;
+    client->pending_attempts = 0;
+    client->is_connecting = 1;
+
+    if (client->connect_timeout > 0)
+    {
+        client->timeout_timer = loop_runafter(client->loop, client->connect_timeout, client_ontimeout, client);
+    }
+
+    start_next_attempt(client);
+
+    return;
+}
+
 tcp_client_t* tcp_client_new
 (
-    loop_t *loop, const char* ip, unsigned short port, 
+    loop_t *loop, const char* ip, unsigned short port,
     on_connected_f connectedcb, on_data_f datacb, on_close_f closecb, void* userdata
 )
 {
@@ -150,90 +466,103 @@ tcp_client_t* tcp_client_new
 
     client = (tcp_client_t*)malloc(sizeof(tcp_client_t));
     memset(client, 0, sizeof(*client));
-    
+
     client->loop = loop;
-    inetaddr_initbyipport(&client->peer_addr, ip, port);
+    client->port = port;
+    if (inet_addr(ip) == INADDR_NONE)
+    {
+        strncpy(client->host, ip, sizeof(client->host)-1);
+    }
+    else
+    {
+        inetaddr_initbyipport(&client->peer_addr, ip, port);
+        client->addrs[0].family = AF_INET;
+        strncpy(client->addrs[0].ip, ip, sizeof(client->addrs[0].ip)-1);
+        client->addr_count = 1;
+    }
+
+    socket_options_init(&client->options);
+    client->stagger_delay = DEFAULT_STAGGER_DELAY;
+    client->seed = (unsigned)ts_ms() ^ (unsigned)(unsigned long)client;
 
     client->connectedcb = connectedcb;
     client->datacb = datacb;
     client->closecb = closecb;
     client->userdata = userdata;
 
-    client->fd = -1;
-    client->channel = NULL;
     client->connection = NULL;
 
     client->is_in_callback = 0;
     client->is_alive = 1;
-    
+
     return client;
 }
 
 static
-void do_tcp_client_connect(void *userdata)
+void client_onresolved(const char *name, const resolver_addr_t *addrs, int count, void *userdata)
 {
     tcp_client_t* client = (tcp_client_t*)userdata;
 
-    int fd;
-    int result;
-    int err;
-    struct sockaddr_in addr;
+    client->query = NULL;
 
-    fd = create_client_socket();
-    if (fd < 0)
+    if (count <= 0)
     {
-        log_error("do_tcp_client_connect: create_client_socket() failed, peer addr: %s:%u, errno: %d", 
-            client->peer_addr.ip, client->peer_addr.port, errno);
+        log_error("client_onresolved: failed to resolve %s", name);
+        client->addr_count = 0;
+        round_failed(client);
+        return;
+    }
 
-        client->is_in_callback = 1;
-        client->connectedcb(NULL, client->userdata);
-        client->is_in_callback = 0;
+    client->addr_count = count;
+    memcpy(client->addrs, addrs, sizeof(resolver_addr_t) * count);
 
-        if (0 == client->is_alive)
-        {
-            delete_client(client);
-        }
+    start_round(client);
 
-        return;
-    }
+    return;
+}
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(client->peer_addr.port);
-    addr.sin_addr.s_addr = inet_addr(client->peer_addr.ip);
-    result = connect(fd, (struct sockaddr*)&addr, sizeof(addr));
-    err = (result == 0) ? result : errno;
+static
+void do_tcp_client_connect(void *userdata)
+{
+    tcp_client_t* client = (tcp_client_t*)userdata;
 
-    switch(err)
+    if (client->is_connecting || NULL != client->query || NULL != client->retry_timer)
     {
-        case 0:
-        case EINPROGRESS:
-        case EINTR:
-        case EISCONN:
-        {
-            client->fd = fd;
-            break;
-        }
-        default:
-        {
-            log_error("tcp_client_connect: connect() failed, peer addr: %s:%u, errno: %d", 
-                client->peer_addr.ip, client->peer_addr.port, err);
+        /* 上一轮连接尚未结束 */
+        return;
+    }
 
-            client->is_in_callback = 1;
-            client->connectedcb(NULL, client->userdata);
-            client->is_in_callback = 0;
+    /* 重连之前，先释放上一次建立的连接 */
+    if (NULL != client->connection)
+    {
+        tcp_connection_destroy(client->connection);
+        client->connection = NULL;
+    }
 
-            if (0 == client->is_alive)
-            {
-                delete_client(client);
-            }
+    if (client->host[0] == '\0')
+    {
+        start_round(client);
+        return;
+    }
 
+    if (NULL == client->resolver)
+    {
+        client->resolver = resolver_new(client->loop, NULL, 0);
+        if (NULL == client->resolver)
+        {
+            log_error("do_tcp_client_connect: resolver_new() failed, peer addr: %s:%u", client->host, client->port);
+            client_notify_failure(client);
             return;
         }
+        client->is_own_resolver = 1;
     }
 
-    client->channel = channel_new(fd, client->loop, client_onevent, client);
-    channel_setevent(client->channel, EPOLLOUT);
+    /* 本网络层仅支持 IPv4，故只查询 A 记录 */
+    client->query = resolver_resolve(client->resolver, client->host, AF_INET, client_onresolved, client);
+    if (NULL == client->query)
+    {
+        client_notify_failure(client);
+    }
 
     return;
 }
@@ -245,12 +574,68 @@ int tcp_client_connect(tcp_client_t* client)
         log_error("tcp_client_connect: bad client");
         return -1;
     }
-    
+
     loop_run_inloop(client->loop, do_tcp_client_connect, client);
-    
+
     return 0;
 }
 
+void tcp_client_set_resolver(tcp_client_t* client, resolver_t *resolver)
+{
+    if (NULL == client || NULL == resolver || NULL != client->query)
+    {
+        return;
+    }
+
+    if (client->is_own_resolver)
+    {
+        resolver_destroy(client->resolver);
+        client->is_own_resolver = 0;
+    }
+    client->resolver = resolver;
+
+    return;
+}
+
+void tcp_client_set_connect_timeout(tcp_client_t* client, unsigned timeout, unsigned stagger_delay)
+{
+    if (NULL == client)
+    {
+        return;
+    }
+
+    client->connect_timeout = timeout;
+    client->stagger_delay = stagger_delay;
+
+    return;
+}
+
+void tcp_client_set_reconnect(tcp_client_t* client, unsigned min_delay, unsigned max_delay, unsigned max_retries)
+{
+    if (NULL == client)
+    {
+        return;
+    }
+
+    client->backoff_min = min_delay;
+    client->backoff_max = (max_delay < min_delay) ? min_delay : max_delay;
+    client->max_retries = max_retries;
+
+    return;
+}
+
+void tcp_client_set_options(tcp_client_t* client, const socket_options_t *options)
+{
+    if (NULL == client || NULL == options)
+    {
+        return;
+    }
+
+    client->options = *options;
+
+    return;
+}
+
 tcp_connection_t* tcp_client_getconnection(tcp_client_t* client)
 {
     return (NULL == client ? NULL : client->connection);
@@ -7,6 +7,8 @@ typedef struct tcp_client tcp_client_t;
 
 #include "tinylib/linux/net/tcp_connection.h"
 #include "tinylib/linux/net/loop.h"
+#include "tinylib/linux/net/resolver.h"
+#include "tinylib/linux/net/socket.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,6 +16,9 @@ extern "C" {
 
 typedef void (*on_connected_f)(tcp_connection_t* connection, void *userdata);
 
+/* ip 亦可为域名，此时每次 tcp_client_connect() 时都会先行异步解析，并依次尝试解析出的各个地址
+ * 直至连接成功或全部失败
+ */
 tcp_client_t* tcp_client_new
 (
     loop_t *loop, const char* ip, unsigned short port, 
@@ -22,6 +27,27 @@ tcp_client_t* tcp_client_new
 
 int tcp_client_connect(tcp_client_t* client);
 
+/* 指定解析域名所用的解析器，多个 client 可共用同一个解析器
+ * 未指定时，client 在首次需要解析时自行创建一个，并随 client 一起销毁
+ * 需在 tcp_client_connect() 之前，于 loop 线程中调用
+ */
+void tcp_client_set_resolver(tcp_client_t* client, resolver_t *resolver);
+
+/* 设置单轮连接的超时时间(ms)，为0时(默认)不限时
+ * 对端有多个地址时，若当前地址在 stagger_delay(ms) 内仍未连上，则并行尝试下一个地址，最先连上者胜出
+ * stagger_delay 默认为250ms，为0时只在前一个地址失败之后才尝试下一个
+ */
+void tcp_client_set_connect_timeout(tcp_client_t* client, unsigned timeout, unsigned stagger_delay);
+
+/* 开启连接失败之后的自动重试，等待时间从 min_delay(ms) 起逐次翻倍至 max_delay，并附加随机抖动
+ * 重试 max_retries 次(为0时不限次数)仍失败时，才以 connectedcb(NULL) 通知用户
+ * min_delay 为0(默认)时不自动重试
+ */
+void tcp_client_set_reconnect(tcp_client_t* client, unsigned min_delay, unsigned max_delay, unsigned max_retries);
+
+/* 设置连接所用的 socket 选项，需在 tcp_client_connect() 之前调用 */
+void tcp_client_set_options(tcp_client_t* client, const socket_options_t *options);
+
 tcp_connection_t* tcp_client_getconnection(tcp_client_t* client);
 
 void tcp_client_destroy(tcp_client_t* client);
@@ -0,0 +1,628 @@
+
+#define LOG_MODULE LOG_MODULE_NET
+
+#include "tinylib/linux/net/tcp_client_pool.h"
+#include "tinylib/linux/net/tcp_client.h"
+
+#include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define POOL_HOST_BUCKETS 64
+#define POOL_CONN_BUCKETS 256
+
+enum pool_conn_state
+{
+    POOL_CONN_CONNECTING = 0,
+    POOL_CONN_BUSY,
+    POOL_CONN_IDLE,
+    POOL_CONN_CLOSING,
+};
+
+struct pool_waiter
+{
+    on_borrowed_f borrowedcb;
+    on_data_f datacb;
+    on_close_f closecb;
+    void *userdata;
+
+    struct pool_waiter *next;
+};
+
+struct pool_host;
+
+struct pool_conn
+{
+    tcp_client_pool_t *pool;
+    struct pool_host *host;
+    tcp_client_t *client;
+    tcp_connection_t *connection;   /* 建连完成之前为NULL */
+    int state;
+    unsigned long long idle_since;
+
+    /* 当前借用者 */
+    struct pool_waiter user;
+
+    struct pool_conn *host_next;    /* 所属对端的连接链表，空闲连接按归还的先后排在前面 */
+    struct pool_conn *hash_next;    /* 以 connection 为键的索引 */
+};
+
+struct pool_host
+{
+    char ip[256];
+    unsigned short port;
+
+    struct pool_conn *conns;
+    unsigned conn_count;
+    unsigned idle_count;
+
+    struct pool_waiter *waiters;
+    struct pool_waiter *waiters_tail;
+
+    struct pool_host *next;
+};
+
+struct tcp_client_pool
+{
+    loop_t *loop;
+    unsigned max_idle;
+    unsigned max_per_host;
+    unsigned idle_timeout;
+    loop_timer_t *evict_timer;
+    socket_options_t options;
+
+    struct pool_host *hosts[POOL_HOST_BUCKETS];
+    struct pool_conn *conns[POOL_CONN_BUCKETS];
+
+    unsigned idle_count;
+    unsigned total_count;
+};
+
+static inline
+unsigned host_hash(const char *ip, unsigned short port)
+{
+    unsigned hash = 5381 + port;
+
+    while (*ip)
+    {
+        hash = ((hash << 5) + hash) + (unsigned char)*ip;
+        ip++;
+    }
+
+    return hash % POOL_HOST_BUCKETS;
+}
+
+static inline
+unsigned conn_hash(tcp_connection_t *connection)
+{
+    return (unsigned)(((uintptr_t)connection >> 4) % POOL_CONN_BUCKETS);
+}
+
+static
+struct pool_host* host_get(tcp_client_pool_t *pool, const char *ip, unsigned short port)
+{
+    unsigned index;
+    struct pool_host *host;
+
+    index = host_hash(ip, port);
+    host = pool->hosts[index];
+    while (NULL != host)
+    {
+        if (host->port == port && strcmp(host->ip, ip) == 0)
+        {
+            return host;
+        }
+        host = host->next;
+    }
+
+    host = (struct pool_host*)malloc(sizeof(*host));
+    memset(host, 0, sizeof(*host));
+    strncpy(host->ip, ip, sizeof(host->ip)-1);
+    host->port = port;
+
+    host->next = pool->hosts[index];
+    pool->hosts[index] = host;
+
+    return host;
+}
+
+static
+void conn_index(tcp_client_pool_t *pool, struct pool_conn *conn)
+{
+    unsigned index = conn_hash(conn->connection);
+
+    conn->hash_next = pool->conns[index];
+    pool->conns[index] = conn;
+
+    return;
+}
+
+static
+struct pool_conn* conn_find(tcp_client_pool_t *pool, tcp_connection_t *connection)
+{
+    struct pool_conn *conn;
+
+    conn = pool->conns[conn_hash(connection)];
+    while (NULL != conn && conn->connection != connection)
+    {
+        conn = conn->hash_next;
+    }
+
+    return conn;
+}
+
+static
+void conn_unlink(tcp_client_pool_t *pool, struct pool_conn *conn)
+{
+    struct pool_conn **link;
+    struct pool_host *host = conn->host;
+
+    link = &host->conns;
+    while (NULL != *link)
+    {
+        if (*link == conn)
+        {
+            *link = conn->host_next;
+            break;
+        }
+        link = &(*link)->host_next;
+    }
+    host->conn_count--;
+    pool->total_count--;
+
+    if (conn->state == POOL_CONN_IDLE)
+    {
+        host->idle_count--;
+        pool->idle_count--;
+    }
+
+    if (NULL != conn->connection)
+    {
+        link = &pool->conns[conn_hash(conn->connection)];
+        while (NULL != *link)
+        {
+            if (*link == conn)
+            {
+                *link = conn->hash_next;
+                break;
+            }
+            link = &(*link)->hash_next;
+        }
+    }
+
+    return;
+}
+
+static void pool_connect(tcp_client_pool_t *pool, struct pool_host *host, struct pool_waiter *waiter);
+
+/* 关闭并移除一个连接，若该对端有排队的借用请求，则为其新建连接 */
+static
+void conn_evict(tcp_client_pool_t *pool, struct pool_conn *conn)
+{
+    struct pool_host *host = conn->host;
+    struct pool_waiter *waiter;
+
+    conn_unlink(pool, conn);
+    tcp_client_destroy(conn->client);
+    free(conn);
+
+    if (NULL != host->waiters && host->conn_count < pool->max_per_host)
+    {
+        waiter = host->waiters;
+        host->waiters = waiter->next;
+        if (NULL == host->waiters)
+        {
+            host->waiters_tail = NULL;
+        }
+
+        pool_connect(pool, host, waiter);
+        free(waiter);
+    }
+
+    return;
+}
+
+static
+void conn_lend(struct pool_conn *conn, struct pool_waiter *waiter)
+{
+    conn->state = POOL_CONN_BUSY;
+    conn->user = *waiter;
+    conn->user.next = NULL;
+
+    conn->user.borrowedcb(conn->connection, conn->user.userdata);
+
+    return;
+}
+
+static
+void pool_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    struct pool_conn *conn = (struct pool_conn*)userdata;
+
+    if (conn->state == POOL_CONN_BUSY)
+    {
+        conn->user.datacb(connection, buffer, conn->user.userdata);
+    }
+    else
+    {
+        /* 空闲连接上收到未预期的数据，连接的协议状态已不可知，不再复用 */
+        log_warn("pool_ondata: unexpected data on idle connection to %s:%u, evicted", conn->host->ip, conn->host->port);
+        buffer_retrieveall(buffer);
+        conn_evict(conn->pool, conn);
+    }
+
+    return;
+}
+
+static
+void pool_onclose(tcp_connection_t* connection, void* userdata)
+{
+    struct pool_conn *conn = (struct pool_conn*)userdata;
+
+    if (conn->state == POOL_CONN_BUSY)
+    {
+        /* 借用者在 closecb 中归还该连接时不做任何处理 */
+        conn->state = POOL_CONN_CLOSING;
+        conn->user.closecb(connection, conn->user.userdata);
+    }
+
+    conn_evict(conn->pool, conn);
+
+    return;
+}
+
+static
+void pool_onconnected(tcp_connection_t* connection, void *userdata)
+{
+    struct pool_conn *conn = (struct pool_conn*)userdata;
+    tcp_client_pool_t *pool = conn->pool;
+    struct pool_waiter waiter;
+
+    waiter = conn->user;
+
+    if (NULL == connection)
+    {
+        log_error("pool_onconnected: failed to connect %s:%u", conn->host->ip, conn->host->port);
+        conn_evict(pool, conn);
+        waiter.borrowedcb(NULL, waiter.userdata);
+        return;
+    }
+
+    conn->connection = connection;
+    conn_index(pool, conn);
+    conn_lend(conn, &waiter);
+
+    return;
+}
+
+static
+void pool_connect(tcp_client_pool_t *pool, struct pool_host *host, struct pool_waiter *waiter)
+{
+    struct pool_conn *conn;
+
+    conn = (struct pool_conn*)malloc(sizeof(*conn));
+    memset(conn, 0, sizeof(*conn));
+    conn->pool = pool;
+    conn->host = host;
+    conn->state = POOL_CONN_CONNECTING;
+    conn->user = *waiter;
+    conn->user.next = NULL;
+
+    conn->client = tcp_client_new(pool->loop, host->ip, host->port, pool_onconnected, pool_ondata, pool_onclose, conn);
+    if (NULL == conn->client)
+    {
+        free(conn);
+        waiter->borrowedcb(NULL, waiter->userdata);
+        return;
+    }
+
+    conn->host_next = host->conns;
+    host->conns = conn;
+    host->conn_count++;
+    pool->total_count++;
+
+    tcp_client_set_options(conn->client, &pool->options);
+    tcp_client_connect(conn->client);
+
+    return;
+}
+
+static
+void pool_onevict(void *userdata)
+{
+    tcp_client_pool_t *pool = (tcp_client_pool_t*)userdata;
+    unsigned long long now;
+    unsigned i;
+    struct pool_host **link;
+    struct pool_host *host;
+    struct pool_conn *conn;
+    struct pool_conn *next;
+
+    now = ts_ms();
+
+    for (i = 0; i < POOL_HOST_BUCKETS; ++i)
+    {
+        link = &pool->hosts[i];
+        while (NULL != *link)
+        {
+            host = *link;
+
+            conn = host->conns;
+            while (NULL != conn)
+            {
+                next = conn->host_next;
+                if (conn->state == POOL_CONN_IDLE && (now - conn->idle_since) >= pool->idle_timeout)
+                {
+                    conn_evict(pool, conn);
+                }
+                conn = next;
+            }
+
+            if (0 == host->conn_count && NULL == host->waiters)
+            {
+                *link = host->next;
+                free(host);
+            }
+            else
+            {
+                link = &host->next;
+            }
+        }
+    }
+
+    return;
+}
+
+tcp_client_pool_t* tcp_client_pool_new(loop_t *loop, unsigned max_idle, unsigned max_per_host, unsigned idle_timeout)
+{
+    tcp_client_pool_t *pool;
+    unsigned interval;
+
+    if (NULL == loop || 0 == max_per_host)
+    {
+        log_error("tcp_client_pool_new: bad loop(%p) or bad max_per_host(%u)", loop, max_per_host);
+        return NULL;
+    }
+
+    pool = (tcp_client_pool_t*)malloc(sizeof(*pool));
+    memset(pool, 0, sizeof(*pool));
+
+    pool->loop = loop;
+    pool->max_idle = max_idle;
+    pool->max_per_host = max_per_host;
+    pool->idle_timeout = idle_timeout;
+    socket_options_init(&pool->options);
+
+    if (idle_timeout > 0)
+    {
+        interval = idle_timeout / 2;
+        if (interval < 100)
+        {
+            interval = 100;
+        }
+        pool->evict_timer = loop_runevery(loop, interval, pool_onevict, pool);
+    }
+
+    return pool;
+}
+
+void tcp_client_pool_destroy(tcp_client_pool_t *pool)
+{
+    unsigned i;
+    struct pool_host *host;
+    struct pool_conn *conn;
+    struct pool_waiter *waiter;
+
+    if (NULL == pool)
+    {
+        return;
+    }
+
+    if (NULL != pool->evict_timer)
+    {
+        loop_cancel(pool->loop, pool->evict_timer);
+    }
+
+    for (i = 0; i < POOL_HOST_BUCKETS; ++i)
+    {
+        while (NULL != pool->hosts[i])
+        {
+            host = pool->hosts[i];
+            pool->hosts[i] = host->next;
+
+            while (NULL != host->conns)
+            {
+                conn = host->conns;
+                host->conns = conn->host_next;
+                tcp_client_destroy(conn->client);
+                free(conn);
+            }
+            while (NULL != host->waiters)
+            {
+                waiter = host->waiters;
+                host->waiters = waiter->next;
+                free(waiter);
+            }
+            free(host);
+        }
+    }
+
+    free(pool);
+
+    return;
+}
+
+int tcp_client_pool_borrow
+(
+    tcp_client_pool_t *pool, const char *ip, unsigned short port,
+    on_borrowed_f borrowedcb, on_data_f datacb, on_close_f closecb, void *userdata
+)
+{
+    struct pool_host *host;
+    struct pool_conn **link;
+    struct pool_conn *conn;
+    struct pool_waiter waiter;
+    struct pool_waiter *pending;
+
+    if (NULL == pool || NULL == ip || 0 == port || NULL == borrowedcb || NULL == datacb || NULL == closecb)
+    {
+        log_error("tcp_client_pool_borrow: bad pool(%p) or bad ip(%p) or bad port(%u) or bad borrowedcb(%p) or bad datacb(%p) or bad closecb(%p)",
+            pool, ip, port, borrowedcb, datacb, closecb);
+        return -1;
+    }
+
+    memset(&waiter, 0, sizeof(waiter));
+    waiter.borrowedcb = borrowedcb;
+    waiter.datacb = datacb;
+    waiter.closecb = closecb;
+    waiter.userdata = userdata;
+
+    host = host_get(pool, ip, port);
+
+    /* 优先复用最近归还的空闲连接，借出之前先探测其是否仍然可用 */
+    link = &host->conns;
+    while (NULL != *link)
+    {
+        conn = *link;
+        if (conn->state != POOL_CONN_IDLE)
+        {
+            link = &conn->host_next;
+            continue;
+        }
+
+        if (tcp_connection_probe(conn->connection))
+        {
+            host->idle_count--;
+            pool->idle_count--;
+            conn_lend(conn, &waiter);
+            return 0;
+        }
+
+        log_debug("tcp_client_pool_borrow: stale connection to %s:%u, evicted", host->ip, host->port);
+        conn_evict(pool, conn);
+        link = &host->conns;
+    }
+
+    if (host->conn_count < pool->max_per_host)
+    {
+        pool_connect(pool, host, &waiter);
+        return 0;
+    }
+
+    pending = (struct pool_waiter*)malloc(sizeof(*pending));
+    *pending = waiter;
+    if (NULL == host->waiters_tail)
+    {
+        host->waiters = pending;
+    }
+    else
+    {
+        host->waiters_tail->next = pending;
+    }
+    host->waiters_tail = pending;
+
+    return 0;
+}
+
+void tcp_client_pool_release(tcp_client_pool_t *pool, tcp_connection_t *connection, int reusable)
+{
+    struct pool_conn *conn;
+    struct pool_host *host;
+    struct pool_conn **link;
+    struct pool_waiter *waiter;
+
+    if (NULL == pool || NULL == connection)
+    {
+        return;
+    }
+
+    conn = conn_find(pool, connection);
+    if (NULL == conn || conn->state != POOL_CONN_BUSY)
+    {
+        /* 在 closecb 中归还的连接，由 pool_onclose() 负责销毁 */
+        return;
+    }
+    host = conn->host;
+
+    if (0 == reusable || 0 == tcp_connection_connected(connection))
+    {
+        conn_evict(pool, conn);
+        return;
+    }
+
+    /* 有排队的借用请求时直接转交 */
+    if (NULL != host->waiters)
+    {
+        waiter = host->waiters;
+        host->waiters = waiter->next;
+        if (NULL == host->waiters)
+        {
+            host->waiters_tail = NULL;
+        }
+
+        conn_lend(conn, waiter);
+        free(waiter);
+        return;
+    }
+
+    if (host->idle_count >= pool->max_idle)
+    {
+        conn_evict(pool, conn);
+        return;
+    }
+
+    memset(&conn->user, 0, sizeof(conn->user));
+    conn->state = POOL_CONN_IDLE;
+    conn->idle_since = ts_ms();
+    host->idle_count++;
+    pool->idle_count++;
+
+    /* 移到链表头部，借用时优先使用 */
+    link = &host->conns;
+    while (NULL != *link && *link != conn)
+    {
+        link = &(*link)->host_next;
+    }
+    if (NULL != *link)
+    {
+        *link = conn->host_next;
+        conn->host_next = host->conns;
+        host->conns = conn;
+    }
+
+    return;
+}
+
+void tcp_client_pool_set_options(tcp_client_pool_t *pool, const socket_options_t *options)
+{
+    if (NULL == pool || NULL == options)
+    {
+        return;
+    }
+
+    pool->options = *options;
+
+    return;
+}
+
+void tcp_client_pool_stat(tcp_client_pool_t *pool, unsigned *idle_count, unsigned *total_count)
+{
+    if (NULL == pool)
+    {
+        return;
+    }
+
+    if (NULL != idle_count)
+    {
+        *idle_count = pool->idle_count;
+    }
+    if (NULL != total_count)
+    {
+        *total_count = pool->total_count;
+    }
+
+    return;
+}
@@ -0,0 +1,61 @@
+
+/** 按 (ip, port) 复用的 tcp 连接池
+ *
+ * 归还的连接保持在池中，下次借用同一对端时直接复用，省去建连的握手、socket、channel 及缓冲区的开销
+ * 空闲的连接上若收到数据或被对端关闭，会被立即逐出；超过空闲时长的连接由 loop 的 timer 定期回收
+ *
+ * 所有接口只能在 loop 线程中调用
+ */
+
+#ifndef TINYLIB_NET_TCP_CLIENT_POOL_H
+#define TINYLIB_NET_TCP_CLIENT_POOL_H
+
+struct tcp_client_pool;
+typedef struct tcp_client_pool tcp_client_pool_t;
+
+#include "tinylib/linux/net/tcp_connection.h"
+#include "tinylib/linux/net/loop.h"
+#include "tinylib/linux/net/socket.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 借用结果回调，connection 为NULL表示建连失败 */
+typedef void (*on_borrowed_f)(tcp_connection_t* connection, void *userdata);
+
+/* max_idle: 每个对端最多保留的空闲连接数
+ * max_per_host: 每个对端最多同时存在的连接数(含借出与建连中的)，超出时借用请求排队等待
+ * idle_timeout: 空闲连接的最长保留时间(ms)，为0时不按时长回收
+ */
+tcp_client_pool_t* tcp_client_pool_new(loop_t *loop, unsigned max_idle, unsigned max_per_host, unsigned idle_timeout);
+
+/* 销毁连接池，池中所有连接(包括尚未归还的)都将被关闭，排队中的借用请求被丢弃 */
+void tcp_client_pool_destroy(tcp_client_pool_t *pool);
+
+/* 借用一个到 ip:port 的连接，ip 亦可为域名
+ * 有可用的空闲连接时 borrowedcb 在本调用返回之前执行，否则在建连完成或有连接归还时执行
+ * 借出期间连接上的数据和关闭事件通过 datacb/closecb 通知，closecb 返回之后该连接由池负责销毁
+ */
+int tcp_client_pool_borrow
+(
+    tcp_client_pool_t *pool, const char *ip, unsigned short port,
+    on_borrowed_f borrowedcb, on_data_f datacb, on_close_f closecb, void *userdata
+);
+
+/* 归还借出的连接，reusable 为0时直接关闭该连接，否则放回池中等待复用
+ * 归还之后不可再使用该连接
+ */
+void tcp_client_pool_release(tcp_client_pool_t *pool, tcp_connection_t *connection, int reusable);
+
+/* 设置此后新建连接所用的 socket 选项 */
+void tcp_client_pool_set_options(tcp_client_pool_t *pool, const socket_options_t *options);
+
+/* 当前池中的空闲连接数及连接总数 */
+void tcp_client_pool_stat(tcp_client_pool_t *pool, unsigned *idle_count, unsigned *total_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_NET_TCP_CLIENT_POOL_H */
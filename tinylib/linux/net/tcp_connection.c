@@ -1,10 +1,14 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/channel.h"
 #include "tinylib/linux/net/tcp_connection.h"
 #include "tinylib/linux/net/inetaddr.h"
 #include "tinylib/linux/net/buffer.h"
+#include "tinylib/linux/net/socket.h"
 
 #include "tinylib/util/log.h"
+#include "tinylib/util/metrics.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -34,9 +38,22 @@ struct tcp_connection
     int is_in_callback;
     int is_alive;
     int is_connected;
-    int need_closed_after_sent_done;
+    int auto_cork;
+
+    int close_state;
+    unsigned close_timeout;
+    loop_timer_t *close_timer;
 };
 
+/* destroy 之后的优雅关闭过程: 发完 out_buffer 中的数据 -> shutdown(SHUT_WR) -> 等待对端 FIN -> close()
+ * 整个过程由 close_timer 限时，超时则以 RST 中止，任何情况下都不会阻塞 loop 线程
+ */
+#define CLOSE_STATE_OPEN 0
+#define CLOSE_STATE_FLUSHING 1
+#define CLOSE_STATE_WAIT_FIN 2
+
+#define DEFAULT_CLOSE_TIMEOUT 5000
+
 struct tcp_connection_msg
 {
     tcp_connection_t* connection;
@@ -49,9 +66,13 @@ void delete_connection(tcp_connection_t *connection)
 {
     log_debug("connection to %s:%u will be destroyed", connection->peer_addr.ip, connection->peer_addr.port);
 
+    if (NULL != connection->close_timer)
+    {
+        loop_cancel(connection->loop, connection->close_timer);
+        connection->close_timer = NULL;
+    }
     channel_detach(connection->channel);
     channel_destroy(connection->channel);
-    shutdown(connection->fd, SHUT_RDWR);
     close(connection->fd);
     buffer_destory(connection->in_buffer);
     buffer_destory(connection->out_buffer);
@@ -60,6 +81,87 @@ void delete_connection(tcp_connection_t *connection)
     return;
 }
 
+/* 以 RST 中止连接，不再等待未发出的数据 */
+static inline
+void reset_connection(tcp_connection_t *connection)
+{
+    struct linger linger_info;
+
+    memset(&linger_info, 0, sizeof(linger_info));
+    linger_info.l_onoff = 1;
+    linger_info.l_linger = 0;
+    setsockopt(connection->fd, SOL_SOCKET, SO_LINGER, &linger_info, sizeof(linger_info));
+
+    return;
+}
+
+/* 待发数据已全部发出，关闭写端，等待对端的 FIN */
+static
+void connection_half_close(tcp_connection_t *connection)
+{
+    shutdown(connection->fd, SHUT_WR);
+    connection->close_state = CLOSE_STATE_WAIT_FIN;
+
+    channel_clearevent(connection->channel, EPOLLOUT);
+    channel_setevent(connection->channel, EPOLLIN);
+
+    return;
+}
+
+static
+void connection_onclosetimeout(void *userdata)
+{
+    tcp_connection_t *connection = (tcp_connection_t*)userdata;
+
+    connection->close_timer = NULL;
+
+    log_warn("connection to %s:%u was not closed gracefully in %u ms, reset it",
+        connection->peer_addr.ip, connection->peer_addr.port, connection->close_timeout);
+
+    reset_connection(connection);
+    delete_connection(connection);
+
+    return;
+}
+
+/* 收发计数记入当前(loop)线程，同时更新缓冲区的最高水位 */
+static inline
+void count_read(buffer_t *in_buffer, int size)
+{
+    metrics_t *metrics = metrics_thread();
+    unsigned long long readable;
+
+    metrics->tcp_reads++;
+    metrics->tcp_bytes_in += size;
+    readable = (unsigned long long)buffer_readablebytes(in_buffer);
+    if (readable > metrics->tcp_in_buffer_max)
+    {
+        metrics->tcp_in_buffer_max = readable;
+    }
+
+    return;
+}
+
+static inline
+void count_written(buffer_t *out_buffer, int written)
+{
+    metrics_t *metrics = metrics_thread();
+    unsigned long long readable;
+
+    if (written > 0)
+    {
+        metrics->tcp_writes++;
+        metrics->tcp_bytes_out += written;
+    }
+    readable = (unsigned long long)buffer_readablebytes(out_buffer);
+    if (readable > metrics->tcp_out_buffer_max)
+    {
+        metrics->tcp_out_buffer_max = readable;
+    }
+
+    return;
+}
+
 static 
 void connection_onevent(int fd, int event, void* userdata)
 {
@@ -77,7 +179,7 @@ void connection_onevent(int fd, int event, void* userdata)
 
     if (event & EPOLLHUP)
     {
-        if (connection->need_closed_after_sent_done == 0)
+        if (connection->close_state == CLOSE_STATE_OPEN)
         {
             connection->is_connected = 0;
             connection->is_in_callback = 1;
@@ -86,8 +188,8 @@ void connection_onevent(int fd, int event, void* userdata)
         }
         else
         {
-            /* 至此，connection 已被执行 destroy 过，仅仅是为了尝试将余下的数据尽可能的发出去而被保留到现在
-             * 但不幸的是，链接已经被远端断开了，此时只能放弃该链接，将其销毁
+            /* 至此，connection 已被执行 destroy 过，仅仅是为了尝试将余下的数据发出去或等待对端关闭而被保留到现在
+             * 链接已经被远端断开了，无需再等待，将其销毁
              */
             connection->is_alive = 0;
         }
@@ -97,10 +199,14 @@ void connection_onevent(int fd, int event, void* userdata)
         if (event & EPOLLIN)
         {
             /* FIXME:每次响应可读事件，只执行一次 read 操作，有些浪费 poller 的通知，考虑循环读至读清 */
-            if (connection->need_closed_after_sent_done == 0)
+            if (connection->close_state == CLOSE_STATE_OPEN)
             {
                 in_buffer = connection->in_buffer;
                 size = buffer_readFd(in_buffer, connection->fd);
+                if (size > 0)
+                {
+                    count_read(in_buffer, size);
+                }
                 if (size == 0)
                 {
                     assert(NULL != connection->closecb);
@@ -112,31 +218,64 @@ void connection_onevent(int fd, int event, void* userdata)
                 else if (size > 0)
                 {
                     assert(NULL != connection->datacb);
+                    if (connection->auto_cork)
+                    {
+                        /* 回调中的多次发送先积攒在内核中，回调返回之后再一并发出 */
+                        set_socket_cork(connection->fd, 1);
+                    }
                     connection->is_in_callback = 1;
                     connection->datacb(connection, in_buffer, connection->userdata);
                     connection->is_in_callback = 0;
+                    if (connection->auto_cork)
+                    {
+                        set_socket_cork(connection->fd, 0);
+                    }
                 }
             }
             else
             {
+                /* 关闭过程中收到的数据直接丢弃，读到 EOF 说明对端也已关闭 */
                 char temp[256];
-                while (read(fd, temp, sizeof(temp)) > 0);
+                while ((size = read(fd, temp, sizeof(temp))) > 0);
+                if (size == 0 || (errno != EAGAIN && errno != EINTR))
+                {
+                    if (connection->close_state == CLOSE_STATE_WAIT_FIN)
+                    {
+                        connection->is_alive = 0;
+                    }
+                    else
+                    {
+                        /* 仍有数据待发，暂停读事件，待数据发完之后再关闭 */
+                        channel_clearevent(connection->channel, EPOLLIN);
+                    }
+                }
             }
         }
 
-        if (event & EPOLLOUT)
+        if ((event & EPOLLOUT) && connection->is_alive)
         {
             out_buffer = connection->out_buffer;
             data = buffer_peek(out_buffer);
             size = buffer_readablebytes(out_buffer);
             written = write(connection->fd, data, size);
+            if (written > 0)
+            {
+                count_written(out_buffer, written);
+            }
             if (written < 0)
             {
                 saved_errno = errno;
                 if (saved_errno != EAGAIN && saved_errno != EINTR)
                 {
                     log_error("connection_onevent: write() failed, fd(%d), errno(%d), peer addr: %s:%u", fd, saved_errno, peer_addr->ip, peer_addr->port);
-                    return;
+                    if (connection->close_state == CLOSE_STATE_OPEN)
+                    {
+                        return;
+                    }
+
+                    /* 关闭过程中发送出错，没有继续等待的必要 */
+                    written = size;
+                    connection->is_alive = 0;
                 }
                 else
                 {
@@ -150,9 +289,9 @@ void connection_onevent(int fd, int event, void* userdata)
             {
                 channel_clearevent(connection->channel, EPOLLOUT);
                 
-                if (connection->need_closed_after_sent_done)
+                if (connection->close_state == CLOSE_STATE_FLUSHING && connection->is_alive)
                 {
-                    connection->is_alive = 0;
+                    connection_half_close(connection);
                 }
             }
         }
@@ -174,9 +313,6 @@ tcp_connection_t* tcp_connection_new
     tcp_connection_t *connection;
     struct sockaddr_in addr;
     socklen_t addr_len;
-    
-    struct linger linger_info;
-    int flag;
 
     if (NULL == loop || fd < 0 || NULL == datacb || NULL == closecb || NULL == peer_addr)
     {
@@ -188,14 +324,6 @@ tcp_connection_t* tcp_connection_new
     connection = (tcp_connection_t*)malloc(sizeof(*connection));
     memset(connection, 0, sizeof(*connection));
 
-    flag = 1;
-    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &flag, sizeof(flag));
-    
-    memset(&linger_info, 0, sizeof(linger_info));
-    linger_info.l_onoff = 1;
-    linger_info.l_linger = 3;
-    setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger_info, sizeof(linger_info));
-
     connection->loop = loop;
     connection->fd = fd;
     connection->datacb = datacb;
@@ -210,7 +338,9 @@ tcp_connection_t* tcp_connection_new
     connection->is_in_callback = 0;
     connection->is_alive = 1;
     connection->is_connected = 1;
-    connection->need_closed_after_sent_done = 0;
+    connection->close_state = CLOSE_STATE_OPEN;
+    connection->close_timeout = DEFAULT_CLOSE_TIMEOUT;
+    connection->close_timer = NULL;
     connection->peer_addr = *peer_addr;
 
     memset(&addr, 0, sizeof(addr));
@@ -228,12 +358,25 @@ void do_tcp_connection_destroy(void *userdata)
 {
     tcp_connection_t* connection = (tcp_connection_t*)userdata;
 
-    if ((buffer_readablebytes(connection->out_buffer) > 0) && (connection->is_connected != 0))
+    if (connection->close_state != CLOSE_STATE_OPEN)
     {
-        channel_clearevent(connection->channel, EPOLLIN);
-        channel_setevent(connection->channel, EPOLLOUT);
+        /* 已处于关闭过程中 */
+        return;
+    }
+
+    if (connection->is_connected != 0)
+    {
+        connection->close_state = CLOSE_STATE_FLUSHING;
+        connection->close_timer = loop_runafter(connection->loop, connection->close_timeout, connection_onclosetimeout, connection);
 
-        connection->need_closed_after_sent_done = 1;
+        if (buffer_readablebytes(connection->out_buffer) > 0)
+        {
+            channel_setevent(connection->channel, EPOLLOUT);
+        }
+        else
+        {
+            connection_half_close(connection);
+        }
     }
     else
     {
@@ -250,6 +393,49 @@ void do_tcp_connection_destroy(void *userdata)
     return;
 }
 
+static
+void do_tcp_connection_abort(void *userdata)
+{
+    tcp_connection_t* connection = (tcp_connection_t*)userdata;
+
+    reset_connection(connection);
+
+    if (connection->is_in_callback)
+    {
+        connection->is_alive = 0;
+    }
+    else
+    {
+        delete_connection(connection);
+    }
+
+    return;
+}
+
+void tcp_connection_abort(tcp_connection_t* connection)
+{
+    if (NULL == connection)
+    {
+        return;
+    }
+
+    loop_run_inloop(connection->loop, do_tcp_connection_abort, connection);
+
+    return;
+}
+
+void tcp_connection_set_close_timeout(tcp_connection_t* connection, unsigned timeout)
+{
+    if (NULL == connection || 0 == timeout)
+    {
+        return;
+    }
+
+    connection->close_timeout = timeout;
+
+    return;
+}
+
 void tcp_connection_destroy(tcp_connection_t* connection)
 {
     if (NULL == connection)
@@ -358,6 +544,8 @@ int tcp_connection_sendInLoop(tcp_connection_t* connection, const void* data, in
         }
     }
 
+    count_written(out_buffer, written);
+
     return 0;
 }
 
@@ -407,6 +595,152 @@ int tcp_connection_send(tcp_connection_t* connection, const void* data, int size
     return 0;
 }
 
+static
+int tcp_connection_sendvInLoop(tcp_connection_t* connection, const struct iovec *vecs, int count)
+{
+    inetaddr_t *peer_addr = &connection->peer_addr;
+    buffer_t* out_buffer;
+    struct iovec iovs[TCP_CONNECTION_MAX_IOVEC+1];
+    int iov_count;
+    unsigned buffer_left_data_size;
+    int written;
+    int sent;
+    int error;
+    int i;
+
+    out_buffer = connection->out_buffer;
+    buffer_left_data_size = buffer_readablebytes(out_buffer);
+
+    /* out_buffer 中尚有数据时须排在最前面，保证数据的先后次序 */
+    iov_count = 0;
+    if (buffer_left_data_size > 0)
+    {
+        iovs[0].iov_base = buffer_peek(out_buffer);
+        iovs[0].iov_len = buffer_left_data_size;
+        iov_count = 1;
+    }
+    for (i = 0; i < count; ++i)
+    {
+        if (vecs[i].iov_len > 0)
+        {
+            iovs[iov_count] = vecs[i];
+            iov_count++;
+        }
+    }
+
+    if (0 == iov_count)
+    {
+        return 0;
+    }
+
+    written = writev(connection->fd, iovs, iov_count);
+    if (written < 0)
+    {
+        error = errno;
+        if (error != EAGAIN && error != EINTR)
+        {
+            log_error("tcp_connection_sendvInLoop: writev() failed, errno: %d, peer addr: %s:%u", error, peer_addr->ip, peer_addr->port);
+            return -1;
+        }
+        written = 0;
+    }
+    sent = written;
+
+    if (buffer_left_data_size > 0)
+    {
+        if ((unsigned)written < buffer_left_data_size)
+        {
+            buffer_retrieve(out_buffer, written);
+            written = 0;
+        }
+        else
+        {
+            buffer_retrieveall(out_buffer);
+            written -= buffer_left_data_size;
+        }
+        iov_count--;
+        memmove(&iovs[0], &iovs[1], (iov_count * sizeof(struct iovec)));
+    }
+
+    /* 本次提交的数据中未发送出去的部分，依次放入 out_buffer，在后续 EPOLLOUT 事件中继续发送 */
+    for (i = 0; i < iov_count; ++i)
+    {
+        if ((size_t)written >= iovs[i].iov_len)
+        {
+            written -= iovs[i].iov_len;
+            continue;
+        }
+
+        buffer_append(out_buffer, ((const char*)iovs[i].iov_base + written), (iovs[i].iov_len - written));
+        written = 0;
+    }
+
+    if (buffer_readablebytes(out_buffer) > 0)
+    {
+        channel_setevent(connection->channel, EPOLLOUT);
+    }
+    else
+    {
+        channel_clearevent(connection->channel, EPOLLOUT);
+    }
+
+    count_written(out_buffer, sent);
+
+    return 0;
+}
+
+int tcp_connection_sendv(tcp_connection_t* connection, const struct iovec *vecs, int count)
+{
+    struct tcp_connection_msg *connection_msg;
+    int size;
+    int i;
+
+    if (connection == NULL || vecs == NULL || count <= 0 || count > TCP_CONNECTION_MAX_IOVEC)
+    {
+        log_error("tcp_connection_sendv: bad connection(%p) or bad vecs(%p) or bad count(%d)", connection, vecs, count);
+        return -1;
+    }
+
+    if (0 == connection->is_connected)
+    {
+        log_warn("not a opened connection");
+        return -1;
+    }
+
+    if (loop_inloopthread(connection->loop))
+    {
+        tcp_connection_sendvInLoop(connection, vecs, count);
+    }
+    else
+    {
+        /* 跨线程时各段数据的地址在投递之后不再有效，只能合并拷贝为一段 */
+        size = 0;
+        for (i = 0; i < count; ++i)
+        {
+            size += vecs[i].iov_len;
+        }
+        if (size <= 0)
+        {
+            return 0;
+        }
+
+        connection_msg = (struct tcp_connection_msg *)malloc(sizeof(*connection_msg) + size);
+        connection_msg->connection = connection;
+        connection_msg->data = &connection_msg[1];
+        connection_msg->size = size;
+        size = 0;
+        for (i = 0; i < count; ++i)
+        {
+            memcpy((char*)connection_msg->data + size, vecs[i].iov_base, vecs[i].iov_len);
+            size += vecs[i].iov_len;
+        }
+
+        loop_async(connection->loop, do_tcp_connection_send, connection_msg);
+    }
+
+    return 0;
+}
+
 void tcp_connection_setcalback(tcp_connection_t* connection, on_data_f datacb, on_close_f closecb, void* userdata)
 {
     if (NULL != connection)
@@ -480,6 +814,41 @@ int tcp_connection_connected(tcp_connection_t *connection)
     return NULL == connection ? 0 : connection->is_connected;
 }
 
+int tcp_connection_pending_bytes(tcp_connection_t *connection)
+{
+    return NULL == connection ? 0 : buffer_readablebytes(connection->out_buffer);
+}
+
+void tcp_connection_set_autocork(tcp_connection_t *connection, int on)
+{
+    if (NULL != connection)
+    {
+        connection->auto_cork = on;
+    }
+
+    return;
+}
+
+int tcp_connection_probe(tcp_connection_t *connection)
+{
+    char byte;
+    int result;
+
+    if (NULL == connection || 0 == connection->is_connected || buffer_readablebytes(connection->in_buffer) > 0)
+    {
+        return 0;
+    }
+
+    result = recv(connection->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+        return 1;
+    }
+
+    /* 0: 对端已关闭，>0: 有未预期的数据，<0: 连接出错 */
+    return 0;
+}
+
 void tcp_connection_expand_send_buffer(tcp_connection_t *connection, unsigned size)
 {
     int result;
@@ -11,6 +11,8 @@ typedef struct tcp_connection tcp_connection_t;
 #include "tinylib/linux/net/loop.h"
 #include "tinylib/linux/net/inetaddr.h"
 
+#include <sys/uio.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,6 +20,7 @@ extern "C" {
 typedef void (*on_data_f)(tcp_connection_t* connection, buffer_t* buffer, void* userdata);
 typedef void (*on_close_f)(tcp_connection_t* connection, void* userdata);
 
+/* socket 选项由调用者(tcp_server/tcp_client)在此之前设置 */
 tcp_connection_t* tcp_connection_new(loop_t *loop, int fd, on_data_f datacb, on_close_f closecb, void* userdata, const inetaddr_t *peer_addr);
 
 const inetaddr_t* tcp_connection_getpeeraddr(tcp_connection_t* connection);
@@ -26,10 +29,27 @@ const inetaddr_t* tcp_connection_getlocaladdr(tcp_connection_t* connection);
 
 int tcp_connection_send(tcp_connection_t* connection, const void* data, int size);
 
+/* 单次 sendv 最多支持的数据段数 */
+#define TCP_CONNECTION_MAX_IOVEC 16
+
+/* 以 writev 一次提交多段数据，各段按顺序发送，如消息头与直接引用的消息体，免去拼接的拷贝
+ * 在 connection 所在的IO线程中调用时，未能立即发出的部分才会被拷贝到发送缓冲区
+ */
+int tcp_connection_sendv(tcp_connection_t* connection, const struct iovec *vecs, int count);
+
 void tcp_connection_setcalback(tcp_connection_t* connection, on_data_f datacb, on_close_f closecb, void* userdata);
 
+/* 优雅关闭: 先发完尚未发出的数据，再 shutdown(SHUT_WR) 并等待对端关闭，全程异步进行
+ * 超过关闭超时(默认5s)仍未完成时，以 RST 中止连接
+ */
 void tcp_connection_destroy(tcp_connection_t* connection);
 
+/* 立即以 RST 中止连接，丢弃尚未发出的数据，用于处理行为异常的对端 */
+void tcp_connection_abort(tcp_connection_t* connection);
+
+/* 设置优雅关闭的超时时间(ms)，需在 destroy 之前设置 */
+void tcp_connection_set_close_timeout(tcp_connection_t* connection, unsigned timeout);
+
 /* 将所给的connection对象从其所属的loop中移出，从此该connection对象的IO事件将不再被监测 
  * 该方法不是线程安全的，只能在其所在的IO线程中执行！
  */
@@ -44,6 +64,19 @@ loop_t* tcp_connection_getloop(tcp_connection_t *connection);
 
 int tcp_connection_connected(tcp_connection_t *connection);
 
+/* 返回发送缓冲区中尚未发出的字节数，可据此判断对端接收是否跟得上 
+ * 只能在 connection 所在的IO线程中执行！
+ */
+int tcp_connection_pending_bytes(tcp_connection_t *connection);
+
+/* 探测连接是否仍可复用: 对端未关闭、无错误且无尚未读取的数据，可复用时返回1
+ * 只能在 connection 所在的IO线程中执行！
+ */
+int tcp_connection_probe(tcp_connection_t *connection);
+
+/* 开启后，数据回调期间对 socket 设置 TCP_CORK，回调返回之后再一并发出 */
+void tcp_connection_set_autocork(tcp_connection_t *connection, int on);
+
 void tcp_connection_expand_send_buffer(tcp_connection_t *connection, unsigned size);
 void tcp_connection_expand_recv_buffer(tcp_connection_t *connection, unsigned size);
 
@@ -1,9 +1,12 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/tcp_server.h"
 #include "tinylib/linux/net/socket.h"
 #include "tinylib/linux/net/buffer.h"
 #include "tinylib/linux/net/inetaddr.h"
 #include "tinylib/util/log.h"
+#include "tinylib/util/metrics.h"
 
 #include <stdlib.h>
 #include <assert.h>
@@ -29,6 +32,7 @@ struct tcp_server
     void *userdata;
 
     inetaddr_t addr;
+    socket_options_t options;
 
     int is_started;
     int is_in_callback;
@@ -106,12 +110,15 @@ void server_onevent(int fd, int event, void* userdata)
     /* FIXME: when the errno is EINTR/ECONNABORTED, when we should go back and try again */
 
     inetaddr_init(&peer_addr, &addr);
+    metrics_thread()->tcp_accepts++;
 
     log_debug("new connection arrived from %s:%d, local addr: %s:%u", 
         peer_addr.ip, peer_addr.port, server->addr.ip, server->addr.port);
 
     set_socket_onblock(client_fd, 1);
+    set_socket_options(client_fd, &server->options);
     connection = tcp_connection_new(server->loop, client_fd, server_ondata, server_onclose, server, &peer_addr);
+    tcp_connection_set_autocork(connection, server->options.auto_cork);
 
     server->is_in_callback = 1;
     server->on_connection(connection, server->userdata, &peer_addr);
@@ -149,6 +156,7 @@ tcp_server_t* tcp_server_new
     server->on_connection = on_connection;
     server->userdata = userdata;
     inetaddr_initbyipport(&server->addr, ip, port);
+    socket_options_init(&server->options);
 
     server->is_started = 0;
     server->is_in_callback = 0;
@@ -202,6 +210,7 @@ void do_tcp_server_start(void* userdata)
 
         server->channel = channel_new(server->fd, server->loop, server_onevent, server);
 
+        set_socket_listen_options(server->fd, &server->options);
         if (listen(server->fd, SOMAXCONN) != 0)
         {
             log_error("do_tcp_server_start: listen() failed, errno: %d, local addr: %s:%u", errno, server->addr.ip, server->addr.port);
@@ -228,6 +237,18 @@ void do_tcp_server_start(void* userdata)
     return;
 }
 
+void tcp_server_set_options(tcp_server_t *server, const socket_options_t *options)
+{
+    if (NULL == server || NULL == options)
+    {
+        return;
+    }
+
+    server->options = *options;
+
+    return;
+}
+
 int tcp_server_start(tcp_server_t *server)
 {
     if (NULL == server)
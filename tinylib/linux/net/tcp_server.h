@@ -6,6 +6,7 @@ typedef struct tcp_server tcp_server_t;
 
 #include "tinylib/linux/net/tcp_connection.h"
 #include "tinylib/linux/net/loop.h"
+#include "tinylib/linux/net/socket.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,6 +22,9 @@ tcp_server_t* tcp_server_new
 
 void tcp_server_destroy(tcp_server_t *server);
 
+/* 设置监听 socket 及 accept 出的连接所用的选项，需在 tcp_server_start() 之前调用 */
+void tcp_server_set_options(tcp_server_t *server, const socket_options_t *options);
+
 int tcp_server_start(tcp_server_t *server);
 
 void tcp_server_stop(tcp_server_t *server);
@@ -1,8 +1,11 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/timer_queue.h"
 
 #include "tinylib/util/log.h"
 #include "tinylib/util/util.h"
+#include "tinylib/util/metrics.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -55,7 +58,7 @@ timer_queue_t* timer_queue_create(loop_t *loop)
     timer_queue->loop = loop;
     timer_queue->timer_list = NULL;
     timer_queue->timer_list_end = NULL;
-    timer_queue->min_timestamp = ts_ms();
+    timer_queue->min_timestamp = loop_now_ms(timer_queue->loop);
 
     return timer_queue;
 }
@@ -153,7 +156,7 @@ void remove_timer_inloop(timer_queue_t *timer_queue, loop_timer_t *timer)
         else
         {
             timer_queue->timer_list_end = NULL;
-            timer_queue->min_timestamp = ts_ms();
+            timer_queue->min_timestamp = loop_now_ms(timer_queue->loop);
         }
     }
     else if (timer_queue->timer_list_end == timer)
@@ -286,7 +289,7 @@ void do_timer_queue_refresh(void *userdata)
     timer_queue_t *timer_queue = timer->timer_queue;
 
     remove_timer_inloop(timer_queue, timer);
-    timer->timestamp = ts_ms() + timer->interval;
+    timer->timestamp = loop_now_ms(timer_queue->loop) + timer->interval;
     timer->prev = NULL;
     timer->next = NULL;
     insert_timer_inloop(timer_queue, timer);
@@ -325,7 +328,7 @@ long timer_queue_gettimeout(timer_queue_t *timer_queue)
         return 100;
     }
 
-    now = ts_ms();
+    now = loop_now_ms(timer_queue->loop);
     interval = (long)(timer_queue->min_timestamp - now);
 
     timeout = 100;
@@ -345,6 +348,8 @@ long timer_queue_gettimeout(timer_queue_t *timer_queue)
 void timer_queue_process_inloop(timer_queue_t *timer_queue)
 {
     unsigned long long now;
+    unsigned long long now_us;
+    metrics_t *metrics;
     loop_timer_t *timer;
 
     loop_timer_t *done_timer;
@@ -361,7 +366,7 @@ void timer_queue_process_inloop(timer_queue_t *timer_queue)
         return;
     }
 
-    now = ts_ms();
+    now = loop_now_ms(timer_queue->loop);
 
     /* 寻找第一个时间戳大于now的节点，在该节点之前的所有timer均为已超时 */
     timer = timer_queue->timer_list;
@@ -409,6 +414,9 @@ void timer_queue_process_inloop(timer_queue_t *timer_queue)
         timer_iter = timer_iter->next;
     }
 
+    metrics = metrics_thread();
+    now_us = loop_now_us(timer_queue->loop);
+
     while (NULL != done_timer)
     {
         timer = done_timer;
@@ -418,6 +426,10 @@ void timer_queue_process_inloop(timer_queue_t *timer_queue)
         timer->next = NULL;
         if (timer->is_alive)
         {
+            /* 超时时刻以ms为单位，延迟按本轮迭代缓存的时间计 */
+            metrics->timer_expired++;
+            histogram_record(&metrics->timer_lag_us, now_us - timer->timestamp * 1000);
+
             timer->is_in_callback = 1;
             timer->expirecb(timer->userdata);
             timer->is_in_callback = 0;
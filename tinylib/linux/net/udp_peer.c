@@ -1,10 +1,18 @@
 
+/* for recvmmsg() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/linux/net/udp_peer.h"
 #include "tinylib/linux/net/socket.h"
 #include "tinylib/linux/net/channel.h"
 #include "tinylib/linux/net/buffer.h"
 
 #include "tinylib/util/log.h"
+#include "tinylib/util/metrics.h"
 #include "tinylib/util/atomic.h"
 
 #include <stdlib.h>
@@ -13,11 +21,18 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/epoll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
 
+/* 每次 recvmmsg() 最多收取的报文个数 */
+#define UDP_PEER_RECV_BATCH 8
+
+/* 单个UDP报文的最大尺寸 */
+#define UDP_PEER_MAX_MESSAGE 65535
+
 struct udp_peer
 {
     atomic_t ref_count;
@@ -27,6 +42,8 @@ struct udp_peer
     unsigned short port;
     on_message_f messagecb;
     void *message_userdata;
+    on_batch_f batchcb;
+    void *batch_userdata;
     
     on_writable_f writecb;
     void *write_userdata;
@@ -34,9 +51,13 @@ struct udp_peer
     int fd;
     channel_t *channel;
 
+    /* 每个报文各占一块足以容纳最大报文的空间，避免截断 */
     struct{
-        unsigned chunk_count;
-        unsigned char data[(65535 + 2 + 18) * 8];
+        struct mmsghdr msgs[UDP_PEER_RECV_BATCH];
+        struct iovec iovs[UDP_PEER_RECV_BATCH];
+        struct sockaddr_in addrs[UDP_PEER_RECV_BATCH];
+        udp_message_t messages[UDP_PEER_RECV_BATCH];
+        unsigned char data[UDP_PEER_RECV_BATCH][UDP_PEER_MAX_MESSAGE];
     }in_buffer;
 };
 
@@ -47,15 +68,9 @@ void udp_peer_onevent(int fd, int event, void* userdata)
 
     int ret;
     int saved_errno;
-    struct sockaddr_in addr;
-    socklen_t addr_len;
-
-    unsigned short *chunk_size;
-    inetaddr_t *addr_buffer;
-    unsigned char *chunk_buffer;
-
-    unsigned chunk_offset;
-    unsigned max_chunk_size;
+    int i;
+    inetaddr_t addr;
+    metrics_t *metrics;
 
     peer = (udp_peer_t *)userdata;
     
@@ -65,65 +80,62 @@ void udp_peer_onevent(int fd, int event, void* userdata)
     }
     if (event & EPOLLIN)
     {
-        peer->in_buffer.chunk_count = 0;
-        chunk_offset = 0;
-        do
+        /* 一次系统调用收取一批报文，收完之后再逐个交给应用处理 */
+        for (i = 0; i < UDP_PEER_RECV_BATCH; ++i)
+        {
+            peer->in_buffer.iovs[i].iov_base = peer->in_buffer.data[i];
+            peer->in_buffer.iovs[i].iov_len = sizeof(peer->in_buffer.data[i]);
+            memset(&peer->in_buffer.msgs[i].msg_hdr, 0, sizeof(peer->in_buffer.msgs[i].msg_hdr));
+            peer->in_buffer.msgs[i].msg_hdr.msg_name = &peer->in_buffer.addrs[i];
+            peer->in_buffer.msgs[i].msg_hdr.msg_namelen = sizeof(peer->in_buffer.addrs[i]);
+            peer->in_buffer.msgs[i].msg_hdr.msg_iov = &peer->in_buffer.iovs[i];
+            peer->in_buffer.msgs[i].msg_hdr.msg_iovlen = 1;
+            peer->in_buffer.msgs[i].msg_len = 0;
+        }
+
+        ret = recvmmsg(peer->fd, peer->in_buffer.msgs, UDP_PEER_RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (ret < 0)
         {
-            max_chunk_size = sizeof(peer->in_buffer.data) - (chunk_offset + sizeof(*chunk_size) + sizeof(*addr_buffer));
-            if (max_chunk_size < 65507) /* 65507 = 65535 - 20 - 8 */
+            saved_errno = errno;
+            if (ECONNRESET != saved_errno && EAGAIN != saved_errno && EINTR != saved_errno)
             {
-                /* 保险起见，当剩下的数据空间，不足65535时，暂停收包，将已收的消息数据交给应用来处理，腾出空间供下次收包
-                 * 防备下一个消息达65535时，盲目收包造成消息截断，数据丢失
-                 */
-                break;
+                log_error_ratelimit(1000, "udp_peer_onevent: recvmmsg() failed, errno: %d, peer: %s:%u", saved_errno, peer->ip, peer->port);
             }
 
-            chunk_size = (unsigned short *)(peer->in_buffer.data + chunk_offset);
-            addr_buffer = (inetaddr_t *)(peer->in_buffer.data + chunk_offset + sizeof(*chunk_size));
-            chunk_buffer = peer->in_buffer.data + chunk_offset + sizeof(*chunk_size) + sizeof(*addr_buffer);
+            return;
+        }
 
-            memset(&addr, 0, sizeof(addr));
-            addr_len = sizeof(addr);
-            ret = recvfrom(peer->fd, chunk_buffer, max_chunk_size, 0, (struct sockaddr*)&addr, &addr_len);
-            if (ret >= 0)
+        if (ret > 0)
+        {
+            metrics = metrics_thread();
+            metrics->udp_packets_in += ret;
+            for (i = 0; i < ret; ++i)
             {
-                *chunk_size = (unsigned short)ret;
-                inetaddr_init(addr_buffer, &addr);
-                
-                chunk_offset += sizeof(*chunk_size) + sizeof(*addr_buffer) + ret;
-                peer->in_buffer.chunk_count++;
+                metrics->udp_bytes_in += peer->in_buffer.msgs[i].msg_len;
             }
-            else
+
+            if (NULL != peer->batchcb)
             {
-                saved_errno = errno;
-                if (ECONNRESET != saved_errno && EAGAIN != saved_errno)
+                for (i = 0; i < ret; ++i)
                 {
-                    log_error("udp_peer_onevent: recvfrom() failed, errno: %d, peer: %s:%u", saved_errno, peer->ip, peer->port);
+                    peer->in_buffer.messages[i].data = peer->in_buffer.data[i];
+                    peer->in_buffer.messages[i].size = peer->in_buffer.msgs[i].msg_len;
+                    peer->in_buffer.messages[i].capacity = sizeof(peer->in_buffer.data[i]);
+                    inetaddr_init(&peer->in_buffer.messages[i].peer_addr, &peer->in_buffer.addrs[i]);
                 }
-
-                break;
+                peer->batchcb(peer, peer->in_buffer.messages, (unsigned)ret, peer->batch_userdata);
             }
-        } while (1);
-        
-        if (peer->in_buffer.chunk_count > 0)
-        {
-            if (NULL != peer->messagecb)
+            else if (NULL != peer->messagecb)
             {
-                chunk_offset = 0;
-                do
+                for (i = 0; i < ret; ++i)
                 {
-                    chunk_size = (unsigned short *)(peer->in_buffer.data + chunk_offset);
-                    addr_buffer = (inetaddr_t *)(peer->in_buffer.data + chunk_offset + sizeof(*chunk_size));
-                    chunk_buffer = peer->in_buffer.data + chunk_offset + sizeof(*chunk_size) + sizeof(*addr_buffer);
-                    peer->messagecb(peer, chunk_buffer, *chunk_size, peer->message_userdata, addr_buffer);
-                    
-                    chunk_offset += sizeof(*chunk_size) + sizeof(*addr_buffer) + *chunk_size;
-                    peer->in_buffer.chunk_count--;
-                } while(peer->in_buffer.chunk_count > 0);
+                    inetaddr_init(&addr, &peer->in_buffer.addrs[i]);
+                    peer->messagecb(peer, peer->in_buffer.data[i], peer->in_buffer.msgs[i].msg_len, peer->message_userdata, &addr);
+                }
             }
             else
             {
-                log_warn("udp_peer(%s:%u): no message callback was found, all received data will be dropped", peer->ip, peer->port);
+                log_warn_ratelimit(1000, "udp_peer(%s:%u): no message callback was found, all received data will be dropped", peer->ip, peer->port);
             }
         }
     }
@@ -151,10 +163,12 @@ udp_peer_t* udp_peer_new(loop_t *loop, const char *ip, unsigned short port, on_m
 {
     int fd;
     udp_peer_t* peer;
+    struct sockaddr_in addr;
+    socklen_t addr_len;
 
-    if (NULL == loop || NULL == ip || 0 == port || NULL == messagecb)
+    if (NULL == loop || NULL == ip || NULL == messagecb)
     {
-        log_error("udp_peer_new: bad loop(%p) or bad ip(%p) or bad port(%p) or bad messagecb(%p)", loop, ip, port, messagecb);
+        log_error("udp_peer_new: bad loop(%p) or bad ip(%p) or bad messagecb(%p)", loop, ip, messagecb);
         return NULL;
     }
 
@@ -165,6 +179,17 @@ udp_peer_t* udp_peer_new(loop_t *loop, const char *ip, unsigned short port, on_m
         return NULL;
     }
 
+    /* port 为0时由系统分配临时端口，取回实际绑定的端口 */
+    if (0 == port)
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr_len = sizeof(addr);
+        if (getsockname(fd, (struct sockaddr*)&addr, &addr_len) == 0)
+        {
+            port = ntohs(addr.sin_port);
+        }
+    }
+
     peer = (udp_peer_t*)malloc(sizeof(udp_peer_t));
     memset(peer, 0, sizeof(*peer));
 
@@ -191,6 +216,8 @@ struct udp_peer_notify
 
     on_message_f messagecb;
     void *message_userdata;
+    on_batch_f batchcb;
+    void *batch_userdata;
     on_writable_f writecb;
     void *write_userdata;
 };
@@ -221,7 +248,7 @@ void do_udp_peer_onmessage(void *userdata)
     
     if (atomic_dec(&peer->ref_count) > 1)
     {
-        if (NULL == peer->messagecb)
+        if (NULL == peer->messagecb && NULL == peer->batchcb)
         {
             channel_clearevent(peer->channel, EPOLLIN);
             peer->message_userdata = NULL;
@@ -264,6 +291,63 @@ on_message_f udp_peer_onmessage(udp_peer_t* peer, on_message_f messagecb, void *
     return old_messagecb;
 }
 
+static 
+void do_udp_peer_onbatch(void *userdata)
+{
+    struct udp_peer_notify *notify;
+    udp_peer_t* peer;
+    
+    notify = (struct udp_peer_notify *)userdata;
+    peer = notify->peer;
+    
+    peer->batchcb = notify->batchcb;
+    peer->batch_userdata = notify->batch_userdata;
+    free(notify);
+    
+    if (atomic_dec(&peer->ref_count) > 1)
+    {
+        if (NULL == peer->messagecb && NULL == peer->batchcb)
+        {
+            channel_clearevent(peer->channel, EPOLLIN);
+        }
+        else
+        {
+            channel_setevent(peer->channel, EPOLLIN);
+        }
+    }
+    else
+    {
+        delete_udp_peer(peer);
+    }
+
+    return;
+}
+
+on_batch_f udp_peer_onbatch(udp_peer_t* peer, on_batch_f batchcb, void *userdata)
+{
+    on_batch_f old_batchcb;
+    struct udp_peer_notify *notify;
+    
+    if (NULL == peer)
+    {
+        log_error("udp_peer_onbatch: bad peer");
+        return NULL;
+    }
+
+    old_batchcb = peer->batchcb;
+
+    notify = (struct udp_peer_notify *)malloc(sizeof(*notify));    
+    memset(notify, 0, sizeof(*notify));
+
+    (void)atomic_inc(&peer->ref_count);
+    notify->peer = peer;
+    notify->batchcb = batchcb;
+    notify->batch_userdata = userdata;
+    loop_run_inloop(peer->loop, do_udp_peer_onbatch, notify);
+
+    return old_batchcb;
+}
+
 static 
 void do_udp_peer_onwrite(void *userdata)
 {
@@ -357,6 +441,18 @@ void udp_peer_destroy(udp_peer_t* peer)
     return;
 }
 
+/* 发送可在任意线程中进行，计入调用线程的计数 */
+static inline
+void count_sent(unsigned len)
+{
+    metrics_t *metrics = metrics_thread();
+
+    metrics->udp_packets_out++;
+    metrics->udp_bytes_out += len;
+
+    return;
+}
+
 /* 由于udp的简单性，请使用者自行完成报文分片，保证每次的message尺寸小于mtu, 本发送接口只做简单发送，不做缓存重发 */
 int udp_peer_send(udp_peer_t* peer, const void *message, unsigned len, const inetaddr_t *peer_addr)
 {
@@ -382,6 +478,10 @@ int udp_peer_send(udp_peer_t* peer, const void *message, unsigned len, const ine
     {
         ret = -1;
     }
+    else
+    {
+        count_sent(len);
+    }
 
     return ret;
 }
@@ -402,9 +502,13 @@ int udp_peer_send2(udp_peer_t* peer, const void *message, unsigned len, const st
     result = sendto(peer->fd, message, len, 0, (const struct sockaddr*)peer_addr, sizeof(*peer_addr));
     if (len != result)
     {
-        log_warn("udp_peer_send2: sendto() failed, errno: %d", errno);
+        log_warn_ratelimit(1000, "udp_peer_send2: sendto() failed, errno: %d", errno);
         ret = -1;
     }
+    else
+    {
+        count_sent(len);
+    }
 
     return ret;
 }
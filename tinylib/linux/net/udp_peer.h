@@ -18,6 +18,18 @@ typedef void (*on_message_f)(udp_peer_t *peer, void *message, unsigned size, voi
 
 typedef void (*on_writable_f)(udp_peer_t *peer, void* userdata);
 
+/* 一次 recvmmsg() 收到的一个报文，data 所在的缓冲区共有 capacity 字节，使用者可在其中原地改写(如 SRTP 解密) */
+typedef struct udp_message
+{
+    void *data;
+    unsigned size;
+    unsigned capacity;
+    inetaddr_t peer_addr;
+}udp_message_t;
+
+typedef void (*on_batch_f)(udp_peer_t *peer, udp_message_t *messages, unsigned count, void* userdata);
+
+/* port 为0时由系统分配端口，可通过 udp_peer_getport() 取得实际端口 */
 udp_peer_t* udp_peer_new(loop_t *loop, const char *ip, unsigned short port, on_message_f messagecb, on_writable_f writecb, void *userdata);
 
 unsigned short udp_peer_getport(udp_peer_t* peer);
@@ -25,6 +37,11 @@ unsigned short udp_peer_getport(udp_peer_t* peer);
 /* 挂接read事件，on_message_f为NULL时，表示清除read事件。返回原来的on_message_f */
 on_message_f udp_peer_onmessage(udp_peer_t* peer, on_message_f messagecb, void *userdata);
 
+/* 挂接批量的read回调，设置之后一次收到的一批报文通过一次 batchcb 交给使用者，不再逐个调用 messagecb，
+ * batchcb为NULL时恢复逐个调用 messagecb。返回原来的 on_batch_f
+ */
+on_batch_f udp_peer_onbatch(udp_peer_t* peer, on_batch_f batchcb, void *userdata);
+
 /* 挂接write事件，writecb为NULL时，表示清除write事件。返回原来的wirtecb */
 on_writable_f udp_peer_onwrite(udp_peer_t* peer, on_writable_f writecb, void *userdata);
 
@@ -0,0 +1,4 @@
+
+#if defined(__linux__)
+  #include "tinylib/linux/net/tcp_client_pool.h"
+#endif
@@ -0,0 +1,976 @@
+
+#define LOG_MODULE LOG_MODULE_RTSP
+
+#include "tinylib/rtp/rtcp_session.h"
+#include "tinylib/rtp/rtp_rtcp_packet.h"
+#include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* 31个报告块的 SR、最长 CNAME 的 SDES 及 BYE 合计不超过该尺寸 */
+#define RTCP_MAX_PACKET 1400
+#define RTCP_MAX_REPORT_BLOCKS 31
+#define RTCP_MAX_CNAME 255
+
+#define RTCP_DEFAULT_BANDWIDTH 1000000
+#define RTCP_DEFAULT_MIN_INTERVAL 5000
+
+/* 超过5个报告间隔没有活动的 SSRC 将被移除，见 RFC 3550 6.3.5 */
+#define RTCP_SOURCE_TIMEOUT_INTERVALS 5
+
+/* 计算平均 RTCP 包尺寸时计入的 UDP/IP 头 */
+#define RTCP_UDP_IP_OVERHEAD 28
+
+/* NTP 时间(1900年起)与 unix 时间(1970年起)的差值(s) */
+#define RTCP_NTP_OFFSET 2208988800u
+
+/* 序号校验的参数，同 RFC 3550 A.1 */
+#define RTP_SEQ_MOD (1<<16)
+#define MAX_DROPOUT 3000
+#define MAX_MISORDER 100
+#define MIN_SEQUENTIAL 2
+
+typedef struct rtcp_source
+{
+    uint32_t ssrc;
+
+    /* RFC 3550 A.1 中的序号状态 */
+    int has_seq;
+    uint16_t max_seq;
+    uint32_t cycles;
+    uint32_t base_seq;
+    uint32_t bad_seq;
+    uint32_t probation;
+    uint32_t received;
+    uint32_t expected_prior;
+    uint32_t received_prior;
+    unsigned long long bytes_received;
+
+    /* RFC 3550 A.8 中的到达间隔抖动，jitter 为实际值的16倍 */
+    int has_transit;
+    int32_t transit;
+    uint32_t jitter;
+
+    unsigned char fraction_lost;
+    int cumulative_lost;
+    int has_rtp;                /* 上次报告之后是否收到过 RTP 包，即是否需要报告块、是否计为 sender */
+
+    /* 最近收到的 SR，用于报告块中的 LSR/DLSR */
+    uint32_t lsr;
+    unsigned long long lsr_arrival;
+    int has_sender_report;
+    unsigned long long sender_packets;
+    unsigned long long sender_bytes;
+
+    int has_remote_report;
+    unsigned char remote_fraction_lost;
+    int remote_cumulative_lost;
+    unsigned remote_jitter;
+    int rtt_ms;
+
+    int is_bye;
+    unsigned long long last_active;
+
+    struct rtcp_source *next;
+}rtcp_source_t;
+
+struct rtcp_session
+{
+    loop_t *loop;
+    uint32_t ssrc;
+    char cname[RTCP_MAX_CNAME+1];
+    unsigned cname_len;
+    unsigned clock_rate;
+
+    rtcp_session_send_f send;
+    void *userdata;
+
+    unsigned bandwidth;
+    unsigned min_interval;
+    double avg_rtcp_size;
+    int initial;                /* 尚未发出过报告，此时最短间隔减半 */
+    loop_timer_t *timer;
+    uint32_t rand_state;
+
+    /* 本端发送的 RTP，用于 SR */
+    int we_sent;
+    uint32_t last_rtp_ts;
+    unsigned long long last_rtp_time;
+
+    rtcp_source_t *sources;
+    rtcp_session_stats_t stats;
+
+    int is_bye_sent;
+    int is_in_callback;
+    int is_alive;
+};
+
+static inline
+uint32_t get32(const unsigned char *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+static inline
+void put32(unsigned char *data, uint32_t value)
+{
+    data[0] = (unsigned char)(value >> 24);
+    data[1] = (unsigned char)(value >> 16);
+    data[2] = (unsigned char)(value >> 8);
+    data[3] = (unsigned char)(value & 0xff);
+
+    return;
+}
+
+/* 写入 RTCP 包头，length 为包的总字节数 */
+static inline
+void put_head(unsigned char *data, unsigned count, rtcp_packet_type_e type, unsigned length)
+{
+    data[0] = (unsigned char)(0x80 | (count & 0x1f));
+    data[1] = (unsigned char)type;
+    data[2] = (unsigned char)(((length/4) - 1) >> 8);
+    data[3] = (unsigned char)(((length/4) - 1) & 0xff);
+
+    return;
+}
+
+static
+uint32_t session_random(rtcp_session_t *session)
+{
+    uint32_t x = session->rand_state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    session->rand_state = x;
+
+    return x;
+}
+
+/* 当前的 NTP 时间，msw 为秒，lsw 为秒的小数部分 */
+static
+void ntp_now(uint32_t *msw, uint32_t *lsw)
+{
+    unsigned long long ms = now_ms();
+
+    *msw = (uint32_t)(ms / 1000 + RTCP_NTP_OFFSET);
+    *lsw = (uint32_t)(((ms % 1000) << 32) / 1000);
+
+    return;
+}
+
+/* NTP 时间中间的32位，即 LSR 及往返时延计算所用的格式，以1/65536s为单位 */
+static inline
+uint32_t ntp_middle(uint32_t msw, uint32_t lsw)
+{
+    return (msw << 16) | (lsw >> 16);
+}
+
+static
+void source_init_seq(rtcp_source_t *source, uint16_t seq)
+{
+    source->base_seq = seq;
+    source->max_seq = seq;
+    source->bad_seq = RTP_SEQ_MOD + 1;
+    source->cycles = 0;
+    source->received = 0;
+    source->received_prior = 0;
+    source->expected_prior = 0;
+
+    return;
+}
+
+/* RFC 3550 A.1，返回0表示该包不计入统计(仍在试用期或序号跳变尚未确认) */
+static
+int source_update_seq(rtcp_source_t *source, uint16_t seq)
+{
+    uint16_t udelta = (uint16_t)(seq - source->max_seq);
+
+    if (source->probation)
+    {
+        if (seq == (uint16_t)(source->max_seq + 1))
+        {
+            source->probation--;
+            source->max_seq = seq;
+            if (0 == source->probation)
+            {
+                source_init_seq(source, seq);
+                source->received++;
+                return 1;
+            }
+        }
+        else
+        {
+            source->probation = MIN_SEQUENTIAL - 1;
+            source->max_seq = seq;
+        }
+        return 0;
+    }
+    else if (udelta < MAX_DROPOUT)
+    {
+        if (seq < source->max_seq)
+        {
+            source->cycles += RTP_SEQ_MOD;
+        }
+        source->max_seq = seq;
+    }
+    else if (udelta <= RTP_SEQ_MOD - MAX_MISORDER)
+    {
+        if (seq == source->bad_seq)
+        {
+            /* 连续两个包确认了跳变，可能是发送端重启 */
+            source_init_seq(source, seq);
+        }
+        else
+        {
+            source->bad_seq = (seq + 1) & (RTP_SEQ_MOD - 1);
+            return 0;
+        }
+    }
+    /* 否则为重复或乱序的包，照常计数 */
+    source->received++;
+
+    return 1;
+}
+
+static
+rtcp_source_t* source_get(rtcp_session_t *session, uint32_t ssrc)
+{
+    rtcp_source_t *source;
+
+    for (source = session->sources; NULL != source; source = source->next)
+    {
+        if (source->ssrc == ssrc)
+        {
+            return source;
+        }
+    }
+
+    source = (rtcp_source_t*)malloc(sizeof(rtcp_source_t));
+    memset(source, 0, sizeof(*source));
+    source->ssrc = ssrc;
+    source->rtt_ms = -1;
+    source->next = session->sources;
+    session->sources = source;
+    session->stats.sources++;
+
+    return source;
+}
+
+static
+rtcp_source_t* source_find(rtcp_session_t *session, uint32_t ssrc)
+{
+    rtcp_source_t *source;
+
+    for (source = session->sources; NULL != source; source = source->next)
+    {
+        if (source->ssrc == ssrc)
+        {
+            return source;
+        }
+    }
+
+    return NULL;
+}
+
+static inline
+uint32_t source_expected(rtcp_source_t *source)
+{
+    return source->cycles + source->max_seq - source->base_seq + 1;
+}
+
+static inline
+int source_lost(rtcp_source_t *source)
+{
+    int lost = (int)(source_expected(source) - source->received);
+
+    /* 24位有符号数 */
+    if (lost > 0x7fffff)
+    {
+        lost = 0x7fffff;
+    }
+    else if (lost < -0x800000)
+    {
+        lost = -0x800000;
+    }
+
+    return lost;
+}
+
+/* 写入针对 source 的报告块(24字节)，RFC 3550 A.3 */
+static
+void source_report_block(rtcp_source_t *source, unsigned char *data, unsigned long long now)
+{
+    uint32_t expected;
+    uint32_t expected_interval;
+    uint32_t received_interval;
+    int lost_interval;
+    uint32_t dlsr;
+
+    expected = source_expected(source);
+    expected_interval = expected - source->expected_prior;
+    source->expected_prior = expected;
+    received_interval = source->received - source->received_prior;
+    source->received_prior = source->received;
+    lost_interval = (int)(expected_interval - received_interval);
+
+    source->cumulative_lost = source_lost(source);
+    if (0 == expected_interval || lost_interval <= 0)
+    {
+        source->fraction_lost = 0;
+    }
+    else
+    {
+        source->fraction_lost = (unsigned char)(((unsigned)lost_interval << 8) / expected_interval);
+    }
+
+    dlsr = 0;
+    if (source->has_sender_report)
+    {
+        dlsr = (uint32_t)((now - source->lsr_arrival) * 65536 / 1000);
+    }
+
+    put32(data, source->ssrc);
+    put32(data + 4, ((uint32_t)source->fraction_lost << 24) | ((uint32_t)source->cumulative_lost & 0xffffff));
+    put32(data + 8, source->cycles + source->max_seq);
+    put32(data + 12, source->jitter >> 4);
+    put32(data + 16, source->lsr);
+    put32(data + 20, dlsr);
+
+    return;
+}
+
+/* 处理 SR/RR 中的报告块，只关心针对本端的报告 */
+static
+void session_on_report_blocks(rtcp_session_t *session, rtcp_source_t *source, const unsigned char *data, unsigned count)
+{
+    uint32_t msw;
+    uint32_t lsw;
+    uint32_t lsr;
+    uint32_t dlsr;
+    uint32_t rtt;
+    int32_t lost;
+    unsigned i;
+
+    for (i = 0; i < count; ++i, data += 24)
+    {
+        if (get32(data) != session->ssrc)
+        {
+            continue;
+        }
+
+        lost = (int32_t)(get32(data + 4) & 0xffffff);
+        if (lost & 0x800000)
+        {
+            lost -= 0x1000000;
+        }
+        source->has_remote_report = 1;
+        source->remote_fraction_lost = data[4];
+        source->remote_cumulative_lost = lost;
+        source->remote_jitter = get32(data + 12);
+
+        lsr = get32(data + 16);
+        dlsr = get32(data + 20);
+        if (0 != lsr)
+        {
+            ntp_now(&msw, &lsw);
+            rtt = ntp_middle(msw, lsw) - lsr - dlsr;
+            source->rtt_ms = ((int32_t)rtt < 0) ? 0 : (int)((unsigned long long)rtt * 1000 / 65536);
+        }
+    }
+
+    return;
+}
+
+/* RFC 3550 6.3.1 及 A.7 计算报告间隔(ms)
+ * 这里没有实现 timer reconsideration，故不再除以 e-3/2 的补偿系数
+ */
+static
+unsigned session_interval(rtcp_session_t *session)
+{
+    rtcp_source_t *source;
+    double rtcp_bw;
+    double t;
+    double tmin;
+    unsigned members;
+    unsigned senders;
+    unsigned n;
+
+    members = 1;
+    senders = session->we_sent ? 1 : 0;
+    for (source = session->sources; NULL != source; source = source->next)
+    {
+        if (source->is_bye)
+        {
+            continue;
+        }
+        members++;
+        if (source->has_rtp)
+        {
+            senders++;
+        }
+    }
+
+    /* RTCP 占会话带宽的5%，以字节每秒计 */
+    rtcp_bw = session->bandwidth / 8.0 * 0.05;
+    n = members;
+    if (senders * 4 <= members)
+    {
+        if (session->we_sent)
+        {
+            rtcp_bw *= 0.25;
+            n = senders;
+        }
+        else
+        {
+            rtcp_bw *= 0.75;
+            n = members - senders;
+        }
+    }
+
+    t = (rtcp_bw > 0) ? (session->avg_rtcp_size * n / rtcp_bw) : 0;
+    tmin = session->min_interval / 1000.0;
+    if (session->initial)
+    {
+        tmin /= 2;
+    }
+    if (t < tmin)
+    {
+        t = tmin;
+    }
+
+    /* 随机化到 [0.5, 1.5] 倍，避免各成员的报告同步 */
+    t = t * (0.5 + (session_random(session) % 1000) / 1000.0);
+
+    return (unsigned)(t * 1000);
+}
+
+static
+void session_send_report(rtcp_session_t *session, int is_bye)
+{
+    unsigned char packet[RTCP_MAX_PACKET];
+    rtcp_source_t *source;
+    unsigned long long now;
+    uint32_t msw;
+    uint32_t lsw;
+    uint32_t rtp_ts;
+    unsigned count;
+    unsigned head;
+    unsigned len;
+    unsigned sdes_len;
+
+    now = ts_ms();
+
+    /* SR/RR，之后是报告块 */
+    if (session->we_sent)
+    {
+        ntp_now(&msw, &lsw);
+        rtp_ts = session->last_rtp_ts + (uint32_t)((now - session->last_rtp_time) * session->clock_rate / 1000);
+        put32(packet + 4, session->ssrc);
+        put32(packet + 8, msw);
+        put32(packet + 12, lsw);
+        put32(packet + 16, rtp_ts);
+        put32(packet + 20, (uint32_t)session->stats.packets_sent);
+        put32(packet + 24, (uint32_t)session->stats.bytes_sent);
+        head = 28;
+    }
+    else
+    {
+        put32(packet + 4, session->ssrc);
+        head = 8;
+    }
+
+    count = 0;
+    len = head;
+    for (source = session->sources; NULL != source && count < RTCP_MAX_REPORT_BLOCKS; source = source->next)
+    {
+        if (0 == source->has_rtp || 0 == source->has_seq || 0 != source->probation)
+        {
+            continue;
+        }
+        source_report_block(source, packet + len, now);
+        len += 24;
+        count++;
+    }
+    put_head(packet, count, session->we_sent ? RTCP_PACKET_TYPE_SR : RTCP_PACKET_TYPE_RR, len);
+
+    /* SDES CNAME，以一个或多个0结束并补齐到4字节 */
+    sdes_len = (8 + 2 + session->cname_len + 1 + 3) & ~3u;
+    memset(packet + len, 0, sdes_len);
+    put_head(packet + len, 1, RTCP_PACKET_TYPE_SDES, sdes_len);
+    put32(packet + len + 4, session->ssrc);
+    packet[len + 8] = 1;
+    packet[len + 9] = (unsigned char)session->cname_len;
+    memcpy(packet + len + 10, session->cname, session->cname_len);
+    len += sdes_len;
+
+    if (is_bye)
+    {
+        put_head(packet + len, 1, RTCP_PACKET_TYPE_BYE, 8);
+        put32(packet + len + 4, session->ssrc);
+        len += 8;
+    }
+
+    for (source = session->sources; NULL != source; source = source->next)
+    {
+        source->has_rtp = 0;
+    }
+    session->we_sent = 0;
+    session->initial = 0;
+    session->avg_rtcp_size += ((len + RTCP_UDP_IP_OVERHEAD) - session->avg_rtcp_size) / 16;
+    session->stats.reports_sent++;
+
+    session->is_in_callback = 1;
+    session->send(session, packet, len, session->userdata);
+    session->is_in_callback = 0;
+
+    return;
+}
+
+static inline
+void session_delete(rtcp_session_t *session)
+{
+    rtcp_source_t *source;
+
+    loop_cancel(session->loop, session->timer);
+    while (NULL != session->sources)
+    {
+        source = session->sources;
+        session->sources = source->next;
+        free(source);
+    }
+    free(session);
+
+    return;
+}
+
+/* 移除长时间没有活动的 SSRC，已发出 BYE 的 SSRC 保留到超时，以便查询其最后的统计 */
+static
+void session_timeout_sources(rtcp_session_t *session, unsigned long long now)
+{
+    rtcp_source_t *source;
+    rtcp_source_t **prev;
+    unsigned long long timeout;
+
+    timeout = (unsigned long long)session->stats.interval_ms * RTCP_SOURCE_TIMEOUT_INTERVALS;
+    if (timeout < session->min_interval * RTCP_SOURCE_TIMEOUT_INTERVALS)
+    {
+        timeout = session->min_interval * RTCP_SOURCE_TIMEOUT_INTERVALS;
+    }
+
+    prev = &session->sources;
+    while (NULL != (source = *prev))
+    {
+        if (source->last_active + timeout < now)
+        {
+            *prev = source->next;
+            free(source);
+            session->stats.sources--;
+            continue;
+        }
+        prev = &source->next;
+    }
+
+    return;
+}
+
+static
+void session_ontimer(void *userdata)
+{
+    rtcp_session_t *session = (rtcp_session_t*)userdata;
+
+    session->timer = NULL;
+    session_timeout_sources(session, loop_now_ms(session->loop));
+    session_send_report(session, 0);
+    if (0 == session->is_alive)
+    {
+        session_delete(session);
+        return;
+    }
+
+    session->stats.interval_ms = session_interval(session);
+    session->timer = loop_runafter(session->loop, session->stats.interval_ms, session_ontimer, session);
+
+    return;
+}
+
+rtcp_session_t* rtcp_session_new
+(
+    loop_t *loop,
+    uint32_t ssrc,
+    const char *cname,
+    unsigned clock_rate,
+    rtcp_session_send_f send,
+    void *userdata
+)
+{
+    rtcp_session_t *session;
+
+    if (NULL == loop || NULL == cname || 0 == clock_rate || NULL == send)
+    {
+        log_error("rtcp_session_new: bad loop(%p) or bad cname(%p) or bad clock_rate(%u) or bad send(%p)",
+            loop, cname, clock_rate, send);
+        return NULL;
+    }
+
+    session = (rtcp_session_t*)malloc(sizeof(rtcp_session_t));
+    memset(session, 0, sizeof(*session));
+    session->loop = loop;
+    session->cname_len = (unsigned)strlen(cname);
+    if (session->cname_len > RTCP_MAX_CNAME)
+    {
+        session->cname_len = RTCP_MAX_CNAME;
+    }
+    memcpy(session->cname, cname, session->cname_len);
+    session->clock_rate = clock_rate;
+    session->send = send;
+    session->userdata = userdata;
+
+    session->bandwidth = RTCP_DEFAULT_BANDWIDTH;
+    session->min_interval = RTCP_DEFAULT_MIN_INTERVAL;
+    session->initial = 1;
+    session->timer = NULL;
+
+    session->rand_state = (uint32_t)now_ms() ^ (uint32_t)current_tid() ^ (uint32_t)(uintptr_t)session;
+    if (0 == session->rand_state)
+    {
+        session->rand_state = 0x9e3779b9;
+    }
+    while (0 == ssrc)
+    {
+        ssrc = session_random(session);
+    }
+    session->ssrc = ssrc;
+    session->stats.ssrc = ssrc;
+
+    /* 初始的平均尺寸取一个 RR + SDES 的大小 */
+    session->avg_rtcp_size = 8 + 8 + 2 + session->cname_len + 1 + RTCP_UDP_IP_OVERHEAD;
+
+    session->is_in_callback = 0;
+    session->is_alive = 1;
+
+    return session;
+}
+
+void rtcp_session_destroy(rtcp_session_t *session)
+{
+    if (NULL == session)
+    {
+        return;
+    }
+
+    if (session->is_in_callback)
+    {
+        session->is_alive = 0;
+    }
+    else
+    {
+        session_delete(session);
+    }
+
+    return;
+}
+
+uint32_t rtcp_session_get_ssrc(rtcp_session_t *session)
+{
+    return NULL == session ? 0 : session->ssrc;
+}
+
+void rtcp_session_set_bandwidth(rtcp_session_t *session, unsigned bandwidth)
+{
+    if (NULL != session && bandwidth > 0)
+    {
+        session->bandwidth = bandwidth;
+    }
+
+    return;
+}
+
+void rtcp_session_set_min_interval(rtcp_session_t *session, unsigned interval)
+{
+    if (NULL != session && interval > 0)
+    {
+        session->min_interval = interval;
+    }
+
+    return;
+}
+
+void rtcp_session_start(rtcp_session_t *session)
+{
+    if (NULL == session || NULL != session->timer || session->is_bye_sent)
+    {
+        return;
+    }
+
+    session->stats.interval_ms = session_interval(session);
+    session->timer = loop_runafter(session->loop, session->stats.interval_ms, session_ontimer, session);
+
+    return;
+}
+
+void rtcp_session_on_rtp_sent(rtcp_session_t *session, const void *packet, unsigned size)
+{
+    const unsigned char *data = (const unsigned char*)packet;
+    unsigned head;
+
+    if (NULL == session || NULL == packet || size < 12)
+    {
+        return;
+    }
+
+    /* octet count 只计负载，不含 RTP 头及 CSRC */
+    head = 12 + (data[0] & 0x0f) * 4;
+    session->stats.packets_sent++;
+    session->stats.bytes_sent += (size > head) ? (size - head) : 0;
+    session->last_rtp_ts = get32(data + 4);
+    session->last_rtp_time = ts_ms();
+    session->we_sent = 1;
+
+    return;
+}
+
+int rtcp_session_on_rtp_received(rtcp_session_t *session, const void *packet, unsigned size)
+{
+    const unsigned char *data = (const unsigned char*)packet;
+    rtcp_source_t *source;
+    unsigned long long now;
+    uint16_t seq;
+    uint32_t arrival;
+    int32_t transit;
+    int32_t d;
+
+    if (NULL == session || NULL == packet || size < 12 || (data[0] >> 6) != 2)
+    {
+        return -1;
+    }
+
+    now = ts_ms();
+    seq = (uint16_t)((data[2] << 8) | data[3]);
+    source = source_get(session, get32(data + 8));
+    source->last_active = now;
+    if (0 == source->has_seq)
+    {
+        source_init_seq(source, seq);
+        source->max_seq = (uint16_t)(seq - 1);
+        source->probation = MIN_SEQUENTIAL;
+        source->has_seq = 1;
+    }
+
+    if (0 == source_update_seq(source, seq))
+    {
+        return 0;
+    }
+    source->bytes_received += size;
+    source->has_rtp = 1;
+
+    /* 到达时间换算为 RTP 时间戳单位，RFC 3550 A.8 */
+    arrival = (uint32_t)(now * session->clock_rate / 1000);
+    transit = (int32_t)(arrival - get32(data + 4));
+    if (source->has_transit)
+    {
+        d = transit - source->transit;
+        if (d < 0)
+        {
+            d = -d;
+        }
+        source->jitter += (uint32_t)d - ((source->jitter + 8) >> 4);
+    }
+    source->transit = transit;
+    source->has_transit = 1;
+
+    return 0;
+}
+
+int rtcp_session_on_rtcp_received(rtcp_session_t *session, const void *packet, unsigned size)
+{
+    const unsigned char *data = (const unsigned char*)packet;
+    rtcp_source_t *source;
+    unsigned long long now;
+    unsigned count;
+    unsigned len;
+    unsigned i;
+
+    if (NULL == session || NULL == packet)
+    {
+        return -1;
+    }
+
+    if (size < 8)
+    {
+        session->stats.invalid_received++;
+        return -1;
+    }
+
+    now = loop_now_ms(session->loop);
+    session->avg_rtcp_size += ((size + RTCP_UDP_IP_OVERHEAD) - session->avg_rtcp_size) / 16;
+    session->stats.reports_received++;
+
+    while (size >= 4)
+    {
+        count = data[0] & 0x1f;
+        len = (((unsigned)data[2] << 8) | data[3]) * 4 + 4;
+        if ((data[0] >> 6) != 2 || len > size)
+        {
+            session->stats.invalid_received++;
+            return -1;
+        }
+
+        switch (data[1])
+        {
+            case RTCP_PACKET_TYPE_SR:
+            {
+                if (len < 28 + count * 24)
+                {
+                    session->stats.invalid_received++;
+                    return -1;
+                }
+
+                source = source_get(session, get32(data + 4));
+                source->last_active = now;
+                source->lsr = ntp_middle(get32(data + 8), get32(data + 12));
+                source->lsr_arrival = now;
+                source->has_sender_report = 1;
+                source->sender_packets = get32(data + 20);
+                source->sender_bytes = get32(data + 24);
+                session_on_report_blocks(session, source, data + 28, count);
+                break;
+            }
+
+            case RTCP_PACKET_TYPE_RR:
+            {
+                if (len < 8 + count * 24)
+                {
+                    session->stats.invalid_received++;
+                    return -1;
+                }
+
+                source = source_get(session, get32(data + 4));
+                source->last_active = now;
+                session_on_report_blocks(session, source, data + 8, count);
+                break;
+            }
+
+            case RTCP_PACKET_TYPE_BYE:
+            {
+                for (i = 0; i < count && (4 + i * 4 + 4) <= len; ++i)
+                {
+                    source = source_find(session, get32(data + 4 + i * 4));
+                    if (NULL != source)
+                    {
+                        source->is_bye = 1;
+                        source->last_active = now;
+                    }
+                }
+                break;
+            }
+
+            default:
+            {
+                /* SDES/APP 等不做处理 */
+                break;
+            }
+        }
+
+        data += len;
+        size -= len;
+    }
+
+    return 0;
+}
+
+void rtcp_session_bye(rtcp_session_t *session)
+{
+    if (NULL == session || session->is_bye_sent)
+    {
+        return;
+    }
+
+    session->is_bye_sent = 1;
+    loop_cancel(session->loop, session->timer);
+    session->timer = NULL;
+
+    session_send_report(session, 1);
+    if (0 == session->is_alive)
+    {
+        session_delete(session);
+    }
+
+    return;
+}
+
+void rtcp_session_get_stats(rtcp_session_t *session, rtcp_session_stats_t *stats)
+{
+    if (NULL == session || NULL == stats)
+    {
+        return;
+    }
+
+    *stats = session->stats;
+
+    return;
+}
+
+int rtcp_session_get_source_stats(rtcp_session_t *session, uint32_t ssrc, rtcp_source_stats_t *stats)
+{
+    rtcp_source_t *source;
+
+    if (NULL == session || NULL == stats)
+    {
+        return -1;
+    }
+
+    source = source_find(session, ssrc);
+    if (NULL == source)
+    {
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    stats->ssrc = ssrc;
+    if (source->has_seq && 0 == source->probation)
+    {
+        stats->packets_received = source->received;
+        stats->bytes_received = source->bytes_received;
+        stats->extended_highest_seq = source->cycles + source->max_seq;
+        stats->cumulative_lost = source_lost(source);
+    }
+    stats->fraction_lost = source->fraction_lost;
+    stats->jitter = source->jitter >> 4;
+    stats->jitter_ms = (unsigned)((unsigned long long)stats->jitter * 1000 / session->clock_rate);
+
+    stats->has_sender_report = source->has_sender_report;
+    stats->sender_packets = source->sender_packets;
+    stats->sender_bytes = source->sender_bytes;
+
+    stats->has_remote_report = source->has_remote_report;
+    stats->remote_fraction_lost = source->remote_fraction_lost;
+    stats->remote_cumulative_lost = source->remote_cumulative_lost;
+    stats->remote_jitter = source->remote_jitter;
+    stats->rtt_ms = source->rtt_ms;
+    stats->is_bye = source->is_bye;
+
+    return 0;
+}
+
+int rtcp_session_get_sources(rtcp_session_t *session, uint32_t *ssrcs, int max)
+{
+    rtcp_source_t *source;
+    int count;
+
+    if (NULL == session || NULL == ssrcs || max <= 0)
+    {
+        return 0;
+    }
+
+    count = 0;
+    for (source = session->sources; NULL != source && count < max; source = source->next)
+    {
+        ssrcs[count] = source->ssrc;
+        count++;
+    }
+
+    return count;
+}
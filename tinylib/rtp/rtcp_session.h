@@ -0,0 +1,122 @@
+
+/** RTCP 会话: 统计收发的 RTP 包，按 RFC 3550 定时发出 SR/RR + SDES 复合包，并解析收到的 RTCP
+  *
+  * 每个远端 SSRC 分别统计收包数、字节数、累计丢包、丢包率及到达间隔抖动(RFC 3550 A.1/A.3/A.8)
+  * 报告间隔按 RFC 3550 6.3 由会话带宽及成员数计算，并在 [0.5, 1.5] 倍之间随机化，避免报告同步
+  * 远端的 SR/RR 中针对本端的报告块由 LSR/DLSR 计算出往返时延
+  *
+  * 会话只负责构建与解析，RTCP 包经由 send 回调发出，可以是 UDP(rtp_peer) 或 interleaved
+  * 可经由 rtp_peer_set_rtcp_session() 挂接到 rtp_peer 上，自动统计其收到的 RTP/RTCP 包
+  * 会话只能在创建时指定的 loop 线程中使用
+  */
+
+#ifndef TINYLIB_RTCP_SESSION_H
+#define TINYLIB_RTCP_SESSION_H
+
+struct rtcp_session;
+typedef struct rtcp_session rtcp_session_t;
+
+#include "tinylib/net/loop.h"
+
+#include <stdint.h>
+
+/* 发出一个 RTCP 复合包，packet 只在回调期间有效 */
+typedef void (*rtcp_session_send_f)(rtcp_session_t *session, const void *packet, unsigned size, void *userdata);
+
+/* 一个远端 SSRC 的统计 */
+typedef struct rtcp_source_stats
+{
+    uint32_t ssrc;
+
+    /* 本端收到的该 SSRC 的 RTP 包 */
+    unsigned long long packets_received;
+    unsigned long long bytes_received;
+    uint32_t extended_highest_seq;          /* 含回绕次数的最大序号 */
+    int cumulative_lost;
+    unsigned char fraction_lost;            /* 最近一个报告周期的丢包率，以1/256为单位 */
+    unsigned jitter;                        /* 到达间隔抖动，以 RTP 时间戳为单位 */
+    unsigned jitter_ms;
+
+    /* 该 SSRC 发来的 SR 中的发送统计 */
+    int has_sender_report;
+    unsigned long long sender_packets;
+    unsigned long long sender_bytes;
+
+    /* 该 SSRC 在 SR/RR 中对本端发送的报告 */
+    int has_remote_report;
+    unsigned char remote_fraction_lost;
+    int remote_cumulative_lost;
+    unsigned remote_jitter;
+    int rtt_ms;                             /* 由 LSR/DLSR 计算的往返时延，-1 表示尚未得到 */
+
+    int is_bye;                             /* 已收到该 SSRC 的 BYE */
+}rtcp_source_stats_t;
+
+typedef struct rtcp_session_stats
+{
+    uint32_t ssrc;                          /* 本端 SSRC */
+    unsigned sources;
+    unsigned long long packets_sent;
+    unsigned long long bytes_sent;          /* RTP 负载字节数，即 SR 中的 octet count */
+    unsigned long long reports_sent;
+    unsigned long long reports_received;
+    unsigned long long invalid_received;    /* 格式不正确的 RTCP 包 */
+    unsigned interval_ms;                   /* 最近一次计算的报告间隔 */
+}rtcp_session_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ssrc 为本端 SSRC，为0时随机生成；cname 为 SDES CNAME，如 "user@host"
+ * clock_rate 为 RTP 时间戳的时钟频率，如视频的90000，用于计算抖动及 SR 中的 RTP 时间戳
+ */
+rtcp_session_t* rtcp_session_new
+(
+    loop_t *loop,
+    uint32_t ssrc,
+    const char *cname,
+    unsigned clock_rate,
+    rtcp_session_send_f send,
+    void *userdata
+);
+
+/* 可在 send 回调中调用 */
+void rtcp_session_destroy(rtcp_session_t *session);
+
+uint32_t rtcp_session_get_ssrc(rtcp_session_t *session);
+
+/* 会话带宽(bit/s)，RTCP 占用其5%，用于计算报告间隔，默认 1Mbit/s */
+void rtcp_session_set_bandwidth(rtcp_session_t *session, unsigned bandwidth);
+
+/* 最短报告间隔(ms)，默认5000ms，即 RFC 3550 中的 Tmin */
+void rtcp_session_set_min_interval(rtcp_session_t *session, unsigned interval);
+
+/* 开始定时发送报告，首个报告在最短间隔的一半左右发出 */
+void rtcp_session_start(rtcp_session_t *session);
+
+/* 统计本端发出的一个 RTP 包 */
+void rtcp_session_on_rtp_sent(rtcp_session_t *session, const void *packet, unsigned size);
+
+/* 统计收到的一个 RTP 包，返回-1 表示不是合法的 RTP 包 */
+int rtcp_session_on_rtp_received(rtcp_session_t *session, const void *packet, unsigned size);
+
+/* 解析收到的 RTCP 复合包，返回-1 表示格式不正确 */
+int rtcp_session_on_rtcp_received(rtcp_session_t *session, const void *packet, unsigned size);
+
+/* 立即发出一个 RR/SR + SDES + BYE 复合包，之后不再定时报告 */
+void rtcp_session_bye(rtcp_session_t *session);
+
+void rtcp_session_get_stats(rtcp_session_t *session, rtcp_session_stats_t *stats);
+
+/* 查询 ssrc 对应的远端统计，不存在时返回-1 */
+int rtcp_session_get_source_stats(rtcp_session_t *session, uint32_t ssrc, rtcp_source_stats_t *stats);
+
+/* 取得全部远端 SSRC，最多 max 个，返回实际取得的个数 */
+int rtcp_session_get_sources(rtcp_session_t *session, uint32_t *ssrcs, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_RTCP_SESSION_H */
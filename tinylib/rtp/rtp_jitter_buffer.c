@@ -0,0 +1,548 @@
+
+#define LOG_MODULE LOG_MODULE_RTSP
+
+#include "tinylib/rtp/rtp_jitter_buffer.h"
+#include "tinylib/util/log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* 序号跳变的判定阈值，同 RFC 3550 A.1 */
+#define JITTER_MAX_DROPOUT 3000
+#define JITTER_MAX_MISORDER 100
+
+#define JITTER_MAX_CAPACITY 32768
+
+/* SSRC 空闲超过该时间(ms)且没有缓存的包时释放 */
+#define JITTER_STREAM_TIMEOUT 10000
+
+/* 定时检查的间隔为 latency 的1/4，限定在该范围之内(ms) */
+#define JITTER_MIN_TICK 5
+#define JITTER_MAX_TICK 20
+
+/* 环形缓冲中的一格，包数据另外存放在 stream->data 中下标相同的块中，二者均连续分配 */
+typedef struct jitter_slot
+{
+    unsigned long long arrival;
+    uint16_t sn;
+    uint16_t size;          /* 为0表示空 */
+    int is_emitted;         /* sn 对应的包已交付，用于区分重复与迟到 */
+}jitter_slot_t;
+
+typedef struct jitter_stream
+{
+    uint32_t ssrc;
+    uint16_t next_sn;       /* 下一个待交付的序号 */
+    uint16_t highest_sn;    /* 已收到的最大序号 */
+    int bad_sn;             /* 序号跳变之后期待的下一个序号，-1 表示没有跳变 */
+    int is_started;         /* 是否已交付过包，之前乱序到达的更小序号可以作为新的起点 */
+    unsigned count;
+    unsigned lost;          /* 尚未告知使用者的丢失数 */
+    unsigned long long last_active;
+
+    jitter_slot_t *slots;
+    unsigned char *data;
+
+    struct jitter_stream *next;
+}jitter_stream_t;
+
+struct rtp_jitter_buffer
+{
+    loop_t *loop;
+    unsigned latency;
+    unsigned capacity;
+    unsigned mask;
+    unsigned max_streams;
+
+    rtp_jitter_buffer_onpacket_f onpacket;
+    void *userdata;
+
+    jitter_stream_t *streams;
+    loop_timer_t *timer;
+
+    rtp_jitter_buffer_stats_t stats;
+
+    int is_in_callback;
+    int is_alive;
+};
+
+static
+void stream_delete(jitter_stream_t *stream)
+{
+    free(stream->slots);
+    free(stream->data);
+    free(stream);
+
+    return;
+}
+
+static
+jitter_stream_t* stream_new(rtp_jitter_buffer_t *jitter_buffer, uint32_t ssrc, uint16_t sn)
+{
+    jitter_stream_t *stream;
+
+    stream = (jitter_stream_t*)malloc(sizeof(jitter_stream_t));
+    memset(stream, 0, sizeof(*stream));
+    stream->ssrc = ssrc;
+    stream->next_sn = sn;
+    stream->highest_sn = (uint16_t)(sn - 1);
+    stream->bad_sn = -1;
+    stream->slots = (jitter_slot_t*)calloc(jitter_buffer->capacity, sizeof(jitter_slot_t));
+    stream->data = (unsigned char*)malloc(jitter_buffer->capacity * RTP_JITTER_BUFFER_MAX_PACKET);
+    if (NULL == stream->slots || NULL == stream->data)
+    {
+        log_error("stream_new: memory out, ssrc: %u, capacity: %u", ssrc, jitter_buffer->capacity);
+        stream_delete(stream);
+        return NULL;
+    }
+
+    stream->next = jitter_buffer->streams;
+    jitter_buffer->streams = stream;
+    jitter_buffer->stats.streams++;
+
+    return stream;
+}
+
+static inline
+jitter_stream_t* stream_find(rtp_jitter_buffer_t *jitter_buffer, uint32_t ssrc)
+{
+    jitter_stream_t *stream;
+
+    for (stream = jitter_buffer->streams; NULL != stream; stream = stream->next)
+    {
+        if (stream->ssrc == ssrc)
+        {
+            return stream;
+        }
+    }
+
+    return NULL;
+}
+
+/* 交付序号为 next_sn 的包并前移，返回0表示 jitter buffer 已在回调中被销毁 */
+static
+int stream_emit(rtp_jitter_buffer_t *jitter_buffer, jitter_stream_t *stream)
+{
+    unsigned index;
+    jitter_slot_t *slot;
+    unsigned lost;
+
+    index = stream->next_sn & jitter_buffer->mask;
+    slot = &stream->slots[index];
+    lost = stream->lost;
+
+    stream->is_started = 1;
+    stream->lost = 0;
+    stream->count--;
+    stream->next_sn++;
+    jitter_buffer->stats.buffered--;
+    jitter_buffer->stats.packets_out++;
+
+    jitter_buffer->is_in_callback = 1;
+    jitter_buffer->onpacket(jitter_buffer, stream->ssrc, &stream->data[index * RTP_JITTER_BUFFER_MAX_PACKET],
+        slot->size, lost, jitter_buffer->userdata);
+    jitter_buffer->is_in_callback = 0;
+
+    slot->size = 0;
+    slot->is_emitted = 1;
+
+    return jitter_buffer->is_alive;
+}
+
+/* 按序交付已等待超过 latency 的包，缺失的包在其后的包等待超过 latency 之后判定为丢失
+ * force 不为0时不再等待，交付全部缓存的包
+ */
+static
+int stream_drain(rtp_jitter_buffer_t *jitter_buffer, jitter_stream_t *stream, unsigned long long now, int force)
+{
+    jitter_slot_t *slot;
+    unsigned gap;
+
+    while (stream->count > 0)
+    {
+        slot = &stream->slots[stream->next_sn & jitter_buffer->mask];
+        if (slot->size > 0)
+        {
+            if (0 == force && slot->arrival + jitter_buffer->latency > now)
+            {
+                break;
+            }
+
+            if (0 == stream_emit(jitter_buffer, stream))
+            {
+                return 0;
+            }
+            continue;
+        }
+
+        /* 找到缺口之后第一个已到达的包，count 不为0时必然存在 */
+        for (gap = 1; gap < jitter_buffer->capacity; ++gap)
+        {
+            slot = &stream->slots[(stream->next_sn + gap) & jitter_buffer->mask];
+            if (slot->size > 0)
+            {
+                break;
+            }
+        }
+
+        if (0 == force && slot->arrival + jitter_buffer->latency > now)
+        {
+            break;
+        }
+
+        stream->lost += gap;
+        stream->next_sn += gap;
+        jitter_buffer->stats.lost += gap;
+    }
+
+    return 1;
+}
+
+/* 强制前移 steps 个序号，其间缓存的包立即交付，缺失的包判定为丢失 */
+static
+int stream_advance(rtp_jitter_buffer_t *jitter_buffer, jitter_stream_t *stream, unsigned steps)
+{
+    for (; steps > 0; --steps)
+    {
+        if (stream->slots[stream->next_sn & jitter_buffer->mask].size > 0)
+        {
+            if (0 == stream_emit(jitter_buffer, stream))
+            {
+                return 0;
+            }
+        }
+        else
+        {
+            stream->lost++;
+            stream->next_sn++;
+            jitter_buffer->stats.lost++;
+        }
+    }
+
+    return 1;
+}
+
+static inline
+void jitter_buffer_delete(rtp_jitter_buffer_t *jitter_buffer)
+{
+    jitter_stream_t *stream;
+
+    loop_cancel(jitter_buffer->loop, jitter_buffer->timer);
+    while (NULL != jitter_buffer->streams)
+    {
+        stream = jitter_buffer->streams;
+        jitter_buffer->streams = stream->next;
+        stream_delete(stream);
+    }
+    free(jitter_buffer);
+
+    return;
+}
+
+static
+void jitter_buffer_ontimer(void *userdata)
+{
+    rtp_jitter_buffer_t *jitter_buffer = (rtp_jitter_buffer_t*)userdata;
+    jitter_stream_t *stream;
+    jitter_stream_t **prev;
+    unsigned long long now;
+
+    now = loop_now_ms(jitter_buffer->loop);
+    prev = &jitter_buffer->streams;
+    while (NULL != (stream = *prev))
+    {
+        if (0 == stream_drain(jitter_buffer, stream, now, 0))
+        {
+            jitter_buffer_delete(jitter_buffer);
+            return;
+        }
+
+        if (0 == stream->count && stream->last_active + JITTER_STREAM_TIMEOUT < now)
+        {
+            *prev = stream->next;
+            stream_delete(stream);
+            jitter_buffer->stats.streams--;
+            continue;
+        }
+
+        prev = &stream->next;
+    }
+
+    return;
+}
+
+static inline
+unsigned jitter_buffer_tick(unsigned latency)
+{
+    unsigned tick = latency / 4;
+
+    if (tick < JITTER_MIN_TICK)
+    {
+        tick = JITTER_MIN_TICK;
+    }
+    else if (tick > JITTER_MAX_TICK)
+    {
+        tick = JITTER_MAX_TICK;
+    }
+
+    return tick;
+}
+
+rtp_jitter_buffer_t* rtp_jitter_buffer_new
+(
+    loop_t *loop,
+    unsigned latency,
+    unsigned capacity,
+    rtp_jitter_buffer_onpacket_f onpacket,
+    void *userdata
+)
+{
+    rtp_jitter_buffer_t *jitter_buffer;
+    unsigned size;
+
+    if (NULL == loop || NULL == onpacket || capacity > JITTER_MAX_CAPACITY)
+    {
+        log_error("rtp_jitter_buffer_new: bad loop(%p) or bad onpacket(%p) or bad capacity(%u)", loop, onpacket, capacity);
+        return NULL;
+    }
+
+    if (0 == capacity)
+    {
+        capacity = RTP_JITTER_BUFFER_DEFAULT_CAPACITY;
+    }
+    for (size = 1; size < capacity; size <<= 1)
+    {
+        ;
+    }
+
+    jitter_buffer = (rtp_jitter_buffer_t*)malloc(sizeof(rtp_jitter_buffer_t));
+    memset(jitter_buffer, 0, sizeof(*jitter_buffer));
+    jitter_buffer->loop = loop;
+    jitter_buffer->latency = latency;
+    jitter_buffer->capacity = size;
+    jitter_buffer->mask = size - 1;
+    jitter_buffer->max_streams = RTP_JITTER_BUFFER_DEFAULT_MAX_STREAMS;
+    jitter_buffer->onpacket = onpacket;
+    jitter_buffer->userdata = userdata;
+    jitter_buffer->streams = NULL;
+    jitter_buffer->timer = loop_runevery(loop, jitter_buffer_tick(latency), jitter_buffer_ontimer, jitter_buffer);
+    jitter_buffer->is_in_callback = 0;
+    jitter_buffer->is_alive = 1;
+
+    return jitter_buffer;
+}
+
+void rtp_jitter_buffer_destroy(rtp_jitter_buffer_t *jitter_buffer)
+{
+    if (NULL == jitter_buffer)
+    {
+        return;
+    }
+
+    if (jitter_buffer->is_in_callback)
+    {
+        jitter_buffer->is_alive = 0;
+    }
+    else
+    {
+        jitter_buffer_delete(jitter_buffer);
+    }
+
+    return;
+}
+
+void rtp_jitter_buffer_set_latency(rtp_jitter_buffer_t *jitter_buffer, unsigned latency)
+{
+    if (NULL == jitter_buffer)
+    {
+        return;
+    }
+
+    if (jitter_buffer_tick(latency) != jitter_buffer_tick(jitter_buffer->latency))
+    {
+        loop_cancel(jitter_buffer->loop, jitter_buffer->timer);
+        jitter_buffer->timer = loop_runevery(jitter_buffer->loop, jitter_buffer_tick(latency), jitter_buffer_ontimer, jitter_buffer);
+    }
+    jitter_buffer->latency = latency;
+
+    return;
+}
+
+void rtp_jitter_buffer_set_max_streams(rtp_jitter_buffer_t *jitter_buffer, unsigned max_streams)
+{
+    if (NULL == jitter_buffer)
+    {
+        return;
+    }
+
+    jitter_buffer->max_streams = (0 == max_streams) ? RTP_JITTER_BUFFER_DEFAULT_MAX_STREAMS : max_streams;
+
+    return;
+}
+
+int rtp_jitter_buffer_push(rtp_jitter_buffer_t *jitter_buffer, const void *packet, unsigned size)
+{
+    const unsigned char *data = (const unsigned char*)packet;
+    jitter_stream_t *stream;
+    jitter_slot_t *slot;
+    unsigned long long now;
+    uint32_t ssrc;
+    uint16_t sn;
+    int diff;
+
+    if (NULL == jitter_buffer || NULL == packet)
+    {
+        log_error("rtp_jitter_buffer_push: bad jitter_buffer(%p) or bad packet(%p)", jitter_buffer, packet);
+        return -1;
+    }
+
+    if (size < 12 || size > RTP_JITTER_BUFFER_MAX_PACKET || (data[0] >> 6) != 2)
+    {
+        jitter_buffer->stats.invalid++;
+        return -1;
+    }
+
+    sn = (uint16_t)((data[2] << 8) | data[3]);
+    ssrc = ((uint32_t)data[8] << 24) | ((uint32_t)data[9] << 16) | ((uint32_t)data[10] << 8) | (uint32_t)data[11];
+    now = loop_now_ms(jitter_buffer->loop);
+
+    stream = stream_find(jitter_buffer, ssrc);
+    if (NULL == stream)
+    {
+        if (jitter_buffer->stats.streams >= jitter_buffer->max_streams)
+        {
+            jitter_buffer->stats.rejected++;
+            log_warn_ratelimit(1000, "rtp_jitter_buffer_push: too many streams(%u), ssrc %u rejected", jitter_buffer->stats.streams, ssrc);
+            return -1;
+        }
+
+        stream = stream_new(jitter_buffer, ssrc, sn);
+        if (NULL == stream)
+        {
+            return -1;
+        }
+    }
+    stream->last_active = now;
+    jitter_buffer->stats.packets_in++;
+
+    diff = (int16_t)(uint16_t)(sn - stream->next_sn);
+    if (diff < 0 && diff >= -JITTER_MAX_MISORDER && 0 == stream->is_started
+        && (int16_t)(uint16_t)(stream->highest_sn - sn) < (int)jitter_buffer->capacity)
+    {
+        /* 尚未交付过包，第一个到达的包并不一定是最早的包 */
+        stream->next_sn = sn;
+        diff = 0;
+    }
+
+    if ((diff < 0 && diff >= -JITTER_MAX_MISORDER) || (diff >= (int)jitter_buffer->capacity && diff < JITTER_MAX_DROPOUT))
+    {
+        if (diff < 0)
+        {
+            /* 已交付过其后的包，只能丢弃 */
+            slot = &stream->slots[sn & jitter_buffer->mask];
+            if (slot->is_emitted && slot->sn == sn)
+            {
+                jitter_buffer->stats.duplicates++;
+            }
+            else
+            {
+                jitter_buffer->stats.late++;
+            }
+            return -1;
+        }
+
+        /* 超出环形缓冲的范围，前移使其能容纳该包 */
+        if (0 == stream_advance(jitter_buffer, stream, diff - jitter_buffer->capacity + 1))
+        {
+            jitter_buffer_delete(jitter_buffer);
+            return -1;
+        }
+        diff = jitter_buffer->capacity - 1;
+    }
+    else if (diff < 0 || diff >= (int)jitter_buffer->capacity)
+    {
+        /* 序号大幅跳变，可能是发送端重启，下一个包与之连续时才重新同步 */
+        if (stream->bad_sn != sn)
+        {
+            stream->bad_sn = (uint16_t)(sn + 1);
+            jitter_buffer->stats.invalid++;
+            return -1;
+        }
+
+        if (0 == stream_drain(jitter_buffer, stream, now, 1))
+        {
+            jitter_buffer_delete(jitter_buffer);
+            return -1;
+        }
+        stream->next_sn = sn;
+        stream->highest_sn = (uint16_t)(sn - 1);
+        jitter_buffer->stats.resyncs++;
+        diff = 0;
+    }
+    stream->bad_sn = -1;
+
+    slot = &stream->slots[sn & jitter_buffer->mask];
+    if (slot->size > 0)
+    {
+        jitter_buffer->stats.duplicates++;
+        return -1;
+    }
+
+    slot->arrival = now;
+    slot->sn = sn;
+    slot->size = (uint16_t)size;
+    slot->is_emitted = 0;
+    memcpy(&stream->data[(sn & jitter_buffer->mask) * RTP_JITTER_BUFFER_MAX_PACKET], data, size);
+    stream->count++;
+    jitter_buffer->stats.buffered++;
+
+    if (diff <= (int16_t)(uint16_t)(stream->highest_sn - stream->next_sn))
+    {
+        jitter_buffer->stats.reordered++;
+    }
+    else
+    {
+        stream->highest_sn = sn;
+    }
+
+    /* 不需等待时立即交付 */
+    if (0 == jitter_buffer->latency && 0 == stream_drain(jitter_buffer, stream, now, 0))
+    {
+        jitter_buffer_delete(jitter_buffer);
+    }
+
+    return 0;
+}
+
+void rtp_jitter_buffer_flush(rtp_jitter_buffer_t *jitter_buffer)
+{
+    jitter_stream_t *stream;
+
+    if (NULL == jitter_buffer)
+    {
+        return;
+    }
+
+    for (stream = jitter_buffer->streams; NULL != stream; stream = stream->next)
+    {
+        if (0 == stream_drain(jitter_buffer, stream, 0, 1))
+        {
+            jitter_buffer_delete(jitter_buffer);
+            return;
+        }
+    }
+
+    return;
+}
+
+void rtp_jitter_buffer_get_stats(rtp_jitter_buffer_t *jitter_buffer, rtp_jitter_buffer_stats_t *stats)
+{
+    if (NULL == jitter_buffer || NULL == stats)
+    {
+        return;
+    }
+
+    *stats = jitter_buffer->stats;
+
+    return;
+}
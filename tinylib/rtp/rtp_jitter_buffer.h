@@ -0,0 +1,97 @@
+
+/** RTP 抖动缓冲: 按 SSRC 分别缓存收到的 RTP 包，排序之后按序号顺序交给使用者
+  *
+  * 每个 SSRC 一个以序号为下标的环形缓冲，序号回绕由16位序号差值自然处理
+  * 包在缓冲中至少停留 latency 毫秒，以吸收网络抖动和乱序；重复的包与迟到的包直接丢弃
+  * 缺失的包在其后的包等待超过 latency 仍未到达时判定为丢失，丢失数随下一个交付的包告知使用者
+  * 序号大幅跳变时参照 RFC 3550 A.1，连续两个包确认之后才重新同步
+  *
+  * 缓冲只能在创建时指定的 loop 线程中使用，可经由 rtp_peer_set_jitter_buffer() 挂接到 rtp_peer 上
+  * 也可以在 interleaved 回调中以 rtp_jitter_buffer_push() 直接输入
+  */
+
+#ifndef TINYLIB_RTP_JITTER_BUFFER_H
+#define TINYLIB_RTP_JITTER_BUFFER_H
+
+struct rtp_jitter_buffer;
+typedef struct rtp_jitter_buffer rtp_jitter_buffer_t;
+
+#include "tinylib/net/loop.h"
+
+#include <stdint.h>
+
+/* 缓存的单个包的最大尺寸，更大的包直接丢弃 */
+#define RTP_JITTER_BUFFER_MAX_PACKET 1500
+
+/* 默认每个 SSRC 可缓存的包数，总为2的幂 */
+#define RTP_JITTER_BUFFER_DEFAULT_CAPACITY 512
+
+/* 默认可同时缓存的 SSRC 数，每个 SSRC 建立时即分配 capacity * RTP_JITTER_BUFFER_MAX_PACKET 字节 */
+#define RTP_JITTER_BUFFER_DEFAULT_MAX_STREAMS 8
+
+/* 按序交付的包，packet 为包括 RTP 头在内的完整包，只在回调期间有效
+ * lost 为该包之前判定丢失的包数
+ */
+typedef void (*rtp_jitter_buffer_onpacket_f)
+(
+    rtp_jitter_buffer_t *jitter_buffer,
+    uint32_t ssrc,
+    const void *packet, unsigned short size,
+    unsigned lost,
+    void *userdata
+);
+
+typedef struct rtp_jitter_buffer_stats
+{
+    unsigned streams;                       /* 当前的 SSRC 数 */
+    unsigned buffered;                      /* 当前缓存的包数 */
+    unsigned long long packets_in;
+    unsigned long long packets_out;
+    unsigned long long duplicates;          /* 重复的包 */
+    unsigned long long late;                /* 到达时已交付过其后的包，只能丢弃 */
+    unsigned long long reordered;           /* 比已收到的更大序号的包晚到，但仍及时排好序 */
+    unsigned long long lost;
+    unsigned long long resyncs;             /* 序号大幅跳变之后重新同步的次数 */
+    unsigned long long invalid;             /* 非 RTP 版本2、超出尺寸或序号跳变尚未确认的包 */
+    unsigned long long rejected;            /* SSRC 数已达上限时新 SSRC 的包 */
+}rtp_jitter_buffer_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* latency 为包在缓冲中的最短停留时间(ms)
+ * capacity 为每个 SSRC 可缓存的包数，向上圆整为2的幂，为0时使用默认值
+ */
+rtp_jitter_buffer_t* rtp_jitter_buffer_new
+(
+    loop_t *loop,
+    unsigned latency,
+    unsigned capacity,
+    rtp_jitter_buffer_onpacket_f onpacket,
+    void *userdata
+);
+
+/* 可在 onpacket 回调中调用，尚未交付的包直接丢弃 */
+void rtp_jitter_buffer_destroy(rtp_jitter_buffer_t *jitter_buffer);
+
+void rtp_jitter_buffer_set_latency(rtp_jitter_buffer_t *jitter_buffer, unsigned latency);
+
+/* 可同时缓存的 SSRC 数上限，达到上限之后新 SSRC 的包直接丢弃，直至已有的 SSRC 空闲释放；为0时使用默认值
+ * 用于防止不断变换 SSRC 的发送方耗尽内存
+ */
+void rtp_jitter_buffer_set_max_streams(rtp_jitter_buffer_t *jitter_buffer, unsigned max_streams);
+
+/* 输入一个 RTP 包，数据会被拷贝；返回0表示已缓存，包被丢弃时返回-1 */
+int rtp_jitter_buffer_push(rtp_jitter_buffer_t *jitter_buffer, const void *packet, unsigned size);
+
+/* 不再等待，立即按序交付全部缓存的包，如在流结束时 */
+void rtp_jitter_buffer_flush(rtp_jitter_buffer_t *jitter_buffer);
+
+void rtp_jitter_buffer_get_stats(rtp_jitter_buffer_t *jitter_buffer, rtp_jitter_buffer_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_RTP_JITTER_BUFFER_H */
@@ -1,6 +1,10 @@
 
+#define LOG_MODULE LOG_MODULE_RTSP
+
 #include "tinylib/rtp/rtp_peer.h"
 #include "tinylib/rtp/rtp_rtcp_packet.h"
+#include "tinylib/rtp/rtp_jitter_buffer.h"
+#include "tinylib/rtp/rtcp_session.h"
 
 #include "tinylib/util/util.h"
 #include "tinylib/util/log.h"
@@ -17,6 +21,12 @@ struct rtp_peer
     udp_peer_t* rtp_udppeer;
     udp_peer_t* rtcp_udppeer;
     unsigned index;
+
+    on_message_f rtpcb;
+    on_message_f rtcpcb;
+    void *userdata;
+    rtp_jitter_buffer_t *jitter_buffer;     /* 不为NULL时 RTP 包交给 jitter buffer 排序，不再交给 rtpcb */
+    rtcp_session_t *rtcp_session;           /* 不为NULL时收到的 RTP/RTCP 包先经其统计 */
 };
 
 static struct rtp_peer_pool
@@ -48,6 +58,42 @@ void rtp_peer_pool_uninit(void)
     return;
 }
 
+static
+void peer_onrtp(udp_peer_t *udppeer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    rtp_peer_t *peer = (rtp_peer_t*)userdata;
+
+    if (NULL != peer->rtcp_session)
+    {
+        (void)rtcp_session_on_rtp_received(peer->rtcp_session, message, size);
+    }
+
+    if (NULL != peer->jitter_buffer)
+    {
+        (void)rtp_jitter_buffer_push(peer->jitter_buffer, message, size);
+    }
+    else
+    {
+        peer->rtpcb(udppeer, message, size, peer->userdata, peer_addr);
+    }
+
+    return;
+}
+
+static
+void peer_onrtcp(udp_peer_t *udppeer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    rtp_peer_t *peer = (rtp_peer_t*)userdata;
+
+    if (NULL != peer->rtcp_session)
+    {
+        (void)rtcp_session_on_rtcp_received(peer->rtcp_session, message, size);
+    }
+    peer->rtcpcb(udppeer, message, size, peer->userdata, peer_addr);
+
+    return;
+}
+
 /* 在给定的ip上分配一个rtp_peer */
 rtp_peer_t* rtp_peer_alloc
 (
@@ -89,14 +135,15 @@ rtp_peer_t* rtp_peer_alloc
             continue;
         }
 
-        rtp_udppeer = udp_peer_new(loop, ip, g_rtp_peer_pool.start_port+(index<<1), rtpcb, rtpwritecb, userdata);
+        /* RTP/RTCP 包先经过 peer_onrtp()/peer_onrtcp()，以便按需交给 jitter buffer 及 rtcp session */
+        rtp_udppeer = udp_peer_new(loop, ip, g_rtp_peer_pool.start_port+(index<<1), peer_onrtp, NULL, peer);
         if (NULL == rtp_udppeer)
         {
             (void)atomic_set(g_rtp_peer_pool.peer_bitmap+index, 0);
             continue;
         }
 
-        rtcp_udppeer = udp_peer_new(loop, ip, g_rtp_peer_pool.start_port+(index<<1)+1, rtcpcb, rtcpwritecb, userdata);
+        rtcp_udppeer = udp_peer_new(loop, ip, g_rtp_peer_pool.start_port+(index<<1)+1, peer_onrtcp, NULL, peer);
         if (NULL == rtcp_udppeer)
         {
             udp_peer_destroy(rtp_udppeer);
@@ -120,6 +167,19 @@ rtp_peer_t* rtp_peer_alloc
     peer->rtp_udppeer = rtp_udppeer;
     peer->rtcp_udppeer = rtcp_udppeer;
     peer->index = index;
+    peer->rtpcb = rtpcb;
+    peer->rtcpcb = rtcpcb;
+    peer->userdata = userdata;
+    peer->jitter_buffer = NULL;
+    peer->rtcp_session = NULL;
+    if (NULL != rtpwritecb)
+    {
+        (void)udp_peer_onwrite(rtp_udppeer, rtpwritecb, userdata);
+    }
+    if (NULL != rtcpwritecb)
+    {
+        (void)udp_peer_onwrite(rtcp_udppeer, rtcpwritecb, userdata);
+    }
 
     return peer;
 }
@@ -159,6 +219,26 @@ udp_peer_t* rtp_peer_get_rtcp_udppeer(rtp_peer_t* peer)
     return NULL == peer ? NULL : peer->rtcp_udppeer;
 }
 
+void rtp_peer_set_jitter_buffer(rtp_peer_t* peer, rtp_jitter_buffer_t *jitter_buffer)
+{
+    if (NULL != peer)
+    {
+        peer->jitter_buffer = jitter_buffer;
+    }
+
+    return;
+}
+
+void rtp_peer_set_rtcp_session(rtp_peer_t* peer, rtcp_session_t *session)
+{
+    if (NULL != peer)
+    {
+        peer->rtcp_session = session;
+    }
+
+    return;
+}
+
 static inline void build_default_bye_rtcp(rtcp_head_t *rtcp)
 {
     memset(rtcp, 0, sizeof(*rtcp));
@@ -3,6 +3,8 @@
 #define TINYLIB_RTP_PEER_H
 
 #include "tinylib/net/udp_peer.h"
+#include "tinylib/rtp/rtp_jitter_buffer.h"
+#include "tinylib/rtp/rtcp_session.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,6 +41,17 @@ udp_peer_t* rtp_peer_get_rtp_udppeer(rtp_peer_t* peer);
 
 udp_peer_t* rtp_peer_get_rtcp_udppeer(rtp_peer_t* peer);
 
+/* 挂接 jitter buffer，之后收到的 RTP 包经其排序之后交付，不再交给 rtp_peer_alloc() 时指定的 rtpcb
+ * jitter_buffer 为NULL时恢复直接交给 rtpcb；只能在 peer 所在的 loop 线程中调用，jitter buffer 由调用者负责销毁
+ */
+void rtp_peer_set_jitter_buffer(rtp_peer_t* peer, rtp_jitter_buffer_t *jitter_buffer);
+
+/* 挂接 rtcp session，之后收到的 RTP/RTCP 包先经其统计，再照常交给 jitter buffer/rtpcb 及 rtcpcb
+ * session 发出的 RTCP 包可在其 send 回调中经由 rtp_peer_get_rtcp_udppeer() 发送
+ * session 为NULL时取消挂接；只能在 peer 所在的 loop 线程中调用，session 由调用者负责销毁
+ */
+void rtp_peer_set_rtcp_session(rtp_peer_t* peer, rtcp_session_t *session);
+
 /* 向指定的地址发送一个RTCP BYE消息 */
 void rtp_peer_bye(rtp_peer_t* peer, const inetaddr_t *peer_addr);
 
@@ -1,11 +1,15 @@
 
 /** ҪǻbuilderģʽrtspϢӦϢн */
 
+#define LOG_MODULE LOG_MODULE_RTSP
+
 #include "tinylib/rtsp/rtsp_message_codec.h"
 
 #include "tinylib/util/log.h"
 #include "tinylib/util/atomic.h"
 #include "tinylib/util/md5.h"     /* for MD5() */
+#include "tinylib/util/text_scan.h"
+#include "tinylib/util/util.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -136,7 +140,7 @@ const char *get_status_text(int code)
             status = success_text[code - 200];
         }
     }
-    else if (code < 306)
+    else if (code >= 300 && code < 306)
     {
         status = redirect_text[code - 300];
     }
@@ -146,7 +150,7 @@ const char *get_status_text(int code)
     }
     else if (code >= 500 && code < 505)
     {
-        status = server_error_text[code - 300];
+        status = server_error_text[code - 500];
     }
     
     if (NULL == status)
@@ -157,52 +161,202 @@ const char *get_status_text(int code)
     return status;
 }
 
-static const char* head_key_text[] = {
-    "Accept",
-    "Accept-Encoding",
-    "Accept-Language",
-    "Allow",
-    "Authorization",
-    "Bandwidth",
-    "Blocksize",
-    "Cache-Control",
-    "Conference",
-    "Connection",
-    "Content-Base",
-    "Content-Encoding",
-    "Content-Language",
-    "Content-Length",
-    "Content-Location",
-    "Content-Type",
-    "CSeq",
-    "Date",
-    "Expires",
-    "From",
-    "Host",
-    "If-Match",
-    "If-Modified-Since",
-    "Last-Modified",
-    "Location",
-    "Proxy-Authenticate",
-    "Proxy-Require",
-    "Public",
-    "Range",
-    "Referer",
-    "Retry-After",
-    "Require",
-    "RTP-Info",
-    "Scale",
-    "Speed",
-    "Server",
-    "Session",
-    "Timestamp",
-    "Transport",
-    "Unsupported",
-    "User-Agent",
-    "Vary",
-    "Via",
-    "WWW-Authentica",
-    NULL
+/*  head Ϣе "Name: " ǰ׺ rtsp_head_key_e ˳УϢʱֱʹ */
+static const struct rtsp_head_prefix
+{
+    const char *text;
+    int len;
+} head_key_prefix[] = {
+    {"Accept: ", 8},
+    {"Accept-Encoding: ", 17},
+    {"Accept-Language: ", 17},
+    {"Allow: ", 7},
+    {"Authorization: ", 15},
+    {"Bandwidth: ", 11},
+    {"Blocksize: ", 11},
+    {"Cache-Control: ", 15},
+    {"Conference: ", 12},
+    {"Connection: ", 12},
+    {"Content-Base: ", 14},
+    {"Content-Encoding: ", 18},
+    {"Content-Language: ", 18},
+    {"Content-Length: ", 16},
+    {"Content-Location: ", 18},
+    {"Content-Type: ", 14},
+    {"CSeq: ", 6},
+    {"Date: ", 6},
+    {"Expires: ", 9},
+    {"From: ", 6},
+    {"Host: ", 6},
+    {"If-Match: ", 10},
+    {"If-Modified-Since: ", 19},
+    {"Last-Modified: ", 15},
+    {"Location: ", 10},
+    {"Proxy-Authenticate: ", 20},
+    {"Proxy-Require: ", 15},
+    {"Public: ", 8},
+    {"Range: ", 7},
+    {"Referer: ", 9},
+    {"Retry-After: ", 13},
+    {"Require: ", 9},
+    {"RTP-Info: ", 10},
+    {"Scale: ", 7},
+    {"Speed: ", 7},
+    {"Server: ", 8},
+    {"Session: ", 9},
+    {"Timestamp: ", 11},
+    {"Transport: ", 11},
+    {"Unsupported: ", 13},
+    {"User-Agent: ", 12},
+    {"Vary: ", 6},
+    {"Via: ", 5},
+    {"WWW-Authenticate: ", 18},
+};
+
+/* head Ƶ rtsp_head_key_e ϣhead ƲִСд(RFC 2326 4.2)
+ * ϣֵΪ seed ʼֽ hash*31 + (c|0x20) ֮ߵ16λȡ7λ
+ *  RTSP_HEAD_HASH_SEED β tools/rtsp_head_hash_gen.c  rtsp_head_key_e  head_key_prefix ɣҪֹ޸
+ * ɾ head ʱ޸ cmake --build <build dir> --target rtsp_head_hash ɣ֤ head ͻ
+ */
+#define RTSP_HEAD_HASH_SEED 13330
+#define RTSP_HEAD_HASH_SIZE 128
+#define RTSP_HEAD_NAME_MIN_LEN 3
+#define RTSP_HEAD_NAME_MAX_LEN 18
+
+static const struct rtsp_head_hash_entry
+{
+    const char *name;
+    int len;
+    rtsp_head_key_e key;
+} head_key_hash_table[RTSP_HEAD_HASH_SIZE] = {
+    {"RTP-Info", 8, RTSP_HEAD_RTP_INFO},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Content-Language", 16, RTSP_HEAD_CONTENT_LANGUAGE},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Session", 7, RTSP_HEAD_SESSION},
+    {"Accept-Language", 15, RTSP_HEAD_ACCEPT_LANGUAGE},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Expires", 7, RTSP_HEAD_EXPIRES},
+    {"Public", 6, RTSP_HEAD_PUBLIC},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Blocksize", 9, RTSP_HEAD_BLOCKSIZE},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Via", 3, RTSP_HEAD_VIA},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Unsupported", 11, RTSP_HEAD_UNSUPPORTED},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Content-Location", 16, RTSP_HEAD_CONTENT_LOCATION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Bandwidth", 9, RTSP_HEAD_BANDWIDTH},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Timestamp", 9, RTSP_HEAD_TIMESTAMP},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Transport", 9, RTSP_HEAD_TRANSPORT},
+    {"Content-Length", 14, RTSP_HEAD_CONTENT_LENGTH},
+    {"Date", 4, RTSP_HEAD_DATE},
+    {"Last-Modified", 13, RTSP_HEAD_LAST_MODIFIED},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Speed", 5, RTSP_HEAD_SPEED},
+    {"Allow", 5, RTSP_HEAD_ALLOW},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Vary", 4, RTSP_HEAD_VARY},
+    {"Proxy-Authenticate", 18, RTSP_HEAD_PROXY_AUTHENTICATE},
+    {"Range", 5, RTSP_HEAD_RANGE},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Scale", 5, RTSP_HEAD_SCALE},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Referer", 7, RTSP_HEAD_REFERER},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"If-Match", 8, RTSP_HEAD_IF_MATCH},
+    {"Host", 4, RTSP_HEAD_HOST},
+    {"From", 4, RTSP_HEAD_FROM},
+    {"WWW-Authenticate", 16, RTSP_HEAD_WWW_AUTHENTICA},
+    {"Authorization", 13, RTSP_HEAD_AUTHORIZATION},
+    {"Require", 7, RTSP_HEAD_REQUIRE},
+    {"Content-Encoding", 16, RTSP_HEAD_CONTENT_ENCODING},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Connection", 10, RTSP_HEAD_CONNECTION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Cache-Control", 13, RTSP_HEAD_CACHE_CONTROL},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"CSeq", 4, RTSP_HEAD_CSEQ},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Content-Base", 12, RTSP_HEAD_CONTENT_BASE},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Location", 8, RTSP_HEAD_LOCATION},
+    {"Conference", 10, RTSP_HEAD_CONFERENCE},
+    {"Server", 6, RTSP_HEAD_SERVER},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"If-Modified-Since", 17, RTSP_HEAD_IF_MODIFIED_SINCE},
+    {"Retry-After", 11, RTSP_HEAD_RETRY_AFTER},
+    {"User-Agent", 10, RTSP_HEAD_USER_AGENT},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Proxy-Require", 13, RTSP_HEAD_PROXY_REQUIRE},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Accept", 6, RTSP_HEAD_ACCEPT},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Content-Type", 12, RTSP_HEAD_CONTENT_TYPE},
+    {NULL, 0, RTSP_HEAD_EXTENSION},
+    {"Accept-Encoding", 15, RTSP_HEAD_ACCEPT_ENCODING},
 };
 
 static const char* method_text[] = {
@@ -244,53 +398,12 @@ static const char* method_text[] = {
     *(uint32_t *) m == ((c3 << 24) | (c2 << 16) | (c1 << 8) | c0)             \
         && ((uint32_t *) m)[1] == ((c7 << 24) | (c6 << 16) | (c5 << 8) | c4)
 
-#define ngx_str9cmp(m, c0, c1, c2, c3, c4, c5, c6, c7, c8)                    \
-    *(uint32_t *) m == ((c3 << 24) | (c2 << 16) | (c1 << 8) | c0)             \
-        && ((uint32_t *) m)[1] == ((c7 << 24) | (c6 << 16) | (c5 << 8) | c4)  \
-        && m[8] == c8
-
-#define ngx_str10cmp(m, c0, c1, c2, c3, c4, c5, c6, c7, c8, c9)               \
-    *(uint32_t *) m == ((c3 << 24) | (c2 << 16) | (c1 << 8) | c0)             \
-        && ((uint32_t *) m)[1] == ((c7 << 24) | (c6 << 16) | (c5 << 8) | c4)  \
-        && (((uint32_t *) m)[2] & 0xffff) == ((c9 << 8) | c8)
-        
-#define ngx_str12cmp(m, c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11)     \
-    *(uint32_t *) m == ((c3 << 24) | (c2 << 16) | (c1 << 8) | c0)             \
-        && ((uint32_t *) m)[1] == ((c7 << 24) | (c6 << 16) | (c5 << 8) | c4)  \
-        && ((uint32_t *) m)[2] == ((c11 << 24) | (c10 << 16) | (c9 << 8) | c8)
-
 #define ngx_str13cmp(m, c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12) \
     *(uint32_t *) m == ((c3 << 24) | (c2 << 16) | (c1 << 8) | c0)              \
         && ((uint32_t *) m)[1] == ((c7 << 24) | (c6 << 16) | (c5 << 8) | c4)   \
         && ((uint32_t *) m)[2] == ((c11 << 24) | (c10 << 16) | (c9 << 8) | c8) \
         && m[12] == c12
         
-#define ngx_str14cmp(m, c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12, c13) \
-    *(uint32_t *) m == ((c3 << 24) | (c2 << 16) | (c1 << 8) | c0)             \
-        && ((uint32_t *)m)[1] == ((c7 << 24) | (c6 << 16) | (c5 << 8) | c4)  \
-        && ((uint32_t *)m)[2] == ((c11 << 24) | (c10 << 16) | (c9 << 8) | c8) \
-        && (((uint32_t *)m)[3] & 0xffff) == ((c13 << 8) | c12)
-
-#define ngx_str16cmp(m, c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12, c13, c14, c15)     \
-    *(uint32_t *) m == ((c3 << 24) | (c2 << 16) | (c1 << 8) | c0)             \
-        && ((uint32_t *)m)[1] == ((c7 << 24) | (c6 << 16) | (c5 << 8) | c4)  \
-        && ((uint32_t *)m)[2] == ((c11 << 24) | (c10 << 16) | (c9 << 8) | c8) \
-        && ((uint32_t *)m)[3] == ((c15 << 24) | (c14 << 16) | (c13 << 8) | c12)
-
-#define ngx_str17cmp(m, c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12, c13, c14, c15, c16)     \
-    *(uint32_t *) m == ((c3 << 24) | (c2 << 16) | (c1 << 8) | c0)             \
-        && ((uint32_t *)m)[1] == ((c7 << 24) | (c6 << 16) | (c5 << 8) | c4)  \
-        && ((uint32_t *)m)[2] == ((c11 << 24) | (c10 << 16) | (c9 << 8) | c8) \
-        && ((uint32_t *)m)[3] == ((c15 << 24) | (c14 << 16) | (c13 << 8) | c12) \
-        && m[16] == c16
-        
-#define ngx_str18cmp(m, c0, c1, c2, c3, c4, c5, c6, c7, c8, c9, c10, c11, c12, c13, c14, c15, c16, c17)     \
-    *(uint32_t *) m == ((c3 << 24) | (c2 << 16) | (c1 << 8) | c0)             \
-        && ((uint32_t *)m)[1] == ((c7 << 24) | (c6 << 16) | (c5 << 8) | c4)  \
-        && ((uint32_t *)m)[2] == ((c11 << 24) | (c10 << 16) | (c9 << 8) | c8) \
-        && ((uint32_t *)m)[3] == ((c15 << 24) | (c14 << 16) | (c13 << 8) | c12) \
-        && (((uint32_t *)m)[4] & 0xffff) == ((c17 << 8) | c16)
-
 static inline
 void save_rtsp_head(rtsp_head_t* head, rtsp_head_t** head_list)
 {
@@ -307,305 +420,63 @@ void save_rtsp_head(rtsp_head_t* head, rtsp_head_t** head_list)
     return;
 }
 
-/* ÿrtsp headֻ֧rfc2326׼涨head
- * ĿǰֻheadõheadֱӷNULL
- */
 static inline
-rtsp_head_t* rtsp_msg_head_parse(const char *key_start, const char *key_end, const char *value_start, const char *value_end)
+unsigned rtsp_head_hash(const char *name, int len)
 {
-    rtsp_head_t* head = NULL;
-    
-    int key_len = key_end - key_start + 1;
-    switch (key_len)
+    uint32_t hash;
+    int i;
+
+    hash = RTSP_HEAD_HASH_SEED;
+    for (i = 0; i < len; ++i)
     {
-        case 3:
-        {
-            if (ngx_str4cmp(key_start, 'V', 'i', 'a', ':'))
-            {
-            }
-            break;
-        }
-        case 4:
-        {
-            if (ngx_str4cmp(key_start, 'C', 'S', 'e', 'q'))
-            {
-                head = (rtsp_head_t*)malloc(sizeof(rtsp_head_t) + (value_end - value_start + 2));
-                head->key = RTSP_HEAD_CSEQ;
-                head->value = (char*)&head[1];
-                head->next = NULL;
-                memcpy(head->value, value_start, (value_end - value_start + 1));
-                head->value[value_end - value_start + 1] = 0;
-            }
-            else if (ngx_str4cmp(key_start, 'D', 'a', 't', 'e'))
-            {
-            }
-            else if (ngx_str4cmp(key_start, 'F', 'r', 'o', 'm'))
-            {
-            }
-            else if (ngx_str4cmp(key_start, 'H', 'o', 's', 't'))
-            {
-                /* This HTTP request header field is not needed for RTSP. 
-                 * It should be silently ignored if sent. 
-                 */
-            }
-            else if (ngx_str4cmp(key_start, 'V', 'a', 'r', 'y'))
-            {
-            }
-            break;
-        }
-        case 5:
-        {
-            if (ngx_str5cmp(key_start, 'A', 'l', 'l', 'o', 'w'))
-            {
-                /* The Allow response header field lists the methods supported by the resource identified by the request-URI. */
-            }
-            else if (ngx_str5cmp(key_start, 'R', 'a', 'n', 'g', 'e'))
-            {
-                /* This request and response header field specifies a range of time. The range can be specified in a number of units. */
-            }
-            else if (ngx_str5cmp(key_start, 'S', 'c', 'a', 'l', 'e'))
-            {
-                /* A scale value of 1 indicates normal play or record at the normal
-                 * forward viewing rate. If not 1, the value corresponds to the rate
-                 * with respect to normal viewing rate. 
-                 */
-            }
-            else if (ngx_str5cmp(key_start, 'S', 'p', 'e', 'e', 'd'))
-            {
-                /* This request header fields parameter requests the server to deliver
-                 * data to the client at a particular speed, contingent on the server's
-                 * ability and desire to serve the media stream at the given speed.
-                 */
-            }
+        hash = hash * 31 + (uint8_t)(name[i] | 0x20);
+    }
 
-            break;
-        }
-        case 6:
-        {
-            if (ngx_str6cmp(key_start, 'A', 'c', 'c', 'e', 'p', 't'))
-            {
-                /* The Accept request-header field can be used to specify certain
-                 * presentation description content types which are acceptable for the response. 
-                 */
-            }
-            else if (ngx_str6cmp(key_start, 'P', 'u', 'b', 'l', 'i', 'c'))
-            {
-                /* The Public response-header field lists the set of methods supported by the server. 
-                 * The purpose of this field is strictly to inform the recipient of the capabilities of the server 
-                 * regarding unusualmethods. 
-                 */
-                head = (rtsp_head_t*)malloc(sizeof(rtsp_head_t) + (value_end - value_start + 2));
-                head->key = RTSP_HEAD_PUBLIC;
-                head->value = (char*)&head[1];
-                head->next = NULL;
-                memcpy(head->value, value_start, (value_end - value_start + 1));
-                head->value[value_end - value_start + 1] = 0;
-            }
-            else if (ngx_str6cmp(key_start, 'S', 'e', 'r', 'v', 'e', 'r'))
-            {
-                /* The Server response-header field contains information about 
-                 * the software used by the origin server to handle the request. 
-                 */
-            }
-            break;
-        }
-        case 7:
-        {
-            if (ngx_str8cmp(key_start, 'E', 'x', 'p', 'i', 'r', 'e', 's', ':'))
-            {
-                /* The Expires entity-header field gives the date/time 
-                 * after which the response should be considered stale. 
-                 */
-            }
-            else if (ngx_str8cmp(key_start, 'R', 'e', 'f', 'e', 'r', 'e', 'r', ':'))
-            {
-                /* The Referer[sic] request-header field allows the client to specify,
-                 * for the server's benefit, the address (URI) of the resource from
-                 * which the Request-URI was obtained (the "referrer", although the
-                 * header field is misspelled.) 
-                 */
-            }
-            else if (ngx_str8cmp(key_start, 'R', 'e', 'q', 'u', 'i', 'r', 'e', ':'))
-            {
-                /* The Require header is used by clients to query the server about options that it may or may not support. */
-            }
-            else if (ngx_str8cmp(key_start, 'S', 'e', 's', 's', 'i', 'o', 'n', ':'))
-            {
-                /* This request and response header field identifies an RTSP session started by the media server in a SETUP response 
-                 * and concluded by TEARDOWN on the presentation URL. 
-                 */
-                head = (rtsp_head_t*)malloc(sizeof(rtsp_head_t) + (value_end - value_start + 2));
-                head->key = RTSP_HEAD_SESSION;
-                head->value = (char*)&head[1];
-                head->next = NULL;
-                memcpy(head->value, value_start, (value_end - value_start + 1));
-                head->value[value_end - value_start + 1] = 0;
-            }
+    return ((hash ^ (hash >> 16)) & (RTSP_HEAD_HASH_SIZE - 1));
+}
 
-            break;
-        }
-        case 8:
-        {
-            if (ngx_str8cmp(key_start, 'I', 'f', '-', 'M', 'a', 't', 'c', 'h'))
-            {
-            }
-            else if (ngx_str8cmp(key_start, 'L', 'o', 'c', 'a', 't', 'i', 'o', 'n'))
-            {
-                /* The Location response-header field is used to redirect the recipient to a location 
-                 * other than the Request-URI for completion of the request or identification of a new resource. 
-                 */
-            }
-            else if (ngx_str8cmp(key_start, 'R', 'T', 'P', '-', 'I', 'n', 'f', 'o'))
-            {
-            }
+/* һιϣһαȽϣǱ׼head RTSP_HEAD_EXTENSION */
+static inline
+rtsp_head_key_e rtsp_head_key_lookup(const char *name, int len)
+{
+    const struct rtsp_head_hash_entry *entry;
 
-            break;
-        }
-        case 9:
-        {
-            if (ngx_str9cmp(key_start, 'B', 'a', 'n', 'd', 'w', 'i', 'd', 't', 'h'))
-            {
-                /* The Bandwidth request header field describes the estimated bandwidth available to the client, 
-                 * expressed as a positive integer and measured in bits per second. 
-                 */
-            }
-            else if (ngx_str9cmp(key_start, 'B', 'l', 'o', 'c', 'k', 's', 'i', 'z', 'e'))
-            {
-            }
-            else if (ngx_str9cmp(key_start, 'T', 'i', 'm', 'e', 's', 't', 'a', 'm', 'p'))
-            {
-            }
-            else if (ngx_str9cmp(key_start, 'T', 'r', 'a', 'n', 's', 'p', 'o', 'r', 't'))
-            {
-                head = (rtsp_head_t*)malloc(sizeof(rtsp_head_t) + (value_end - value_start + 2));
-                head->key = RTSP_HEAD_TRANSPORT;
-                head->value = (char*)&head[1];
-                head->next = NULL;
-                memcpy(head->value, value_start, (value_end - value_start + 1));
-                head->value[value_end - value_start + 1] = 0;
-            }
-            
-            break;
-        }
-        case 10:
-        {
-            if (ngx_str10cmp(key_start, 'C', 'o', 'n', 'f', 'e', 'r', 'e', 'n', 'c', 'e'))
-            {
-            }
-            else if (ngx_str10cmp(key_start, 'C', 'o', 'n', 'n', 'e', 'c', 't', 'i', 'o', 'n'))
-            {
-            }
-            else if (ngx_str10cmp(key_start, 'U', 's', 'e', 'r', '-', 'A', 'g', 'e', 'n', 't'))
-            {
-            }
-            
-            break;
-        }
-        case 11:
-        {
-            if (ngx_str12cmp(key_start, 'R', 'e', 't', 'r', 'y', '-', 'A', 'f', 't', 'e', 'r', ':'))
-            {
-                /* The Retry-After response-header field can be used with a 503 (Service Unavailable) response to indicate 
-                 * how long the service is expected to be unavailable to the requesting client. 
-                 */
-            }
-            else if (ngx_str12cmp(key_start, 'U', 'n', 's', 'u', 'p', 'p', 'o', 'r', 't', 'e', 'd', ':'))
-            {
-                /* The Unsupported response header lists the features not supported by the server. */
-            }
-            break;
-        }
-        case 12:
-        {
-            if (ngx_str12cmp(key_start, 'C', 'o', 'n', 't', 'e', 'n', 't', '-', 'B', 'a', 's', 'e'))
-            {
-                /* The Content-Base entity-header field may be used to specify the base URI for resolving relative URLs within the entity. */
-            }
-            else if (ngx_str12cmp(key_start, 'C', 'o', 'n', 't', 'e', 'n', 't', '-', 'T', 'y', 'p', 'e'))
-            {
-                head = (rtsp_head_t*)malloc(sizeof(rtsp_head_t) + (value_end - value_start + 2));
-                head->key = RTSP_HEAD_CONTENT_TYPE;
-                head->value = (char*)&head[1];
-                head->next = NULL;
-                memcpy(head->value, value_start, (value_end - value_start + 1));
-                head->value[value_end - value_start + 1] = 0;
-            }
-            break;
-        }
-        case 13:
-        {
-            if (ngx_str13cmp(key_start, 'A', 'u', 't', 'h', 'o', 'r', 'i', 'z', 'a', 't', 'i', 'o', 'n'))
-            {
-                /* A user agent that wishes to authenticate itself with a server--
-                 * usually, but not necessarily, after receiving a 401 response--
-                 * MAY do so by including an Authorization request-header field with the request. 
-                 */
-            }
-            else if (ngx_str13cmp(key_start, 'C', 'a', 'c', 'h', 'e', '-', 'C', 'o', 'n', 't', 'r', 'o', 'l'))
-            {
-                
-            }
-            
-            break;
-        }
-        case 14:
-        {
-            if (ngx_str14cmp(key_start, 'C', 'o', 'n', 't', 'e', 'n', 't', '-', 'L', 'e', 'n', 'g', 't', 'h'))
-            {
-                head = (rtsp_head_t*)malloc(sizeof(rtsp_head_t) + (value_end - value_start + 2));
-                head->key = RTSP_HEAD_CONTENT_LENGTH;
-                head->value = (char*)&head[1];
-                head->next = NULL;
-                memcpy(head->value, value_start, (value_end - value_start + 1));
-                head->value[value_end - value_start + 1] = 0;
-            }
-            else if (ngx_str14cmp(key_start, 'W', 'W', 'W', '-', 'A', 'u', 't', 'h', 'e', 'n', 't', 'i', 'c', 'a'))
-            {
-                
-            }
-            
-            break;
-        }
-        case 15:
-        {
-            if (ngx_str16cmp(key_start, 'A', 'c', 'c', 'e', 'p', 't', '-', 'E', 'n', 'c', 'o', 'd', 'i', 'n', 'g', ':'))
-            {
-                
-            }
-            else if (ngx_str16cmp(key_start, 'A', 'c', 'c', 'e', 'p', 't', '-', 'L', 'a', 'n', 'g', 'u', 'a', 'g', 'e', ':'))
-            {
-                
-            }
-        }
-        case 16:
-        {
-            if (ngx_str16cmp(key_start, 'C', 'o', 'n', 't', 'e', 'n', 't', '-', 'E', 'n', 'c', 'o', 'd', 'i', 'n', 'g'))
-            {
-                
-            }
-            else if (ngx_str16cmp(key_start, 'C', 'o', 'n', 't', 'e', 'n', 't', '-', 'L', 'a', 'n', 'g', 'u', 'a', 'g', 'e'))
-            {
-                
-            }
-            else if (ngx_str16cmp(key_start, 'C', 'o', 'n', 't', 'e', 'n', 't', '-', 'L', 'o', 'c', 'a', 't', 'i', 'o', 'n'))
-            {
-                
-            }
-        }
-        case 17:
-        {
-            if (ngx_str17cmp(key_start, 'I', 'f', '-', 'M', 'o', 'd', 'i', 'f', 'i', 'e', 'd', '-', 'S', 'i', 'n', 'c', 'e'))
-            {
-            }
-        }
-        case 18:
-        {
-            if (ngx_str18cmp(key_start, 'P','r', 'o', 'x', 'y', '-', 'A', 'u', 't', 'h', 'e', 'n', 't', 'i', 'c', 'a', 't', 'e'))
-            {
-            }
-        }
+    if (len < RTSP_HEAD_NAME_MIN_LEN || len > RTSP_HEAD_NAME_MAX_LEN)
+    {
+        return RTSP_HEAD_EXTENSION;
     }
-    
+
+    entry = &head_key_hash_table[rtsp_head_hash(name, len)];
+    if (entry->len != len || strncasecmp(entry->name, name, len) != 0)
+    {
+        return RTSP_HEAD_EXTENSION;
+    }
+
+    return entry->key;
+}
+
+/* ÿrtsp headֻ֧rfc2326׼涨headǱ׼headֱӷNULL */
+static inline
+rtsp_head_t* rtsp_msg_head_parse(const char *key_start, const char *key_end, const char *value_start, const char *value_end)
+{
+    rtsp_head_t* head;
+    rtsp_head_key_e key;
+    int value_len;
+
+    key = rtsp_head_key_lookup(key_start, (key_end - key_start + 1));
+    if (RTSP_HEAD_EXTENSION == key)
+    {
+        return NULL;
+    }
+
+    value_len = value_end - value_start + 1;
+    head = (rtsp_head_t*)malloc(sizeof(rtsp_head_t) + value_len + 1);
+    head->key = key;
+    head->value = (char*)&head[1];
+    head->next = NULL;
+    memcpy(head->value, value_start, value_len);
+    head->value[value_len] = 0;
+
     return head;
 }
 
@@ -864,7 +735,7 @@ int rtsp_request_msg_decode(rtsp_request_msg_t* request_msg, const char *data, i
                         url_scheme[2] |= 0x20;
                         url_scheme[3] |= 0x20;
 
-                        if (!ngx_str7cmp(url_scheme, 'r', 't', 's', 'p', ':', '/', '/'))
+                        if (!(ngx_str7cmp(url_scheme, 'r', 't', 's', 'p', ':', '/', '/')))
                         {
                             /* uri'rtsp://'ʼģΪǷϢ */
                             log_error("rtsp_request_msg_decode: rtsp uri is started with 'rtsp://'");
@@ -918,7 +789,7 @@ int rtsp_request_msg_decode(rtsp_request_msg_t* request_msg, const char *data, i
                     }
 
                     /* RTSP汾Ϣ */
-                    if (!ngx_str5cmp(priv->version_start, 'R', 'T', 'S', 'P', '/'))
+                    if (!(ngx_str5cmp(priv->version_start, 'R', 'T', 'S', 'P', '/')))
                     {
                         log_error("rtsp_request_msg_decode: rtsp version is not started with 'RTSP/'");
                         return -1;
@@ -975,6 +846,19 @@ int rtsp_request_msg_decode(rtsp_request_msg_t* request_msg, const char *data, i
             }
             case sw_head_key:
             {
+                if (ch != ':')
+                {
+                    /* key ֽڴֱӶλ':' */
+                    pos = text_scan_char(pos, data_end, ':');
+                    if (NULL == pos)
+                    {
+                        priv->data_ptr_offset = size;
+                        return 1;
+                    }
+                    priv->data_ptr_offset = pos - data;
+                    ch = ':';
+                }
+
                 if (ch == ':')
                 {
                     priv->head_key_end = pos - 1;
@@ -1000,6 +884,19 @@ int rtsp_request_msg_decode(rtsp_request_msg_t* request_msg, const char *data, i
             }
             case sw_head_value:
             {
+                if (ch != '\r')
+                {
+                    /* value ֱͬӶλβ */
+                    pos = text_scan_char(pos, data_end, '\r');
+                    if (NULL == pos)
+                    {
+                        priv->data_ptr_offset = size;
+                        return 1;
+                    }
+                    priv->data_ptr_offset = pos - data;
+                    ch = '\r';
+                }
+
                 if (ch == '\r')
                 {
                     priv->head_value_end = pos - 1;
@@ -1072,24 +969,32 @@ int rtsp_request_msg_decode(rtsp_request_msg_t* request_msg, const char *data, i
 
                         return 0;
                     }
+
+                    priv->body_start = pos + 1;
+
+                    state = sw_body;
+                    priv->state = state;
                 }
 
                 break;
             }
             case sw_body:
             {
-                if ((pos - priv->body_start + 1) == request_msg->body_len)
+                /* body ֲֽڴ㹻ʱֱβ */
+                if ((data_end - priv->body_start) < request_msg->body_len)
                 {
-                    *parsed_bytes = priv->data_ptr_offset + 1;
-
-                    /* bodyݽȡϣϢ */
-                    request_msg->body = (char*)malloc(request_msg->body_len);
-                    memcpy(request_msg->body, priv->body_start, request_msg->body_len);
-
-                    return 0;
+                    priv->data_ptr_offset = size;
+                    return 1;
                 }
+                pos = priv->body_start + request_msg->body_len - 1;
+                priv->data_ptr_offset = pos - data;
+                *parsed_bytes = priv->data_ptr_offset + 1;
 
-                break;
+                /* bodyݽȡϣϢ */
+                request_msg->body = (char*)malloc(request_msg->body_len);
+                memcpy(request_msg->body, priv->body_start, request_msg->body_len);
+
+                return 0;
             }
             default:
             {
@@ -1097,6 +1002,9 @@ int rtsp_request_msg_decode(rtsp_request_msg_t* request_msg, const char *data, i
             }
         }
     }
+
+    /* ȫ´δ׷ӵݴʼһֽµ״̬±ظ */
+    priv->data_ptr_offset = size;
     
     return 1;
 }
@@ -1139,7 +1047,7 @@ rtsp_response_msg_t* rtsp_response_msg_new(void)
     return response_msg;
 }
 
-int rtsp_response_msg_decode(rtsp_response_msg_t* response_msg, const char *data, int size, unsigned *parsed_bytes)
+int rtsp_response_msg_decode(rtsp_response_msg_t* response_msg, const char *data, int size, int *parsed_bytes)
 {
     struct response_msg_private *priv;
     
@@ -1201,7 +1109,7 @@ int rtsp_response_msg_decode(rtsp_response_msg_t* response_msg, const char *data
                     }
 
                     /* RTSP汾Ϣ */
-                    if (!ngx_str5cmp(priv->version_start, 'R', 'T', 'S', 'P', '/'))
+                    if (!(ngx_str5cmp(priv->version_start, 'R', 'T', 'S', 'P', '/')))
                     {
                         log_error("rtsp_response_msg_decode: rtsp version is not started with 'RTSP/'");
                         return -1;
@@ -1322,6 +1230,19 @@ int rtsp_response_msg_decode(rtsp_response_msg_t* response_msg, const char *data
             }
             case sw_head_key:
             {
+                if (ch != ':')
+                {
+                    /* key ֽڴֱӶλ':' */
+                    pos = text_scan_char(pos, data_end, ':');
+                    if (NULL == pos)
+                    {
+                        priv->data_ptr_offset = size;
+                        return 1;
+                    }
+                    priv->data_ptr_offset = pos - data;
+                    ch = ':';
+                }
+
                 if (ch == ':')
                 {
                     priv->head_key_end = pos - 1;
@@ -1347,6 +1268,19 @@ int rtsp_response_msg_decode(rtsp_response_msg_t* response_msg, const char *data
             }
             case sw_head_value:
             {
+                if (ch != '\r')
+                {
+                    /* value ֱͬӶλβ */
+                    pos = text_scan_char(pos, data_end, '\r');
+                    if (NULL == pos)
+                    {
+                        priv->data_ptr_offset = size;
+                        return 1;
+                    }
+                    priv->data_ptr_offset = pos - data;
+                    ch = '\r';
+                }
+
                 if (ch == '\r')
                 {
                     priv->head_value_end = pos - 1;
@@ -1424,24 +1358,32 @@ int rtsp_response_msg_decode(rtsp_response_msg_t* response_msg, const char *data
 
                         return 0;
                     }
+
+                    priv->body_start = pos + 1;
+
+                    state = sw_body;
+                    priv->state = state;
                 }
 
                 break;
             }
             case sw_body:
             {
-                if ((pos - priv->body_start + 1) == response_msg->body_len)
+                /* body ֲֽڴ㹻ʱֱβ */
+                if ((data_end - priv->body_start) < response_msg->body_len)
                 {
-                    *parsed_bytes = priv->data_ptr_offset + 1;
+                    priv->data_ptr_offset = size;
+                    return 1;
+                }
+                pos = priv->body_start + response_msg->body_len - 1;
+                priv->data_ptr_offset = pos - data;
+                *parsed_bytes = priv->data_ptr_offset + 1;
 
-                    /* bodyݽȡϣϢ */
-                    response_msg->body = (char*)malloc(response_msg->body_len);
-                    memcpy(response_msg->body, priv->body_start, response_msg->body_len);
+                /* bodyݽȡϣϢ */
+                response_msg->body = (char*)malloc(response_msg->body_len);
+                memcpy(response_msg->body, priv->body_start, response_msg->body_len);
 
-                    return 0;
-                }
-                
-                break;
+                return 0;
             }
             default:
             {
@@ -1449,6 +1391,9 @@ int rtsp_response_msg_decode(rtsp_response_msg_t* response_msg, const char *data
             }
         }
     }
+
+    /* ȫ´δ׷ӵݴʼһֽµ״̬±ظ */
+    priv->data_ptr_offset = size;
     
     return 1;
 }
@@ -1510,176 +1455,756 @@ int rtsp_request_msg_unref(rtsp_request_msg_t* request_msg)
     return ref_count;
 }
 
-/** һü */
-void rtsp_response_msg_ref(rtsp_response_msg_t* response_msg)
+/* Ϊ slice ʽĽֱָݣڴ䣬Ҳδʶ head */
+
+#define RTSP_MAX_HEAD_BYTES (64*1024)
+
+static inline
+int is_head_space(char ch)
 {
-    struct response_msg_private *priv;
+    return (ch == ' ' || ch == '\t');
+}
 
-    if (NULL == response_msg)
+static
+rtsp_method_e rtsp_method_lookup(const char *method, int len)
+{
+    int i;
+
+    for (i = 0; NULL != method_text[i]; ++i)
     {
-        return;
+        if ((int)strlen(method_text[i]) == len && memcmp(method_text[i], method, len) == 0)
+        {
+            return (rtsp_method_e)(1 << i);
+        }
     }
 
-    priv = (struct response_msg_private *)&response_msg[1];
-    (void)atomic_inc(&priv->ref_count);
-
-    return;
+    return RTSP_METHOD_NONE;
 }
 
-/** һüزļֵֵΪ0ʱö󽫱 */
-int rtsp_response_msg_unref(rtsp_response_msg_t* response_msg)
+/* ʮƵķǸǷʱ-1 */
+static
+int slice_to_int(const char *data, int len)
 {
-    int ref_count;
-    struct response_msg_private *priv;
+    int value;
+    int i;
 
-    if (NULL == response_msg)
+    if (len <= 0 || len > 9)
     {
-        return 0;
+        return -1;
     }
 
-    priv = (struct response_msg_private *)&response_msg[1];
-    ref_count = atomic_dec(&priv->ref_count);
-    if (1 == ref_count)
+    value = 0;
+    for (i = 0; i < len; ++i)
     {
-        rtsp_response_msg_destroy(response_msg);
+        if (data[i] < '0' || data[i] > '9')
+        {
+            return -1;
+        }
+        value = value * 10 + (data[i] - '0');
     }
 
-    return ref_count-1;
+    return value;
 }
 
-int rtsp_msg_build_response
-(
-    char *response_msg, int len, int cseq, int code, 
-    rtsp_head_t* head, const char* body, int body_len
-)
+static
+int rtsp_request_line_parse(rtsp_request_slice_t* request, const char *pos, const char *line_end)
 {
-    int total;
-    int lentmp;
-    time_t t;
-    struct tm *tm;
-    rtsp_head_t* node;
+    const char *space;
 
-    if (NULL == response_msg || 0 == len)
+    space = (const char*)memchr(pos, ' ', (line_end - pos));
+    if (NULL == space)
     {
-        log_error("rtsp_msg_build_response: bad response_msg buffer(%p) or bad len(%u)", 
-                  response_msg, len);
-        return 0;
+        log_error("rtsp_request_line_parse: no method in request line");
+        return -1;
+    }
+    request->method = rtsp_method_lookup(pos, (space - pos));
+    if (RTSP_METHOD_NONE == request->method)
+    {
+        log_error("rtsp_request_line_parse: bad method");
+        return -1;
     }
 
-    t = time(NULL);
-    tm = gmtime(&t);
+    pos = space;
+    while (pos < line_end && *pos == ' ')
+    {
+        ++pos;
+    }
+    space = (const char*)memchr(pos, ' ', (line_end - pos));
+    if (NULL == space)
+    {
+        log_error("rtsp_request_line_parse: no url in request line");
+        return -1;
+    }
+    request->url.data = pos;
+    request->url.len = space - pos;
 
-    total = 0;
-    total = snprintf(response_msg, len, 
-                     "RTSP/1.0 %d %s\r\n"
-                     "CSeq: %d\r\n"
-                     "Server: tinylib/rtsp\r\n",
-                     code, get_status_text(code), 
-                     cseq);
-    lentmp = strftime(response_msg+total, (len-total), "Date: %a, %b %d %Y %H:%M:%S GMT\r\n", tm);
-    total += lentmp;
+    if (request->url.len == 1)
+    {
+        if (*pos != '*')
+        {
+            log_error("rtsp_request_line_parse: bad 1 char rtps uri");
+            return -1;
+        }
+    }
+    else if (request->url.len < 8 || strncasecmp(pos, "rtsp://", 7) != 0)
+    {
+        log_error("rtsp_request_line_parse: rtsp uri is not started with 'rtsp://'");
+        return -1;
+    }
 
-    while (NULL != head)
+    pos = space;
+    while (pos < line_end && *pos == ' ')
     {
-        node = head->next;
-        if (NULL != head->value)
+        ++pos;
+    }
+    if ((line_end - pos) < 8 || memcmp(pos, "RTSP/", 5) != 0 || pos[6] != '.'
+        || pos[5] < '0' || pos[5] > '9' || pos[7] < '0' || pos[7] > '9')
+    {
+        log_error("rtsp_request_line_parse: bad rtsp version");
+        return -1;
+    }
+    request->version = ((int)(pos[5] - '0') << 8) | (int)(pos[7] - '0');
+
+    return 0;
+}
+
+void rtsp_request_slice_init(rtsp_request_slice_t* request, rtsp_head_slice_t *heads, int max_heads)
+{
+    if (NULL == request)
+    {
+        return;
+    }
+
+    memset(request, 0, sizeof(*request));
+    request->heads = heads;
+    request->max_heads = (NULL == heads || max_heads < 0) ? 0 : max_heads;
+
+    return;
+}
+
+void rtsp_request_slice_reset(rtsp_request_slice_t* request)
+{
+    if (NULL == request)
+    {
+        return;
+    }
+
+    request->method = RTSP_METHOD_NONE;
+    request->url.data = NULL;
+    request->url.len = 0;
+    request->version = 0;
+    request->cseq = 0;
+    request->head_count = 0;
+    request->body.data = NULL;
+    request->body.len = 0;
+    request->scanned_bytes = 0;
+    request->head_bytes = 0;
+
+    return;
+}
+
+int rtsp_request_slice_decode(rtsp_request_slice_t* request, const char *data, int size, int *parsed_bytes)
+{
+    const char *pos;
+    const char *line_end;
+    const char *head_end;
+    const char *colon;
+    const char *value_end;
+    rtsp_head_slice_t *head;
+    int start;
+    int body_len;
+
+    if (NULL == request || NULL == data || size < 0 || NULL == parsed_bytes)
+    {
+        log_error("rtsp_request_slice_decode: bad request(%p) or bad data(%p) or bad size(%d) or bad parsed_bytes(%p)", 
+            request, data, size, parsed_bytes);
+        return -1;
+    }
+
+    *parsed_bytes = 0;
+
+    /* Ϣ֮ǰĿ */
+    start = 0;
+    while (start < size && (data[start] == '\r' || data[start] == '\n'))
+    {
+        ++start;
+    }
+    if (start == size)
+    {
+        return 1;
+    }
+    if (data[start] < 'A' || data[start] > 'Z')
+    {
+        log_error("rtsp_request_slice_decode: bad rtsp message start");
+        return -1;
+    }
+
+    if (0 == request->head_bytes)
+    {
+        /* ϴμ鵽λüң3ֽ©ԽĿ */
+        pos = data + ((request->scanned_bytes - 3) > start ? (request->scanned_bytes - 3) : start);
+        head_end = text_scan_head_end(pos, (data + size));
+        if (NULL == head_end)
         {
-            lentmp = snprintf((response_msg+total), (len-total), "%s: %s\r\n", head_key_text[(int)head->key], head->value);
-            total += lentmp;
+            if ((size - start) > RTSP_MAX_HEAD_BYTES)
+            {
+                log_error("rtsp_request_slice_decode: rtsp head is too long");
+                return -1;
+            }
+
+            request->scanned_bytes = size;
+            return 1;
         }
+        request->head_bytes = head_end - data;
+    }
+    else if (size < (request->head_bytes + request->body.len))
+    {
+        /* head body  */
+        return 1;
+    }
+    head_end = data + request->head_bytes;
 
-        head = node;
+    pos = data + start;
+    line_end = text_scan_char(pos, head_end, '\r');
+    if (rtsp_request_line_parse(request, pos, line_end) != 0)
+    {
+        return -1;
     }
 
-    if (NULL != body && body_len > 0)
+    request->cseq = 0;
+    request->head_count = 0;
+    body_len = 0;
+    head = NULL;
+
+    /* head_end ֮ǰֽΪ */
+    for (pos = line_end + 2; pos < (head_end - 2); pos = line_end + 2)
     {
-        lentmp = snprintf((response_msg+total), (len-total), "Content-Length: %u\r\n", body_len);
-        total += lentmp;        
-    
-        lentmp = snprintf((response_msg+total), (len-total), "\r\n");
-        total += lentmp;
+        line_end = text_scan_char(pos, head_end, '\r');
 
-        strncpy((response_msg+total), body, body_len);
-        total += body_len;
+        if (is_head_space(*pos))
+        {
+            /* Уһ head  value */
+            if (NULL == head)
+            {
+                log_error("rtsp_request_slice_decode: bad folded head line");
+                return -1;
+            }
+
+            value_end = line_end;
+            while (value_end > pos && is_head_space(value_end[-1]))
+            {
+                --value_end;
+            }
+            if (value_end > pos)
+            {
+                head->value.len = value_end - head->value.data;
+            }
+            continue;
+        }
+
+        colon = text_scan_char(pos, line_end, ':');
+        if (NULL == colon || colon == pos)
+        {
+            log_error("rtsp_request_slice_decode: bad head line");
+            return -1;
+        }
+
+        if (request->head_count >= request->max_heads)
+        {
+            log_error("rtsp_request_slice_decode: too many heads, max heads: %d", request->max_heads);
+            return -1;
+        }
+        head = &request->heads[request->head_count];
+        request->head_count++;
+
+        head->name.data = pos;
+        head->name.len = colon - pos;
+        while (head->name.len > 0 && is_head_space(pos[head->name.len - 1]))
+        {
+            head->name.len--;
+        }
+
+        pos = colon + 1;
+        while (pos < line_end && is_head_space(*pos))
+        {
+            ++pos;
+        }
+        value_end = line_end;
+        while (value_end > pos && is_head_space(value_end[-1]))
+        {
+            --value_end;
+        }
+        head->value.data = pos;
+        head->value.len = value_end - pos;
+
+        head->key = rtsp_head_key_lookup(head->name.data, head->name.len);
+        if (RTSP_HEAD_CSEQ == head->key)
+        {
+            request->cseq = slice_to_int(head->value.data, head->value.len);
+        }
+        else if (RTSP_HEAD_CONTENT_LENGTH == head->key)
+        {
+            body_len = slice_to_int(head->value.data, head->value.len);
+            if (body_len < 0)
+            {
+                log_error("rtsp_request_slice_decode: bad Content-Length");
+                return -1;
+            }
+        }
+    }
+
+    request->body.len = body_len;
+    if (size < (request->head_bytes + body_len))
+    {
+        /* body в㹻ʱ½ head */
+        request->body.data = NULL;
+        request->head_count = 0;
+        return 1;
+    }
+
+    request->body.data = (body_len > 0) ? head_end : NULL;
+    *parsed_bytes = request->head_bytes + body_len;
+
+    return 0;
+}
+
+const rtsp_head_slice_t* rtsp_request_slice_head(const rtsp_request_slice_t* request, rtsp_head_key_e key)
+{
+    int i;
+
+    if (NULL == request)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < request->head_count; ++i)
+    {
+        if (request->heads[i].key == key)
+        {
+            return &request->heads[i];
+        }
+    }
+
+    return NULL;
+}
+
+int rtsp_slice_copy(const rtsp_slice_t *slice, char *text, int len)
+{
+    int copied;
+
+    if (NULL == slice || NULL == text || len <= 0)
+    {
+        return 0;
+    }
+
+    copied = (slice->len < (len - 1)) ? slice->len : (len - 1);
+    if (copied > 0)
+    {
+        memcpy(text, slice->data, copied);
     }
     else
     {
-        lentmp = snprintf((response_msg+total), (len-total), "\r\n");
-        total += lentmp;    
+        copied = 0;
     }
+    text[copied] = 0;
 
-    return total;
+    return copied;
 }
 
-int rtsp_msg_buid_request
-(
-    char* request_msg, int len, int cseq, rtsp_method_e method, const char* url, 
-    rtsp_head_t* head, const char* body, int body_len
-)
+rtsp_request_msg_t* rtsp_request_slice_to_msg(const rtsp_request_slice_t* request)
 {
-    int total;
-    rtsp_head_t *node;
-    int lentmp;
-    
-    int m;
-    int m_idx;
+    rtsp_request_msg_t* request_msg;
+    const rtsp_head_slice_t *slice;
+    rtsp_head_t* head;
+    int i;
+
+    if (NULL == request || NULL == request->url.data)
+    {
+        log_error("rtsp_request_slice_to_msg: bad request(%p)", request);
+        return NULL;
+    }
+
+    request_msg = rtsp_request_msg_new();
+    request_msg->method = request->method;
+    request_msg->version = request->version;
+    request_msg->cseq = request->cseq;
+
+    request_msg->url = (char*)malloc(request->url.len + 1);
+    rtsp_slice_copy(&request->url, request_msg->url, request->url.len + 1);
+
+    for (i = 0; i < request->head_count; ++i)
+    {
+        slice = &request->heads[i];
+        if (RTSP_HEAD_CSEQ == slice->key || RTSP_HEAD_CONTENT_LENGTH == slice->key || RTSP_HEAD_EXTENSION == slice->key)
+        {
+            continue;
+        }
+
+        head = (rtsp_head_t*)malloc(sizeof(rtsp_head_t) + slice->value.len + 1);
+        head->key = slice->key;
+        head->value = (char*)&head[1];
+        head->next = NULL;
+        rtsp_slice_copy(&slice->value, head->value, slice->value.len + 1);
+        save_rtsp_head(head, &(request_msg->head));
+    }
+
+    if (request->body.len > 0)
+    {
+        request_msg->body = (char*)malloc(request->body.len);
+        memcpy(request_msg->body, request->body.data, request->body.len);
+        request_msg->body_len = request->body.len;
+    }
+
+    return request_msg;
+}
+
+/** һü */
+void rtsp_response_msg_ref(rtsp_response_msg_t* response_msg)
+{
+    struct response_msg_private *priv;
+
+    if (NULL == response_msg)
+    {
+        return;
+    }
+
+    priv = (struct response_msg_private *)&response_msg[1];
+    (void)atomic_inc(&priv->ref_count);
+
+    return;
+}
+
+/** һüزļֵֵΪ0ʱö󽫱 */
+int rtsp_response_msg_unref(rtsp_response_msg_t* response_msg)
+{
+    int ref_count;
+    struct response_msg_private *priv;
 
-    if (NULL == request_msg || 0 == len || NULL == url)
+    if (NULL == response_msg)
     {
-        log_error("rtsp_msg_buid_request: bad request_msg(%p) or bad len(%u) or bad url(%p)", 
-                  request_msg, len, method, url);
         return 0;
     }
-    
-    if (method == RTSP_METHOD_NONE)
+
+    priv = (struct response_msg_private *)&response_msg[1];
+    ref_count = atomic_dec(&priv->ref_count);
+    if (1 == ref_count)
+    {
+        rtsp_response_msg_destroy(response_msg);
+    }
+
+    return ref_count-1;
+}
+
+static inline
+void builder_append(rtsp_msg_builder_t *builder, const char *text, int len)
+{
+    if (builder->overflow || (builder->size - builder->len) < len)
+    {
+        builder->overflow = 1;
+        return;
+    }
+
+    memcpy(builder->data + builder->len, text, len);
+    builder->len += len;
+
+    return;
+}
+
+static inline
+void builder_append_str(rtsp_msg_builder_t *builder, const char *text)
+{
+    builder_append(builder, text, strlen(text));
+    return;
+}
+
+static
+void builder_append_int(rtsp_msg_builder_t *builder, int value)
+{
+    char text[16];
+    int pos;
+    unsigned v;
+
+    pos = sizeof(text);
+    v = (value < 0) ? (0u - (unsigned)value) : (unsigned)value;
+    do
+    {
+        text[--pos] = '0' + (v % 10);
+        v /= 10;
+    } while (v > 0);
+
+    if (value < 0)
+    {
+        text[--pos] = '-';
+    }
+
+    builder_append(builder, &text[pos], (sizeof(text) - pos));
+    return;
+}
+
+int rtsp_interleaved_frames_decode(void *data, int size, rtsp_interleaved_frame_t *frames, int max, int *parsed_bytes)
+{
+    unsigned char *pos;
+    unsigned short len;
+    int count;
+
+    if (NULL == data || size < 0 || NULL == frames || max <= 0 || NULL == parsed_bytes)
     {
+        log_error("rtsp_interleaved_frames_decode: bad data(%p) or bad size(%d) or bad frames(%p) or bad max(%d) or bad parsed_bytes(%p)", 
+            data, size, frames, max, parsed_bytes);
         return 0;
     }
-    
+
+    pos = (unsigned char*)data;
+    count = 0;
+    while (count < max && size >= 4 && pos[0] == 0x24)
+    {
+        len = (unsigned short)((pos[2] << 8) | pos[3]);
+        if (size < (4 + len))
+        {
+            break;
+        }
+
+        frames[count].channel = pos[1];
+        frames[count].size = len;
+        frames[count].data = pos + 4;
+        count++;
+
+        pos += 4 + len;
+        size -= 4 + len;
+    }
+    *parsed_bytes = (int)(pos - (unsigned char*)data);
+
+    return count;
+}
+
+void rtsp_interleaved_head_encode(unsigned char head[4], unsigned char channel, unsigned short size)
+{
+    head[0] = 0x24;
+    head[1] = channel;
+    head[2] = (unsigned char)(size >> 8);
+    head[3] = (unsigned char)(size & 0xff);
+
+    return;
+}
+
+void rtsp_msg_builder_init(rtsp_msg_builder_t *builder, char *data, int size)
+{
+    if (NULL == builder)
+    {
+        return;
+    }
+
+    builder->data = data;
+    builder->size = (NULL == data || size < 0) ? 0 : size;
+    builder->len = 0;
+    builder->overflow = 0;
+    builder->cseq = -1;
+    builder->body = NULL;
+    builder->body_len = 0;
+
+    return;
+}
+
+void rtsp_msg_builder_response(rtsp_msg_builder_t *builder, int cseq, int code)
+{
+    char date[32];
+    int date_len;
+
+    if (NULL == builder)
+    {
+        return;
+    }
+
+    builder->cseq = cseq;
+    builder_append(builder, "RTSP/1.0 ", 9);
+    builder_append_int(builder, code);
+    builder_append(builder, " ", 1);
+    builder_append_str(builder, get_status_text(code));
+    builder_append(builder, "\r\nCSeq: ", 8);
+    builder_append_int(builder, cseq);
+    builder_append(builder, "\r\nServer: tinylib/rtsp\r\n", 24);
+
+    /* Date  util 뻺ڵǰ̣߳loop ߳ȡǱֵʱ */
+    date_len = time_format_gmt(date, time_cache_now_ms());
+    builder_append(builder, "Date: ", 6);
+    builder_append(builder, date, date_len);
+    builder_append(builder, "\r\n", 2);
+
+    return;
+}
+
+void rtsp_msg_builder_request(rtsp_msg_builder_t *builder, int cseq, rtsp_method_e method, const char* url)
+{
+    int m;
+    int m_idx;
+
+    if (NULL == builder || NULL == url || RTSP_METHOD_NONE == method)
+    {
+        log_error("rtsp_msg_builder_request: bad builder(%p) or bad method(%d) or bad url(%p)", builder, method, url);
+        if (NULL != builder)
+        {
+            builder->overflow = 1;
+        }
+        return;
+    }
+
     m_idx = 0;
-    m =(int)method;
+    m = (int)method;
     while (m > 0)
     {
         m = m>>1;
         m_idx++;
     }
 
-    total = 0;
-    total = snprintf(request_msg, len,
-                     "%s %s RTSP/1.0\r\n"
-                     "CSeq: %u\r\n"
-                     "User-Agent: tinylib/rtsp\r\n",
-                     method_text[m_idx-1], 
-                     url,
-                     cseq);
-    while (NULL != head)
+    builder->cseq = cseq;
+    builder_append_str(builder, method_text[m_idx-1]);
+    builder_append(builder, " ", 1);
+    builder_append_str(builder, url);
+    builder_append(builder, " RTSP/1.0\r\nCSeq: ", 17);
+    builder_append_int(builder, cseq);
+    builder_append(builder, "\r\nUser-Agent: tinylib/rtsp\r\n", 28);
+
+    return;
+}
+
+void rtsp_msg_builder_head(rtsp_msg_builder_t *builder, rtsp_head_key_e key, const char *value, int len)
+{
+    if (NULL == builder || NULL == value || (int)key < 0 || key >= RTSP_HEAD_EXTENSION)
+    {
+        return;
+    }
+
+    builder_append(builder, head_key_prefix[(int)key].text, head_key_prefix[(int)key].len);
+    builder_append(builder, value, (len < 0 ? (int)strlen(value) : len));
+    builder_append(builder, "\r\n", 2);
+
+    return;
+}
+
+void rtsp_msg_builder_head_int(rtsp_msg_builder_t *builder, rtsp_head_key_e key, int value)
+{
+    if (NULL == builder || (int)key < 0 || key >= RTSP_HEAD_EXTENSION)
+    {
+        return;
+    }
+
+    builder_append(builder, head_key_prefix[(int)key].text, head_key_prefix[(int)key].len);
+    builder_append_int(builder, value);
+    builder_append(builder, "\r\n", 2);
+
+    return;
+}
+
+int rtsp_msg_builder_finish(rtsp_msg_builder_t *builder, const char *body, int body_len)
+{
+    if (NULL == builder)
+    {
+        return -1;
+    }
+
+    if (NULL != body && body_len > 0)
+    {
+        rtsp_msg_builder_head_int(builder, RTSP_HEAD_CONTENT_LENGTH, body_len);
+        builder->body = body;
+        builder->body_len = body_len;
+    }
+    else
     {
-        node = head->next;
+        builder->body = NULL;
+        builder->body_len = 0;
+    }
+    builder_append(builder, "\r\n", 2);
+
+    return builder->overflow ? -1 : builder->len;
+}
 
+/*  builder  head ֮ſ bodyõϢ */
+static
+int builder_flatten(rtsp_msg_builder_t *builder, rtsp_head_t* head, const char* body, int body_len)
+{
+    while (NULL != head)
+    {
         if (NULL != head->value)
         {
-            lentmp = snprintf(request_msg+total, (len-total), "%s: %s\r\n", head_key_text[(int)head->key], head->value);
-            total += lentmp;
+            rtsp_msg_builder_head(builder, head->key, head->value, -1);
         }
+        head = head->next;
+    }
 
-        head = node;
+    if (rtsp_msg_builder_finish(builder, body, body_len) < 0)
+    {
+        return 0;
     }
 
-    if (NULL != body && 0 < body_len)
+    builder_append(builder, builder->body, builder->body_len);
+    if (builder->overflow)
     {
-        lentmp = snprintf((request_msg+total), (len-total), "Content-Length: %u\r\n", body_len);
-        total += lentmp;        
-    
-        lentmp = snprintf((request_msg+total), (len-total), "\r\n");
-        total += lentmp;
+        return 0;
+    }
+
+    /* пʱһ'\0'߽ϢΪַӡ */
+    if (builder->len < builder->size)
+    {
+        builder->data[builder->len] = '\0';
+    }
+
+    return builder->len;
+}
+
+int rtsp_msg_build_response
+(
+    char *response_msg, int len, int cseq, int code, 
+    rtsp_head_t* head, const char* body, int body_len
+)
+{
+    rtsp_msg_builder_t builder;
+    int total;
+
+    if (NULL == response_msg || 0 >= len)
+    {
+        log_error("rtsp_msg_build_response: bad response_msg buffer(%p) or bad len(%d)", 
+                  response_msg, len);
+        return 0;
+    }
+
+    rtsp_msg_builder_init(&builder, response_msg, len);
+    rtsp_msg_builder_response(&builder, cseq, code);
+    total = builder_flatten(&builder, head, body, body_len);
+    if (0 == total)
+    {
+        log_error("rtsp_msg_build_response: buffer len(%d) is too small, cseq: %d", len, cseq);
+    }
+
+    return total;
+}
+
+int rtsp_msg_buid_request
+(
+    char* request_msg, int len, int cseq, rtsp_method_e method, const char* url, 
+    rtsp_head_t* head, const char* body, int body_len
+)
+{
+    rtsp_msg_builder_t builder;
+    int total;
+
+    if (NULL == request_msg || 0 >= len || NULL == url)
+    {
+        log_error("rtsp_msg_buid_request: bad request_msg(%p) or bad len(%d) or bad url(%p)", 
+                  request_msg, len, url);
+        return 0;
+    }
     
-        strncpy((request_msg+total), body, body_len);
-        total += body_len;    
+    if (method == RTSP_METHOD_NONE)
+    {
+        return 0;
     }
-    else
+
+    rtsp_msg_builder_init(&builder, request_msg, len);
+    rtsp_msg_builder_request(&builder, cseq, method, url);
+    total = builder_flatten(&builder, head, body, body_len);
+    if (0 == total)
     {
-        lentmp = snprintf((request_msg+total), (len-total), "\r\n");
-        total += lentmp;       
+        log_error("rtsp_msg_buid_request: buffer len(%d) is too small, cseq: %d", len, cseq);
     }
 
     return total;
@@ -65,7 +65,8 @@ typedef enum rtsp_head_key{
     RTSP_HEAD_USER_AGENT,
     RTSP_HEAD_VARY,
     RTSP_HEAD_VIA,
-    RTSP_HEAD_WWW_AUTHENTICA
+    RTSP_HEAD_WWW_AUTHENTICA,
+    RTSP_HEAD_EXTENSION             /* Ǳ׼head slice ʽʹ */
 }rtsp_head_key_e;
 
 typedef struct rtsp_head
@@ -96,12 +97,71 @@ typedef struct rtsp_response_msg
     int body_len;                /*ϢĳȣbodyʱЧ*/
 }rtsp_response_msg_t;
 
+/* ָԭʼϢеһı'\0'β */
+typedef struct rtsp_slice
+{
+    const char *data;
+    int len;
+}rtsp_slice_t;
+
+typedef struct rtsp_head_slice
+{
+    rtsp_head_key_e key;        /* Ǳ׼headΪ RTSP_HEAD_EXTENSION name ԭʼ key */
+    rtsp_slice_t name;
+    rtsp_slice_t value;         /* ȥβհ */
+}rtsp_head_slice_t;
+
+/* slice ʽϢurl/head/body ֱָݣвκڴ
+ * head ɵṩڽһϢ֮ reset 
+ *  slice ֻЧڼã rtsp_session Ϊ session_handler صڼ
+ */
+typedef struct rtsp_request_slice
+{
+    rtsp_method_e method;
+    rtsp_slice_t url;
+    int version;                /* 0x0100ʾRTSP/1.0 */
+    int cseq;
+    rtsp_head_slice_t *heads;   /* ȫhead CSeq  Content-Length */
+    int head_count;
+    int max_heads;
+    rtsp_slice_t body;
+
+    int scanned_bytes;          /* Ϊм״̬¼Ķƫݵĵַε֮Ա仯 */
+    int head_bytes;
+}rtsp_request_slice_t;
+
+/* ʽ rtsp Ϣ: head дṩڴ棬body ֻ¼ַ
+ * ɺ head  body Ϊһύͣ rtsp_session_send_message()
+ * ڴ治ʱ overflow֮дԣ rtsp_msg_builder_finish() -1
+ */
+typedef struct rtsp_msg_builder
+{
+    char *data;
+    int size;
+    int len;                    /* head дĳ */
+    int overflow;
+    int cseq;                   /*  rtsp_msg_builder_response/request ¼ڰ CSeq ƥӦ */
+    const char *body;
+    int body_len;
+}rtsp_msg_builder_t;
+
 typedef struct rtsp_interleaved_head{
     unsigned char magic;
     unsigned char channel;
     unsigned short len;
 }rtsp_interleaved_head_t;
 
+/* һȡ interleaved ֡ */
+#define RTSP_INTERLEAVED_BATCH 64
+
+/* һ interleaved ֡data ָջ4ֽͷ֮ݣֻڻصڼЧ */
+typedef struct rtsp_interleaved_frame
+{
+    unsigned char channel;
+    unsigned short size;
+    unsigned char *data;
+}rtsp_interleaved_frame_t;
+
 typedef struct rtsp_transport_head
 {
     const char *trans;
@@ -151,6 +211,28 @@ void rtsp_request_msg_ref(rtsp_request_msg_t* request_msg);
 /** һüزļֵֵΪ0ʱö󽫱 */
 int rtsp_request_msg_unref(rtsp_request_msg_t* request_msg);
 
+/* Եṩ head ʼһ slice Ϣ */
+void rtsp_request_slice_init(rtsp_request_slice_t* request, rtsp_head_slice_t *heads, int max_heads);
+
+/* һϢĽԱһϢ */
+void rtsp_request_slice_reset(rtsp_request_slice_t* request);
+
+/* ֵ parsed_bytes ĺͬ rtsp_request_msg_decode()head  max_heads ʱΪǷϢ
+ * ݲʱ׷֮ͬʼٴεãѼݲᱻظɨ
+ */
+int rtsp_request_slice_decode(rtsp_request_slice_t* request, const char *data, int size, int *parsed_bytes);
+
+/* ҵһ key Ӧ headʱNULL */
+const rtsp_head_slice_t* rtsp_request_slice_head(const rtsp_request_slice_t* request, rtsp_head_key_e key);
+
+/*  slice Ϊ'\0'βַ len ʱضϣؿַ */
+int rtsp_slice_copy(const rtsp_slice_t *slice, char *text, int len);
+
+/* ɽɵ slice 󹹽һ rtsp_request_msg_t(üΪ1) rtsp_request_msg_decode() Ľͬ:
+ * head  CSeqContent-Length Ǳ׼headڼʹ rtsp_request_msg_t ľɴ
+ */
+rtsp_request_msg_t* rtsp_request_slice_to_msg(const rtsp_request_slice_t* request);
+
 rtsp_response_msg_t* rtsp_response_msg_new(void);
 
 /* expatʽʽн
@@ -170,7 +252,34 @@ void rtsp_response_msg_ref(rtsp_response_msg_t* response_msg);
 /** һüزļֵֵΪ0ʱö󽫱 */
 int rtsp_response_msg_unref(rtsp_response_msg_t* response_msg);
 
-/** ӦϢtime-headercseq-header ڲ䣬headerheadָ */
+/*  data һȡ interleaved('$')֡ max '$'ͷ֡ʱֹͣ
+ * ȡ֡parsed_bytes ΪЩ֡ռֽһ֡ʱ0
+ */
+int rtsp_interleaved_frames_decode(void *data, int size, rtsp_interleaved_frame_t *frames, int max, int *parsed_bytes);
+
+/* д interleaved ֡4ֽͷ: '$' channel size(ֽ) */
+void rtsp_interleaved_head_encode(unsigned char head[4], unsigned char channel, unsigned short size);
+
+void rtsp_msg_builder_init(rtsp_msg_builder_t *builder, char *data, int size);
+
+/* д״̬м CSeq/Server/Date headDate 뻺ڵǰ̣߳ÿζʽʱ */
+void rtsp_msg_builder_response(rtsp_msg_builder_t *builder, int cseq, int code);
+
+/* дм CSeq/User-Agent head */
+void rtsp_msg_builder_request(rtsp_msg_builder_t *builder, int cseq, rtsp_method_e method, const char* url);
+
+/* ׷һ headlen С0 ʱ value '\0'βַ */
+void rtsp_msg_builder_head(rtsp_msg_builder_t *builder, rtsp_head_key_e key, const char *value, int len);
+void rtsp_msg_builder_head_int(rtsp_msg_builder_t *builder, rtsp_head_key_e key, int value);
+
+/*  body ʱд Content-LengthԿн head ֣body Ϣ֮ǰЧ
+ *  head ֵĳȣڴ治ʱ-1
+ */
+int rtsp_msg_builder_finish(rtsp_msg_builder_t *builder, const char *body, int body_len);
+
+/** ӦϢtime-headercseq-header ڲ䣬headerheadָ
+ * Ϣ( body) len ʱ0
+ */
 int rtsp_msg_build_response
 (
     char *response_msg, int len, int cseq, int code,
@@ -0,0 +1,612 @@
+
+#define LOG_MODULE LOG_MODULE_RTSP
+
+#include "tinylib/rtsp/rtsp_relay.h"
+#include "tinylib/util/log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef WIN32
+  #include <sys/uio.h>
+#endif
+
+/* slab 中每块可容纳的包尺寸，覆盖常见的以 MTU 为限的 RTP 包，更大的包单独分配 */
+#define RELAY_SLAB_BLOCK_SIZE 1500
+#define RELAY_SLAB_MAX_FREE 4096
+
+#define RELAY_DEFAULT_MAX_BACKLOG (512*1024)
+#define RELAY_DEFAULT_CACHE_PACKETS 2048
+#define RELAY_DEFAULT_CACHE_BYTES (4*1024*1024)
+
+typedef struct relay_packet
+{
+    struct relay_packet *next;      /* 关键帧缓存链表或 slab 的空闲链表 */
+    int ref;
+    int track;
+    int is_rtcp;
+    int is_keyframe;                /* 是否为关键帧的第一个包，即观看者可以开始或恢复接收的位置 */
+    unsigned size;
+    unsigned capacity;
+    unsigned char data[1];
+}relay_packet_t;
+
+struct relay_track
+{
+    int in_use;
+    unsigned char channel;
+    rtsp_relay_codec_e codec;
+
+    /* 关键帧可能由多个包组成(如 SPS/PPS/IDR)，以时间戳区分是否为同一个关键帧 */
+    uint32_t keyframe_ts;
+    int has_keyframe_ts;
+};
+
+struct rtsp_relay_viewer
+{
+    rtsp_relay_t *relay;
+    tcp_connection_t *connection;
+
+    int has_target[RTSP_RELAY_MAX_TRACKS];
+    rtsp_relay_target_t targets[RTSP_RELAY_MAX_TRACKS];
+
+    int waiting_keyframe;
+    unsigned replay_tracks;         /* 新加入、尚需补发缓存的 track，按位表示 */
+
+    struct rtsp_relay_viewer *prev;
+    struct rtsp_relay_viewer *next;
+};
+
+struct rtsp_relay
+{
+    loop_t *loop;
+
+    struct relay_track tracks[RTSP_RELAY_MAX_TRACKS];
+    int track_count;
+    int video_track;                /* 用于判断关键帧的媒体流，-1 表示没有 */
+    short channel_map[256];         /* 输入端 interleaved channel => (track<<1 | is_rtcp)，-1 表示未知的 channel */
+
+    relay_packet_t *free_list;
+    unsigned free_count;
+
+    relay_packet_t *cache_head;
+    relay_packet_t *cache_tail;
+    unsigned cache_bytes;
+    int cache_full;
+    unsigned cache_max_packets;
+    unsigned cache_max_bytes;
+
+    unsigned max_backlog;
+
+    rtsp_relay_viewer_t *viewers;
+    rtsp_relay_stats_t stats;
+};
+
+static
+relay_packet_t* packet_new(rtsp_relay_t *relay, const void *data, unsigned size)
+{
+    relay_packet_t *packet;
+
+    if (size <= RELAY_SLAB_BLOCK_SIZE && NULL != relay->free_list)
+    {
+        packet = relay->free_list;
+        relay->free_list = packet->next;
+        relay->free_count--;
+    }
+    else
+    {
+        packet = (relay_packet_t*)malloc(sizeof(relay_packet_t) + (size <= RELAY_SLAB_BLOCK_SIZE ? RELAY_SLAB_BLOCK_SIZE : size));
+        packet->capacity = (size <= RELAY_SLAB_BLOCK_SIZE ? RELAY_SLAB_BLOCK_SIZE : size);
+    }
+
+    packet->next = NULL;
+    packet->ref = 1;
+    packet->size = size;
+    memcpy(packet->data, data, size);
+
+    return packet;
+}
+
+static
+void packet_unref(rtsp_relay_t *relay, relay_packet_t *packet)
+{
+    packet->ref--;
+    if (packet->ref > 0)
+    {
+        return;
+    }
+
+    if (packet->capacity == RELAY_SLAB_BLOCK_SIZE && relay->free_count < RELAY_SLAB_MAX_FREE)
+    {
+        packet->next = relay->free_list;
+        relay->free_list = packet;
+        relay->free_count++;
+    }
+    else
+    {
+        free(packet);
+    }
+
+    return;
+}
+
+static
+void cache_clear(rtsp_relay_t *relay)
+{
+    relay_packet_t *packet;
+
+    while (NULL != relay->cache_head)
+    {
+        packet = relay->cache_head;
+        relay->cache_head = packet->next;
+        packet_unref(relay, packet);
+    }
+    relay->cache_tail = NULL;
+    relay->cache_bytes = 0;
+    relay->stats.cached_packets = 0;
+
+    return;
+}
+
+/* 判断 RTP 包是否属于关键帧: H264 的 SPS/IDR，H265 的 VPS/SPS/PPS/IRAP，包括其在 STAP-A/AP 及 FU 中的情况 */
+static
+int rtp_is_keyframe(rtsp_relay_codec_e codec, const unsigned char *rtp, unsigned size)
+{
+    const unsigned char *payload;
+    unsigned offset;
+    int type;
+
+    if (size < 12)
+    {
+        return 0;
+    }
+
+    offset = 12 + (rtp[0] & 0x0f) * 4;
+    if ((rtp[0] & 0x10) && (offset + 4) <= size)
+    {
+        offset += 4 + ((rtp[offset+2] << 8) | rtp[offset+3]) * 4;
+    }
+    if (offset >= size)
+    {
+        return 0;
+    }
+
+    payload = rtp + offset;
+    size -= offset;
+
+    if (RTSP_RELAY_CODEC_H264 == codec)
+    {
+        type = payload[0] & 0x1f;
+        if (24 == type && size > 3)
+        {
+            /* STAP-A，看第一个 NAL */
+            type = payload[3] & 0x1f;
+        }
+        else if (28 == type && size > 1)
+        {
+            /* FU-A，只有起始分片才算 */
+            if (0 == (payload[1] & 0x80))
+            {
+                return 0;
+            }
+            type = payload[1] & 0x1f;
+        }
+
+        return (5 == type || 7 == type);
+    }
+    else if (RTSP_RELAY_CODEC_H265 == codec)
+    {
+        type = (payload[0] >> 1) & 0x3f;
+        if (48 == type && size > 4)
+        {
+            type = (payload[4] >> 1) & 0x3f;
+        }
+        else if (49 == type && size > 2)
+        {
+            if (0 == (payload[2] & 0x80))
+            {
+                return 0;
+            }
+            type = payload[2] & 0x3f;
+        }
+
+        return ((type >= 16 && type <= 21) || (type >= 32 && type <= 34));
+    }
+
+    return 1;
+}
+
+static
+void viewer_send(rtsp_relay_t *relay, rtsp_relay_viewer_t *viewer, relay_packet_t *packet)
+{
+    rtsp_relay_target_t *target;
+    unsigned char head[4];
+    int is_start;
+    #ifndef WIN32
+    struct iovec vecs[2];
+    #endif
+
+    if (0 == viewer->has_target[packet->track])
+    {
+        return;
+    }
+    target = &viewer->targets[packet->track];
+
+    /* 不接收视频的观看者，任何包都可以作为起点 */
+    is_start = packet->is_keyframe || relay->video_track < 0 || 0 == viewer->has_target[relay->video_track];
+
+    if (viewer->waiting_keyframe)
+    {
+        if (0 == is_start || (NULL != viewer->connection && tcp_connection_pending_bytes(viewer->connection) > (int)(relay->max_backlog/2)))
+        {
+            relay->stats.packets_dropped++;
+            return;
+        }
+        viewer->waiting_keyframe = 0;
+    }
+
+    if (NULL == viewer->connection)
+    {
+        if (packet->is_rtcp)
+        {
+            udp_peer_send(rtp_peer_get_rtcp_udppeer(target->peer), packet->data, packet->size, &target->rtcp_addr);
+        }
+        else
+        {
+            udp_peer_send(rtp_peer_get_rtp_udppeer(target->peer), packet->data, packet->size, &target->rtp_addr);
+        }
+    }
+    else
+    {
+        /* 积压过多时不再继续堆积，丢弃直至下一个关键帧 */
+        if (tcp_connection_pending_bytes(viewer->connection) > (int)relay->max_backlog)
+        {
+            viewer->waiting_keyframe = 1;
+            relay->stats.viewer_skips++;
+            relay->stats.packets_dropped++;
+            return;
+        }
+
+        head[0] = 0x24;
+        head[1] = packet->is_rtcp ? target->rtcp_channel : target->rtp_channel;
+        head[2] = (unsigned char)(packet->size >> 8);
+        head[3] = (unsigned char)(packet->size & 0xff);
+
+        #ifdef WIN32
+        tcp_connection_send(viewer->connection, head, 4);
+        tcp_connection_send(viewer->connection, packet->data, packet->size);
+        #else
+        vecs[0].iov_base = head;
+        vecs[0].iov_len = 4;
+        vecs[1].iov_base = packet->data;
+        vecs[1].iov_len = packet->size;
+        tcp_connection_sendv(viewer->connection, vecs, 2);
+        #endif
+    }
+
+    relay->stats.packets_out++;
+    relay->stats.bytes_out += packet->size;
+
+    return;
+}
+
+rtsp_relay_t* rtsp_relay_new(loop_t *loop)
+{
+    rtsp_relay_t *relay;
+
+    if (NULL == loop)
+    {
+        log_error("rtsp_relay_new: bad loop");
+        return NULL;
+    }
+
+    relay = (rtsp_relay_t*)malloc(sizeof(rtsp_relay_t));
+    memset(relay, 0, sizeof(*relay));
+    relay->loop = loop;
+    relay->track_count = 0;
+    relay->video_track = -1;
+    memset(relay->channel_map, 0xff, sizeof(relay->channel_map));
+
+    relay->free_list = NULL;
+    relay->free_count = 0;
+
+    relay->cache_head = NULL;
+    relay->cache_tail = NULL;
+    relay->cache_bytes = 0;
+    relay->cache_full = 0;
+    relay->cache_max_packets = RELAY_DEFAULT_CACHE_PACKETS;
+    relay->cache_max_bytes = RELAY_DEFAULT_CACHE_BYTES;
+
+    relay->max_backlog = RELAY_DEFAULT_MAX_BACKLOG;
+    relay->viewers = NULL;
+
+    return relay;
+}
+
+void rtsp_relay_destroy(rtsp_relay_t *relay)
+{
+    rtsp_relay_viewer_t *viewer;
+    relay_packet_t *packet;
+
+    if (NULL == relay)
+    {
+        return;
+    }
+
+    while (NULL != relay->viewers)
+    {
+        viewer = relay->viewers;
+        relay->viewers = viewer->next;
+        free(viewer);
+    }
+
+    cache_clear(relay);
+    while (NULL != relay->free_list)
+    {
+        packet = relay->free_list;
+        relay->free_list = packet->next;
+        free(packet);
+    }
+
+    free(relay);
+
+    return;
+}
+
+int rtsp_relay_add_track(rtsp_relay_t *relay, unsigned char channel, rtsp_relay_codec_e codec)
+{
+    struct relay_track *track;
+    int index;
+
+    if (NULL == relay || relay->track_count >= RTSP_RELAY_MAX_TRACKS || channel == 255)
+    {
+        log_error("rtsp_relay_add_track: bad relay(%p) or too many tracks or bad channel(%u)", relay, channel);
+        return -1;
+    }
+
+    index = relay->track_count;
+    track = &relay->tracks[index];
+    track->in_use = 1;
+    track->channel = channel;
+    track->codec = codec;
+    track->has_keyframe_ts = 0;
+    relay->track_count++;
+
+    relay->channel_map[channel] = (short)(index << 1);
+    relay->channel_map[channel+1] = (short)((index << 1) | 1);
+
+    /* 以第一路视频流判断关键帧 */
+    if (relay->video_track < 0 && RTSP_RELAY_CODEC_OTHER != codec)
+    {
+        relay->video_track = index;
+    }
+
+    return index;
+}
+
+void rtsp_relay_set_max_backlog(rtsp_relay_t *relay, unsigned bytes)
+{
+    if (NULL != relay && bytes > 0)
+    {
+        relay->max_backlog = bytes;
+    }
+
+    return;
+}
+
+void rtsp_relay_set_cache_limit(rtsp_relay_t *relay, unsigned packets, unsigned bytes)
+{
+    if (NULL != relay)
+    {
+        relay->cache_max_packets = packets;
+        relay->cache_max_bytes = bytes;
+    }
+
+    return;
+}
+
+void rtsp_relay_feed(rtsp_relay_t *relay, int track, int is_rtcp, const void *data, unsigned short size)
+{
+    struct relay_track *t;
+    rtsp_relay_viewer_t *viewer;
+    relay_packet_t *packet;
+    relay_packet_t *cached;
+    uint32_t ts;
+
+    if (NULL == relay || track < 0 || track >= relay->track_count || NULL == data || 0 == size)
+    {
+        log_error("rtsp_relay_feed: bad relay(%p) or bad track(%d) or bad data(%p) or bad size(%u)", relay, track, data, size);
+        return;
+    }
+
+    t = &relay->tracks[track];
+    relay->stats.packets_in++;
+    relay->stats.bytes_in += size;
+
+    packet = packet_new(relay, data, size);
+    packet->track = track;
+    packet->is_rtcp = is_rtcp;
+    packet->is_keyframe = 0;
+
+    if (0 == is_rtcp && track == relay->video_track && rtp_is_keyframe(t->codec, packet->data, size))
+    {
+        ts = ((uint32_t)packet->data[4] << 24) | ((uint32_t)packet->data[5] << 16) | ((uint32_t)packet->data[6] << 8) | packet->data[7];
+        if (0 == t->has_keyframe_ts || ts != t->keyframe_ts)
+        {
+            packet->is_keyframe = 1;
+            t->keyframe_ts = ts;
+            t->has_keyframe_ts = 1;
+        }
+    }
+
+    for (viewer = relay->viewers; NULL != viewer; viewer = viewer->next)
+    {
+        /* 新加入的 track 先补发缓存中属于它的包，当前包就是关键帧时则无需补发 */
+        if (0 != viewer->replay_tracks)
+        {
+            if (0 == packet->is_keyframe)
+            {
+                for (cached = relay->cache_head; NULL != cached; cached = cached->next)
+                {
+                    if (viewer->replay_tracks & (1u << cached->track))
+                    {
+                        viewer_send(relay, viewer, cached);
+                    }
+                }
+            }
+            viewer->replay_tracks = 0;
+        }
+
+        viewer_send(relay, viewer, packet);
+    }
+
+    /* 更新关键帧缓存: 遇到关键帧时重新开始，超出上限时停止缓存直至下一个关键帧 */
+    if (relay->video_track >= 0)
+    {
+        if (packet->is_keyframe)
+        {
+            cache_clear(relay);
+            relay->cache_full = 0;
+        }
+
+        if (0 == relay->cache_full && (NULL != relay->cache_head || packet->is_keyframe))
+        {
+            if (relay->stats.cached_packets >= relay->cache_max_packets || (relay->cache_bytes + size) > relay->cache_max_bytes)
+            {
+                cache_clear(relay);
+                relay->cache_full = 1;
+            }
+            else
+            {
+                packet->ref++;
+                if (NULL == relay->cache_tail)
+                {
+                    relay->cache_head = packet;
+                }
+                else
+                {
+                    relay->cache_tail->next = packet;
+                }
+                relay->cache_tail = packet;
+                relay->cache_bytes += size;
+                relay->stats.cached_packets++;
+            }
+        }
+    }
+
+    packet_unref(relay, packet);
+
+    return;
+}
+
+void rtsp_relay_feed_interleaved(rtsp_relay_t *relay, unsigned char channel, const void *packet, unsigned short size)
+{
+    short map;
+
+    if (NULL == relay)
+    {
+        return;
+    }
+
+    map = relay->channel_map[channel];
+    if (map < 0)
+    {
+        return;
+    }
+
+    rtsp_relay_feed(relay, (map >> 1), (map & 1), packet, size);
+
+    return;
+}
+
+rtsp_relay_viewer_t* rtsp_relay_add_viewer(rtsp_relay_t *relay, tcp_connection_t *connection)
+{
+    rtsp_relay_viewer_t *viewer;
+
+    if (NULL == relay)
+    {
+        log_error("rtsp_relay_add_viewer: bad relay");
+        return NULL;
+    }
+
+    viewer = (rtsp_relay_viewer_t*)malloc(sizeof(rtsp_relay_viewer_t));
+    memset(viewer, 0, sizeof(*viewer));
+    viewer->relay = relay;
+    viewer->connection = connection;
+    viewer->waiting_keyframe = 1;
+    viewer->replay_tracks = 0;
+
+    viewer->prev = NULL;
+    viewer->next = relay->viewers;
+    if (NULL != relay->viewers)
+    {
+        relay->viewers->prev = viewer;
+    }
+    relay->viewers = viewer;
+    relay->stats.viewers++;
+
+    return viewer;
+}
+
+int rtsp_relay_viewer_add_track(rtsp_relay_viewer_t *viewer, int track, const rtsp_relay_target_t *target)
+{
+    if (NULL == viewer || track < 0 || track >= viewer->relay->track_count || NULL == target)
+    {
+        log_error("rtsp_relay_viewer_add_track: bad viewer(%p) or bad track(%d) or bad target(%p)", viewer, track, target);
+        return -1;
+    }
+
+    if (NULL == viewer->connection && NULL == target->peer)
+    {
+        log_error("rtsp_relay_viewer_add_track: udp viewer without rtp peer");
+        return -1;
+    }
+
+    viewer->targets[track] = *target;
+    viewer->has_target[track] = 1;
+    viewer->replay_tracks |= (1u << track);
+    /* 只有加入视频时才需等待关键帧，之后再加入其他 track 不影响已在接收的视频 */
+    if (track == viewer->relay->video_track)
+    {
+        viewer->waiting_keyframe = 1;
+    }
+
+    return 0;
+}
+
+void rtsp_relay_remove_viewer(rtsp_relay_t *relay, rtsp_relay_viewer_t *viewer)
+{
+    if (NULL == relay || NULL == viewer)
+    {
+        return;
+    }
+
+    if (NULL != viewer->prev)
+    {
+        viewer->prev->next = viewer->next;
+    }
+    else
+    {
+        relay->viewers = viewer->next;
+    }
+    if (NULL != viewer->next)
+    {
+        viewer->next->prev = viewer->prev;
+    }
+
+    relay->stats.viewers--;
+    free(viewer);
+
+    return;
+}
+
+void rtsp_relay_get_stats(rtsp_relay_t *relay, rtsp_relay_stats_t *stats)
+{
+    if (NULL != relay && NULL != stats)
+    {
+        *stats = relay->stats;
+    }
+
+    return;
+}
@@ -0,0 +1,102 @@
+
+/** 媒体流转发: 一路输入(rtsp_request 拉流或 ANNOUNCE/RECORD 推流)，分发给多个观看者
+  *
+  * 每个 RTP/RTCP 包只在 slab 中存放一份，以引用计数在缓存与各观看者之间共享
+  * TCP(interleaved) 观看者以 writev 发送各自的 interleaved 头与共享的包数据，UDP 观看者直接发送共享的包数据
+  * 观看者接收跟不上时不再为其缓存数据，而是丢弃直至下一个关键帧，再从关键帧处恢复
+  * 缓存自最近的关键帧开始的一组包，新加入的观看者可以立即从关键帧开始播放
+  *
+  * relay 及其全部观看者只能在创建 relay 的 loop 线程中使用
+  */
+
+#ifndef TINYLIB_RTSP_RELAY_H
+#define TINYLIB_RTSP_RELAY_H
+
+struct rtsp_relay;
+typedef struct rtsp_relay rtsp_relay_t;
+
+struct rtsp_relay_viewer;
+typedef struct rtsp_relay_viewer rtsp_relay_viewer_t;
+
+#include "tinylib/net/tcp_connection.h"
+#include "tinylib/net/loop.h"
+#include "tinylib/rtp/rtp_peer.h"
+
+/* 单个 relay 最多支持的媒体流数 */
+#define RTSP_RELAY_MAX_TRACKS 8
+
+/* 用于识别关键帧的编码类型，其他编码的每个包都可作为恢复发送的起点 */
+typedef enum rtsp_relay_codec
+{
+    RTSP_RELAY_CODEC_OTHER = 0,
+    RTSP_RELAY_CODEC_H264,
+    RTSP_RELAY_CODEC_H265,
+}rtsp_relay_codec_e;
+
+/* 观看者接收某一媒体流的方式
+ * TCP 观看者使用 rtp_channel/rtcp_channel，即其 SETUP 时 Transport head 中的 interleaved
+ * UDP 观看者使用 peer 及 rtp_addr/rtcp_addr，即其 SETUP 时 Transport head 中的 client_port
+ */
+typedef struct rtsp_relay_target
+{
+    unsigned char rtp_channel;
+    unsigned char rtcp_channel;
+
+    rtp_peer_t *peer;
+    inetaddr_t rtp_addr;
+    inetaddr_t rtcp_addr;
+}rtsp_relay_target_t;
+
+typedef struct rtsp_relay_stats
+{
+    unsigned viewers;
+    unsigned cached_packets;                /* 关键帧缓存中的包数 */
+    unsigned long long packets_in;
+    unsigned long long bytes_in;
+    unsigned long long packets_out;
+    unsigned long long bytes_out;
+    unsigned long long packets_dropped;     /* 因观看者接收跟不上而丢弃的包数 */
+    unsigned long long viewer_skips;        /* 观看者因接收跟不上而跳至下一关键帧的次数 */
+}rtsp_relay_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+rtsp_relay_t* rtsp_relay_new(loop_t *loop);
+
+/* 同时移除全部观看者，但不会关闭其连接 */
+void rtsp_relay_destroy(rtsp_relay_t *relay);
+
+/* 添加一路媒体流，channel 为其在输入端的 interleaved rtp channel(rtcp 为 channel+1)，返回媒体流序号，失败时返回-1 */
+int rtsp_relay_add_track(rtsp_relay_t *relay, unsigned char channel, rtsp_relay_codec_e codec);
+
+/* TCP 观看者的发送缓冲区中积压超过该值时跳至下一个关键帧，默认 512KB */
+void rtsp_relay_set_max_backlog(rtsp_relay_t *relay, unsigned bytes);
+
+/* 关键帧缓存的上限，超过时不再缓存直至下一个关键帧，默认 2048 个包或 4MB */
+void rtsp_relay_set_cache_limit(rtsp_relay_t *relay, unsigned packets, unsigned bytes);
+
+/* 输入一个 RTP/RTCP 包 */
+void rtsp_relay_feed(rtsp_relay_t *relay, int track, int is_rtcp, const void *packet, unsigned short size);
+
+/* 按输入端的 interleaved channel 输入，可直接在 rtsp_request/rtsp_session 的 interleaved 回调中调用 */
+void rtsp_relay_feed_interleaved(rtsp_relay_t *relay, unsigned char channel, const void *packet, unsigned short size);
+
+/* 添加一个观看者，connection 为NULL时为 UDP 观看者
+ * 观看者的 connection 关闭之前，须先以 rtsp_relay_remove_viewer() 移除
+ */
+rtsp_relay_viewer_t* rtsp_relay_add_viewer(rtsp_relay_t *relay, tcp_connection_t *connection);
+
+/* 指定观看者接收 track 的方式，指定之后即从关键帧开始发送(优先使用关键帧缓存) */
+int rtsp_relay_viewer_add_track(rtsp_relay_viewer_t *viewer, int track, const rtsp_relay_target_t *target);
+
+void rtsp_relay_remove_viewer(rtsp_relay_t *relay, rtsp_relay_viewer_t *viewer);
+
+void rtsp_relay_get_stats(rtsp_relay_t *relay, rtsp_relay_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_RTSP_RELAY_H */
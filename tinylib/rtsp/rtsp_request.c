@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_RTSP
+
 #include "tinylib/rtsp/rtsp_request.h"
 #include "tinylib/rtsp/rtsp_message_codec.h"
 #include "tinylib/util/url.h"
@@ -28,6 +30,7 @@ struct rtsp_request
 
     rtsp_request_handler_f request_handler; /* userṩӦ */
     rtsp_request_interleaved_packet_f interleaved_sink;
+    rtsp_request_interleaved_batch_f interleaved_batch_sink;
     void* userdata;
     
     rtsp_response_msg_t *response_msg;
@@ -177,6 +180,47 @@ static void request_filt_response
     return;
 }
 
+/* ʼȫ interleaved ֮֡һƳ
+ * 1ʾѽ0ʾ֡в-1ʾڻصб
+ */
+static
+int request_interleaved(rtsp_request_t *request, buffer_t* buffer)
+{
+    rtsp_interleaved_frame_t frames[RTSP_INTERLEAVED_BATCH];
+    int parsed_bytes;
+    int count;
+    int i;
+
+    count = rtsp_interleaved_frames_decode(buffer_peek(buffer), buffer_readablebytes(buffer), frames, RTSP_INTERLEAVED_BATCH, &parsed_bytes);
+    if (count <= 0)
+    {
+        return 0;
+    }
+
+    request->is_in_handler = 1;
+    if (NULL != request->interleaved_batch_sink)
+    {
+        request->interleaved_batch_sink(request, frames, count, request->userdata);
+    }
+    else
+    {
+        for (i = 0; i < count && request->is_alive; ++i)
+        {
+            request->interleaved_sink(request, frames[i].channel, frames[i].data, frames[i].size, request->userdata);
+        }
+    }
+    request->is_in_handler = 0;
+
+    buffer_retrieve(buffer, parsed_bytes);
+    if (0 == request->is_alive)
+    {
+        request_delete(request);
+        return -1;
+    }
+
+    return 1;
+}
+
 static void request_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
 {
     rtsp_request_t *request;
@@ -186,7 +230,6 @@ static void request_ondata(tcp_connection_t* connection, buffer_t* buffer, void*
     int size;
     char ch;
 
-    uint16_t interleaved_len;
     int ret;
 
     request = (rtsp_request_t *)userdata;
@@ -199,6 +242,10 @@ static void request_ondata(tcp_connection_t* connection, buffer_t* buffer, void*
         {
             data = (char*)buffer_peek(buffer);
             size = buffer_readablebytes(buffer);
+            if (size <= 0)
+            {
+                return;
+            }
 
             ch = data[0];
             if (ch == 0x24)
@@ -206,16 +253,11 @@ static void request_ondata(tcp_connection_t* connection, buffer_t* buffer, void*
                 request->is_new_response = 0;
                 request->is_interleaved_message = 1;
 
-                ch = data[1];
-                interleaved_len = ntohs(*(uint16_t*)&data[2]);
-                if (size < (unsigned)(interleaved_len+4))
+                if (request_interleaved(request, buffer) <= 0)
                 {
                     return;
                 }
 
-                request->interleaved_sink(request, (unsigned char)ch, &data[4], interleaved_len, request->userdata);
-                buffer_retrieve(buffer, (interleaved_len+4));
-
                 request->is_new_response = 1;
                 request->is_interleaved_message = 0;
                 continue;
@@ -278,6 +320,10 @@ static void request_ondata(tcp_connection_t* connection, buffer_t* buffer, void*
         {
             data = (char*)buffer_peek(buffer);
             size = buffer_readablebytes(buffer);
+            if (size <= 0)
+            {
+                return;
+            }
 
             /* ʵǰһβinterleavedϢʼֽһ 0x24 */
 
@@ -287,18 +333,13 @@ static void request_ondata(tcp_connection_t* connection, buffer_t* buffer, void*
                 request->is_new_response = 0;
                 request->is_interleaved_message = 1;
                 
-                ch = data[1];
-                interleaved_len = ntohs(*(uint16_t*)&data[2]);
-                if (size < (unsigned)(interleaved_len+4))
+                if (request_interleaved(request, buffer) <= 0)
                 {
                     return;
                 }
 
-                request->interleaved_sink(request, (unsigned char)ch, &data[4], interleaved_len, request->userdata);
-                buffer_retrieve(buffer, (interleaved_len+4));
-
                 request->is_new_response = 1;
-
+                request->is_interleaved_message = 0;
                 continue;
             }
             else
@@ -499,6 +540,20 @@ int rtsp_request_launch(rtsp_request_t* request)
     return result;
 }
 
+#if defined(__linux__)
+void rtsp_request_set_resolver(rtsp_request_t* request, resolver_t *resolver)
+{
+    if (NULL == request || NULL == request->client)
+    {
+        return;
+    }
+
+    tcp_client_set_resolver(request->client, resolver);
+
+    return;
+}
+#endif
+
 unsigned rtsp_request_server_method(rtsp_request_t* request)
 {
     return NULL == request ? 0 : request->server_methods;
@@ -509,6 +564,53 @@ int rtsp_request_timeout(rtsp_request_t* request)
     return NULL == request ? 0 : request->timeout;
 }
 
+void rtsp_request_set_interleaved_batch_sink(rtsp_request_t* request, rtsp_request_interleaved_batch_f batch_sink)
+{
+    if (NULL != request)
+    {
+        request->interleaved_batch_sink = batch_sink;
+    }
+
+    return;
+}
+
+int rtsp_request_send_interleaved(rtsp_request_t* request, unsigned char channel, const void *packet, unsigned short size)
+{
+    tcp_connection_t* connection;
+    unsigned char head[4];
+    #ifndef WIN32
+    struct iovec vecs[2];
+    #endif
+
+    if (NULL == request || NULL == packet || 0 == size)
+    {
+        log_error("rtsp_request_send_interleaved: bad request(%p) or bad packet(%p) or bad size(%u)", request, packet, size);
+        return -1;
+    }
+
+    connection = tcp_client_getconnection(request->client);
+    if (NULL == connection)
+    {
+        log_error("rtsp_request_send_interleaved: bad connection");
+        return -1;
+    }
+
+    rtsp_interleaved_head_encode(head, channel, size);
+
+    #ifdef WIN32
+    tcp_connection_send(connection, head, 4);
+    tcp_connection_send(connection, packet, size);
+    #else
+    vecs[0].iov_base = head;
+    vecs[0].iov_len = 4;
+    vecs[1].iov_base = (void*)packet;
+    vecs[1].iov_len = size;
+    tcp_connection_sendv(connection, vecs, 2);
+    #endif
+
+    return 0;
+}
+
 int rtsp_request_options(rtsp_request_t* request)
 {
     char buffer[1024];
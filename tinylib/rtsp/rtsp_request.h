@@ -8,6 +8,9 @@ struct rtsp_request;
 typedef struct rtsp_request rtsp_request_t;
 
 #include "tinylib/net/tcp_connection.h"
+#if defined(__linux__)
+  #include "tinylib/net/resolver.h"
+#endif
 #include "tinylib/rtsp/rtsp_message_codec.h"
 
 #ifdef __cplusplus
@@ -38,6 +41,14 @@ typedef void (*rtsp_request_interleaved_packet_f)
     void *userdata
 );
 
+/* һյȫ interleaved ֡frames еָջֻڻصڼЧ */
+typedef void (*rtsp_request_interleaved_batch_f)
+(
+    rtsp_request_t *request, 
+    const rtsp_interleaved_frame_t *frames, int count,
+    void *userdata
+);
+
 rtsp_request_t* rtsp_request_new
 (
     loop_t* loop, 
@@ -51,12 +62,23 @@ void rtsp_request_destroy(rtsp_request_t* request);
 
 int rtsp_request_launch(rtsp_request_t* request);
 
+#if defined(__linux__)
+/* url еΪʱָõĽɹͬһ rtsp_request_launch() ֮ǰ( linux) */
+void rtsp_request_set_resolver(rtsp_request_t* request, resolver_t *resolver);
+#endif
+
 /* Զ˷ֵ֧ķOPTIONSȷӦ֮Ч0 */
 unsigned rtsp_request_server_method(rtsp_request_t* request);
 
 /* ȡصĻػʱֵ */
 int rtsp_request_timeout(rtsp_request_t* request);
 
+/* ֮ interleaved ֡Ϊ batch_sink interleaved_sinkΪNULLʱָ */
+void rtsp_request_set_interleaved_batch_sink(rtsp_request_t* request, rtsp_request_interleaved_batch_f batch_sink);
+
+/*  interleaved ֡һ RTP/RTCP ( RECORD  RTCP ձ)4ֽͷ packet һ writev ύpacket ƴӿ */
+int rtsp_request_send_interleaved(rtsp_request_t* request, unsigned char channel, const void *packet, unsigned short size);
+
 int rtsp_request_options(rtsp_request_t* request);
 
 int rtsp_request_describe(rtsp_request_t* request, rtsp_head_t* head);
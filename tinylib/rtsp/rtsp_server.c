@@ -1,34 +1,408 @@
 
+#define LOG_MODULE LOG_MODULE_RTSP
+
 #include "tinylib/rtsp/rtsp_server.h"
 #include "tinylib/net/tcp_server.h"
+#include "tinylib/util/time_wheel.h"
 #include "tinylib/util/log.h"
 
 #include <string.h>
 #include <stdlib.h>
 
+/* session ĳʼͰǼǵ session Ͱʱӱ */
+#define RTSP_SERVER_INIT_TABLE_SIZE 64
+
+/* time wheel 1sΪһʱʱ䳬һȦİһȦ */
+#define RTSP_SERVER_WHEEL_STEPS 3600
+
+/* Ǽ server е session */
+typedef struct rtsp_server_session
+{
+    rtsp_server_t *server;
+    rtsp_session_t *session;
+    const char *id;
+    unsigned hash;
+
+    void *timer;                /* time wheel еĳʱ timerΪNULLʱʾδڼʱ */
+    unsigned timeout;           /* ύ timer ʱ session ĳʱʱ䣬session ޸ĳʱ֮ύ */
+    int is_notifying;           /* ֪ͨʹߣ˼ session ͷʱ entry ֪֮ͨͷ */
+
+    struct rtsp_server_session *next;
+}rtsp_server_session_t;
+
 struct rtsp_server
 {
+    loop_t *loop;
     tcp_server_t *server;
     rtsp_session_handler_f session_handler;
     rtsp_session_interleaved_packet_f interleaved_sink;
+    rtsp_session_interleaved_batch_f interleaved_batch_sink;
+    rtsp_server_session_expire_f expirecb;
     void* userdata;
-    
+
+    rtsp_server_session_t **table;
+    unsigned table_size;
+
+    time_wheel_t *wheel;
+    loop_timer_t *wheel_timer;
+
+    rtsp_server_stats_t stats;
+
     int started;
     int is_in_callback;
     int is_alive;
 };
 
+static inline
+unsigned session_id_hash(const char *id, int len)
+{
+    unsigned hash;
+    int i;
+
+    /* FNV-1a */
+    hash = 2166136261u;
+    for (i = 0; i < len; ++i)
+    {
+        hash ^= (unsigned char)id[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static
+void table_expand(rtsp_server_t *server)
+{
+    rtsp_server_session_t **table;
+    rtsp_server_session_t *entry;
+    rtsp_server_session_t *next;
+    unsigned size;
+    unsigned i;
+
+    size = server->table_size * 2;
+    table = (rtsp_server_session_t**)malloc(sizeof(rtsp_server_session_t*) * size);
+    memset(table, 0, sizeof(rtsp_server_session_t*) * size);
+
+    for (i = 0; i < server->table_size; ++i)
+    {
+        entry = server->table[i];
+        while (NULL != entry)
+        {
+            next = entry->next;
+            entry->next = table[entry->hash & (size - 1)];
+            table[entry->hash & (size - 1)] = entry;
+            entry = next;
+        }
+    }
+
+    free(server->table);
+    server->table = table;
+    server->table_size = size;
+
+    return;
+}
+
+static
+void table_insert(rtsp_server_t *server, rtsp_server_session_t *entry)
+{
+    unsigned index;
+
+    if (server->stats.sessions >= server->table_size)
+    {
+        table_expand(server);
+    }
+
+    index = entry->hash & (server->table_size - 1);
+    entry->next = server->table[index];
+    server->table[index] = entry;
+
+    server->stats.sessions++;
+    server->stats.total_sessions++;
+    if (server->stats.sessions > server->stats.peak_sessions)
+    {
+        server->stats.peak_sessions = server->stats.sessions;
+    }
+
+    return;
+}
+
+static
+void table_remove(rtsp_server_t *server, rtsp_server_session_t *entry)
+{
+    rtsp_server_session_t **iter;
+
+    iter = &server->table[entry->hash & (server->table_size - 1)];
+    while (NULL != *iter)
+    {
+        if (*iter == entry)
+        {
+            *iter = entry->next;
+            server->stats.sessions--;
+            break;
+        }
+        iter = &(*iter)->next;
+    }
+
+    return;
+}
+
+static
+rtsp_server_session_t* table_find(rtsp_server_t *server, const char *id, int len)
+{
+    rtsp_server_session_t *entry;
+    unsigned hash;
+
+    hash = session_id_hash(id, len);
+    for (entry = server->table[hash & (server->table_size - 1)]; NULL != entry; entry = entry->next)
+    {
+        if (entry->hash == hash && (int)strlen(entry->id) == len && memcmp(entry->id, id, len) == 0)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
 static inline void delete_server(rtsp_server_t *server)
 {
+    rtsp_server_session_t *entry;
+    rtsp_server_session_t *next;
+    unsigned i;
+
+    /* server ʱеǼǵ sessionȽǼǣͷʱٻص server */
+    for (i = 0; i < server->table_size; ++i)
+    {
+        entry = server->table[i];
+        while (NULL != entry)
+        {
+            next = entry->next;
+            rtsp_session_set_release_callback(entry->session, NULL, NULL);
+            rtsp_session_end(entry->session);
+            free(entry);
+            entry = next;
+        }
+    }
+
+    loop_cancel(server->loop, server->wheel_timer);
+    time_wheel_destroy(server->wheel);
+    free(server->table);
+
     tcp_server_destroy(server->server);
     free(server);
-    
+
+    return;
+}
+
+static
+int server_session_onexpire(void *userdata)
+{
+    rtsp_server_session_t *entry = (rtsp_server_session_t*)userdata;
+    rtsp_server_t *server = entry->server;
+    rtsp_session_t *session;
+
+    /*  ONESHOT ֮ time wheel л timer session ͷʱظ cancel */
+    entry->timer = NULL;
+    server->stats.expired_sessions++;
+
+    log_info("rtsp session(%s) expired after %u seconds idle", entry->id, entry->timeout);
+
+    /* ֪ͨʹͷԴصҲн session */
+    entry->is_notifying = 1;
+    if (0 == server->is_alive)
+    {
+        /* ڱֵĳʱ֪ͨ server֪ͨ */
+    }
+    else if (NULL != server->expirecb)
+    {
+        server->expirecb(entry->session, server->userdata);
+    }
+    else
+    {
+        server->session_handler(entry->session, NULL, NULL, server->userdata);
+    }
+
+    /* صûн session  server ʹߣ session һֱڱ */
+    session = entry->session;
+    if (NULL != session)
+    {
+        rtsp_session_set_release_callback(session, NULL, NULL);
+        table_remove(server, entry);
+        rtsp_session_end(session);
+    }
+    free(entry);
+
+    return TIME_WHEEL_EXPIRE_ONESHOT;
+}
+
+/* session л( interleaved )ʱ¿ʼʱ */
+static
+void server_session_touch(rtsp_server_session_t *entry)
+{
+    rtsp_server_t *server = entry->server;
+    unsigned timeout;
+
+    timeout = rtsp_session_get_timeout(entry->session);
+    if (NULL != entry->timer && timeout == entry->timeout)
+    {
+        time_wheel_refresh(server->wheel, entry->timer);
+        return;
+    }
+
+    if (NULL != entry->timer)
+    {
+        time_wheel_cancel(server->wheel, entry->timer);
+    }
+    entry->timeout = timeout;
+    entry->timer = time_wheel_submit(server->wheel, server_session_onexpire, entry, timeout);
+
+    return;
+}
+
+static
+void server_session_onrelease(rtsp_session_t *session, void *userdata)
+{
+    rtsp_server_session_t *entry = (rtsp_server_session_t*)userdata;
+    rtsp_server_t *server = entry->server;
+
+    if (NULL != entry->timer)
+    {
+        time_wheel_cancel(server->wheel, entry->timer);
+    }
+    table_remove(server, entry);
+
+    if (entry->is_notifying)
+    {
+        entry->session = NULL;
+    }
+    else
+    {
+        free(entry);
+    }
+
+    return;
+}
+
+static
+void server_session_handler
+(
+    rtsp_session_t* session,
+    tcp_connection_t* connection,
+    rtsp_request_slice_t *request,
+    void *userdata
+)
+{
+    rtsp_server_session_t *entry = (rtsp_server_session_t*)userdata;
+    rtsp_server_t *server = entry->server;
+    int request_or_new;
+
+    if (NULL == entry->session)
+    {
+        /* rtsp_session_start() е״֪ͨʱǼ sessionԱ handler мɲҵ */
+        entry->session = session;
+        entry->id = rtsp_session_get_id(session);
+        while (NULL != table_find(server, entry->id, RTSP_SESSION_ID_LEN))
+        {
+            /* id δ֪ͻˣһɣظ id ʹҵ session */
+            log_warn("server_session_handler: duplicated session id(%s), renew it", entry->id);
+            if (0 != rtsp_session_renew_id(session))
+            {
+                log_error("server_session_handler: failed to renew session id(%s)", entry->id);
+                break;
+            }
+        }
+        entry->hash = session_id_hash(entry->id, RTSP_SESSION_ID_LEN);
+        table_insert(server, entry);
+        rtsp_session_set_release_callback(session, server_session_onrelease, entry);
+        request_or_new = 1;
+    }
+    else
+    {
+        request_or_new = (NULL != request);
+    }
+
+    server->is_in_callback = 1;
+    entry->is_notifying = 1;
+    server->session_handler(session, connection, request, server->userdata);
+    entry->is_notifying = 0;
+    server->is_in_callback = 0;
+
+    if (NULL == entry->session)
+    {
+        /* session ڻصͷ */
+        free(entry);
+    }
+    else if (request_or_new && server->is_alive)
+    {
+        /* ص֮ټʱhandler õĳʱʱ( session  SETUP ʱ)Ч */
+        server_session_touch(entry);
+    }
+
+    if (0 == server->is_alive)
+    {
+        delete_server(server);
+    }
+
+    return;
+}
+
+static
+void server_interleaved_sink
+(
+    rtsp_session_t* session,
+    unsigned char channel,
+    void* packet, unsigned short size,
+    void *userdata
+)
+{
+    rtsp_server_session_t *entry = (rtsp_server_session_t*)userdata;
+    rtsp_server_t *server = entry->server;
+
+    server_session_touch(entry);
+    server->interleaved_sink(session, channel, packet, size, server->userdata);
+
+    return;
+}
+
+static
+void server_interleaved_batch_sink
+(
+    rtsp_session_t* session,
+    const rtsp_interleaved_frame_t *frames, int count,
+    void *userdata
+)
+{
+    rtsp_server_session_t *entry = (rtsp_server_session_t*)userdata;
+    rtsp_server_t *server = entry->server;
+
+    server_session_touch(entry);
+    server->interleaved_batch_sink(session, frames, count, server->userdata);
+
+    return;
+}
+
+static
+void server_onwheel(void *userdata)
+{
+    rtsp_server_t *server = (rtsp_server_t*)userdata;
+
+    /* ʱ֪ͨп server time wheel ֮ͷ */
+    server->is_in_callback = 1;
+    time_wheel_step(server->wheel);
+    server->is_in_callback = 0;
+
+    if (0 == server->is_alive)
+    {
+        delete_server(server);
+    }
+
     return;
 }
 
 static void server_onconnection(tcp_connection_t* connection, void* userdata, const inetaddr_t* peer_addr)
 {
     rtsp_server_t *server;
+    rtsp_server_session_t *entry;
     rtsp_session_t *session;
 
     if (NULL == connection || NULL == userdata)
@@ -37,24 +411,32 @@ static void server_onconnection(tcp_connection_t* connection, void* userdata, co
     }
 
     (void)peer_addr;
-    
+
     server = (rtsp_server_t *)userdata;
-    session = rtsp_session_start(connection, server->session_handler, server->interleaved_sink, server->userdata);
-    
-    (void)session;
 
-    /* FIXME: rtsp_server ڲ session еǼǹ?  */
+    entry = (rtsp_server_session_t*)malloc(sizeof(rtsp_server_session_t));
+    memset(entry, 0, sizeof(*entry));
+    entry->server = server;
+    entry->session = NULL;
+    entry->timer = NULL;
+
+    /* Ǽ session ״֪ͨɣ server_session_handler() */
+    session = rtsp_session_start(connection, server_session_handler, server_interleaved_sink, entry);
+    if (NULL != session && NULL != server->interleaved_batch_sink)
+    {
+        rtsp_session_set_interleaved_batch_sink(session, server_interleaved_batch_sink);
+    }
 
     return;
 }
 
 rtsp_server_t* rtsp_server_new
 (
-    loop_t *loop, 
-    rtsp_session_handler_f session_handler, 
-    rtsp_session_interleaved_packet_f interleaved_sink, 
+    loop_t *loop,
+    rtsp_session_handler_f session_handler,
+    rtsp_session_interleaved_packet_f interleaved_sink,
     void *userdata,
-    unsigned short port, 
+    unsigned short port,
     const char* ip
 )
 {
@@ -62,13 +444,14 @@ rtsp_server_t* rtsp_server_new
 
     if (NULL == loop || NULL == session_handler || NULL == interleaved_sink ||  0 == port || NULL == ip)
     {
-        log_error("rtsp_server_new: bad loop(%p) or bad session_handler(%p) or interleaved_sink(%p) bad  or bad port(%u) or bad ip(%p)", 
+        log_error("rtsp_server_new: bad loop(%p) or bad session_handler(%p) or interleaved_sink(%p) bad  or bad port(%u) or bad ip(%p)",
             loop, session_handler, interleaved_sink, port, ip);
         return NULL;
     }
 
     server = (rtsp_server_t*)malloc(sizeof(rtsp_server_t));
     memset(server, 0, sizeof(*server));
+    server->loop = loop;
     server->session_handler = session_handler;
     server->interleaved_sink = interleaved_sink;
     server->userdata = userdata;
@@ -79,7 +462,16 @@ rtsp_server_t* rtsp_server_new
         log_error("rtsp_server_new: tcp_server_new() failed");
         return NULL;
     }
-    
+
+    server->table_size = RTSP_SERVER_INIT_TABLE_SIZE;
+    server->table = (rtsp_server_session_t**)malloc(sizeof(rtsp_server_session_t*) * server->table_size);
+    memset(server->table, 0, sizeof(rtsp_server_session_t*) * server->table_size);
+
+    server->wheel = time_wheel_create(RTSP_SERVER_WHEEL_STEPS);
+    server->wheel_timer = loop_runevery(loop, 1000, server_onwheel, server);
+
+    memset(&server->stats, 0, sizeof(server->stats));
+
     server->started = 0;
     server->is_in_callback = 0;
     server->is_alive = 1;
@@ -87,6 +479,26 @@ rtsp_server_t* rtsp_server_new
     return server;
 }
 
+void rtsp_server_set_interleaved_batch_sink(rtsp_server_t *server, rtsp_session_interleaved_batch_f batch_sink)
+{
+    if (NULL != server)
+    {
+        server->interleaved_batch_sink = batch_sink;
+    }
+
+    return;
+}
+
+void rtsp_server_set_expire_callback(rtsp_server_t *server, rtsp_server_session_expire_f expirecb)
+{
+    if (NULL != server)
+    {
+        server->expirecb = expirecb;
+    }
+
+    return;
+}
+
 void rtsp_server_start(rtsp_server_t *server)
 {
     if (NULL == server)
@@ -143,3 +555,46 @@ void rtsp_server_destroy(rtsp_server_t *server)
 
     return;
 }
+
+rtsp_session_t* rtsp_server_find_session(rtsp_server_t *server, const char *id, int len)
+{
+    rtsp_server_session_t *entry;
+    int i;
+
+    if (NULL == server || NULL == id)
+    {
+        return NULL;
+    }
+
+    if (len < 0)
+    {
+        len = strlen(id);
+    }
+
+    /* Session head  id ܴ֮ ";timeout=" Ȳ */
+    for (i = 0; i < len; ++i)
+    {
+        if (id[i] == ';' || id[i] == ' ')
+        {
+            len = i;
+            break;
+        }
+    }
+
+    entry = table_find(server, id, len);
+
+    return (NULL == entry) ? NULL : entry->session;
+}
+
+void rtsp_server_get_stats(rtsp_server_t *server, rtsp_server_stats_t *stats)
+{
+    if (NULL == server || NULL == stats)
+    {
+        return;
+    }
+
+    *stats = server->stats;
+    stats->table_size = server->table_size;
+
+    return;
+}
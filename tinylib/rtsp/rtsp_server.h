@@ -7,10 +7,27 @@ typedef struct rtsp_server rtsp_server_t;
 #include "tinylib/rtsp/rtsp_session.h"
 #include "tinylib/net/loop.h"
 
+typedef struct rtsp_server_stats
+{
+    unsigned sessions;                      /* ǰǼǵ session  */
+    unsigned peak_sessions;
+    unsigned long long total_sessions;      /* ۼƴ session  */
+    unsigned long long expired_sessions;    /* ʱδյ session  */
+    unsigned table_size;                    /* session Ͱ */
+}rtsp_server_stats_t;
+
+/* session ʱδյ֪ͨص֮ server  sessionصҲе rtsp_session_end() */
+typedef void (*rtsp_server_session_expire_f)(rtsp_session_t* session, void *userdata);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* server ΪÿӴ session Session-ID ǼԼ session 
+ * յ interleaved ʱ session ¼ʱ䳬ʱʱ( rtsp_session_set_timeout())޻ʱ
+ * ֪ͨʹ֮ server  sessionδ rtsp_server_set_expire_callback() ʱ connection  request ΪNULL֪ͨ session_handler
+ * server ʱȫ session
+ */
 rtsp_server_t* rtsp_server_new
 (
     loop_t *loop, 
@@ -23,10 +40,26 @@ rtsp_server_t* rtsp_server_new
 
 void rtsp_server_destroy(rtsp_server_t *server);
 
+/* ֮½ session Ϊ batch_sink  interleaved ֡ rtsp_session_set_interleaved_batch_sink()
+ *  rtsp_server_start() ֮ǰ
+ */
+void rtsp_server_set_interleaved_batch_sink(rtsp_server_t *server, rtsp_session_interleaved_batch_f batch_sink);
+
+/*  session ʱյ֪ͨʱ֪֣ͨuserdata ͬ rtsp_server_new() */
+void rtsp_server_set_expire_callback(rtsp_server_t *server, rtsp_server_session_expire_f expirecb);
+
 void rtsp_server_start(rtsp_server_t *server);
 
 void rtsp_server_stop(rtsp_server_t *server);
 
+/*  Session-ID  sessionid ֱ Session head ֵ ';' ֮Ĳᱻ
+ * len С0 ʱ id '\0'βַֻ server ڵ loop ߳е
+ */
+rtsp_session_t* rtsp_server_find_session(rtsp_server_t *server, const char *id, int len);
+
+/* ֻ server ڵ loop ߳е */
+void rtsp_server_get_stats(rtsp_server_t *server, rtsp_server_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
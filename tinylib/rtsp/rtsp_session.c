@@ -1,13 +1,17 @@
 
+#define LOG_MODULE LOG_MODULE_RTSP
+
 #include "tinylib/rtsp/rtsp_session.h"
 
 #include "tinylib/net/buffer.h"
 #include "tinylib/rtsp/rtsp_message_codec.h"
 #include "tinylib/util/log.h"
+#include "tinylib/util/util.h"
 
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdint.h>
 
 #ifdef WIN32
@@ -16,21 +20,58 @@
   #include <arpa/inet.h>
 #endif
 
+/* Ϣֵ֧ head  */
+#define RTSP_SESSION_MAX_HEADS 32
+
+/* Ĭϵ session ʱʱ(s) RFC 2326  Session head  timeout ȱʡֵ */
+#define RTSP_SESSION_DEFAULT_TIMEOUT 60
+
+/* ȴ͵Ӧ󵽴ȺŶ
+ * ӳٴ rtsp_session_defer_reply() ʱӣis_done Ϊ0ֱӦ CSeq Ӧ
+ * δ֮ӦҲӵȴԱ֤Ӧ˳һ
+ */
+typedef struct rtsp_reply
+{
+    int cseq;
+    int is_done;
+    const char *data;
+    int size;
+    void *memory;
+    struct rtsp_reply *next;
+}rtsp_reply_t;
+
+/* ߳Ͷݵ loop ̵߳ӦϢݽ */
+struct rtsp_reply_msg
+{
+    rtsp_session_t *session;
+    int cseq;
+    int size;
+};
+
 struct rtsp_session
 {
     tcp_connection_t* connection;
+    loop_t *loop;
 
     rtsp_session_handler_f session_handler;
+    rtsp_session_msg_handler_f msg_handler;     /*  rtsp_session_start_msg() ʱΪɰ汾 handler */
     rtsp_session_interleaved_packet_f interleaved_sink;
+    rtsp_session_interleaved_batch_f interleaved_batch_sink;
     void* userdata;
 
-    rtsp_request_msg_t *request_msg;
+    /* Ϣ head  session һ䣬ÿһϢ reset ֮ */
+    rtsp_request_slice_t request;
+    rtsp_head_slice_t heads[RTSP_SESSION_MAX_HEADS];
+
+    char id[RTSP_SESSION_ID_LEN+1];
+    unsigned timeout;
 
-    int is_new_request;                /* һµrtspͻϢĿʼµrtspϢinterleavedϢ
-                                     * ʼÿһϢҪΪ1
-                                     */
+    rtsp_session_release_f release_callback;
+    void *release_userdata;
 
-    int is_interleaved_message;        /* ǷһinterleavedϢ */
+    rtsp_reply_t *reply_head;
+    rtsp_reply_t *reply_tail;
+    int deferred_count;         /* δɵӳΪ0ʱ session ֮ҲҪȫ */
 
     unsigned long context_data[4];
     void *extra_userdata;
@@ -39,185 +80,313 @@ struct rtsp_session
     int is_alive;    
 };
 
+/* Session-ID ൱ڷ session ƾ(RFC 2326 12.37)ȡϵͳԴʱ䡢ַƲ */
+static
+int session_generate_id(rtsp_session_t* session)
+{
+    static const char hex[] = "0123456789abcdef";
+    unsigned char bytes[RTSP_SESSION_ID_LEN / 2];
+    int i;
+
+    if (0 != random_bytes(bytes, sizeof(bytes)))
+    {
+        return -1;
+    }
+
+    for (i = 0; i < (int)sizeof(bytes); ++i)
+    {
+        session->id[i * 2] = hex[bytes[i] >> 4];
+        session->id[i * 2 + 1] = hex[bytes[i] & 0xf];
+    }
+    session->id[RTSP_SESSION_ID_LEN] = '\0';
+
+    return 0;
+}
+
 static inline
 void session_delete(rtsp_session_t* session)
 {
-    tcp_connection_destroy(session->connection);
-    rtsp_request_msg_unref(session->request_msg);
+    rtsp_reply_t *reply;
+
+    if (NULL != session->release_callback)
+    {
+        session->release_callback(session, session->release_userdata);
+    }
+
+    while (NULL != session->reply_head)
+    {
+        reply = session->reply_head;
+        session->reply_head = reply->next;
+        free(reply->memory);
+        free(reply);
+    }
+
+    if (NULL != session->connection)
+    {
+        tcp_connection_destroy(session->connection);
+    }
     free(session);
 
     return;
 }
 
-static void session_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+/* ӳδʱȹرӣsession һӳӦʱͷ */
+static
+void session_close(rtsp_session_t* session)
 {
-    rtsp_session_t* session;
+    session->is_alive = 0;
 
-    int parsed_bytes;
-    char* data;
-    int size;
-    uint8_t ch;
+    if (session->deferred_count > 0)
+    {
+        if (NULL != session->connection)
+        {
+            tcp_connection_destroy(session->connection);
+            session->connection = NULL;
+        }
+    }
+    else
+    {
+        session_delete(session);
+    }
 
-    uint16_t interleaved_len;
-    int ret;
+    return;
+}
 
-    session = (rtsp_session_t*)userdata;
+static
+void session_send(rtsp_session_t* session, const char *head, int head_len, const char *body, int body_len)
+{
+    #ifndef WIN32
+    struct iovec vecs[2];
+    #endif
 
-    if (session->is_new_request)
+    if (NULL == body || body_len <= 0)
     {
-        while (1)
-        {
-            data = (char*)buffer_peek(buffer);
-            size = buffer_readablebytes(buffer);
+        tcp_connection_send(session->connection, head, head_len);
+        return;
+    }
 
-            ch = data[0];
-            if (ch == 0x24)
-            {
-                session->is_new_request = 0;
-                session->is_interleaved_message = 1;
+    #ifdef WIN32
+    tcp_connection_send(session->connection, head, head_len);
+    tcp_connection_send(session->connection, body, body_len);
+    #else
+    vecs[0].iov_base = (void*)head;
+    vecs[0].iov_len = head_len;
+    vecs[1].iov_base = (void*)body;
+    vecs[1].iov_len = body_len;
+    tcp_connection_sendv(session->connection, vecs, 2);
+    #endif
 
-                ch = data[1];
-                interleaved_len = ntohs(*(uint16_t*)&data[2]);
-                if (size < (unsigned)(interleaved_len+4))
-                {
-                    return;
-                }
+    return;
+}
 
-                session->interleaved_sink(session, (unsigned char)ch, &data[4], interleaved_len, session->userdata);
+/* ηɵӦֱδɵӳ */
+static
+void session_flush(rtsp_session_t* session)
+{
+    rtsp_reply_t *reply;
 
-                buffer_retrieve(buffer, (interleaved_len+4));
-                session->is_new_request = 1;
-                session->is_interleaved_message = 0;
-                continue;
-            }
-            else
-            {
-                session->is_new_request = 0;
-                session->is_interleaved_message = 0;
+    while (NULL != session->reply_head && session->reply_head->is_done)
+    {
+        reply = session->reply_head;
+        session->reply_head = reply->next;
+        if (NULL == session->reply_head)
+        {
+            session->reply_tail = NULL;
+        }
 
-                /* ΪǳrtspıϢʼԽ֮ */
-                ret = rtsp_request_msg_decode(session->request_msg, data, size, &parsed_bytes);
-                if (ret == 0)
-                {
-                    session->is_in_handler = 1;
-                    session->session_handler(session, connection, session->request_msg, session->userdata);
-                    session->is_in_handler = 0;
+        if (NULL != session->connection && reply->size > 0)
+        {
+            tcp_connection_send(session->connection, reply->data, reply->size);
+        }
+        free(reply->memory);
+        free(reply);
+    }
 
-                    rtsp_request_msg_unref(session->request_msg);
-                    session->request_msg = NULL;
-                    buffer_retrieve(buffer, parsed_bytes);
+    return;
+}
 
-                    if (0 == session->is_alive)
-                    {
-                        session_delete(session);
+/* ֻ loop ִ߳Уmemory NULLʱΪ head/body ڵڴ棬ɸúͷ */
+static
+void session_reply(rtsp_session_t* session, int cseq, const char *head, int head_len, const char *body, int body_len, void *memory)
+{
+    rtsp_reply_t *reply;
+    char *data;
 
-                        break;
-                    }
+    for (reply = session->reply_head; NULL != reply; reply = reply->next)
+    {
+        if (0 == reply->is_done && reply->cseq == cseq)
+        {
+            session->deferred_count--;
+            break;
+        }
+    }
 
-                    session->request_msg = rtsp_request_msg_new();
-                    session->is_new_request = 1;
-                    continue;
-                }
-                else if (ret > 0)
-                {
-                    /* нûгݲ޷ؼ */
-                    return;
-                }
-                else
-                {
-                    /* ΪǷϢ */
-                    session->is_in_handler = 1;
-                    session->session_handler(session, NULL, NULL, session->userdata);
-                    session->is_in_handler = 0;
-                    
-                    if (0 == session->is_alive)
-                    {
-                        session_delete(session);
-                    }
-                    
-                    return;
-                }
-            }
+    if (NULL == session->connection)
+    {
+        /* session ѽӦֱӶ */
+        free(memory);
+        if (0 == session->deferred_count)
+        {
+            session_delete(session);
         }
+        return;
+    }
+
+    if (reply == session->reply_head)
+    {
+        /* ֮ǰûδɵ(Ϊջ߾Ƕ)ֱӷ */
+        session_send(session, head, head_len, body, body_len);
+        free(memory);
+
+        if (NULL != reply)
+        {
+            reply->is_done = 1;
+            reply->data = NULL;
+            reply->size = 0;
+            reply->memory = NULL;
+            session_flush(session);
+        }
+        return;
+    }
+
+    if (NULL == reply)
+    {
+        reply = (rtsp_reply_t*)malloc(sizeof(rtsp_reply_t));
+        memset(reply, 0, sizeof(*reply));
+        reply->cseq = cseq;
+        session->reply_tail->next = reply;
+        session->reply_tail = reply;
+    }
+
+    if (NULL != memory && (body_len <= 0 || (head + head_len) == body))
+    {
+        reply->data = head;
+        reply->memory = memory;
     }
     else
     {
-        while (1)
+        data = (char*)malloc(head_len + body_len);
+        memcpy(data, head, head_len);
+        if (body_len > 0)
         {
-            data = (char*)buffer_peek(buffer);
-            size = buffer_readablebytes(buffer);
+            memcpy(data + head_len, body, body_len);
+        }
+        free(memory);
+        reply->data = data;
+        reply->memory = data;
+    }
+    reply->size = head_len + body_len;
+    reply->is_done = 1;
 
-            /* ʵǰһβinterleavedϢʼֽһ 0x24 */
+    return;
+}
 
-            ch = data[0];
-            if (ch == 0x24)
-            {
-                session->is_new_request = 0;
-                session->is_interleaved_message = 1;
+static
+void do_session_reply(void *userdata)
+{
+    struct rtsp_reply_msg *msg = (struct rtsp_reply_msg*)userdata;
+    const char *data = (const char*)&msg[1];
 
-                ch = data[1];
-                interleaved_len = ntohs(*(uint16_t*)&data[2]);
-                if (size < (unsigned)(interleaved_len+4))
-                {
-                    return;
-                }
+    session_reply(msg->session, msg->cseq, data, msg->size, NULL, 0, msg);
 
-                session->interleaved_sink(session, (unsigned char)ch, &data[4], interleaved_len, session->userdata);
+    return;
+}
 
-                buffer_retrieve(buffer, (interleaved_len+4));
-                session->is_new_request = 1;
-                session->is_interleaved_message = 0;
-                continue;
+static void session_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    rtsp_session_t* session;
+
+    int parsed_bytes;
+    char* data;
+    int size;
+    uint8_t ch;
+
+    rtsp_interleaved_frame_t frames[RTSP_INTERLEAVED_BATCH];
+    int count;
+    int i;
+    int ret;
+
+    session = (rtsp_session_t*)userdata;
+
+    while (buffer_readablebytes(buffer) > 0)
+    {
+        data = (char*)buffer_peek(buffer);
+        size = buffer_readablebytes(buffer);
+
+        ch = data[0];
+        if (ch == 0x24)
+        {
+            /* һȡȫ֮֡һƳ */
+            count = rtsp_interleaved_frames_decode(data, size, frames, RTSP_INTERLEAVED_BATCH, &parsed_bytes);
+            if (count <= 0)
+            {
+                return;
+            }
+
+            session->is_in_handler = 1;
+            if (NULL != session->interleaved_batch_sink)
+            {
+                session->interleaved_batch_sink(session, frames, count, session->userdata);
             }
             else
             {
-                session->is_new_request = 0;
-                session->is_interleaved_message = 0;
-
-                /* ΪǳrtspıϢʼԽ֮ */
-                ret = rtsp_request_msg_decode(session->request_msg, data, size, &parsed_bytes);
-                if (ret == 0)
+                for (i = 0; i < count && session->is_alive; ++i)
                 {
-                    session->is_in_handler = 1;
-                    session->session_handler(session, connection, session->request_msg, session->userdata);
-                    session->is_in_handler = 0;
+                    session->interleaved_sink(session, frames[i].channel, frames[i].data, frames[i].size, session->userdata);
+                }
+            }
+            session->is_in_handler = 0;
 
-                    rtsp_request_msg_unref(session->request_msg);
-                    session->request_msg = NULL;
-                    buffer_retrieve(buffer, parsed_bytes);
+            buffer_retrieve(buffer, parsed_bytes);
+            if (0 == session->is_alive)
+            {
+                session_close(session);
+                return;
+            }
 
-                    if (0 == session->is_alive)
-                    {
-                        session_delete(session);
+            continue;
+        }
 
-                        break;
-                    }
+        /* ΪǳrtspıϢʼԽ֮
+         * ӳٴ󲻻Ľˮ߷ڴ handler
+         */
+        ret = rtsp_request_slice_decode(&session->request, data, size, &parsed_bytes);
+        if (ret == 0)
+        {
+            session->is_in_handler = 1;
+            session->session_handler(session, connection, &session->request, session->userdata);
+            session->is_in_handler = 0;
 
-                    session->request_msg = rtsp_request_msg_new();
-                    session->is_new_request = 1;
-                    continue;
-                }
-                else if (ret > 0)
-                {
-                    /* нûгݲ޷ؼ */
-                    return;
-                }
-                else
-                {
-                    /* ΪǷϢ */
-                    session->is_in_handler = 1;
-                    session->session_handler(session, NULL, NULL, session->userdata);
-                    session->is_in_handler = 0;
-
-                    if (0 == session->is_alive)
-                    {
-                        session_delete(session);
-                    }
-                    
-                    return;
-                }
+            /* Ϣеĸ slice ָ bufferֻڻص֮Ƴ */
+            buffer_retrieve(buffer, parsed_bytes);
+            rtsp_request_slice_reset(&session->request);
+
+            if (0 == session->is_alive)
+            {
+                session_close(session);
+                return;
             }
         }
+        else if (ret > 0)
+        {
+            /* нûгݲ޷ؼ */
+            return;
+        }
+        else
+        {
+            /* ΪǷϢ */
+            rtsp_request_slice_reset(&session->request);
+            session->is_in_handler = 1;
+            session->session_handler(session, NULL, NULL, session->userdata);
+            session->is_in_handler = 0;
+            
+            if (0 == session->is_alive)
+            {
+                session_close(session);
+            }
+            
+            return;
+        }
     }
 
     return;
@@ -233,43 +402,77 @@ static void session_onclose(tcp_connection_t* connection, void* userdata)
 
     if (0 == session->is_alive)
     {
-        session_delete(session);
+        session_close(session);
     }
 
     return;
 }
 
-rtsp_session_t* rtsp_session_start
+/*  slice תΪ rtsp_request_msg_t ֮󽻸ɰ汾 handler */
+static
+void session_msg_handler
+(
+    rtsp_session_t* session, 
+    tcp_connection_t* connection, 
+    rtsp_request_slice_t *request, 
+    void *userdata
+)
+{
+    rtsp_request_msg_t *request_msg;
+
+    if (NULL == request)
+    {
+        session->msg_handler(session, connection, NULL, userdata);
+        return;
+    }
+
+    request_msg = rtsp_request_slice_to_msg(request);
+    session->msg_handler(session, connection, request_msg, userdata);
+    rtsp_request_msg_unref(request_msg);
+
+    return;
+}
+
+static
+rtsp_session_t* session_start
 (
     tcp_connection_t *connection, 
     rtsp_session_handler_f session_handler, 
+    rtsp_session_msg_handler_f msg_handler, 
     rtsp_session_interleaved_packet_f interleaved_sink, 
     void* userdata
 )
 {
     rtsp_session_t* session;
 
-    if (NULL == connection || NULL == session_handler || NULL == interleaved_sink)
+    session = (rtsp_session_t*)malloc(sizeof(rtsp_session_t));
+
+    memset(session, 0, sizeof(*session));
+    if (0 != session_generate_id(session))
     {
-        log_error("rtsp_session_start: bad connection(%p) or bad session_handler(%p) or bad interleaved_sink(%p)", 
-            connection, session_handler, interleaved_sink);
+        log_error("session_start: failed to generate session id");
+        free(session);
         return NULL;
     }
 
-    session = (rtsp_session_t*)malloc(sizeof(rtsp_session_t));
-
-    memset(session, 0, sizeof(*session));
     tcp_connection_setcalback(connection, session_ondata, session_onclose, session);
     session->connection = connection;
+    session->loop = tcp_connection_getloop(connection);
     
     session->session_handler = session_handler;
+    session->msg_handler = msg_handler;
     session->interleaved_sink = interleaved_sink;
     session->userdata = userdata;
 
-    session->request_msg = rtsp_request_msg_new();
+    rtsp_request_slice_init(&session->request, session->heads, RTSP_SESSION_MAX_HEADS);
+
+    session->timeout = RTSP_SESSION_DEFAULT_TIMEOUT;
+    session->release_callback = NULL;
+    session->release_userdata = NULL;
 
-    session->is_new_request = 1;
-    session->is_interleaved_message = 0;
+    session->reply_head = NULL;
+    session->reply_tail = NULL;
+    session->deferred_count = 0;
 
     memset(session->context_data, 0, sizeof(session->context_data));
     session->extra_userdata = NULL;
@@ -283,6 +486,42 @@ rtsp_session_t* rtsp_session_start
     return session;
 }
 
+rtsp_session_t* rtsp_session_start
+(
+    tcp_connection_t *connection, 
+    rtsp_session_handler_f session_handler, 
+    rtsp_session_interleaved_packet_f interleaved_sink, 
+    void* userdata
+)
+{
+    if (NULL == connection || NULL == session_handler || NULL == interleaved_sink)
+    {
+        log_error("rtsp_session_start: bad connection(%p) or bad session_handler(%p) or bad interleaved_sink(%p)", 
+            connection, session_handler, interleaved_sink);
+        return NULL;
+    }
+
+    return session_start(connection, session_handler, NULL, interleaved_sink, userdata);
+}
+
+rtsp_session_t* rtsp_session_start_msg
+(
+    tcp_connection_t *connection, 
+    rtsp_session_msg_handler_f session_handler, 
+    rtsp_session_interleaved_packet_f interleaved_sink, 
+    void* userdata
+)
+{
+    if (NULL == connection || NULL == session_handler || NULL == interleaved_sink)
+    {
+        log_error("rtsp_session_start_msg: bad connection(%p) or bad session_handler(%p) or bad interleaved_sink(%p)", 
+            connection, session_handler, interleaved_sink);
+        return NULL;
+    }
+
+    return session_start(connection, session_msg_handler, session_handler, interleaved_sink, userdata);
+}
+
 void rtsp_session_end(rtsp_session_t* session)
 {
     if (NULL == session)
@@ -296,7 +535,175 @@ void rtsp_session_end(rtsp_session_t* session)
     }
     else
     {
-        session_delete(session);
+        session_close(session);
+    }
+
+    return;
+}
+
+int rtsp_session_defer_reply(rtsp_session_t* session)
+{
+    rtsp_reply_t *reply;
+
+    if (NULL == session || 0 == session->is_in_handler || RTSP_METHOD_NONE == session->request.method)
+    {
+        log_error("rtsp_session_defer_reply: bad session(%p) or not in request handler", session);
+        return -1;
+    }
+
+    reply = (rtsp_reply_t*)malloc(sizeof(rtsp_reply_t));
+    memset(reply, 0, sizeof(*reply));
+    reply->cseq = session->request.cseq;
+    reply->is_done = 0;
+
+    if (NULL == session->reply_tail)
+    {
+        session->reply_head = reply;
+    }
+    else
+    {
+        session->reply_tail->next = reply;
+    }
+    session->reply_tail = reply;
+    session->deferred_count++;
+
+    return 0;
+}
+
+int rtsp_session_send_message(rtsp_session_t* session, const rtsp_msg_builder_t *builder)
+{
+    struct rtsp_reply_msg *msg;
+    char *data;
+
+    if (NULL == session || NULL == builder || builder->overflow || builder->len <= 0)
+    {
+        log_error("rtsp_session_send_message: bad session(%p) or bad builder(%p)", session, builder);
+        return -1;
+    }
+
+    if (loop_inloopthread(session->loop))
+    {
+        session_reply(session, builder->cseq, builder->data, builder->len, builder->body, builder->body_len, NULL);
+    }
+    else
+    {
+        /* builder ڴڷ֮󼴲Ч֮Ͷݵ loop ߳ */
+        msg = (struct rtsp_reply_msg*)malloc(sizeof(struct rtsp_reply_msg) + builder->len + builder->body_len);
+        msg->session = session;
+        msg->cseq = builder->cseq;
+        msg->size = builder->len + builder->body_len;
+        data = (char*)&msg[1];
+        memcpy(data, builder->data, builder->len);
+        if (NULL != builder->body && builder->body_len > 0)
+        {
+            memcpy(data + builder->len, builder->body, builder->body_len);
+        }
+
+        loop_run_inloop(session->loop, do_session_reply, msg);
+    }
+
+    return 0;
+}
+
+void rtsp_session_set_interleaved_batch_sink(rtsp_session_t* session, rtsp_session_interleaved_batch_f batch_sink)
+{
+    if (NULL != session)
+    {
+        session->interleaved_batch_sink = batch_sink;
+    }
+
+    return;
+}
+
+int rtsp_session_send_interleaved(rtsp_session_t* session, unsigned char channel, const void *packet, unsigned short size)
+{
+    tcp_connection_t *connection;
+    unsigned char head[4];
+    #ifndef WIN32
+    struct iovec vecs[2];
+    #endif
+
+    if (NULL == session || NULL == packet || 0 == size)
+    {
+        log_error("rtsp_session_send_interleaved: bad session(%p) or bad packet(%p) or bad size(%u)", session, packet, size);
+        return -1;
+    }
+
+    connection = session->connection;
+    if (NULL == connection)
+    {
+        return -1;
+    }
+
+    rtsp_interleaved_head_encode(head, channel, size);
+
+    #ifdef WIN32
+    tcp_connection_send(connection, head, 4);
+    tcp_connection_send(connection, packet, size);
+    #else
+    vecs[0].iov_base = head;
+    vecs[0].iov_len = 4;
+    vecs[1].iov_base = (void*)packet;
+    vecs[1].iov_len = size;
+    tcp_connection_sendv(connection, vecs, 2);
+    #endif
+
+    return 0;
+}
+
+const char* rtsp_session_get_id(rtsp_session_t* session)
+{
+    return (NULL == session) ? NULL : session->id;
+}
+
+int rtsp_session_renew_id(rtsp_session_t* session)
+{
+    if (NULL == session)
+    {
+        log_error("rtsp_session_renew_id: bad session");
+        return -1;
+    }
+
+    return session_generate_id(session);
+}
+
+void rtsp_session_set_timeout(rtsp_session_t* session, unsigned timeout)
+{
+    if (NULL != session && timeout > 0)
+    {
+        session->timeout = timeout;
+    }
+
+    return;
+}
+
+unsigned rtsp_session_get_timeout(rtsp_session_t* session)
+{
+    return (NULL == session) ? 0 : session->timeout;
+}
+
+void rtsp_session_head(rtsp_session_t* session, rtsp_msg_builder_t *builder)
+{
+    char value[RTSP_SESSION_ID_LEN + 32];
+    int len;
+
+    if (NULL == session || NULL == builder)
+    {
+        return;
+    }
+
+    len = snprintf(value, sizeof(value), "%s;timeout=%u", session->id, session->timeout);
+    rtsp_msg_builder_head(builder, RTSP_HEAD_SESSION, value, len);
+
+    return;
+}
+
+void rtsp_session_set_release_callback(rtsp_session_t* session, rtsp_session_release_f callback, void *userdata)
+{
+    if (NULL != session)
+    {
+        session->release_callback = callback;
+        session->release_userdata = userdata;
     }
 
     return;
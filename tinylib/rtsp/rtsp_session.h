@@ -12,10 +12,27 @@ typedef struct rtsp_session rtsp_session_t;
 extern "C" {
 #endif
 
-/* Ự½ӶϿʱ request_msg ΪNULL, ʹ tcp_connection_connected() 
- * request_msgӦϢ
+/* Session-ID Ϊ session ʱɵ16ʮַ */
+#define RTSP_SESSION_ID_LEN 16
+
+/* Ự½ӶϿʱ request ΪNULL, ʹ tcp_connection_connected() 
+ * requestӦϢе url/head/body ֱָӵĽջֻڻصڼЧ
+ * ص֮ʹõݣп
+ * ڻصӦʱ rtsp_session_defer_reply() ֮󼴿ɷ
+ *
+ * ע: request ԭΪ rtsp_request_msg_t*ָΪ rtsp_request_slice_t*ɵ handler ݣ
+ * ɴɸ rtsp_session_start_msg()޸ļɼʹ rtsp_request_msg_t
  */
 typedef void (*rtsp_session_handler_f)
+(
+    rtsp_session_t* session, 
+    tcp_connection_t* connection, 
+    rtsp_request_slice_t *request, 
+    void *userdata
+);
+
+/* ɰ汾 handlerrequest_msg  session ڻصǰص֮ͷţҪʱ rtsp_request_msg_ref() */
+typedef void (*rtsp_session_msg_handler_f)
 (
     rtsp_session_t* session, 
     tcp_connection_t* connection, 
@@ -23,6 +40,9 @@ typedef void (*rtsp_session_handler_f)
     void *userdata
 );
 
+/* session ͷʱ֪ͨ rtsp_server ȹߵǼ/ע session ʹ */
+typedef void (*rtsp_session_release_f)(rtsp_session_t* session, void *userdata);
+
 typedef void (*rtsp_session_interleaved_packet_f)
 (
     rtsp_session_t* session, 
@@ -31,6 +51,14 @@ typedef void (*rtsp_session_interleaved_packet_f)
     void *userdata
 );
 
+/* һյȫ interleaved ֡frames еָջֻڻصڼЧ */
+typedef void (*rtsp_session_interleaved_batch_f)
+(
+    rtsp_session_t* session, 
+    const rtsp_interleaved_frame_t *frames, int count,
+    void *userdata
+);
+
 rtsp_session_t* rtsp_session_start
 (
     tcp_connection_t *connection, 
@@ -39,6 +67,53 @@ rtsp_session_t* rtsp_session_start
     void* userdata
 );
 
+/* ͬ rtsp_session_start()handler Ϊɰ汾ʽÿҪ䲢һ rtsp_request_msg_t */
+rtsp_session_t* rtsp_session_start_msg
+(
+    tcp_connection_t *connection, 
+    rtsp_session_msg_handler_f session_handler, 
+    rtsp_session_interleaved_packet_f interleaved_sink, 
+    void* userdata
+);
+
+/*  session_handler еãʾǰڻص֮Ӧ(赽߳вѯýϢ)
+ * ֮ճ handlerӦڸӦ֮󷢳Ա֤Ӧ˳һ
+ * ӳٵԶӦ CSeq Ӧɣsession ȫ֮ǰᱻͷ
+ */
+int rtsp_session_defer_reply(rtsp_session_t* session);
+
+/*  builder Ϣ builder е CSeq ӳٵƥ䣬ǰδɵʱŶӵȴ
+ * head  body һ writev ύbody ƴӿ
+ * ߳еã loop ֻ֮߳ӳٵ
+ * 0ʾɹύbuilder ڴ治ʱ-1
+ */
+int rtsp_session_send_message(rtsp_session_t* session, const rtsp_msg_builder_t *builder);
+
+/* ֮ interleaved ֡Ϊ batch_sink interleaved_sinkΪNULLʱָ
+ * batch_sink  userdata  interleaved_sink ͬrtsp_server  session ʹ rtsp_server_set_interleaved_batch_sink()
+ */
+void rtsp_session_set_interleaved_batch_sink(rtsp_session_t* session, rtsp_session_interleaved_batch_f batch_sink);
+
+/*  interleaved ֡һ RTP/RTCP 4ֽͷ packet һ writev ύpacket ƴӿ
+ * ߳Ҫ tcp_connection_send() ͬsession ѽʱ-1
+ */
+int rtsp_session_send_interleaved(rtsp_session_t* session, unsigned char channel, const void *packet, unsigned short size);
+
+const char* rtsp_session_get_id(rtsp_session_t* session);
+
+/*  Session-IDֻ id ֪ͻ֮ǰã rtsp_server Ǽʱ id ظʧʱ-1 */
+int rtsp_session_renew_id(rtsp_session_t* session);
+
+/* session ĳʱʱ(s)Ĭ60s rtsp_session_head() ֪ͻˣrtsp_server ݴ˻ղ session */
+void rtsp_session_set_timeout(rtsp_session_t* session, unsigned timeout);
+unsigned rtsp_session_get_timeout(rtsp_session_t* session);
+
+/*  builder д "Session: <id>;timeout=<timeout>" SETUP Ӧ */
+void rtsp_session_head(rtsp_session_t* session, rtsp_msg_builder_t *builder);
+
+/*  session ͷʱ֪ͨͬһʱֻһrtsp_server  session  server ռ */
+void rtsp_session_set_release_callback(rtsp_session_t* session, rtsp_session_release_f callback, void *userdata);
+
 void rtsp_session_set_extra_userdata(rtsp_session_t* session, void *userdata);
 void* rtsp_session_get_extra_userdata(rtsp_session_t* session);
 
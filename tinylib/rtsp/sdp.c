@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_RTSP
+
 #include "tinylib/rtsp/sdp.h"
 #include "tinylib/util/log.h"
 
@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_SSL
+
 #include "tinylib/ssl/dtls_endpoint.h"
 #include "tinylib/util/log.h"
 
@@ -107,22 +109,14 @@ void dtls_endoint_onevent(SOCKET fd, int event, void* userdata)
             dtls_endoint->handshakecb(dtls_endoint, 1, dtls_endoint->userdata);
             dtls_endoint->is_in_callback = 0;
             
-          #if 1
             {
+                /* 协商了 use_srtp 时，可在 handshakecb 中以 srtp_engine_new_from_ssl(dtls_endoint_getssl()) 导出 SRTP 密钥 */
                 SRTP_PROTECTION_PROFILE *srtp_profile = SSL_get_selected_srtp_profile(dtls_endoint->ssl);
                 if (srtp_profile)
                 {
-                    SSL_SESSION *ssl_sess = SSL_get_session(dtls_endoint->ssl);
-                    printf("=== ssl master key: 0x");
-                    for (int i = 0; i < ssl_sess->master_key_length; ++i)
-                    {
-                        printf("%X", ssl_sess->master_key[i]);
-                    }
-                    printf(" ===\n");
-                    printf("=== selected srtp profile, id: %lu, name: %s ===\n", srtp_profile->id, srtp_profile->name);
+                    log_info("dtls_endoint_onevent: selected srtp profile, id: %lu, name: %s", srtp_profile->id, srtp_profile->name);
                 }
             }
-          #endif
         }
         else if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
         {
@@ -352,7 +346,7 @@ int dtls_endoint_enable_srtp(dtls_endoint_t* dtls_endoint)
     ssl_ret  = SSL_set_tlsext_use_srtp(dtls_endoint->ssl, srtp_profiles);
     if (ssl_ret != 0)
     {
-        printf("SSL_set_tlsext_use_srtp() failed, ret: %d\n", ssl_ret);
+        log_error("dtls_endoint_enable_srtp: SSL_set_tlsext_use_srtp() failed, ret: %d", ssl_ret);
         return -1;
     }
 
@@ -464,3 +458,14 @@ int dtls_endoint_send(dtls_endoint_t* dtls_endoint, const void *packet, unsigned
 
     return 0;
 }
+
+SSL* dtls_endoint_getssl(dtls_endoint_t* dtls_endoint)
+{
+    if (NULL == dtls_endoint)
+    {
+        log_error("dtls_endoint_getssl: bad dtls_endoint(%p)", dtls_endoint);
+        return NULL;
+    }
+
+    return dtls_endoint->ssl;
+}
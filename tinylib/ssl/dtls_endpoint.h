@@ -14,6 +14,8 @@ enum dtls_endpoint_mode {
 
 #include "tinylib/linux/net/loop.h"
 
+#include <openssl/ssl.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -48,6 +50,9 @@ int dtls_endoint_start(dtls_endoint_t* dtls_endoint);
 
 int dtls_endoint_send(dtls_endoint_t* dtls_endoint, const void *packet, unsigned size);
 
+/* 握手完成之后可以此创建 srtp_engine，见 srtp_engine_new_from_ssl() */
+SSL* dtls_endoint_getssl(dtls_endoint_t* dtls_endoint);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,1017 @@
+
+#define LOG_MODULE LOG_MODULE_SSL
+
+#include "tinylib/ssl/dtls_server.h"
+#include "tinylib/net/udp_peer.h"
+#include "tinylib/util/log.h"
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+enum dtls_session_state
+{
+    DTLS_SESSION_STATE_LISTEN,
+    DTLS_SESSION_STATE_HANDSHAKE,
+    DTLS_SESSION_STATE_ESTABLISHED,
+    DTLS_SESSION_STATE_CLOSED,
+};
+
+/* 哈希桶的初始个数，会话数超过桶数时加倍 */
+#define DTLS_SERVER_INITIAL_BUCKETS 64
+
+/* IPv4 与 UDP 头的尺寸 */
+#define DTLS_SERVER_MTU_OVERHEAD 28
+
+#define DTLS_COOKIE_SECRET_SIZE 32
+
+/* cookie 的时间段(ms)，只接受当前及上一时间段生成的 cookie，即一个 cookie 最多有效两个时间段 */
+#define DTLS_COOKIE_EPOCH_MS 60000
+
+struct dtls_session
+{
+    dtls_server_t *server;
+    inetaddr_t peer_addr;
+    struct sockaddr_in sockaddr;
+    unsigned hash;
+
+    SSL *ssl;
+    enum dtls_session_state state;
+    loop_timer_t *retransmit_timer;
+    loop_timer_t *handshake_timer;
+
+    dtls_session_on_message_f messagecb;
+    dtls_session_on_raw_f rawcb;
+    dtls_session_on_close_f closecb;
+    void *userdata;
+
+    int is_in_callback;
+    int is_alive;
+
+    struct dtls_session *next;  /* 同一哈希桶中的下一个会话 */
+};
+
+struct dtls_server
+{
+    loop_t *loop;
+    udp_peer_t *udp_peer;
+    unsigned short port;
+
+    SSL_CTX *ssl_ctx;
+    BIO_METHOD *bio_method;
+    BIO_ADDR *listen_addr;
+    unsigned char cookie_secret[DTLS_COOKIE_SECRET_SIZE];
+
+    dtls_server_on_session_f onsession;
+    void *userdata;
+
+    unsigned handshake_timeout;
+    unsigned mtu;
+
+    dtls_session_t **buckets;
+    unsigned bucket_count;
+    unsigned session_count;
+
+    /* 用于 DTLSv1_listen() 的会话，cookie 校验通过之后即转为正式会话，再另建一个 */
+    dtls_session_t *listener;
+
+    /* 正在处理的报文，只供 in_session 的 BIO 读取一次 */
+    dtls_session_t *in_session;
+    const unsigned char *in_data;
+    unsigned in_size;
+
+    /* 全部会话共用的解密缓冲区 */
+    unsigned char packet[65535];
+
+    int is_in_callback;
+    int is_alive;
+};
+
+static
+unsigned hash_addr(const inetaddr_t *addr)
+{
+    const unsigned char *p = (const unsigned char*)addr->ip;
+    unsigned hash = 2166136261u;
+
+    while (*p != '\0')
+    {
+        hash = (hash ^ *p++) * 16777619u;
+    }
+    hash = (hash ^ (addr->port & 0xff)) * 16777619u;
+    hash = (hash ^ (addr->port >> 8)) * 16777619u;
+
+    return hash;
+}
+
+static
+dtls_session_t* find_session(dtls_server_t *server, const inetaddr_t *addr)
+{
+    dtls_session_t *session;
+    unsigned hash = hash_addr(addr);
+
+    session = server->buckets[hash & (server->bucket_count - 1)];
+    while (NULL != session)
+    {
+        if (session->hash == hash && session->peer_addr.port == addr->port && strcmp(session->peer_addr.ip, addr->ip) == 0)
+        {
+            break;
+        }
+        session = session->next;
+    }
+
+    return session;
+}
+
+static
+void grow_buckets(dtls_server_t *server)
+{
+    dtls_session_t **buckets;
+    dtls_session_t *session;
+    unsigned bucket_count;
+    unsigned i;
+
+    bucket_count = server->bucket_count * 2;
+    buckets = (dtls_session_t**)malloc(sizeof(dtls_session_t*) * bucket_count);
+    memset(buckets, 0, sizeof(dtls_session_t*) * bucket_count);
+
+    for (i = 0; i < server->bucket_count; ++i)
+    {
+        while (NULL != server->buckets[i])
+        {
+            session = server->buckets[i];
+            server->buckets[i] = session->next;
+            session->next = buckets[session->hash & (bucket_count - 1)];
+            buckets[session->hash & (bucket_count - 1)] = session;
+        }
+    }
+
+    free(server->buckets);
+    server->buckets = buckets;
+    server->bucket_count = bucket_count;
+
+    return;
+}
+
+static
+void link_session(dtls_server_t *server, dtls_session_t *session)
+{
+    unsigned index;
+
+    if (server->session_count >= server->bucket_count)
+    {
+        grow_buckets(server);
+    }
+
+    index = session->hash & (server->bucket_count - 1);
+    session->next = server->buckets[index];
+    server->buckets[index] = session;
+    server->session_count++;
+
+    return;
+}
+
+static
+void unlink_session(dtls_server_t *server, dtls_session_t *session)
+{
+    dtls_session_t **link;
+
+    link = &server->buckets[session->hash & (server->bucket_count - 1)];
+    while (NULL != *link)
+    {
+        if (*link == session)
+        {
+            *link = session->next;
+            server->session_count--;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    session->next = NULL;
+
+    return;
+}
+
+static
+void cancel_timers(dtls_session_t *session)
+{
+    if (NULL != session->retransmit_timer)
+    {
+        loop_cancel(session->server->loop, session->retransmit_timer);
+        session->retransmit_timer = NULL;
+    }
+    if (NULL != session->handshake_timer)
+    {
+        loop_cancel(session->server->loop, session->handshake_timer);
+        session->handshake_timer = NULL;
+    }
+
+    return;
+}
+
+static
+void delete_session(dtls_session_t *session, int send_close_notify)
+{
+    dtls_server_t *server = session->server;
+
+    if (session->state == DTLS_SESSION_STATE_ESTABLISHED && send_close_notify)
+    {
+        SSL_shutdown(session->ssl);
+    }
+
+    if (session->state != DTLS_SESSION_STATE_LISTEN)
+    {
+        unlink_session(server, session);
+    }
+    cancel_timers(session);
+    if (server->in_session == session)
+    {
+        server->in_session = NULL;
+    }
+
+    SSL_free(session->ssl);
+    free(session);
+
+    return;
+}
+
+/* BIO 只读取当前报文，写出的每个记录各自作为一个UDP报文发给会话的对端 */
+static
+int session_bio_write(BIO *bio, const char *data, int size)
+{
+    dtls_session_t *session = (dtls_session_t*)BIO_get_data(bio);
+
+    BIO_clear_retry_flags(bio);
+
+    /* 发送失败与报文在途中丢失一样，由 DTLS 的重传处理 */
+    udp_peer_send2(session->server->udp_peer, data, (unsigned)size, &session->sockaddr);
+
+    return size;
+}
+
+static
+int session_bio_read(BIO *bio, char *data, int size)
+{
+    dtls_session_t *session = (dtls_session_t*)BIO_get_data(bio);
+    dtls_server_t *server = session->server;
+
+    BIO_clear_retry_flags(bio);
+    if (server->in_session != session || NULL == server->in_data)
+    {
+        BIO_set_retry_read(bio);
+        return -1;
+    }
+
+    if ((unsigned)size > server->in_size)
+    {
+        size = (int)server->in_size;
+    }
+    memcpy(data, server->in_data, size);
+    server->in_data = NULL;
+    server->in_size = 0;
+
+    return size;
+}
+
+static
+long session_bio_ctrl(BIO *bio, int cmd, long num, void *ptr)
+{
+    long ret;
+
+    switch (cmd)
+    {
+        case BIO_CTRL_FLUSH:
+        case BIO_CTRL_DUP:
+        {
+            ret = 1;
+            break;
+        }
+        case BIO_CTRL_DGRAM_GET_MTU_OVERHEAD:
+        {
+            ret = DTLS_SERVER_MTU_OVERHEAD;
+            break;
+        }
+        default:
+        {
+            ret = 0;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+static
+int session_bio_destroy(BIO *bio)
+{
+    BIO_set_data(bio, NULL);
+    BIO_set_init(bio, 0);
+    return 1;
+}
+
+static inline
+unsigned long long cookie_epoch(SSL *ssl)
+{
+    dtls_session_t *session = (dtls_session_t*)SSL_get_app_data(ssl);
+
+    return loop_now_ms(session->server->loop) / DTLS_COOKIE_EPOCH_MS;
+}
+
+/* cookie 为 HMAC(secret, 源地址 + 时间段)，服务端无需为尚未通过校验的对端保存任何状态，
+ * 截获的 cookie 也只在有限的时间内有效
+ */
+static
+int make_cookie(SSL *ssl, unsigned long long epoch, unsigned char *cookie, unsigned *cookie_len)
+{
+    dtls_session_t *session = (dtls_session_t*)SSL_get_app_data(ssl);
+    dtls_server_t *server = session->server;
+    unsigned char input[14];
+    int i;
+
+    memcpy(input, &session->sockaddr.sin_addr.s_addr, 4);
+    memcpy(input + 4, &session->sockaddr.sin_port, 2);
+    for (i = 0; i < 8; ++i)
+    {
+        input[6 + i] = (unsigned char)(epoch >> (56 - 8 * i));
+    }
+
+    if (NULL == HMAC(EVP_sha256(), server->cookie_secret, sizeof(server->cookie_secret), input, sizeof(input), cookie, cookie_len))
+    {
+        return 0;
+    }
+
+    return 1;
+}
+
+static
+int generate_cookie(SSL *ssl, unsigned char *cookie, unsigned *cookie_len)
+{
+    return make_cookie(ssl, cookie_epoch(ssl), cookie, cookie_len);
+}
+
+static
+int verify_cookie(SSL *ssl, const unsigned char *cookie, unsigned cookie_len)
+{
+    unsigned char expected[EVP_MAX_MD_SIZE];
+    unsigned expected_len;
+    unsigned long long epoch;
+    int i;
+
+    /* 时间段的边界附近生成的 cookie 也应通过，故同时接受上一时间段 */
+    epoch = cookie_epoch(ssl);
+    for (i = 0; i < 2; ++i)
+    {
+        expected_len = 0;
+        if (make_cookie(ssl, epoch - i, expected, &expected_len) != 0 && expected_len == cookie_len
+            && CRYPTO_memcmp(expected, cookie, cookie_len) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static
+dtls_session_t* new_session(dtls_server_t *server)
+{
+    dtls_session_t *session;
+    SSL *ssl;
+    BIO *bio;
+
+    ssl = SSL_new(server->ssl_ctx);
+    if (NULL == ssl)
+    {
+        log_error("new_session: SSL_new() failed, ssl error: %lu", ERR_get_error());
+        return NULL;
+    }
+    bio = BIO_new(server->bio_method);
+    if (NULL == bio)
+    {
+        log_error("new_session: BIO_new() failed, ssl error: %lu", ERR_get_error());
+        SSL_free(ssl);
+        return NULL;
+    }
+
+    session = (dtls_session_t*)malloc(sizeof(*session));
+    memset(session, 0, sizeof(*session));
+    session->server = server;
+    session->ssl = ssl;
+    session->state = DTLS_SESSION_STATE_LISTEN;
+    session->is_in_callback = 0;
+    session->is_alive = 1;
+
+    BIO_set_data(bio, session);
+    BIO_set_init(bio, 1);
+    SSL_set_bio(ssl, bio, bio);
+    SSL_set_app_data(ssl, session);
+
+    SSL_set_options(ssl, SSL_OP_COOKIE_EXCHANGE | SSL_OP_NO_QUERY_MTU);
+    DTLS_set_link_mtu(ssl, server->mtu);
+    SSL_set_accept_state(ssl);
+
+    return session;
+}
+
+static void session_onretransmit(void *userdata);
+
+static
+void schedule_retransmit(dtls_session_t *session)
+{
+    struct timeval tv;
+    unsigned interval;
+
+    if (NULL != session->retransmit_timer)
+    {
+        loop_cancel(session->server->loop, session->retransmit_timer);
+        session->retransmit_timer = NULL;
+    }
+
+    if (DTLSv1_get_timeout(session->ssl, &tv) > 0)
+    {
+        interval = (unsigned)(tv.tv_sec * 1000 + tv.tv_usec / 1000) + 1;
+        session->retransmit_timer = loop_runafter(session->server->loop, interval, session_onretransmit, session);
+    }
+
+    return;
+}
+
+static
+void session_onretransmit(void *userdata)
+{
+    dtls_session_t *session = (dtls_session_t*)userdata;
+
+    session->retransmit_timer = NULL;
+    if (DTLSv1_handle_timeout(session->ssl) < 0)
+    {
+        log_warn("session_onretransmit: dtls handshake with %s:%u failed on retransmission",
+            session->peer_addr.ip, session->peer_addr.port);
+        delete_session(session, 0);
+        return;
+    }
+    schedule_retransmit(session);
+
+    return;
+}
+
+static
+void session_onhandshaketimeout(void *userdata)
+{
+    dtls_session_t *session = (dtls_session_t*)userdata;
+
+    log_warn("session_onhandshaketimeout: dtls handshake with %s:%u was not completed in %u ms",
+        session->peer_addr.ip, session->peer_addr.port, session->server->handshake_timeout);
+
+    session->handshake_timer = NULL;
+    delete_session(session, 0);
+
+    return;
+}
+
+static
+void session_handshake(dtls_session_t *session)
+{
+    dtls_server_t *server = session->server;
+    int ssl_ret;
+    int ssl_error;
+
+    ssl_ret = SSL_do_handshake(session->ssl);
+    if (ssl_ret == 1)
+    {
+        cancel_timers(session);
+        session->state = DTLS_SESSION_STATE_ESTABLISHED;
+        log_debug("session_handshake: dtls session with %s:%u is established", session->peer_addr.ip, session->peer_addr.port);
+
+        session->is_in_callback = 1;
+        server->onsession(session, server->userdata, &session->peer_addr);
+        session->is_in_callback = 0;
+        if (0 == session->is_alive)
+        {
+            delete_session(session, 1);
+        }
+        return;
+    }
+
+    ssl_error = SSL_get_error(session->ssl, ssl_ret);
+    if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+    {
+        schedule_retransmit(session);
+        return;
+    }
+
+    log_warn("session_handshake: dtls handshake with %s:%u failed, ssl error: %d, %lu",
+        session->peer_addr.ip, session->peer_addr.port, ssl_error, ERR_get_error());
+    delete_session(session, 0);
+
+    return;
+}
+
+static
+void session_onrecord(dtls_session_t *session)
+{
+    dtls_server_t *server = session->server;
+    int ssl_ret;
+    int ssl_error;
+
+    /* 一个报文中可能有多个记录 */
+    while (session->is_alive && session->state == DTLS_SESSION_STATE_ESTABLISHED)
+    {
+        ssl_ret = SSL_read(session->ssl, server->packet, sizeof(server->packet));
+        if (ssl_ret > 0)
+        {
+            if (NULL != session->messagecb)
+            {
+                session->is_in_callback = 1;
+                session->messagecb(session, server->packet, (unsigned)ssl_ret, session->userdata);
+                session->is_in_callback = 0;
+            }
+            continue;
+        }
+
+        ssl_error = SSL_get_error(session->ssl, ssl_ret);
+        if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+        {
+            break;
+        }
+
+        if (ssl_error != SSL_ERROR_ZERO_RETURN)
+        {
+            log_warn_ratelimit(1000, "session_onrecord: ssl read error: %d, %lu, peer: %s:%u",
+                ssl_error, ERR_get_error(), session->peer_addr.ip, session->peer_addr.port);
+        }
+        session->state = DTLS_SESSION_STATE_CLOSED;
+        if (NULL != session->closecb)
+        {
+            session->is_in_callback = 1;
+            session->closecb(session, ssl_error == SSL_ERROR_ZERO_RETURN, session->userdata);
+            session->is_in_callback = 0;
+        }
+        break;
+    }
+
+    if (0 == session->is_alive)
+    {
+        delete_session(session, 0);
+    }
+
+    return;
+}
+
+/* 新对端的报文先经无状态的 cookie 校验 */
+static
+void server_onlisten(dtls_server_t *server, void *message, unsigned size, const inetaddr_t *peer_addr)
+{
+    dtls_session_t *session;
+    int ret;
+
+    if (NULL == server->listener)
+    {
+        server->listener = new_session(server);
+        if (NULL == server->listener)
+        {
+            return;
+        }
+    }
+    session = server->listener;
+
+    session->peer_addr = *peer_addr;
+    memset(&session->sockaddr, 0, sizeof(session->sockaddr));
+    session->sockaddr.sin_family = AF_INET;
+    session->sockaddr.sin_addr.s_addr = inet_addr(peer_addr->ip);
+    session->sockaddr.sin_port = htons(peer_addr->port);
+
+    server->in_session = session;
+    server->in_data = (const unsigned char*)message;
+    server->in_size = size;
+    ret = DTLSv1_listen(session->ssl, server->listen_addr);
+    server->in_session = NULL;
+    server->in_data = NULL;
+
+    if (ret == 0)
+    {
+        /* 已回复 HelloVerifyRequest，或者不是合法的 ClientHello */
+        return;
+    }
+    if (ret < 0)
+    {
+        log_warn_ratelimit(1000, "server_onlisten: DTLSv1_listen() failed for %s:%u, ssl error: %lu", peer_addr->ip, peer_addr->port, ERR_get_error());
+        server->listener = NULL;
+        delete_session(session, 0);
+        return;
+    }
+
+    /* cookie 校验通过，转为正式会话继续握手 */
+    server->listener = NULL;
+    session->hash = hash_addr(peer_addr);
+    session->state = DTLS_SESSION_STATE_HANDSHAKE;
+    link_session(server, session);
+    if (server->handshake_timeout > 0)
+    {
+        session->handshake_timer = loop_runafter(server->loop, server->handshake_timeout, session_onhandshaketimeout, session);
+    }
+
+    session_handshake(session);
+
+    return;
+}
+
+static
+void delete_server(dtls_server_t *server)
+{
+    dtls_session_t *session;
+    unsigned i;
+
+    udp_peer_destroy(server->udp_peer);
+
+    for (i = 0; i < server->bucket_count; ++i)
+    {
+        while (NULL != server->buckets[i])
+        {
+            session = server->buckets[i];
+            delete_session(session, 1);
+        }
+    }
+    if (NULL != server->listener)
+    {
+        delete_session(server->listener, 0);
+    }
+
+    free(server->buckets);
+    BIO_ADDR_free(server->listen_addr);
+    SSL_CTX_free(server->ssl_ctx);
+    BIO_meth_free(server->bio_method);
+    free(server);
+
+    return;
+}
+
+static
+void do_delete_server(void *userdata)
+{
+    delete_server((dtls_server_t*)userdata);
+    return;
+}
+
+static
+void server_onmessage(udp_peer_t *peer, void *message, unsigned size, void* userdata, const inetaddr_t *peer_addr)
+{
+    dtls_server_t *server = (dtls_server_t*)userdata;
+    dtls_session_t *session;
+    unsigned char first_byte;
+
+    if (0 == server->is_alive || 0 == size)
+    {
+        return;
+    }
+
+    first_byte = ((unsigned char*)message)[0];
+    session = find_session(server, peer_addr);
+
+    server->is_in_callback = 1;
+    if (NULL == session)
+    {
+        /* 只有握手记录(22)才可能是 ClientHello */
+        if (first_byte == 22)
+        {
+            server_onlisten(server, message, size, peer_addr);
+        }
+    }
+    else if (first_byte < 20 || first_byte > 63)
+    {
+        if (session->state == DTLS_SESSION_STATE_ESTABLISHED && NULL != session->rawcb)
+        {
+            session->is_in_callback = 1;
+            session->rawcb(session, message, size, session->userdata);
+            session->is_in_callback = 0;
+            if (0 == session->is_alive)
+            {
+                delete_session(session, 1);
+            }
+        }
+    }
+    else
+    {
+        server->in_session = session;
+        server->in_data = (const unsigned char*)message;
+        server->in_size = size;
+
+        if (session->state == DTLS_SESSION_STATE_HANDSHAKE)
+        {
+            session_handshake(session);
+        }
+        else if (session->state == DTLS_SESSION_STATE_ESTABLISHED)
+        {
+            session_onrecord(session);
+        }
+
+        server->in_session = NULL;
+        server->in_data = NULL;
+    }
+    server->is_in_callback = 0;
+
+    if (0 == server->is_alive)
+    {
+        /* udp_peer 尚在分发本批报文，推迟到下一轮再销毁 */
+        loop_async(server->loop, do_delete_server, server);
+    }
+
+    return;
+}
+
+dtls_server_t* dtls_server_new
+(
+    loop_t *loop, const char *ip, unsigned short port, const char *cert_file, const char *key_file,
+    dtls_server_on_session_f onsession, void *userdata
+)
+{
+    dtls_server_t *server;
+    SSL_CTX *ssl_ctx;
+    BIO_METHOD *bio_method;
+
+    if (NULL == loop || NULL == ip || NULL == cert_file || NULL == onsession)
+    {
+        log_error("dtls_server_new: bad loop(%p) or bad ip(%p) or bad cert_file(%p) or bad onsession(%p)",
+            loop, ip, cert_file, onsession);
+        return NULL;
+    }
+
+    ssl_ctx = SSL_CTX_new(DTLS_server_method());
+    if (NULL == ssl_ctx)
+    {
+        log_error("dtls_server_new: failed to alloc ssl context, ssl error: %lu", ERR_get_error());
+        return NULL;
+    }
+    SSL_CTX_set_min_proto_version(ssl_ctx, DTLS1_2_VERSION);
+
+    if (SSL_CTX_use_certificate_chain_file(ssl_ctx, cert_file) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ssl_ctx, (NULL != key_file ? key_file : cert_file), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ssl_ctx) != 1)
+    {
+        log_error("dtls_server_new: failed to load certificate %s or private key %s, ssl error: %lu",
+            cert_file, (NULL != key_file ? key_file : cert_file), ERR_get_error());
+        SSL_CTX_free(ssl_ctx);
+        return NULL;
+    }
+    SSL_CTX_set_cookie_generate_cb(ssl_ctx, generate_cookie);
+    SSL_CTX_set_cookie_verify_cb(ssl_ctx, verify_cookie);
+
+    bio_method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "tinylib dtls session");
+    if (NULL == bio_method)
+    {
+        log_error("dtls_server_new: failed to alloc bio method");
+        SSL_CTX_free(ssl_ctx);
+        return NULL;
+    }
+    BIO_meth_set_write(bio_method, session_bio_write);
+    BIO_meth_set_read(bio_method, session_bio_read);
+    BIO_meth_set_ctrl(bio_method, session_bio_ctrl);
+    BIO_meth_set_destroy(bio_method, session_bio_destroy);
+
+    server = (dtls_server_t*)malloc(sizeof(*server));
+    memset(server, 0, sizeof(*server));
+
+    server->loop = loop;
+    server->ssl_ctx = ssl_ctx;
+    server->bio_method = bio_method;
+    server->listen_addr = BIO_ADDR_new();
+    if (RAND_bytes(server->cookie_secret, sizeof(server->cookie_secret)) != 1)
+    {
+        log_warn("dtls_server_new: RAND_bytes() failed, ssl error: %lu", ERR_get_error());
+    }
+
+    server->onsession = onsession;
+    server->userdata = userdata;
+    server->handshake_timeout = DTLS_SERVER_DEFAULT_HANDSHAKE_TIMEOUT;
+    server->mtu = DTLS_SERVER_DEFAULT_MTU;
+
+    server->bucket_count = DTLS_SERVER_INITIAL_BUCKETS;
+    server->buckets = (dtls_session_t**)malloc(sizeof(dtls_session_t*) * server->bucket_count);
+    memset(server->buckets, 0, sizeof(dtls_session_t*) * server->bucket_count);
+    server->session_count = 0;
+    server->listener = NULL;
+
+    server->is_in_callback = 0;
+    server->is_alive = 1;
+
+    server->udp_peer = udp_peer_new(loop, ip, port, server_onmessage, NULL, server);
+    if (NULL == server->udp_peer)
+    {
+        free(server->buckets);
+        BIO_ADDR_free(server->listen_addr);
+        SSL_CTX_free(ssl_ctx);
+        BIO_meth_free(bio_method);
+        free(server);
+        return NULL;
+    }
+    server->port = udp_peer_getport(server->udp_peer);
+
+    return server;
+}
+
+static
+void do_dtls_server_destroy(void *userdata)
+{
+    dtls_server_t *server = (dtls_server_t*)userdata;
+
+    if (server->is_in_callback)
+    {
+        server->is_alive = 0;
+    }
+    else
+    {
+        delete_server(server);
+    }
+
+    return;
+}
+
+void dtls_server_destroy(dtls_server_t *server)
+{
+    if (NULL == server)
+    {
+        return;
+    }
+
+    loop_run_inloop(server->loop, do_dtls_server_destroy, server);
+
+    return;
+}
+
+unsigned short dtls_server_getport(dtls_server_t *server)
+{
+    if (NULL == server)
+    {
+        return 0;
+    }
+
+    return server->port;
+}
+
+void dtls_server_set_handshake_timeout(dtls_server_t *server, unsigned timeout)
+{
+    if (NULL == server)
+    {
+        return;
+    }
+
+    server->handshake_timeout = timeout;
+
+    return;
+}
+
+void dtls_server_set_mtu(dtls_server_t *server, unsigned mtu)
+{
+    if (NULL == server || mtu <= DTLS_SERVER_MTU_OVERHEAD)
+    {
+        log_error("dtls_server_set_mtu: bad server(%p) or bad mtu(%u)", server, mtu);
+        return;
+    }
+
+    server->mtu = mtu;
+    if (NULL != server->listener)
+    {
+        DTLS_set_link_mtu(server->listener->ssl, mtu);
+    }
+
+    return;
+}
+
+int dtls_server_set_srtp_profiles(dtls_server_t *server, const char *profiles)
+{
+    if (NULL == server || NULL == profiles)
+    {
+        log_error("dtls_server_set_srtp_profiles: bad server(%p) or bad profiles(%p)", server, profiles);
+        return -1;
+    }
+
+    /* 与多数 OpenSSL 接口相反，成功时返回0 */
+    if (SSL_CTX_set_tlsext_use_srtp(server->ssl_ctx, profiles) != 0)
+    {
+        log_error("dtls_server_set_srtp_profiles: unsupported profiles: %s", profiles);
+        return -1;
+    }
+
+    return 0;
+}
+
+SSL_CTX* dtls_server_get_ssl_ctx(dtls_server_t *server)
+{
+    if (NULL == server)
+    {
+        return NULL;
+    }
+
+    return server->ssl_ctx;
+}
+
+unsigned dtls_server_session_count(dtls_server_t *server)
+{
+    if (NULL == server)
+    {
+        return 0;
+    }
+
+    return server->session_count;
+}
+
+void dtls_session_setcallback
+(
+    dtls_session_t *session, dtls_session_on_message_f messagecb, dtls_session_on_raw_f rawcb,
+    dtls_session_on_close_f closecb, void *userdata
+)
+{
+    if (NULL == session)
+    {
+        return;
+    }
+
+    session->messagecb = messagecb;
+    session->rawcb = rawcb;
+    session->closecb = closecb;
+    session->userdata = userdata;
+
+    return;
+}
+
+int dtls_session_send(dtls_session_t *session, const void *data, unsigned size)
+{
+    int ssl_ret;
+
+    if (NULL == session || NULL == data || 0 == size)
+    {
+        log_error("dtls_session_send: bad session(%p) or bad data(%p) or bad size(%u)", session, data, size);
+        return -1;
+    }
+    if (session->state != DTLS_SESSION_STATE_ESTABLISHED)
+    {
+        log_error("dtls_session_send: bad session state: %d, session: %p", session->state, session);
+        return -1;
+    }
+
+    ssl_ret = SSL_write(session->ssl, data, (int)size);
+    if (ssl_ret <= 0)
+    {
+        log_warn("dtls_session_send: SSL_write() failed, ssl error: %d, peer: %s:%u",
+            SSL_get_error(session->ssl, ssl_ret), session->peer_addr.ip, session->peer_addr.port);
+        return -1;
+    }
+
+    return 0;
+}
+
+int dtls_session_send_raw(dtls_session_t *session, const void *packet, unsigned size)
+{
+    if (NULL == session || NULL == packet || 0 == size)
+    {
+        log_error("dtls_session_send_raw: bad session(%p) or bad packet(%p) or bad size(%u)", session, packet, size);
+        return -1;
+    }
+
+    return udp_peer_send2(session->server->udp_peer, packet, size, &session->sockaddr);
+}
+
+SSL* dtls_session_getssl(dtls_session_t *session)
+{
+    if (NULL == session)
+    {
+        return NULL;
+    }
+
+    return session->ssl;
+}
+
+const inetaddr_t* dtls_session_getpeeraddr(dtls_session_t *session)
+{
+    if (NULL == session)
+    {
+        return NULL;
+    }
+
+    return &session->peer_addr;
+}
+
+void dtls_session_destroy(dtls_session_t *session)
+{
+    if (NULL == session)
+    {
+        return;
+    }
+
+    if (session->is_in_callback)
+    {
+        session->is_alive = 0;
+    }
+    else
+    {
+        delete_session(session, 1);
+    }
+
+    return;
+}
@@ -0,0 +1,102 @@
+
+/** 在同一个UDP端口上服务多个 DTLS 对端的服务端
+  *
+  * 全部对端共用一个 udp_peer、一个 SSL_CTX 及一块解密缓冲区，按源地址在哈希表中区分各个会话
+  * 新对端的 ClientHello 先经 DTLSv1_listen() 做无状态的 cookie 校验，通过之后才建立会话，
+  * 伪造源地址的 ClientHello 只会得到一个 HelloVerifyRequest，不占用任何服务端状态；
+  * cookie 与生成时所在的时间段绑定，至多在两个时间段(2分钟)之内有效
+  *
+  * 已建立会话的对端发来的非 DTLS 报文(按 RFC 7983 首字节不在 [20, 63] 之内，如 SRTP/STUN)，
+  * 原样交给会话的 rawcb，便于 SRTP 等与 DTLS 复用同一端口
+  *
+  * 接口均只能在 loop 线程中调用
+  */
+
+#ifndef TINYLIB_SSL_DTLS_SERVER_H
+#define TINYLIB_SSL_DTLS_SERVER_H
+
+struct dtls_server;
+typedef struct dtls_server dtls_server_t;
+
+struct dtls_session;
+typedef struct dtls_session dtls_session_t;
+
+#include "tinylib/net/loop.h"
+#include "tinylib/net/inetaddr.h"
+
+#include <openssl/ssl.h>
+
+/* 默认的握手超时(ms) */
+#define DTLS_SERVER_DEFAULT_HANDSHAKE_TIMEOUT 10000
+
+/* 默认的链路 MTU(含IP及UDP头) */
+#define DTLS_SERVER_DEFAULT_MTU 1500
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 握手完成的会话，使用者需在其中以 dtls_session_setcallback() 设置回调，并负责销毁 */
+typedef void (*dtls_server_on_session_f)(dtls_session_t *session, void *userdata, const inetaddr_t *peer_addr);
+
+/* 解密之后的应用层数据，message 指向共享的缓冲区，仅在回调期间有效 */
+typedef void (*dtls_session_on_message_f)(dtls_session_t *session, void *message, unsigned size, void *userdata);
+
+/* 对端发来的非 DTLS 报文 */
+typedef void (*dtls_session_on_raw_f)(dtls_session_t *session, void *packet, unsigned size, void *userdata);
+
+/* normal 为1表示对端发来了 close_notify */
+typedef void (*dtls_session_on_close_f)(dtls_session_t *session, int normal, void *userdata);
+
+/* 证书及私钥为 PEM 格式，key_file 为NULL时从 cert_file 中读取私钥 */
+dtls_server_t* dtls_server_new
+(
+    loop_t *loop, const char *ip, unsigned short port, const char *cert_file, const char *key_file,
+    dtls_server_on_session_f onsession, void *userdata
+);
+
+/* 全部会话一并关闭 */
+void dtls_server_destroy(dtls_server_t *server);
+
+/* 实际监听的端口，port 为0时由系统分配 */
+unsigned short dtls_server_getport(dtls_server_t *server);
+
+/* 设置握手超时(ms)，为0时不限时 */
+void dtls_server_set_handshake_timeout(dtls_server_t *server, unsigned timeout);
+
+/* 设置链路 MTU，只影响之后建立的会话 */
+void dtls_server_set_mtu(dtls_server_t *server, unsigned mtu);
+
+/* 协商 SRTP 保护方案(use_srtp 扩展)，如 "SRTP_AES128_CM_SHA1_80:SRTP_AEAD_AES_128_GCM" */
+int dtls_server_set_srtp_profiles(dtls_server_t *server, const char *profiles);
+
+/* 全部会话共用的 SSL_CTX，可用于设置校验对端证书等更多选项 */
+SSL_CTX* dtls_server_get_ssl_ctx(dtls_server_t *server);
+
+/* 当前的会话个数，含尚在握手中的 */
+unsigned dtls_server_session_count(dtls_server_t *server);
+
+void dtls_session_setcallback
+(
+    dtls_session_t *session, dtls_session_on_message_f messagecb, dtls_session_on_raw_f rawcb,
+    dtls_session_on_close_f closecb, void *userdata
+);
+
+/* 加密之后作为一个报文发出，size 不能超过 MTU 所能容纳的尺寸 */
+int dtls_session_send(dtls_session_t *session, const void *data, unsigned size);
+
+/* 不经加密直接发给对端，如 SRTP 报文 */
+int dtls_session_send_raw(dtls_session_t *session, const void *packet, unsigned size);
+
+SSL* dtls_session_getssl(dtls_session_t *session);
+
+const inetaddr_t* dtls_session_getpeeraddr(dtls_session_t *session);
+
+/* 发出 close_notify 之后销毁会话 */
+void dtls_session_destroy(dtls_session_t *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_SSL_DTLS_SERVER_H */
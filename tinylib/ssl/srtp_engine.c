@@ -0,0 +1,1074 @@
+
+#define LOG_MODULE LOG_MODULE_SSL
+
+#include "tinylib/ssl/srtp_engine.h"
+#include "tinylib/util/log.h"
+
+#include <openssl/evp.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  #include <openssl/core_names.h>
+#else
+  #include <openssl/hmac.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+/* RFC 3711 4.3.2 的密钥派生标签 */
+#define SRTP_LABEL_RTP_ENCRYPTION 0x00
+#define SRTP_LABEL_RTP_AUTH 0x01
+#define SRTP_LABEL_RTP_SALT 0x02
+#define SRTP_LABEL_RTCP_ENCRYPTION 0x03
+
+#define SRTP_MAX_KEY_LEN 32
+#define SRTP_MAX_SALT_LEN 14
+#define SRTP_AUTH_KEY_LEN 20
+#define SRTP_HMAC_SHA1_LEN 20
+#define SRTP_AEAD_TAG_LEN 16
+#define SRTCP_INDEX_LEN 4
+#define SRTCP_E_FLAG 0x80000000u
+
+#define SRTP_REPLAY_WINDOW 64
+
+typedef struct srtp_profile_params
+{
+    unsigned long id;
+    unsigned key_len;
+    unsigned salt_len;
+    unsigned rtp_tag_len;
+    unsigned rtcp_tag_len;
+    int is_aead;
+}srtp_profile_params_t;
+
+static const srtp_profile_params_t g_profiles[] =
+{
+    {SRTP_AES128_CM_SHA1_80, 16, 14, 10, 10, 0},
+    {SRTP_AES128_CM_SHA1_32, 16, 14, 4, 10, 0},   /* SRTCP 仍使用80位的标签(RFC 5764 4.1.2) */
+    {SRTP_AEAD_AES_128_GCM, 16, 12, SRTP_AEAD_TAG_LEN, SRTP_AEAD_TAG_LEN, 1},
+    {SRTP_AEAD_AES_256_GCM, 32, 12, SRTP_AEAD_TAG_LEN, SRTP_AEAD_TAG_LEN, 1},
+};
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+typedef EVP_MAC_CTX srtp_mac_t;
+#else
+typedef HMAC_CTX srtp_mac_t;
+#endif
+
+/* 某一方向上 RTP 或 RTCP 的会话密钥 */
+typedef struct srtp_crypto
+{
+    EVP_CIPHER_CTX *cipher;
+    srtp_mac_t *mac;    /* AEAD 时为NULL */
+    unsigned char salt[SRTP_MAX_SALT_LEN];
+}srtp_crypto_t;
+
+/* 某个 SSRC 的 ROC 及防重放状态，RTP 的 index 为 ROC<<16 | SEQ */
+typedef struct srtp_stream
+{
+    unsigned ssrc;
+    int in_use;
+
+    int rtp_seen;
+    unsigned long long rtp_index;
+    unsigned long long rtp_window;
+
+    int rtcp_seen;
+    unsigned rtcp_index;
+    unsigned long long rtcp_window;
+}srtp_stream_t;
+
+typedef struct srtp_stream_table
+{
+    srtp_stream_t *streams;
+    unsigned capacity;
+    unsigned count;
+    unsigned last;      /* 最近一次命中的位置，同一批报文多来自同一个 SSRC */
+}srtp_stream_table_t;
+
+struct srtp_engine
+{
+    const srtp_profile_params_t *profile;
+
+    srtp_crypto_t local_rtp;
+    srtp_crypto_t local_rtcp;
+    srtp_crypto_t remote_rtp;
+    srtp_crypto_t remote_rtcp;
+
+    srtp_stream_table_t local_streams;
+    srtp_stream_table_t remote_streams;
+};
+
+static inline
+unsigned read_u32(const unsigned char *p)
+{
+    return ((unsigned)p[0] << 24) | ((unsigned)p[1] << 16) | ((unsigned)p[2] << 8) | p[3];
+}
+
+static inline
+void write_u32(unsigned char *p, unsigned value)
+{
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)value;
+    return;
+}
+
+static
+const srtp_profile_params_t* find_profile(unsigned long id)
+{
+    unsigned i;
+
+    for (i = 0; i < sizeof(g_profiles)/sizeof(g_profiles[0]); ++i)
+    {
+        if (g_profiles[i].id == id)
+        {
+            return &g_profiles[i];
+        }
+    }
+
+    return NULL;
+}
+
+int srtp_kdf
+(
+    const unsigned char *master_key, unsigned key_len, const unsigned char *master_salt, unsigned salt_len,
+    unsigned char label, unsigned char *out, unsigned out_len
+)
+{
+    EVP_CIPHER_CTX *ctx;
+    unsigned char iv[16];
+    int len;
+    int ret;
+
+    if (NULL == master_key || (16 != key_len && 32 != key_len) || NULL == master_salt ||
+        salt_len > SRTP_MAX_SALT_LEN || NULL == out || 0 == out_len)
+    {
+        log_error("srtp_kdf: bad master_key(%p) or bad key_len(%u) or bad master_salt(%p) or bad salt_len(%u) or bad out(%p) or bad out_len(%u)",
+            master_key, key_len, master_salt, salt_len, out, out_len);
+        return -1;
+    }
+
+    /* x = (label || r) XOR master_salt，r 为0；以 x * 2^16 为 IV 的 AES-CM 密钥流即为派生结果 */
+    memset(iv, 0, sizeof(iv));
+    memcpy(iv, master_salt, salt_len);
+    iv[7] ^= label;
+
+    ctx = EVP_CIPHER_CTX_new();
+    memset(out, 0, out_len);
+    ret = EVP_EncryptInit_ex(ctx, (16 == key_len ? EVP_aes_128_ctr() : EVP_aes_256_ctr()), NULL, master_key, iv) == 1 &&
+        EVP_EncryptUpdate(ctx, out, &len, out, (int)out_len) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+
+    return ret ? 0 : -1;
+}
+
+static
+srtp_mac_t* new_mac(const unsigned char *key, unsigned key_len)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC *mac;
+    EVP_MAC_CTX *ctx;
+    OSSL_PARAM params[2];
+
+    mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+    if (NULL == mac)
+    {
+        return NULL;
+    }
+    ctx = EVP_MAC_CTX_new(mac);
+    EVP_MAC_free(mac);
+    if (NULL == ctx)
+    {
+        return NULL;
+    }
+
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)"SHA1", 0);
+    params[1] = OSSL_PARAM_construct_end();
+    if (EVP_MAC_init(ctx, key, key_len, params) != 1)
+    {
+        EVP_MAC_CTX_free(ctx);
+        return NULL;
+    }
+
+    return ctx;
+#else
+    HMAC_CTX *ctx;
+
+    ctx = HMAC_CTX_new();
+    if (NULL != ctx && HMAC_Init_ex(ctx, key, (int)key_len, EVP_sha1(), NULL) != 1)
+    {
+        HMAC_CTX_free(ctx);
+        ctx = NULL;
+    }
+
+    return ctx;
+#endif
+}
+
+static
+void free_mac(srtp_mac_t *mac)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX_free(mac);
+#else
+    HMAC_CTX_free(mac);
+#endif
+    return;
+}
+
+/* HMAC-SHA1(data || roc)，roc 为NULL时(SRTCP)不含 ROC，密钥沿用创建时设置的 */
+static
+int compute_tag(srtp_mac_t *mac, const unsigned char *data, unsigned size, const unsigned char *roc, unsigned char *tag)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    size_t len;
+
+    if (EVP_MAC_init(mac, NULL, 0, NULL) != 1 || EVP_MAC_update(mac, data, size) != 1 ||
+        (NULL != roc && EVP_MAC_update(mac, roc, 4) != 1) || EVP_MAC_final(mac, tag, &len, SRTP_HMAC_SHA1_LEN) != 1)
+    {
+        return -1;
+    }
+#else
+    unsigned len;
+
+    if (HMAC_Init_ex(mac, NULL, 0, NULL, NULL) != 1 || HMAC_Update(mac, data, size) != 1 ||
+        (NULL != roc && HMAC_Update(mac, roc, 4) != 1) || HMAC_Final(mac, tag, &len) != 1)
+    {
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+static
+void uninit_crypto(srtp_crypto_t *crypto)
+{
+    EVP_CIPHER_CTX_free(crypto->cipher);
+    if (NULL != crypto->mac)
+    {
+        free_mac(crypto->mac);
+    }
+    OPENSSL_cleanse(crypto->salt, sizeof(crypto->salt));
+    memset(crypto, 0, sizeof(*crypto));
+
+    return;
+}
+
+/* 派生会话密钥并设置到 EVP 上下文中，label 为加密密钥的标签，认证密钥及 salt 的标签依次加1、加2 */
+static
+int init_crypto
+(
+    srtp_crypto_t *crypto, const srtp_profile_params_t *profile,
+    const unsigned char *master_key, const unsigned char *master_salt, unsigned char label, int is_encrypt
+)
+{
+    unsigned char key[SRTP_MAX_KEY_LEN];
+    unsigned char auth_key[SRTP_AUTH_KEY_LEN];
+    const EVP_CIPHER *cipher;
+    int ret = -1;
+
+    memset(crypto, 0, sizeof(*crypto));
+
+    if (srtp_kdf(master_key, profile->key_len, master_salt, profile->salt_len, label, key, profile->key_len) != 0 ||
+        srtp_kdf(master_key, profile->key_len, master_salt, profile->salt_len, label + 2, crypto->salt, profile->salt_len) != 0)
+    {
+        goto end;
+    }
+
+    if (profile->is_aead)
+    {
+        cipher = (16 == profile->key_len) ? EVP_aes_128_gcm() : EVP_aes_256_gcm();
+    }
+    else
+    {
+        cipher = (16 == profile->key_len) ? EVP_aes_128_ctr() : EVP_aes_256_ctr();
+    }
+    crypto->cipher = EVP_CIPHER_CTX_new();
+    if (NULL == crypto->cipher || EVP_CipherInit_ex(crypto->cipher, cipher, NULL, key, NULL, is_encrypt) != 1)
+    {
+        goto end;
+    }
+
+    if (0 == profile->is_aead)
+    {
+        if (srtp_kdf(master_key, profile->key_len, master_salt, profile->salt_len, label + 1, auth_key, sizeof(auth_key)) != 0)
+        {
+            goto end;
+        }
+        crypto->mac = new_mac(auth_key, sizeof(auth_key));
+        if (NULL == crypto->mac)
+        {
+            goto end;
+        }
+    }
+
+    ret = 0;
+
+end:
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(auth_key, sizeof(auth_key));
+    if (0 != ret)
+    {
+        log_error("init_crypto: failed to init srtp crypto, label: %u, ssl error: %lu", label, ERR_get_error());
+        uninit_crypto(crypto);
+    }
+
+    return ret;
+}
+
+static
+srtp_stream_t* stream_find(srtp_stream_table_t *table, unsigned ssrc)
+{
+    unsigned i;
+
+    if (0 == table->capacity)
+    {
+        return NULL;
+    }
+    if (table->streams[table->last].in_use && table->streams[table->last].ssrc == ssrc)
+    {
+        return &table->streams[table->last];
+    }
+
+    i = (ssrc * 2654435761u) & (table->capacity - 1);
+    while (table->streams[i].in_use)
+    {
+        if (table->streams[i].ssrc == ssrc)
+        {
+            table->last = i;
+            return &table->streams[i];
+        }
+        i = (i + 1) & (table->capacity - 1);
+    }
+
+    return NULL;
+}
+
+static
+srtp_stream_t* stream_insert(srtp_stream_table_t *table, unsigned ssrc)
+{
+    srtp_stream_t *streams;
+    unsigned capacity;
+    unsigned i;
+    unsigned j;
+
+    /* 负载超过一半时加倍 */
+    if ((table->count + 1) * 2 > table->capacity)
+    {
+        capacity = (0 == table->capacity) ? 8 : table->capacity * 2;
+        streams = (srtp_stream_t*)malloc(sizeof(srtp_stream_t) * capacity);
+        memset(streams, 0, sizeof(srtp_stream_t) * capacity);
+        for (i = 0; i < table->capacity; ++i)
+        {
+            if (table->streams[i].in_use)
+            {
+                j = (table->streams[i].ssrc * 2654435761u) & (capacity - 1);
+                while (streams[j].in_use)
+                {
+                    j = (j + 1) & (capacity - 1);
+                }
+                streams[j] = table->streams[i];
+            }
+        }
+        free(table->streams);
+        table->streams = streams;
+        table->capacity = capacity;
+    }
+
+    i = (ssrc * 2654435761u) & (table->capacity - 1);
+    while (table->streams[i].in_use)
+    {
+        i = (i + 1) & (table->capacity - 1);
+    }
+    memset(&table->streams[i], 0, sizeof(table->streams[i]));
+    table->streams[i].ssrc = ssrc;
+    table->streams[i].in_use = 1;
+    table->count++;
+    table->last = i;
+
+    return &table->streams[i];
+}
+
+static
+srtp_stream_t* stream_get(srtp_stream_table_t *table, unsigned ssrc)
+{
+    srtp_stream_t *stream;
+
+    stream = stream_find(table, ssrc);
+    if (NULL == stream)
+    {
+        stream = stream_insert(table, ssrc);
+    }
+
+    return stream;
+}
+
+/* RFC 3711 3.3.1 由 SEQ 估计 index，估计出的 ROC 为负(早于首个报文)时返回-1 */
+static
+long long estimate_index(const srtp_stream_t *stream, unsigned short seq)
+{
+    unsigned long long roc;
+    unsigned s_l;
+
+    if (NULL == stream || 0 == stream->rtp_seen)
+    {
+        return seq;
+    }
+
+    roc = stream->rtp_index >> 16;
+    s_l = (unsigned)(stream->rtp_index & 0xffff);
+    if (s_l < 32768)
+    {
+        if ((int)seq - (int)s_l > 32768)
+        {
+            if (0 == roc)
+            {
+                return -1;
+            }
+            roc--;
+        }
+    }
+    else if ((int)s_l - 32768 > (int)seq)
+    {
+        roc++;
+    }
+
+    return (long long)((roc << 16) | seq);
+}
+
+/* 检查 index 是否已收到过或已落在窗口之外 */
+static
+int replay_check(int seen, unsigned long long max_index, unsigned long long window, unsigned long long index)
+{
+    unsigned long long delta;
+
+    if (0 == seen || index > max_index)
+    {
+        return 0;
+    }
+
+    delta = max_index - index;
+    if (delta >= SRTP_REPLAY_WINDOW || (window >> delta) & 1)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static
+void replay_update(int *seen, unsigned long long *max_index, unsigned long long *window, unsigned long long index)
+{
+    unsigned long long shift;
+
+    if (0 == *seen)
+    {
+        *seen = 1;
+        *max_index = index;
+        *window = 1;
+    }
+    else if (index > *max_index)
+    {
+        shift = index - *max_index;
+        *window = (shift >= SRTP_REPLAY_WINDOW) ? 1 : ((*window << shift) | 1);
+        *max_index = index;
+    }
+    else
+    {
+        *window |= 1ULL << (*max_index - index);
+    }
+
+    return;
+}
+
+/* RTP 头(含 CSRC 及扩展头)的长度 */
+static
+int rtp_header_size(const unsigned char *p, unsigned size)
+{
+    unsigned header_size;
+
+    if (size < 12 || (p[0] >> 6) != 2)
+    {
+        return -1;
+    }
+
+    header_size = 12 + (p[0] & 0x0f) * 4;
+    if (p[0] & 0x10)
+    {
+        if (size < header_size + 4)
+        {
+            return -1;
+        }
+        header_size += 4 + (((unsigned)p[header_size + 2] << 8) | p[header_size + 3]) * 4;
+    }
+    if (header_size > size)
+    {
+        return -1;
+    }
+
+    return (int)header_size;
+}
+
+/* AES-CM 的 IV: (salt * 2^16) XOR (SSRC * 2^64) XOR (index * 2^16) */
+static
+void make_cm_iv(unsigned char *iv, const unsigned char *salt, const unsigned char *ssrc, unsigned long long index)
+{
+    int i;
+
+    memset(iv, 0, 16);
+    memcpy(iv, salt, 14);
+    for (i = 0; i < 4; ++i)
+    {
+        iv[4 + i] ^= ssrc[i];
+    }
+    for (i = 0; i < 6; ++i)
+    {
+        iv[13 - i] ^= (unsigned char)(index >> (8 * i));
+    }
+
+    return;
+}
+
+/* AEAD 的 IV(RFC 7714 8.1/9.1): (0x0000 || SSRC || ROC/0x0000 || SEQ/index) XOR salt */
+static
+void make_gcm_iv(unsigned char *iv, const unsigned char *salt, const unsigned char *ssrc, unsigned high, unsigned low, int is_rtcp)
+{
+    int i;
+
+    memset(iv, 0, 12);
+    memcpy(iv + 2, ssrc, 4);
+    if (is_rtcp)
+    {
+        write_u32(iv + 8, low);
+    }
+    else
+    {
+        write_u32(iv + 6, high);
+        iv[10] = (unsigned char)(low >> 8);
+        iv[11] = (unsigned char)low;
+    }
+    for (i = 0; i < 12; ++i)
+    {
+        iv[i] ^= salt[i];
+    }
+
+    return;
+}
+
+static
+int cipher_update(EVP_CIPHER_CTX *ctx, unsigned char *data, unsigned size)
+{
+    int len;
+
+    if (0 == size)
+    {
+        return 0;
+    }
+
+    return EVP_CipherUpdate(ctx, data, &len, data, (int)size) == 1 ? 0 : -1;
+}
+
+static
+int aad_update(EVP_CIPHER_CTX *ctx, const unsigned char *data, unsigned size)
+{
+    int len;
+
+    return EVP_CipherUpdate(ctx, NULL, &len, data, (int)size) == 1 ? 0 : -1;
+}
+
+srtp_engine_t* srtp_engine_new
+(
+    unsigned long profile,
+    const unsigned char *local_key, const unsigned char *local_salt,
+    const unsigned char *remote_key, const unsigned char *remote_salt
+)
+{
+    const srtp_profile_params_t *params;
+    srtp_engine_t *engine;
+
+    if (NULL == local_key || NULL == local_salt || NULL == remote_key || NULL == remote_salt)
+    {
+        log_error("srtp_engine_new: bad local_key(%p) or bad local_salt(%p) or bad remote_key(%p) or bad remote_salt(%p)",
+            local_key, local_salt, remote_key, remote_salt);
+        return NULL;
+    }
+
+    params = find_profile(profile);
+    if (NULL == params)
+    {
+        log_error("srtp_engine_new: unsupported srtp profile: %lu", profile);
+        return NULL;
+    }
+
+    engine = (srtp_engine_t*)malloc(sizeof(*engine));
+    memset(engine, 0, sizeof(*engine));
+    engine->profile = params;
+
+    if (init_crypto(&engine->local_rtp, params, local_key, local_salt, SRTP_LABEL_RTP_ENCRYPTION, 1) != 0 ||
+        init_crypto(&engine->local_rtcp, params, local_key, local_salt, SRTP_LABEL_RTCP_ENCRYPTION, 1) != 0 ||
+        init_crypto(&engine->remote_rtp, params, remote_key, remote_salt, SRTP_LABEL_RTP_ENCRYPTION, 0) != 0 ||
+        init_crypto(&engine->remote_rtcp, params, remote_key, remote_salt, SRTP_LABEL_RTCP_ENCRYPTION, 0) != 0)
+    {
+        srtp_engine_destroy(engine);
+        return NULL;
+    }
+
+    return engine;
+}
+
+srtp_engine_t* srtp_engine_new_from_ssl(SSL *ssl)
+{
+    static const char label[] = "EXTRACTOR-dtls_srtp";
+
+    SRTP_PROTECTION_PROFILE *srtp_profile;
+    const srtp_profile_params_t *params;
+    unsigned char material[2 * (SRTP_MAX_KEY_LEN + SRTP_MAX_SALT_LEN)];
+    const unsigned char *client_key;
+    const unsigned char *server_key;
+    const unsigned char *client_salt;
+    const unsigned char *server_salt;
+    srtp_engine_t *engine;
+
+    if (NULL == ssl)
+    {
+        log_error("srtp_engine_new_from_ssl: bad ssl(%p)", ssl);
+        return NULL;
+    }
+
+    srtp_profile = SSL_get_selected_srtp_profile(ssl);
+    if (NULL == srtp_profile)
+    {
+        log_error("srtp_engine_new_from_ssl: no srtp profile was negotiated, ssl: %p", ssl);
+        return NULL;
+    }
+    params = find_profile(srtp_profile->id);
+    if (NULL == params)
+    {
+        log_error("srtp_engine_new_from_ssl: unsupported srtp profile: %s", srtp_profile->name);
+        return NULL;
+    }
+
+    /* RFC 5764 4.2: client_key || server_key || client_salt || server_salt */
+    if (SSL_export_keying_material(ssl, material, 2 * (params->key_len + params->salt_len), label, strlen(label), NULL, 0, 0) != 1)
+    {
+        log_error("srtp_engine_new_from_ssl: failed to export keying material, ssl error: %lu", ERR_get_error());
+        return NULL;
+    }
+    client_key = material;
+    server_key = material + params->key_len;
+    client_salt = material + 2 * params->key_len;
+    server_salt = client_salt + params->salt_len;
+
+    if (SSL_is_server(ssl))
+    {
+        engine = srtp_engine_new(params->id, server_key, server_salt, client_key, client_salt);
+    }
+    else
+    {
+        engine = srtp_engine_new(params->id, client_key, client_salt, server_key, server_salt);
+    }
+    OPENSSL_cleanse(material, sizeof(material));
+
+    return engine;
+}
+
+void srtp_engine_destroy(srtp_engine_t *engine)
+{
+    if (NULL == engine)
+    {
+        return;
+    }
+
+    uninit_crypto(&engine->local_rtp);
+    uninit_crypto(&engine->local_rtcp);
+    uninit_crypto(&engine->remote_rtp);
+    uninit_crypto(&engine->remote_rtcp);
+    free(engine->local_streams.streams);
+    free(engine->remote_streams.streams);
+    free(engine);
+
+    return;
+}
+
+unsigned long srtp_engine_get_profile(srtp_engine_t *engine)
+{
+    if (NULL == engine)
+    {
+        return 0;
+    }
+
+    return engine->profile->id;
+}
+
+int srtp_engine_protect_rtp(srtp_engine_t *engine, void *packet, unsigned size, unsigned capacity)
+{
+    const srtp_profile_params_t *profile;
+    srtp_crypto_t *crypto;
+    srtp_stream_t *stream;
+    unsigned char *p = (unsigned char*)packet;
+    unsigned char iv[16];
+    unsigned char roc[4];
+    unsigned char tag[SRTP_HMAC_SHA1_LEN];
+    unsigned short seq;
+    long long index;
+    int header_size;
+
+    if (NULL == engine || NULL == packet)
+    {
+        log_error("srtp_engine_protect_rtp: bad engine(%p) or bad packet(%p)", engine, packet);
+        return SRTP_ENGINE_ERR_BAD_PACKET;
+    }
+
+    profile = engine->profile;
+    crypto = &engine->local_rtp;
+    header_size = rtp_header_size(p, size);
+    if (header_size < 0 || size + profile->rtp_tag_len > capacity)
+    {
+        return SRTP_ENGINE_ERR_BAD_PACKET;
+    }
+
+    seq = (unsigned short)((p[2] << 8) | p[3]);
+    stream = stream_get(&engine->local_streams, read_u32(p + 8));
+    index = estimate_index(stream, seq);
+    if (index < 0)
+    {
+        index = seq;
+    }
+    if (0 == stream->rtp_seen || (unsigned long long)index > stream->rtp_index)
+    {
+        stream->rtp_seen = 1;
+        stream->rtp_index = (unsigned long long)index;
+    }
+    write_u32(roc, (unsigned)(index >> 16));
+
+    if (profile->is_aead)
+    {
+        make_gcm_iv(iv, crypto->salt, p + 8, read_u32(roc), seq, 0);
+        if (EVP_CipherInit_ex(crypto->cipher, NULL, NULL, NULL, iv, -1) != 1 ||
+            aad_update(crypto->cipher, p, header_size) != 0 ||
+            cipher_update(crypto->cipher, p + header_size, size - header_size) != 0 ||
+            EVP_CipherFinal_ex(crypto->cipher, tag, (int*)&header_size) != 1 ||
+            EVP_CIPHER_CTX_ctrl(crypto->cipher, EVP_CTRL_GCM_GET_TAG, SRTP_AEAD_TAG_LEN, p + size) != 1)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+    }
+    else
+    {
+        make_cm_iv(iv, crypto->salt, p + 8, (unsigned long long)index);
+        if (EVP_CipherInit_ex(crypto->cipher, NULL, NULL, NULL, iv, -1) != 1 ||
+            cipher_update(crypto->cipher, p + header_size, size - header_size) != 0 ||
+            compute_tag(crypto->mac, p, size, roc, tag) != 0)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+        memcpy(p + size, tag, profile->rtp_tag_len);
+    }
+
+    return (int)(size + profile->rtp_tag_len);
+}
+
+int srtp_engine_unprotect_rtp(srtp_engine_t *engine, void *packet, unsigned size)
+{
+    const srtp_profile_params_t *profile;
+    srtp_crypto_t *crypto;
+    srtp_stream_t *stream;
+    unsigned char *p = (unsigned char*)packet;
+    unsigned char iv[16];
+    unsigned char roc[4];
+    unsigned char tag[SRTP_HMAC_SHA1_LEN];
+    unsigned short seq;
+    unsigned ssrc;
+    unsigned payload_size;
+    long long index;
+    int header_size;
+    int len;
+
+    if (NULL == engine || NULL == packet)
+    {
+        log_error("srtp_engine_unprotect_rtp: bad engine(%p) or bad packet(%p)", engine, packet);
+        return SRTP_ENGINE_ERR_BAD_PACKET;
+    }
+
+    profile = engine->profile;
+    crypto = &engine->remote_rtp;
+    if (size < 12 + profile->rtp_tag_len)
+    {
+        return SRTP_ENGINE_ERR_BAD_PACKET;
+    }
+    size -= profile->rtp_tag_len;
+    header_size = rtp_header_size(p, size);
+    if (header_size < 0)
+    {
+        return SRTP_ENGINE_ERR_BAD_PACKET;
+    }
+    payload_size = size - header_size;
+
+    /* 认证通过之前只查找不建立 SSRC 的状态 */
+    seq = (unsigned short)((p[2] << 8) | p[3]);
+    ssrc = read_u32(p + 8);
+    stream = stream_find(&engine->remote_streams, ssrc);
+    index = estimate_index(stream, seq);
+    if (index < 0 || (NULL != stream &&
+        replay_check(stream->rtp_seen, stream->rtp_index, stream->rtp_window, (unsigned long long)index) != 0))
+    {
+        return SRTP_ENGINE_ERR_REPLAY;
+    }
+    write_u32(roc, (unsigned)(index >> 16));
+
+    if (profile->is_aead)
+    {
+        make_gcm_iv(iv, crypto->salt, p + 8, read_u32(roc), seq, 0);
+        if (EVP_CipherInit_ex(crypto->cipher, NULL, NULL, NULL, iv, -1) != 1 ||
+            aad_update(crypto->cipher, p, header_size) != 0 ||
+            cipher_update(crypto->cipher, p + header_size, payload_size) != 0 ||
+            EVP_CIPHER_CTX_ctrl(crypto->cipher, EVP_CTRL_GCM_SET_TAG, SRTP_AEAD_TAG_LEN, p + size) != 1)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+        if (EVP_CipherFinal_ex(crypto->cipher, tag, &len) != 1)
+        {
+            return SRTP_ENGINE_ERR_AUTH;
+        }
+    }
+    else
+    {
+        if (compute_tag(crypto->mac, p, size, roc, tag) != 0)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+        if (CRYPTO_memcmp(tag, p + size, profile->rtp_tag_len) != 0)
+        {
+            return SRTP_ENGINE_ERR_AUTH;
+        }
+
+        make_cm_iv(iv, crypto->salt, p + 8, (unsigned long long)index);
+        if (EVP_CipherInit_ex(crypto->cipher, NULL, NULL, NULL, iv, -1) != 1 ||
+            cipher_update(crypto->cipher, p + header_size, payload_size) != 0)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+    }
+
+    if (NULL == stream)
+    {
+        stream = stream_insert(&engine->remote_streams, ssrc);
+    }
+    replay_update(&stream->rtp_seen, &stream->rtp_index, &stream->rtp_window, (unsigned long long)index);
+
+    return (int)size;
+}
+
+int srtp_engine_protect_rtcp(srtp_engine_t *engine, void *packet, unsigned size, unsigned capacity)
+{
+    const srtp_profile_params_t *profile;
+    srtp_crypto_t *crypto;
+    srtp_stream_t *stream;
+    unsigned char *p = (unsigned char*)packet;
+    unsigned char iv[16];
+    unsigned char tag[SRTP_HMAC_SHA1_LEN];
+    unsigned char trailer[SRTCP_INDEX_LEN];
+    unsigned index;
+    int len;
+
+    if (NULL == engine || NULL == packet)
+    {
+        log_error("srtp_engine_protect_rtcp: bad engine(%p) or bad packet(%p)", engine, packet);
+        return SRTP_ENGINE_ERR_BAD_PACKET;
+    }
+
+    profile = engine->profile;
+    crypto = &engine->local_rtcp;
+    if (size < 8 || (p[0] >> 6) != 2 || size + SRTCP_INDEX_LEN + profile->rtcp_tag_len > capacity)
+    {
+        return SRTP_ENGINE_ERR_BAD_PACKET;
+    }
+
+    /* SRTCP index 按发送方的 SSRC 逐包递增，31位 */
+    stream = stream_get(&engine->local_streams, read_u32(p + 4));
+    index = stream->rtcp_seen ? ((stream->rtcp_index + 1) & 0x7fffffff) : 0;
+    stream->rtcp_seen = 1;
+    stream->rtcp_index = index;
+    write_u32(trailer, SRTCP_E_FLAG | index);
+
+    if (profile->is_aead)
+    {
+        /* 密文 || 标签 || E+index，AAD 为头部8字节及 E+index */
+        make_gcm_iv(iv, crypto->salt, p + 4, 0, index, 1);
+        if (EVP_CipherInit_ex(crypto->cipher, NULL, NULL, NULL, iv, -1) != 1 ||
+            aad_update(crypto->cipher, p, 8) != 0 ||
+            aad_update(crypto->cipher, trailer, SRTCP_INDEX_LEN) != 0 ||
+            cipher_update(crypto->cipher, p + 8, size - 8) != 0 ||
+            EVP_CipherFinal_ex(crypto->cipher, tag, &len) != 1 ||
+            EVP_CIPHER_CTX_ctrl(crypto->cipher, EVP_CTRL_GCM_GET_TAG, SRTP_AEAD_TAG_LEN, p + size) != 1)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+        memcpy(p + size + SRTP_AEAD_TAG_LEN, trailer, SRTCP_INDEX_LEN);
+    }
+    else
+    {
+        /* 密文 || E+index || 标签，标签覆盖前面的全部内容 */
+        make_cm_iv(iv, crypto->salt, p + 4, index);
+        if (EVP_CipherInit_ex(crypto->cipher, NULL, NULL, NULL, iv, -1) != 1 ||
+            cipher_update(crypto->cipher, p + 8, size - 8) != 0)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+        memcpy(p + size, trailer, SRTCP_INDEX_LEN);
+        if (compute_tag(crypto->mac, p, size + SRTCP_INDEX_LEN, NULL, tag) != 0)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+        memcpy(p + size + SRTCP_INDEX_LEN, tag, profile->rtcp_tag_len);
+    }
+
+    return (int)(size + SRTCP_INDEX_LEN + profile->rtcp_tag_len);
+}
+
+int srtp_engine_unprotect_rtcp(srtp_engine_t *engine, void *packet, unsigned size)
+{
+    const srtp_profile_params_t *profile;
+    srtp_crypto_t *crypto;
+    srtp_stream_t *stream;
+    unsigned char *p = (unsigned char*)packet;
+    unsigned char iv[16];
+    unsigned char tag[SRTP_HMAC_SHA1_LEN];
+    unsigned char *trailer;
+    unsigned ssrc;
+    unsigned index;
+    int is_encrypted;
+    int len;
+
+    if (NULL == engine || NULL == packet)
+    {
+        log_error("srtp_engine_unprotect_rtcp: bad engine(%p) or bad packet(%p)", engine, packet);
+        return SRTP_ENGINE_ERR_BAD_PACKET;
+    }
+
+    profile = engine->profile;
+    crypto = &engine->remote_rtcp;
+    if (size < 8 + SRTCP_INDEX_LEN + profile->rtcp_tag_len || (p[0] >> 6) != 2)
+    {
+        return SRTP_ENGINE_ERR_BAD_PACKET;
+    }
+    size -= SRTCP_INDEX_LEN + profile->rtcp_tag_len;
+
+    if (profile->is_aead)
+    {
+        trailer = p + size + SRTP_AEAD_TAG_LEN;
+    }
+    else
+    {
+        trailer = p + size;
+    }
+    is_encrypted = (read_u32(trailer) & SRTCP_E_FLAG) != 0;
+    index = read_u32(trailer) & 0x7fffffff;
+
+    ssrc = read_u32(p + 4);
+    stream = stream_find(&engine->remote_streams, ssrc);
+    if (NULL != stream && replay_check(stream->rtcp_seen, stream->rtcp_index, stream->rtcp_window, index) != 0)
+    {
+        return SRTP_ENGINE_ERR_REPLAY;
+    }
+
+    if (profile->is_aead)
+    {
+        make_gcm_iv(iv, crypto->salt, p + 4, 0, index, 1);
+        if (EVP_CipherInit_ex(crypto->cipher, NULL, NULL, NULL, iv, -1) != 1 ||
+            aad_update(crypto->cipher, p, is_encrypted ? 8 : size) != 0 ||
+            aad_update(crypto->cipher, trailer, SRTCP_INDEX_LEN) != 0 ||
+            (is_encrypted && cipher_update(crypto->cipher, p + 8, size - 8) != 0) ||
+            EVP_CIPHER_CTX_ctrl(crypto->cipher, EVP_CTRL_GCM_SET_TAG, SRTP_AEAD_TAG_LEN, p + size) != 1)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+        if (EVP_CipherFinal_ex(crypto->cipher, tag, &len) != 1)
+        {
+            return SRTP_ENGINE_ERR_AUTH;
+        }
+    }
+    else
+    {
+        if (compute_tag(crypto->mac, p, size + SRTCP_INDEX_LEN, NULL, tag) != 0)
+        {
+            return SRTP_ENGINE_ERR_BAD_PACKET;
+        }
+        if (CRYPTO_memcmp(tag, p + size + SRTCP_INDEX_LEN, profile->rtcp_tag_len) != 0)
+        {
+            return SRTP_ENGINE_ERR_AUTH;
+        }
+
+        if (is_encrypted)
+        {
+            make_cm_iv(iv, crypto->salt, p + 4, index);
+            if (EVP_CipherInit_ex(crypto->cipher, NULL, NULL, NULL, iv, -1) != 1 ||
+                cipher_update(crypto->cipher, p + 8, size - 8) != 0)
+            {
+                return SRTP_ENGINE_ERR_BAD_PACKET;
+            }
+        }
+    }
+
+    if (NULL == stream)
+    {
+        stream = stream_insert(&engine->remote_streams, ssrc);
+    }
+    {
+        unsigned long long max_index = stream->rtcp_index;
+        replay_update(&stream->rtcp_seen, &max_index, &stream->rtcp_window, index);
+        stream->rtcp_index = (unsigned)max_index;
+    }
+
+    return (int)size;
+}
+
+unsigned srtp_engine_protect_rtp_batch(srtp_engine_t *engine, srtp_packet_t *packets, unsigned count)
+{
+    unsigned succeeded = 0;
+    unsigned i;
+
+    if (NULL == engine || NULL == packets)
+    {
+        log_error("srtp_engine_protect_rtp_batch: bad engine(%p) or bad packets(%p)", engine, packets);
+        return 0;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        packets[i].result = srtp_engine_protect_rtp(engine, packets[i].data, packets[i].size, packets[i].capacity);
+        if (packets[i].result > 0)
+        {
+            succeeded++;
+        }
+    }
+
+    return succeeded;
+}
+
+unsigned srtp_engine_unprotect_rtp_batch(srtp_engine_t *engine, srtp_packet_t *packets, unsigned count)
+{
+    unsigned succeeded = 0;
+    unsigned i;
+
+    if (NULL == engine || NULL == packets)
+    {
+        log_error("srtp_engine_unprotect_rtp_batch: bad engine(%p) or bad packets(%p)", engine, packets);
+        return 0;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        packets[i].result = srtp_engine_unprotect_rtp(engine, packets[i].data, packets[i].size);
+        if (packets[i].result > 0)
+        {
+            succeeded++;
+        }
+    }
+
+    return succeeded;
+}
@@ -0,0 +1,85 @@
+
+/** SRTP/SRTCP 报文的加解密及认证(RFC 3711, RFC 7714)
+  *
+  * 支持 AES128_CM_HMAC_SHA1_80/32 及 AEAD_AES_128/256_GCM，由 OpenSSL EVP 实现
+  * 会话密钥在创建时一次派生并设置到 EVP 上下文中，之后每个报文只需更换 IV
+  *
+  * 报文均原地处理: 解保护直接在收包缓冲区(如 udp_peer 的接收缓冲区)中解密，
+  * 保护时认证标签(SRTCP 另有 index)追加在报文之后，缓冲区需留出 SRTP_ENGINE_MAX_OVERHEAD 字节的空间
+  *
+  * 按 SSRC 维护 ROC 及 64 个报文的防重放窗口，收到的报文只有认证通过之后才会建立或更新其 SSRC 的状态
+  *
+  * 非线程安全，一个 engine 只应在一个线程中使用
+  */
+
+#ifndef TINYLIB_SSL_SRTP_ENGINE_H
+#define TINYLIB_SSL_SRTP_ENGINE_H
+
+struct srtp_engine;
+typedef struct srtp_engine srtp_engine_t;
+
+#include <openssl/ssl.h>
+#include <openssl/srtp.h>
+
+/* 保护之后报文增加的最大字节数: GCM 标签16字节 + SRTCP index 4字节 */
+#define SRTP_ENGINE_MAX_OVERHEAD 20
+
+/* 解保护失败的原因 */
+#define SRTP_ENGINE_ERR_BAD_PACKET (-1)
+#define SRTP_ENGINE_ERR_AUTH (-2)
+#define SRTP_ENGINE_ERR_REPLAY (-3)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 批量处理的报文，result 为处理之后的长度，失败时为上面的错误码 */
+typedef struct srtp_packet
+{
+    void *data;
+    unsigned size;
+    unsigned capacity;  /* data 所在缓冲区的尺寸，仅保护时使用 */
+    int result;
+}srtp_packet_t;
+
+/* profile 为 OpenSSL 的 SRTP profile id，如 SRTP_AES128_CM_SHA1_80、SRTP_AEAD_AES_128_GCM
+ * local_* 用于保护发出的报文，remote_* 用于解保护收到的报文
+ */
+srtp_engine_t* srtp_engine_new
+(
+    unsigned long profile,
+    const unsigned char *local_key, const unsigned char *local_salt,
+    const unsigned char *remote_key, const unsigned char *remote_salt
+);
+
+/* 以 DTLS-SRTP(RFC 5764) 协商的 profile 及导出的密钥创建，ssl 需已完成握手且协商了 use_srtp */
+srtp_engine_t* srtp_engine_new_from_ssl(SSL *ssl);
+
+void srtp_engine_destroy(srtp_engine_t *engine);
+
+unsigned long srtp_engine_get_profile(srtp_engine_t *engine);
+
+/* 原地保护，返回保护之后的长度，失败返回 SRTP_ENGINE_ERR_BAD_PACKET */
+int srtp_engine_protect_rtp(srtp_engine_t *engine, void *packet, unsigned size, unsigned capacity);
+int srtp_engine_protect_rtcp(srtp_engine_t *engine, void *packet, unsigned size, unsigned capacity);
+
+/* 原地解保护，返回明文报文的长度，失败返回 SRTP_ENGINE_ERR_* */
+int srtp_engine_unprotect_rtp(srtp_engine_t *engine, void *packet, unsigned size);
+int srtp_engine_unprotect_rtcp(srtp_engine_t *engine, void *packet, unsigned size);
+
+/* 批量处理，如 udp_peer 一次 recvmmsg() 收到的一批报文，返回成功的个数 */
+unsigned srtp_engine_protect_rtp_batch(srtp_engine_t *engine, srtp_packet_t *packets, unsigned count);
+unsigned srtp_engine_unprotect_rtp_batch(srtp_engine_t *engine, srtp_packet_t *packets, unsigned count);
+
+/* RFC 3711 4.3 的 AES-CM 密钥派生(key derivation rate 为0)，master_salt 不足14字节时在末尾补0 */
+int srtp_kdf
+(
+    const unsigned char *master_key, unsigned key_len, const unsigned char *master_salt, unsigned salt_len,
+    unsigned char label, unsigned char *out, unsigned out_len
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_SSL_SRTP_ENGINE_H */
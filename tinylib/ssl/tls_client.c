@@ -1,5 +1,9 @@
 
+#define LOG_MODULE LOG_MODULE_SSL
+
 #include "tinylib/ssl/tls_client.h"
+#include "tinylib/ssl/tls_context.h"
+#include "tinylib/ssl/tls_worker_pool.h"
 #include "tinylib/util/log.h"
 
 #if defined(WIN32)
@@ -28,6 +32,7 @@
 
 #include <openssl/ssl.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -39,6 +44,14 @@ enum tls_state
     TLS_STATE_SNDRCV,
 };
 
+enum early_data_state
+{
+    EARLY_DATA_NONE,
+    EARLY_DATA_WRITING,     /* 随 ClientHello 发出 */
+    EARLY_DATA_WRITTEN,
+    EARLY_DATA_DEFERRED,    /* 无法作为 early data 发出，握手完成之后再发 */
+};
+
 struct tls_client
 {
     loop_t *loop;
@@ -53,11 +66,21 @@ struct tls_client
     char server_ip[16];
     unsigned short server_port;
 
-    SSL_CTX *ssl_ctx;
+    tls_context_t *context;
+    int is_own_context;
+    char session_key[24];
     SSL *ssl;
     enum tls_state tls_state;
     char *ca_password;
 
+    buffer_t *early_buffer;
+    unsigned early_written;
+    enum early_data_state early_state;
+
+    tls_worker_pool_t *handshake_pool;
+    int is_offloaded;       /* 握手正在工作线程中进行，期间 ssl 由工作线程独占 */
+    int offload_result;
+
     int is_in_callback;
     int is_alive;
 
@@ -75,11 +98,15 @@ void delete_tls_client(tls_client_t* tls_client, int is_passive_close)
     }
 
     SSL_free(tls_client->ssl);
-    SSL_CTX_free(tls_client->ssl_ctx);
+    if (tls_client->is_own_context)
+    {
+        tls_context_destroy(tls_client->context);
+    }
     free(tls_client->ca_password);
 
     buffer_destory(tls_client->in_buffer);
     buffer_destory(tls_client->out_buffer);
+    buffer_destory(tls_client->early_buffer);
 
     channel_detach(tls_client->channel);
     channel_destroy(tls_client->channel);
@@ -89,6 +116,21 @@ void delete_tls_client(tls_client_t* tls_client, int is_passive_close)
     return;
 }
 
+static
+SSL* new_ssl(tls_context_t *context)
+{
+    SSL *ssl;
+
+    ssl = SSL_new(tls_context_get_ssl_ctx(context));
+    if (ssl != NULL)
+    {
+        /* 发送路径依赖部分写入的语义 */
+        SSL_set_mode(ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_AUTO_RETRY);
+    }
+
+    return ssl;
+}
+
 tls_client_t* tls_client_new
 (
     loop_t *loop, const char *server_ip, unsigned short server_port, 
@@ -97,7 +139,7 @@ tls_client_t* tls_client_new
 {
     tls_client_t *tls_client;
     
-    SSL_CTX *ssl_ctx;
+    tls_context_t *context;
     SSL *ssl;
 
     if (loop == NULL || server_ip == NULL  || server_port == 0 || connectcb == NULL || datacb == NULL || closecb == NULL)
@@ -105,20 +147,18 @@ tls_client_t* tls_client_new
         return NULL;
     }
 
-    ssl_ctx = SSL_CTX_new(TLSv1_2_client_method());
-    if (ssl_ctx == NULL)
+    /* 未以 tls_client_set_context() 指定共享的 context 时，使用自己的 context */
+    context = tls_context_new(TLS_CONTEXT_MODE_CLIENT);
+    if (context == NULL)
     {
-        log_error("tls_client_new: failed to alloc TLSv1.2 ssl context, server addr: %s:%u, errno: %d", 
-            server_ip, server_port, errno);
+        log_error("tls_client_new: failed to alloc ssl context, server addr: %s:%u", server_ip, server_port);
         return NULL;
     }
 
-    SSL_CTX_set_mode(ssl_ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_AUTO_RETRY);
-
-    ssl = SSL_new(ssl_ctx);
+    ssl = new_ssl(context);
     if (ssl == NULL)
     {
-        SSL_CTX_free(ssl_ctx);
+        tls_context_destroy(context);
         return NULL;
     }
 
@@ -138,11 +178,21 @@ tls_client_t* tls_client_new
     strncpy(tls_client->server_ip, server_ip, sizeof(tls_client->server_ip));
     tls_client->server_port = server_port;
 
-    tls_client->ssl_ctx = ssl_ctx;
+    tls_client->context = context;
+    tls_client->is_own_context = 1;
+    snprintf(tls_client->session_key, sizeof(tls_client->session_key), "%s:%u", tls_client->server_ip, server_port);
     tls_client->ssl = ssl;
     tls_client->tls_state = TLS_STATE_INIT;
     tls_client->ca_password = NULL;
 
+    tls_client->early_buffer = buffer_new(1024);
+    tls_client->early_written = 0;
+    tls_client->early_state = EARLY_DATA_NONE;
+
+    tls_client->handshake_pool = NULL;
+    tls_client->is_offloaded = 0;
+    tls_client->offload_result = 0;
+
     tls_client->is_in_callback = 0;
     tls_client->is_alive = 1;
 
@@ -171,12 +221,13 @@ int tls_client_use_ca(tls_client_t* tls_client, const char* ca_file, const char
         return -1;
     }
     
-    /* 仅当是证书加密过的才需要提供密码 */
+    /* 仅当是证书加密过的才需要提供密码，context 可能是共享的，密码只设置给本连接 */
     if (ca_pwd != NULL)
     {
-        SSL_CTX_set_default_passwd_cb(tls_client->ssl_ctx, default_pem_passwd_cb);
+        free(tls_client->ca_password);
         tls_client->ca_password = strdup(ca_pwd);
-        SSL_CTX_set_default_passwd_cb_userdata(tls_client->ssl_ctx, tls_client->ca_password);
+        SSL_set_default_passwd_cb(tls_client->ssl, default_pem_passwd_cb);
+        SSL_set_default_passwd_cb_userdata(tls_client->ssl, tls_client->ca_password);
     }
 
     /* client端是否需要配置证书，要看server的协商要求
@@ -211,11 +262,80 @@ int tls_client_use_ca(tls_client_t* tls_client, const char* ca_file, const char
     return 0;
 }
 
+int tls_client_set_context(tls_client_t* tls_client, tls_context_t *context)
+{
+    SSL *ssl;
+
+    if (tls_client == NULL || context == NULL || tls_context_get_mode(context) != TLS_CONTEXT_MODE_CLIENT)
+    {
+        log_error("tls_client_set_context: bad tls_client(%p) or bad context(%p)", tls_client, context);
+        return -1;
+    }
+    if (tls_client->tls_state != TLS_STATE_INIT)
+    {
+        log_error("tls_client_set_context: bad tls state: %d, tls_client: %p", tls_client->tls_state, tls_client);
+        return -1;
+    }
+
+    ssl = new_ssl(context);
+    if (ssl == NULL)
+    {
+        return -1;
+    }
+
+    SSL_free(tls_client->ssl);
+    if (tls_client->is_own_context)
+    {
+        tls_context_destroy(tls_client->context);
+    }
+    tls_client->ssl = ssl;
+    tls_client->context = context;
+    tls_client->is_own_context = 0;
+
+    return 0;
+}
+
+int tls_client_send_early(tls_client_t* tls_client, const void *data, unsigned size)
+{
+    if (tls_client == NULL || data == NULL || size == 0)
+    {
+        log_error("tls_client_send_early: bad tls_client(%p) or bad data(%p) or bad size(%u)", tls_client, data, size);
+        return -1;
+    }
+    if (tls_client->tls_state != TLS_STATE_INIT)
+    {
+        log_error("tls_client_send_early: bad tls state: %d, tls_client: %p", tls_client->tls_state, tls_client);
+        return -1;
+    }
+
+    buffer_append(tls_client->early_buffer, data, (int)size);
+
+    return 0;
+}
+
+int tls_client_set_handshake_pool(tls_client_t* tls_client, tls_worker_pool_t *pool)
+{
+    if (tls_client == NULL)
+    {
+        log_error("tls_client_set_handshake_pool: bad tls_client(%p)", tls_client);
+        return -1;
+    }
+    if (tls_client->tls_state != TLS_STATE_INIT)
+    {
+        log_error("tls_client_set_handshake_pool: bad tls state: %d, tls_client: %p", tls_client->tls_state, tls_client);
+        return -1;
+    }
+
+    tls_client->handshake_pool = pool;
+
+    return 0;
+}
+
 static
 void do_tls_client_destroy(void *userdata)
 {
     tls_client_t *tls_client = (tls_client_t*)userdata;
-    if (tls_client->is_in_callback)
+    if (tls_client->is_in_callback || tls_client->is_offloaded)
     {
         tls_client->is_alive = 0;
     }
@@ -238,6 +358,194 @@ void tls_client_destroy(tls_client_t* tls_client)
     return;
 }
 
+/* 以服务端地址恢复之前的会话，并决定 early data 能否随 ClientHello 发出 */
+static
+void tls_client_prepare_handshake(tls_client_t* tls_client)
+{
+    SSL_SESSION *session;
+    int is_resumed;
+    unsigned early_size;
+
+    is_resumed = tls_context_resume_session(tls_client->context, tls_client->ssl, tls_client->session_key);
+
+    early_size = (unsigned)buffer_readablebytes(tls_client->early_buffer);
+    if (early_size == 0)
+    {
+        tls_client->early_state = EARLY_DATA_NONE;
+        return;
+    }
+
+    session = SSL_get_session(tls_client->ssl);
+    if (is_resumed && tls_context_get_max_early_data(tls_client->context) > 0 && session != NULL &&
+        SSL_SESSION_get_max_early_data(session) >= early_size)
+    {
+        tls_client->early_state = EARLY_DATA_WRITING;
+    }
+    else
+    {
+        tls_client->early_state = EARLY_DATA_DEFERRED;
+    }
+
+    return;
+}
+
+/* 推进一步握手，返回1表示握手完成，0表示尚需等待，-1表示失败 */
+static
+int tls_client_do_handshake(tls_client_t* tls_client)
+{
+    const char *early_data;
+    unsigned early_size;
+    size_t written;
+    int ssl_ret;
+    int ssl_error;
+
+    while (tls_client->early_state == EARLY_DATA_WRITING)
+    {
+        early_data = (const char*)buffer_peek(tls_client->early_buffer);
+        early_size = (unsigned)buffer_readablebytes(tls_client->early_buffer);
+        if (tls_client->early_written >= early_size)
+        {
+            tls_client->early_state = EARLY_DATA_WRITTEN;
+            break;
+        }
+
+        written = 0;
+        ssl_ret = SSL_write_early_data(tls_client->ssl, early_data + tls_client->early_written, early_size - tls_client->early_written, &written);
+        if (ssl_ret == 1)
+        {
+            tls_client->early_written += (unsigned)written;
+            continue;
+        }
+
+        ssl_error = SSL_get_error(tls_client->ssl, ssl_ret);
+        if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+        {
+            return 0;
+        }
+
+        log_error("tls_client_do_handshake: failed to write early data, ssl error: %d, tls_client: %p", ssl_error, tls_client);
+        return -1;
+    }
+
+    ssl_ret = SSL_connect(tls_client->ssl);
+    if (ssl_ret == 1)
+    {
+        return 1;
+    }
+
+    ssl_error = SSL_get_error(tls_client->ssl, ssl_ret);
+    if (ssl_ret < 0 && (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE))
+    {
+        return 0;
+    }
+
+    log_error("tls_client_do_handshake: fatal ssl error: %d, tls state: %d, tls_client: %p", ssl_error, tls_client->tls_state, tls_client);
+
+    return -1;
+}
+
+/* 握手结束，result 为 tls_client_do_handshake() 的非0结果 */
+static
+void tls_client_handshake_finish(tls_client_t* tls_client, int result)
+{
+    if (result > 0)
+    {
+        tls_client->tls_state = TLS_STATE_SNDRCV;
+
+        /* 未被服务端接受或未能作为 early data 发出的数据，握手完成之后照常发送 */
+        if (buffer_readablebytes(tls_client->early_buffer) > 0)
+        {
+            if (tls_client->early_state != EARLY_DATA_WRITTEN || SSL_get_early_data_status(tls_client->ssl) != SSL_EARLY_DATA_ACCEPTED)
+            {
+                buffer_append(tls_client->out_buffer, buffer_peek(tls_client->early_buffer), buffer_readablebytes(tls_client->early_buffer));
+                channel_setevent(tls_client->channel, POLLOUT);
+            }
+            buffer_retrieveall(tls_client->early_buffer);
+        }
+    }
+
+    tls_client->is_in_callback = 1;
+    tls_client->connectcb(tls_client, result > 0, tls_client->userdata);
+    tls_client->is_in_callback = 0;
+
+    return;
+}
+
+/* 在工作线程中执行 */
+static
+void tls_client_handshake_work(void *userdata)
+{
+    tls_client_t *tls_client = (tls_client_t*)userdata;
+
+    tls_client->offload_result = tls_client_do_handshake(tls_client);
+
+    return;
+}
+
+/* 回到 loop 线程中执行 */
+static
+void tls_client_handshake_done(void *userdata)
+{
+    tls_client_t *tls_client = (tls_client_t*)userdata;
+
+    tls_client->is_offloaded = 0;
+    if (tls_client->is_alive == 0)
+    {
+        delete_tls_client(tls_client, 0);
+        return;
+    }
+
+    channel_setevent(tls_client->channel, POLLIN);
+    if (tls_client->offload_result == 0)
+    {
+        if (SSL_want_write(tls_client->ssl))
+        {
+            channel_setevent(tls_client->channel, POLLOUT);
+        }
+        return;
+    }
+
+    tls_client_handshake_finish(tls_client, tls_client->offload_result);
+    if (tls_client->is_alive == 0)
+    {
+        delete_tls_client(tls_client, 0);
+    }
+
+    return;
+}
+
+static
+void tls_client_handshake_step(tls_client_t* tls_client)
+{
+    int result;
+
+    if (tls_client->handshake_pool != NULL)
+    {
+        /* 交给工作线程之后不再检测IO事件，直至其回到 loop 线程 */
+        channel_clearevent(tls_client->channel, POLLIN | POLLOUT);
+        if (tls_worker_pool_submit(tls_client->handshake_pool, tls_client->loop,
+            tls_client_handshake_work, tls_client_handshake_done, tls_client) == 0)
+        {
+            tls_client->is_offloaded = 1;
+            return;
+        }
+
+        /* 提交失败时在 loop 线程中继续 */
+        channel_setevent(tls_client->channel, POLLIN);
+    }
+
+    result = tls_client_do_handshake(tls_client);
+    if (result == 0)
+    {
+        /* keep going and nothing todo */
+        return;
+    }
+
+    tls_client_handshake_finish(tls_client, result);
+
+    return;
+}
+
 static
 void tls_client_onevent(SOCKET fd, int event, void* userdata)
 {
@@ -265,26 +573,8 @@ void tls_client_onevent(SOCKET fd, int event, void* userdata)
             channel_setevent(tls_client->channel, POLLIN);
 
             SSL_set_fd(tls_client->ssl, tls_client->fd);
-            ssl_ret = SSL_connect(tls_client->ssl);
-            ssl_error = SSL_get_error(tls_client->ssl, ssl_ret);
-            if (ssl_ret == 1)
-            {
-                tls_client->tls_state = TLS_STATE_SNDRCV;
-                tls_client->is_in_callback = 1;
-                tls_client->connectcb(tls_client, 1, tls_client->userdata);
-                tls_client->is_in_callback = 0;
-            }
-            else if (ssl_ret < 0 && (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE))
-            {
-                /* keep going and nothing todo */
-            }
-            else
-            {
-                log_error("tls_client_onevent: fatal ssl error: %d, tls state: %d, tls_client: %p", ssl_error, tls_client->tls_state, tls_client);
-                tls_client->is_in_callback = 1;
-                tls_client->connectcb(tls_client, 0, tls_client->userdata);
-                tls_client->is_in_callback = 1;
-            }
+            tls_client_prepare_handshake(tls_client);
+            tls_client_handshake_step(tls_client);
         }
     }
     else if (tls_client->tls_state == TLS_STATE_HANDSHAKE)
@@ -298,26 +588,7 @@ void tls_client_onevent(SOCKET fd, int event, void* userdata)
         }
         else
         {
-            ssl_ret = SSL_connect(tls_client->ssl);
-            ssl_error = SSL_get_error(tls_client->ssl, ssl_ret);
-            if (ssl_ret == 1)
-            {
-                tls_client->tls_state = TLS_STATE_SNDRCV;
-                tls_client->is_in_callback = 1;
-                tls_client->connectcb(tls_client, 1, tls_client->userdata);
-                tls_client->is_in_callback = 0;
-            }
-            else if (ssl_ret < 0 && (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE))
-            {
-                /* keep going and nothing todo */
-            }
-            else
-            {
-                log_error("tls_client_onevent: handeshake state, fatal ssl error: %d, tls state: %d, tls_client: %p", ssl_error, tls_client->tls_state, tls_client);
-                tls_client->is_in_callback = 1;
-                tls_client->connectcb(tls_client, 0, tls_client->userdata);
-                tls_client->is_in_callback = 1;
-            }
+            tls_client_handshake_step(tls_client);
         }
     }
     else if (tls_client->tls_state == TLS_STATE_SNDRCV)
@@ -456,6 +727,8 @@ void do_tls_client_connect(void *userdata)
 
         return;
     }
+    /* 握手的最后一个消息与紧随其后的应用层数据分别写出，避免 Nagle 与对端的延迟确认叠加 */
+    set_socket_nodelay(fd, 1);
     len = sizeof(buffer_size);
     if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, (char*)&buffer_size, &len) == 0)
     {
@@ -714,3 +987,13 @@ int tls_client_send(tls_client_t* tls_client, const void *data, unsigned size)
 
     return 0;
 }
+
+int tls_client_session_reused(tls_client_t* tls_client)
+{
+    if (tls_client == NULL || tls_client->tls_state != TLS_STATE_SNDRCV)
+    {
+        return 0;
+    }
+
+    return SSL_session_reused(tls_client->ssl);
+}
@@ -1,5 +1,10 @@
 
-/** a basic TLSv1.2 client implementation using openssl */
+/** a basic TLS(v1.2 and v1.3) client implementation using openssl
+  *
+  * 多个 client 可经由 tls_client_set_context() 共用同一个 tls_context，
+  * 再次连接同一服务端时即可恢复之前的会话，省去完整握手
+  * 经由 tls_client_set_handshake_pool() 可将握手交给工作线程执行，握手完成之后的收发仍在 loop 线程中进行
+  */
 
 #ifndef TINYLIB_SSL_TLS_CLIENT_H
 #define TINYLIB_SSL_TLS_CLIENT_H
@@ -8,6 +13,8 @@ typedef struct tls_client tls_client_t;
 
 #include "tinylib/net/loop.h"
 #include "tinylib/net/buffer.h"
+#include "tinylib/ssl/tls_context.h"
+#include "tinylib/ssl/tls_worker_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +30,17 @@ tls_client_t* tls_client_new
     tls_client_on_connect_f connectcb, tls_client_on_data_f datacb, tls_client_on_close_f closecb, void *userdata
 );
 
+/* 使用共享的客户端 context 代替 client 自己的 context，需在 tls_client_use_ca() 及 tls_client_connect() 之前调用
+ * context 由调用者持有，需在 client 销毁之后再销毁
+ */
+int tls_client_set_context(tls_client_t* tls_client, tls_context_t *context);
+
+/* 握手(含证书校验及密钥交换)在 pool 的工作线程中进行，完成之后 connectcb 仍在 loop 线程中执行
+ * 需在 tls_client_connect() 之前调用，pool 为NULL时恢复在 loop 线程中握手
+ * pool 由调用者持有，需在 client 销毁之后再销毁
+ */
+int tls_client_set_handshake_pool(tls_client_t* tls_client, tls_worker_pool_t *pool);
+
 /* 根据需要，指定client端使用的证书，仅支持PEM格式 
  * 如果key文件和cert文件是分离的，请通过private_key_file额外提供
  * 如果证书是加密过的，请通过ca_pwd提供密码
@@ -35,6 +53,15 @@ int tls_client_connect(tls_client_t* tls_client);
 
 int tls_client_send(tls_client_t* tls_client, const void *data, unsigned size);
 
+/* 握手完成之后有效，恢复了之前的会话时返回1 */
+int tls_client_session_reused(tls_client_t* tls_client);
+
+/* 在 tls_client_connect() 之前提交首批数据，如请求
+ * context 开启了 early data 且恢复的会话允许时，作为 0-RTT 数据随 ClientHello 发出，
+ * 否则(或被服务端拒绝时)在握手完成之后照常发送；early data 可被重放，只适用于幂等的请求
+ */
+int tls_client_send_early(tls_client_t* tls_client, const void *data, unsigned size);
+
 #ifdef __cplusplus
 }
 #endif
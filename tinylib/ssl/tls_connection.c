@@ -0,0 +1,644 @@
+
+#define LOG_MODULE LOG_MODULE_SSL
+
+#include "tinylib/ssl/tls_connection.h"
+#include "tinylib/util/log.h"
+
+#include <openssl/err.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+enum tls_connection_state
+{
+    TLS_CONNECTION_STATE_HANDSHAKE,
+    TLS_CONNECTION_STATE_ESTABLISHED,
+    TLS_CONNECTION_STATE_CLOSED,
+};
+
+/* 单个 TLS 记录的最大明文尺寸 */
+#define TLS_RECORD_SIZE 16384
+
+struct tls_connection
+{
+    loop_t *loop;
+    tcp_connection_t *connection;
+
+    tls_connection_on_handshake_f handshakecb;
+    tls_connection_on_data_f datacb;
+    tls_connection_on_close_f closecb;
+    void *userdata;
+
+    SSL *ssl;
+    enum tls_connection_state state;
+
+    /* in 只在数据回调期间指向 tcp_connection 的接收缓冲区，out 指向 out_buffer */
+    tls_bio_buffers_t bio_buffers;
+    buffer_t *out_buffer;           /* 尚未交给 tcp_connection 的密文 */
+    buffer_t *in_buffer;            /* 解密后交给使用者的数据 */
+    buffer_t *pending_buffer;       /* 握手完成之前提交的明文 */
+
+    char session_key[32];           /* 客户端缓存会话所用的 key，即服务端地址 */
+    int is_reading_early_data;      /* 服务端正在接收 early data */
+
+    int is_in_callback;
+    int is_alive;
+};
+
+struct tls_connection_send_msg
+{
+    tls_connection_t *tls_connection;
+    void *data;
+    unsigned size;
+};
+
+static
+void delete_tls_connection(tls_connection_t *tls_connection)
+{
+    SSL_free(tls_connection->ssl);
+    buffer_destory(tls_connection->out_buffer);
+    buffer_destory(tls_connection->in_buffer);
+    buffer_destory(tls_connection->pending_buffer);
+    free(tls_connection);
+
+    return;
+}
+
+/* 将积攒的密文以一次写操作交给 tcp_connection */
+static
+void tls_connection_flush(tls_connection_t *tls_connection)
+{
+    int size;
+
+    size = buffer_readablebytes(tls_connection->out_buffer);
+    if (size <= 0)
+    {
+        return;
+    }
+
+    if (NULL != tls_connection->connection)
+    {
+        tcp_connection_send(tls_connection->connection, buffer_peek(tls_connection->out_buffer), size);
+    }
+    buffer_retrieveall(tls_connection->out_buffer);
+
+    return;
+}
+
+static
+void log_ssl_error(const char *where, tls_connection_t *tls_connection, int ssl_error)
+{
+    char reason[256];
+
+    ERR_error_string_n(ERR_peek_last_error(), reason, sizeof(reason));
+    ERR_clear_error();
+    log_error("%s: ssl error(%d): %s, tls_connection: %p, connection: %p",
+        where, ssl_error, reason, tls_connection, tls_connection->connection);
+
+    return;
+}
+
+/* 返回1表示握手完成，0表示需要等待更多的数据，-1表示握手失败 */
+static
+int tls_connection_handshake(tls_connection_t *tls_connection)
+{
+    int ssl_ret;
+    int ssl_error;
+
+    ssl_ret = SSL_do_handshake(tls_connection->ssl);
+    if (ssl_ret == 1)
+    {
+        return 1;
+    }
+
+    ssl_error = SSL_get_error(tls_connection->ssl, ssl_ret);
+    if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+    {
+        return 0;
+    }
+
+    log_ssl_error("tls_connection_handshake", tls_connection, ssl_error);
+
+    return -1;
+}
+
+/* 服务端在握手之前接收客户端的 early data，放入 in_buffer 中待握手完成之后交给使用者
+ * 返回1表示 early data 已接收完毕(或客户端未发送)，0表示需要等待更多的数据，-1表示出错
+ */
+static
+int tls_connection_read_early_data(tls_connection_t *tls_connection)
+{
+    char temp[TLS_RECORD_SIZE];
+    size_t readbytes;
+    int ssl_ret;
+
+    while (1)
+    {
+        readbytes = 0;
+        ssl_ret = SSL_read_early_data(tls_connection->ssl, temp, sizeof(temp), &readbytes);
+        if (readbytes > 0)
+        {
+            buffer_append(tls_connection->in_buffer, temp, (int)readbytes);
+        }
+
+        if (ssl_ret == SSL_READ_EARLY_DATA_FINISH)
+        {
+            return 1;
+        }
+        else if (ssl_ret == SSL_READ_EARLY_DATA_ERROR)
+        {
+            ssl_ret = SSL_get_error(tls_connection->ssl, 0);
+            if (ssl_ret == SSL_ERROR_WANT_READ || ssl_ret == SSL_ERROR_WANT_WRITE)
+            {
+                return 0;
+            }
+
+            log_ssl_error("tls_connection_read_early_data", tls_connection, ssl_ret);
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+/* 解密收到的全部完整记录，返回0表示正常，1表示对端发来了 close_notify，-1表示出错 */
+static
+int tls_connection_decrypt(tls_connection_t *tls_connection)
+{
+    char temp[TLS_RECORD_SIZE];
+    int ssl_ret;
+    int ssl_error;
+
+    while (1)
+    {
+        ssl_ret = SSL_read(tls_connection->ssl, temp, sizeof(temp));
+        if (ssl_ret > 0)
+        {
+            buffer_append(tls_connection->in_buffer, temp, ssl_ret);
+            continue;
+        }
+
+        ssl_error = SSL_get_error(tls_connection->ssl, ssl_ret);
+        if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)
+        {
+            return 0;
+        }
+        else if (ssl_error == SSL_ERROR_ZERO_RETURN)
+        {
+            return 1;
+        }
+        else
+        {
+            log_ssl_error("tls_connection_decrypt", tls_connection, ssl_error);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static
+int tls_connection_encrypt(tls_connection_t *tls_connection, const void *data, int size)
+{
+    int ssl_ret;
+
+    /* 密文写入 out_buffer 总能成功，SSL_write 会一次写完 */
+    ssl_ret = SSL_write(tls_connection->ssl, data, size);
+    if (ssl_ret <= 0)
+    {
+        log_ssl_error("tls_connection_encrypt", tls_connection, SSL_get_error(tls_connection->ssl, ssl_ret));
+        return -1;
+    }
+    assert(ssl_ret == size);
+
+    return 0;
+}
+
+static
+void tls_connection_ondata(tcp_connection_t* connection, buffer_t* buffer, void* userdata)
+{
+    tls_connection_t *tls_connection = (tls_connection_t*)userdata;
+    int result;
+
+    tls_connection->bio_buffers.in = buffer;
+    tls_connection->is_in_callback = 1;
+
+    if (tls_connection->state == TLS_CONNECTION_STATE_HANDSHAKE)
+    {
+        result = 1;
+        if (tls_connection->is_reading_early_data)
+        {
+            result = tls_connection_read_early_data(tls_connection);
+            if (result > 0)
+            {
+                tls_connection->is_reading_early_data = 0;
+            }
+        }
+        if (result > 0)
+        {
+            result = tls_connection_handshake(tls_connection);
+        }
+
+        if (result < 0)
+        {
+            tls_connection->state = TLS_CONNECTION_STATE_CLOSED;
+            /* 先发出 alert，再通知使用者 */
+            tls_connection_flush(tls_connection);
+            if (NULL != tls_connection->handshakecb)
+            {
+                tls_connection->handshakecb(tls_connection, 0, tls_connection->userdata);
+            }
+        }
+        else if (result > 0)
+        {
+            tls_connection->state = TLS_CONNECTION_STATE_ESTABLISHED;
+            /* 握手期间提交的数据排在握手回调中发送的数据之前 */
+            if (buffer_readablebytes(tls_connection->pending_buffer) > 0)
+            {
+                if (tls_connection_encrypt(tls_connection, buffer_peek(tls_connection->pending_buffer),
+                    buffer_readablebytes(tls_connection->pending_buffer)) < 0)
+                {
+                    tls_connection->state = TLS_CONNECTION_STATE_CLOSED;
+                }
+                buffer_retrieveall(tls_connection->pending_buffer);
+            }
+            if (NULL != tls_connection->handshakecb)
+            {
+                tls_connection->handshakecb(tls_connection, tls_connection->state == TLS_CONNECTION_STATE_ESTABLISHED, tls_connection->userdata);
+            }
+        }
+    }
+
+    /* 握手完成之后，同一批数据中可能紧跟着应用层数据 */
+    if (tls_connection->state == TLS_CONNECTION_STATE_ESTABLISHED && tls_connection->is_alive)
+    {
+        result = tls_connection_decrypt(tls_connection);
+        if (buffer_readablebytes(tls_connection->in_buffer) > 0 && NULL != tls_connection->datacb)
+        {
+            tls_connection->datacb(tls_connection, tls_connection->in_buffer, tls_connection->userdata);
+        }
+
+        if (result != 0 && tls_connection->is_alive && tls_connection->state == TLS_CONNECTION_STATE_ESTABLISHED)
+        {
+            if (result > 0)
+            {
+                /* 回应对端的 close_notify，未正常关闭的连接的会话会被 openssl 移出缓存 */
+                SSL_shutdown(tls_connection->ssl);
+            }
+            tls_connection->state = TLS_CONNECTION_STATE_CLOSED;
+            tls_connection_flush(tls_connection);
+            if (NULL != tls_connection->closecb)
+            {
+                tls_connection->closecb(tls_connection, tls_connection->userdata);
+            }
+        }
+    }
+
+    if (tls_connection->state == TLS_CONNECTION_STATE_CLOSED)
+    {
+        /* 关闭之后收到的数据直接丢弃 */
+        buffer_retrieveall(buffer);
+    }
+
+    tls_connection->bio_buffers.in = NULL;
+    tls_connection->is_in_callback = 0;
+
+    /* 本次回调中产生的全部记录(握手消息、使用者的应答)一并发出 */
+    tls_connection_flush(tls_connection);
+
+    if (0 == tls_connection->is_alive)
+    {
+        delete_tls_connection(tls_connection);
+    }
+
+    return;
+}
+
+static
+void tls_connection_onclose(tcp_connection_t* connection, void* userdata)
+{
+    tls_connection_t *tls_connection = (tls_connection_t*)userdata;
+    enum tls_connection_state state = tls_connection->state;
+
+    tls_connection->state = TLS_CONNECTION_STATE_CLOSED;
+    tls_connection->is_in_callback = 1;
+    if (state == TLS_CONNECTION_STATE_HANDSHAKE)
+    {
+        if (NULL != tls_connection->handshakecb)
+        {
+            tls_connection->handshakecb(tls_connection, 0, tls_connection->userdata);
+        }
+    }
+    else if (state == TLS_CONNECTION_STATE_ESTABLISHED)
+    {
+        if (NULL != tls_connection->closecb)
+        {
+            tls_connection->closecb(tls_connection, tls_connection->userdata);
+        }
+    }
+    tls_connection->is_in_callback = 0;
+
+    if (0 == tls_connection->is_alive)
+    {
+        delete_tls_connection(tls_connection);
+    }
+
+    return;
+}
+
+tls_connection_t* tls_connection_new
+(
+    tcp_connection_t *connection, tls_context_t *context,
+    tls_connection_on_handshake_f handshakecb, tls_connection_on_data_f datacb, tls_connection_on_close_f closecb,
+    void *userdata
+)
+{
+    tls_connection_t *tls_connection;
+    const inetaddr_t *peer_addr;
+    SSL *ssl;
+    BIO *bio;
+
+    if (NULL == connection || NULL == context)
+    {
+        log_error("tls_connection_new: bad connection(%p) or bad context(%p)", connection, context);
+        return NULL;
+    }
+
+    ssl = SSL_new(tls_context_get_ssl_ctx(context));
+    if (NULL == ssl)
+    {
+        log_error("tls_connection_new: SSL_new() failed, ssl error: %lu", ERR_get_error());
+        return NULL;
+    }
+
+    tls_connection = (tls_connection_t*)malloc(sizeof(*tls_connection));
+    memset(tls_connection, 0, sizeof(*tls_connection));
+
+    tls_connection->loop = tcp_connection_getloop(connection);
+    tls_connection->connection = connection;
+
+    tls_connection->handshakecb = handshakecb;
+    tls_connection->datacb = datacb;
+    tls_connection->closecb = closecb;
+    tls_connection->userdata = userdata;
+
+    tls_connection->ssl = ssl;
+    tls_connection->state = TLS_CONNECTION_STATE_HANDSHAKE;
+
+    tls_connection->out_buffer = buffer_new(4096);
+    tls_connection->in_buffer = buffer_new(4096);
+    tls_connection->pending_buffer = buffer_new(1024);
+    tls_connection->bio_buffers.in = NULL;
+    tls_connection->bio_buffers.out = tls_connection->out_buffer;
+
+    tls_connection->is_in_callback = 0;
+    tls_connection->is_alive = 1;
+
+    bio = tls_context_new_bio(context, &tls_connection->bio_buffers);
+    if (NULL == bio)
+    {
+        log_error("tls_connection_new: failed to alloc bio, connection: %p", connection);
+        delete_tls_connection(tls_connection);
+        return NULL;
+    }
+    SSL_set_bio(ssl, bio, bio);
+
+    tcp_connection_setcalback(connection, tls_connection_ondata, tls_connection_onclose, tls_connection);
+
+    if (tls_context_get_mode(context) == TLS_CONTEXT_MODE_CLIENT)
+    {
+        /* 以服务端地址恢复之前的会话，之后立即发出 ClientHello */
+        peer_addr = tcp_connection_getpeeraddr(connection);
+        snprintf(tls_connection->session_key, sizeof(tls_connection->session_key), "%s:%u", peer_addr->ip, peer_addr->port);
+        tls_context_resume_session(context, ssl, tls_connection->session_key);
+
+        SSL_set_connect_state(ssl);
+        if (tls_connection_handshake(tls_connection) >= 0)
+        {
+            tls_connection_flush(tls_connection);
+        }
+    }
+    else
+    {
+        SSL_set_accept_state(ssl);
+        tls_connection->is_reading_early_data = (tls_context_get_max_early_data(context) > 0);
+    }
+
+    return tls_connection;
+}
+
+void tls_connection_setcallback
+(
+    tls_connection_t *tls_connection,
+    tls_connection_on_handshake_f handshakecb, tls_connection_on_data_f datacb, tls_connection_on_close_f closecb,
+    void *userdata
+)
+{
+    if (NULL == tls_connection)
+    {
+        return;
+    }
+
+    tls_connection->handshakecb = handshakecb;
+    tls_connection->datacb = datacb;
+    tls_connection->closecb = closecb;
+    tls_connection->userdata = userdata;
+
+    return;
+}
+
+int tls_connection_set_hostname(tls_connection_t *tls_connection, const char *hostname)
+{
+    if (NULL == tls_connection || NULL == hostname)
+    {
+        log_error("tls_connection_set_hostname: bad tls_connection(%p) or bad hostname(%p)", tls_connection, hostname);
+        return -1;
+    }
+
+    return SSL_set_tlsext_host_name(tls_connection->ssl, hostname) == 1 ? 0 : -1;
+}
+
+static
+int do_tls_connection_send(tls_connection_t *tls_connection, const void *data, unsigned size)
+{
+    if (tls_connection->state == TLS_CONNECTION_STATE_HANDSHAKE)
+    {
+        buffer_append(tls_connection->pending_buffer, data, (int)size);
+        return 0;
+    }
+    if (tls_connection->state != TLS_CONNECTION_STATE_ESTABLISHED)
+    {
+        return -1;
+    }
+
+    if (tls_connection_encrypt(tls_connection, data, (int)size) < 0)
+    {
+        return -1;
+    }
+
+    /* 回调中发送的数据在回调返回之后一并发出 */
+    if (0 == tls_connection->is_in_callback)
+    {
+        tls_connection_flush(tls_connection);
+    }
+
+    return 0;
+}
+
+static
+void do_tls_connection_send_msg(void *userdata)
+{
+    struct tls_connection_send_msg *send_msg = (struct tls_connection_send_msg*)userdata;
+
+    do_tls_connection_send(send_msg->tls_connection, send_msg->data, send_msg->size);
+    free(send_msg);
+
+    return;
+}
+
+int tls_connection_send(tls_connection_t *tls_connection, const void *data, unsigned size)
+{
+    struct tls_connection_send_msg *send_msg;
+
+    if (NULL == tls_connection || NULL == data || 0 == size)
+    {
+        log_error("tls_connection_send: bad tls_connection(%p) or bad data(%p) or bad size(%u)", tls_connection, data, size);
+        return -1;
+    }
+
+    if (loop_inloopthread(tls_connection->loop))
+    {
+        return do_tls_connection_send(tls_connection, data, size);
+    }
+
+    send_msg = (struct tls_connection_send_msg*)malloc(sizeof(*send_msg) + size);
+    send_msg->tls_connection = tls_connection;
+    send_msg->data = &send_msg[1];
+    send_msg->size = size;
+    memcpy(send_msg->data, data, size);
+    loop_run_inloop(tls_connection->loop, do_tls_connection_send_msg, send_msg);
+
+    return 0;
+}
+
+int tls_connection_sendv(tls_connection_t *tls_connection, const struct iovec *vecs, int count)
+{
+    struct tls_connection_send_msg *send_msg;
+    unsigned size;
+    int is_in_callback;
+    int result;
+    int i;
+
+    if (NULL == tls_connection || NULL == vecs || count <= 0)
+    {
+        log_error("tls_connection_sendv: bad tls_connection(%p) or bad vecs(%p) or bad count(%d)", tls_connection, vecs, count);
+        return -1;
+    }
+
+    if (loop_inloopthread(tls_connection->loop))
+    {
+        /* 各段分别加密，产生的记录最后一并发出 */
+        is_in_callback = tls_connection->is_in_callback;
+        tls_connection->is_in_callback = 1;
+        result = 0;
+        for (i = 0; i < count && 0 == result; ++i)
+        {
+            if (vecs[i].iov_len > 0)
+            {
+                result = do_tls_connection_send(tls_connection, vecs[i].iov_base, (unsigned)vecs[i].iov_len);
+            }
+        }
+        tls_connection->is_in_callback = is_in_callback;
+        if (0 == is_in_callback)
+        {
+            tls_connection_flush(tls_connection);
+        }
+
+        return result;
+    }
+
+    size = 0;
+    for (i = 0; i < count; ++i)
+    {
+        size += (unsigned)vecs[i].iov_len;
+    }
+    if (0 == size)
+    {
+        return 0;
+    }
+
+    send_msg = (struct tls_connection_send_msg*)malloc(sizeof(*send_msg) + size);
+    send_msg->tls_connection = tls_connection;
+    send_msg->data = &send_msg[1];
+    send_msg->size = 0;
+    for (i = 0; i < count; ++i)
+    {
+        memcpy((char*)send_msg->data + send_msg->size, vecs[i].iov_base, vecs[i].iov_len);
+        send_msg->size += (unsigned)vecs[i].iov_len;
+    }
+    loop_run_inloop(tls_connection->loop, do_tls_connection_send_msg, send_msg);
+
+    return 0;
+}
+
+static
+void do_tls_connection_destroy(void *userdata)
+{
+    tls_connection_t *tls_connection = (tls_connection_t*)userdata;
+
+    if (NULL == tls_connection->connection)
+    {
+        /* 已 destroy 过 */
+        return;
+    }
+
+    if (tls_connection->state == TLS_CONNECTION_STATE_ESTABLISHED)
+    {
+        SSL_shutdown(tls_connection->ssl);
+    }
+    tls_connection->state = TLS_CONNECTION_STATE_CLOSED;
+    tls_connection_flush(tls_connection);
+
+    tcp_connection_destroy(tls_connection->connection);
+    tls_connection->connection = NULL;
+
+    if (tls_connection->is_in_callback)
+    {
+        tls_connection->is_alive = 0;
+    }
+    else
+    {
+        delete_tls_connection(tls_connection);
+    }
+
+    return;
+}
+
+void tls_connection_destroy(tls_connection_t *tls_connection)
+{
+    if (NULL == tls_connection)
+    {
+        return;
+    }
+
+    loop_run_inloop(tls_connection->loop, do_tls_connection_destroy, tls_connection);
+
+    return;
+}
+
+tcp_connection_t* tls_connection_getconnection(tls_connection_t *tls_connection)
+{
+    return (NULL == tls_connection ? NULL : tls_connection->connection);
+}
+
+SSL* tls_connection_getssl(tls_connection_t *tls_connection)
+{
+    return (NULL == tls_connection ? NULL : tls_connection->ssl);
+}
+
+int tls_connection_established(tls_connection_t *tls_connection)
+{
+    return (NULL != tls_connection && tls_connection->state == TLS_CONNECTION_STATE_ESTABLISHED);
+}
@@ -0,0 +1,78 @@
+
+/** 基于 tcp_connection 的 TLS 连接
+  *
+  * SSL 对象不直接持有 socket，密文经由内存中的 buffer 与 tcp_connection 交换:
+  * 收到的密文直接从 tcp_connection 的接收缓冲区中解密，加密产生的记录先积攒在发送缓冲区中，
+  * 每轮处理(一次数据回调、一次发送调用)结束时以一次 tcp_connection_send 全部交出
+  * SSL_CTX 由 tls_context 在连接之间共享
+  *
+  * connection 的回调由 tls_connection 接管，并随 tls_connection_destroy 一并销毁
+  * 因此只适用于调用者独占的连接，如 tcp_server 交出的连接，而 tcp_client 的连接随 tcp_client 销毁，不适用
+  */
+
+#ifndef TINYLIB_SSL_TLS_CONNECTION_H
+#define TINYLIB_SSL_TLS_CONNECTION_H
+
+struct tls_connection;
+typedef struct tls_connection tls_connection_t;
+
+#include "tinylib/ssl/tls_context.h"
+#include "tinylib/net/tcp_connection.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 握手完成(ok为1)或失败(ok为0)，失败之后只需 destroy */
+typedef void (*tls_connection_on_handshake_f)(tls_connection_t* tls_connection, int ok, void* userdata);
+
+/* 解密后的数据 */
+typedef void (*tls_connection_on_data_f)(tls_connection_t* tls_connection, buffer_t* buffer, void* userdata);
+
+/* 对端关闭了 TLS 或 tcp 连接，或者出错 */
+typedef void (*tls_connection_on_close_f)(tls_connection_t* tls_connection, void* userdata);
+
+/* 在 connection 所在的IO线程中调用，客户端立即发起握手，服务端等待对端的 ClientHello
+ * context 为客户端模式时本端为客户端，否则为服务端
+ * 客户端以对端地址在 context 中查找并恢复之前的会话；客户端不发送 early data，
+ * 服务端的 context 开启了 early data 时则接收之，并在握手完成之后随其余数据交给使用者
+ */
+tls_connection_t* tls_connection_new
+(
+    tcp_connection_t *connection, tls_context_t *context,
+    tls_connection_on_handshake_f handshakecb, tls_connection_on_data_f datacb, tls_connection_on_close_f closecb,
+    void *userdata
+);
+
+/* 更换回调，如 tls_server 交出握手完成的连接之后 */
+void tls_connection_setcallback
+(
+    tls_connection_t *tls_connection,
+    tls_connection_on_handshake_f handshakecb, tls_connection_on_data_f datacb, tls_connection_on_close_f closecb,
+    void *userdata
+);
+
+/* 客户端指定 SNI 中的主机名，需在握手完成之前调用 */
+int tls_connection_set_hostname(tls_connection_t *tls_connection, const char *hostname);
+
+/* 握手完成之前提交的数据会先缓存，握手完成之后再发出 */
+int tls_connection_send(tls_connection_t *tls_connection, const void *data, unsigned size);
+
+/* 一次提交多段数据，加密产生的全部记录以一次写操作发出 */
+int tls_connection_sendv(tls_connection_t *tls_connection, const struct iovec *vecs, int count);
+
+/* 已建立 TLS 时先发出 close_notify，之后优雅关闭 tcp 连接，可在回调中调用 */
+void tls_connection_destroy(tls_connection_t *tls_connection);
+
+tcp_connection_t* tls_connection_getconnection(tls_connection_t *tls_connection);
+
+/* 握手完成之后有效，如是否恢复了之前的会话、协商的版本 */
+SSL* tls_connection_getssl(tls_connection_t *tls_connection);
+
+int tls_connection_established(tls_connection_t *tls_connection);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_SSL_TLS_CONNECTION_H */
@@ -0,0 +1,478 @@
+
+#define LOG_MODULE LOG_MODULE_SSL
+
+#include "tinylib/ssl/tls_context.h"
+#include "tinylib/util/log.h"
+#include "tinylib/util/lock.h"
+
+#include <openssl/err.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* 客户端会话缓存中的一项，key 为服务端地址 */
+typedef struct tls_session_entry
+{
+    char key[64];
+    SSL_SESSION *session;
+}tls_session_entry_t;
+
+struct tls_context
+{
+    enum tls_context_mode mode;
+    SSL_CTX *ssl_ctx;
+    BIO_METHOD *bio_method;
+    char *ca_password;
+    unsigned max_early_data;
+
+    /* 以 ex_data 记录每个 SSL 的会话 key，新会话回调中据此缓存 */
+    int key_index;
+    lock_t session_lock;
+    tls_session_entry_t *sessions;
+    unsigned session_slots;
+};
+
+static
+unsigned session_key_hash(const char *key)
+{
+    unsigned hash;
+
+    hash = 2166136261u;
+    while (*key != '\0')
+    {
+        hash ^= (unsigned char)*key;
+        hash *= 16777619u;
+        key++;
+    }
+
+    return hash;
+}
+
+static
+unsigned round_up_power_of_2(unsigned size)
+{
+    unsigned slots = 1;
+
+    while (slots < size)
+    {
+        slots <<= 1;
+    }
+
+    return slots;
+}
+
+static
+void clear_sessions(tls_context_t *context)
+{
+    unsigned i;
+
+    for (i = 0; i < context->session_slots; ++i)
+    {
+        if (NULL != context->sessions[i].session)
+        {
+            SSL_SESSION_free(context->sessions[i].session);
+            context->sessions[i].session = NULL;
+        }
+    }
+
+    return;
+}
+
+/* 客户端得到新的会话(握手完成或收到 TLSv1.3 的 NewSessionTicket)，返回1表示接管了 session 的引用 */
+static
+int client_onnewsession(SSL *ssl, SSL_SESSION *session)
+{
+    tls_context_t *context = (tls_context_t*)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    const char *key = (const char*)SSL_get_ex_data(ssl, context->key_index);
+    tls_session_entry_t *entry;
+    SSL_SESSION *replaced;
+
+    if (NULL == key || strlen(key) >= sizeof(entry->key) || !SSL_SESSION_is_resumable(session))
+    {
+        return 0;
+    }
+
+    lock_it(&context->session_lock);
+    entry = &context->sessions[session_key_hash(key) & (context->session_slots - 1)];
+    replaced = entry->session;
+    strcpy(entry->key, key);
+    entry->session = session;
+    unlock_it(&context->session_lock);
+
+    if (NULL != replaced)
+    {
+        SSL_SESSION_free(replaced);
+    }
+
+    return 1;
+}
+
+static
+int buffer_bio_write(BIO *bio, const char *data, int size)
+{
+    tls_bio_buffers_t *buffers = (tls_bio_buffers_t*)BIO_get_data(bio);
+
+    BIO_clear_retry_flags(bio);
+    if (NULL == buffers->out)
+    {
+        BIO_set_retry_write(bio);
+        return -1;
+    }
+
+    return buffer_append(buffers->out, data, size);
+}
+
+static
+int buffer_bio_read(BIO *bio, char *data, int size)
+{
+    tls_bio_buffers_t *buffers = (tls_bio_buffers_t*)BIO_get_data(bio);
+    int readable;
+
+    BIO_clear_retry_flags(bio);
+    readable = (NULL == buffers->in) ? 0 : buffer_readablebytes(buffers->in);
+    if (readable <= 0)
+    {
+        BIO_set_retry_read(bio);
+        return -1;
+    }
+
+    if (size > readable)
+    {
+        size = readable;
+    }
+    memcpy(data, buffer_peek(buffers->in), size);
+    buffer_retrieve(buffers->in, size);
+
+    return size;
+}
+
+static
+long buffer_bio_ctrl(BIO *bio, int cmd, long num, void *ptr)
+{
+    tls_bio_buffers_t *buffers = (tls_bio_buffers_t*)BIO_get_data(bio);
+    long ret;
+
+    switch (cmd)
+    {
+        case BIO_CTRL_PENDING:
+        {
+            ret = (NULL == buffers->in) ? 0 : buffer_readablebytes(buffers->in);
+            break;
+        }
+        case BIO_CTRL_WPENDING:
+        {
+            ret = (NULL == buffers->out) ? 0 : buffer_readablebytes(buffers->out);
+            break;
+        }
+        case BIO_CTRL_FLUSH:
+        case BIO_CTRL_DUP:
+        {
+            /* 密文何时发出由使用者决定 */
+            ret = 1;
+            break;
+        }
+        default:
+        {
+            ret = 0;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+static
+int buffer_bio_destroy(BIO *bio)
+{
+    BIO_set_data(bio, NULL);
+    BIO_set_init(bio, 0);
+    return 1;
+}
+
+static
+int default_pem_passwd_cb(char *buf, int size, int rwflag, void *password)
+{
+    size_t password_len = strlen(password);
+
+    if (password_len >= (size_t)size)
+    {
+        password_len = size - 1;
+    }
+    memcpy(buf, password, password_len);
+    buf[password_len] = '\0';
+
+    return (int)password_len;
+}
+
+tls_context_t* tls_context_new(enum tls_context_mode mode)
+{
+    static const unsigned char session_id_context[] = "tinylib";
+
+    tls_context_t *context;
+    SSL_CTX *ssl_ctx;
+    BIO_METHOD *bio_method;
+
+    if (mode != TLS_CONTEXT_MODE_CLIENT && mode != TLS_CONTEXT_MODE_SERVER)
+    {
+        log_error("tls_context_new: bad mode(%d)", mode);
+        return NULL;
+    }
+
+    ssl_ctx = SSL_CTX_new(mode == TLS_CONTEXT_MODE_SERVER ? TLS_server_method() : TLS_client_method());
+    if (NULL == ssl_ctx)
+    {
+        log_error("tls_context_new: failed to alloc ssl context, ssl error: %lu", ERR_get_error());
+        return NULL;
+    }
+
+    bio_method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "tinylib buffer");
+    if (NULL == bio_method)
+    {
+        log_error("tls_context_new: failed to alloc bio method");
+        SSL_CTX_free(ssl_ctx);
+        return NULL;
+    }
+    BIO_meth_set_write(bio_method, buffer_bio_write);
+    BIO_meth_set_read(bio_method, buffer_bio_read);
+    BIO_meth_set_ctrl(bio_method, buffer_bio_ctrl);
+    BIO_meth_set_destroy(bio_method, buffer_bio_destroy);
+
+    SSL_CTX_set_min_proto_version(ssl_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_mode(ssl_ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_AUTO_RETRY | SSL_MODE_RELEASE_BUFFERS);
+
+    context = (tls_context_t*)malloc(sizeof(*context));
+    memset(context, 0, sizeof(*context));
+
+    context->mode = mode;
+    context->ssl_ctx = ssl_ctx;
+    context->bio_method = bio_method;
+    context->ca_password = NULL;
+    context->max_early_data = 0;
+
+    context->key_index = -1;
+    context->sessions = NULL;
+    context->session_slots = 0;
+    lock_init(&context->session_lock);
+
+    SSL_CTX_set_app_data(ssl_ctx, context);
+    SSL_CTX_set_timeout(ssl_ctx, TLS_CONTEXT_DEFAULT_SESSION_TIMEOUT);
+
+    if (mode == TLS_CONTEXT_MODE_SERVER)
+    {
+        /* 全部连接共用同一个会话缓存，客户端凭会话ID或 ticket 即可恢复会话，省去完整握手 */
+        SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_set_session_id_context(ssl_ctx, session_id_context, sizeof(session_id_context) - 1);
+        SSL_CTX_sess_set_cache_size(ssl_ctx, TLS_CONTEXT_DEFAULT_SESSION_CACHE_SIZE);
+    }
+    else
+    {
+        /* 会话由本模块按服务端地址缓存，不使用 openssl 内部的客户端缓存 */
+        context->key_index = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+        context->session_slots = round_up_power_of_2(TLS_CONTEXT_DEFAULT_SESSION_CACHE_SIZE);
+        context->sessions = (tls_session_entry_t*)malloc(sizeof(tls_session_entry_t) * context->session_slots);
+        memset(context->sessions, 0, sizeof(tls_session_entry_t) * context->session_slots);
+
+        SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ssl_ctx, client_onnewsession);
+    }
+
+    return context;
+}
+
+void tls_context_destroy(tls_context_t *context)
+{
+    if (NULL == context)
+    {
+        return;
+    }
+
+    SSL_CTX_free(context->ssl_ctx);
+    BIO_meth_free(context->bio_method);
+    free(context->ca_password);
+    if (NULL != context->sessions)
+    {
+        clear_sessions(context);
+        free(context->sessions);
+    }
+    lock_uninit(&context->session_lock);
+    free(context);
+
+    return;
+}
+
+int tls_context_use_certificate(tls_context_t *context, const char *cert_file, const char *private_key_file, const char *ca_pwd)
+{
+    if (NULL == context || NULL == cert_file)
+    {
+        log_error("tls_context_use_certificate: bad context(%p) or bad cert_file(%p)", context, cert_file);
+        return -1;
+    }
+
+    /* 仅当是证书加密过的才需要提供密码 */
+    if (NULL != ca_pwd)
+    {
+        free(context->ca_password);
+        context->ca_password = strdup(ca_pwd);
+        SSL_CTX_set_default_passwd_cb(context->ssl_ctx, default_pem_passwd_cb);
+        SSL_CTX_set_default_passwd_cb_userdata(context->ssl_ctx, context->ca_password);
+    }
+
+    if (SSL_CTX_use_certificate_chain_file(context->ssl_ctx, cert_file) != 1)
+    {
+        log_error("tls_context_use_certificate: failed to load certificate %s, ssl error: %lu", cert_file, ERR_get_error());
+        return -1;
+    }
+
+    if (NULL == private_key_file)
+    {
+        private_key_file = cert_file;
+    }
+    if (SSL_CTX_use_PrivateKey_file(context->ssl_ctx, private_key_file, SSL_FILETYPE_PEM) != 1)
+    {
+        log_error("tls_context_use_certificate: failed to load private key %s, ssl error: %lu", private_key_file, ERR_get_error());
+        return -1;
+    }
+
+    if (SSL_CTX_check_private_key(context->ssl_ctx) != 1)
+    {
+        log_error("tls_context_use_certificate: private key does not match the certificate, ssl error: %lu", ERR_get_error());
+        return -1;
+    }
+
+    return 0;
+}
+
+void tls_context_set_session_cache(tls_context_t *context, unsigned size, unsigned timeout)
+{
+    if (NULL == context)
+    {
+        return;
+    }
+
+    if (size > 0)
+    {
+        if (context->mode == TLS_CONTEXT_MODE_SERVER)
+        {
+            SSL_CTX_sess_set_cache_size(context->ssl_ctx, size);
+        }
+        else
+        {
+            lock_it(&context->session_lock);
+            clear_sessions(context);
+            free(context->sessions);
+            context->session_slots = round_up_power_of_2(size);
+            context->sessions = (tls_session_entry_t*)malloc(sizeof(tls_session_entry_t) * context->session_slots);
+            memset(context->sessions, 0, sizeof(tls_session_entry_t) * context->session_slots);
+            unlock_it(&context->session_lock);
+        }
+    }
+    if (timeout > 0)
+    {
+        SSL_CTX_set_timeout(context->ssl_ctx, timeout);
+    }
+
+    return;
+}
+
+void tls_context_set_max_early_data(tls_context_t *context, unsigned max_early_data)
+{
+    if (NULL == context)
+    {
+        return;
+    }
+
+    context->max_early_data = max_early_data;
+    if (context->mode == TLS_CONTEXT_MODE_SERVER)
+    {
+        /* 服务端为0时拒绝 early data，ticket 中也不再声明接受 */
+        SSL_CTX_set_max_early_data(context->ssl_ctx, max_early_data);
+        SSL_CTX_set_recv_max_early_data(context->ssl_ctx, max_early_data);
+    }
+
+    return;
+}
+
+unsigned tls_context_get_max_early_data(tls_context_t *context)
+{
+    return (NULL == context ? 0 : context->max_early_data);
+}
+
+int tls_context_resume_session(tls_context_t *context, SSL *ssl, const char *key)
+{
+    tls_session_entry_t *entry;
+    SSL_SESSION *session;
+    int result;
+
+    if (NULL == context || NULL == ssl || NULL == key)
+    {
+        log_error("tls_context_resume_session: bad context(%p) or bad ssl(%p) or bad key(%p)", context, ssl, key);
+        return 0;
+    }
+
+    if (context->mode != TLS_CONTEXT_MODE_CLIENT)
+    {
+        return 0;
+    }
+
+    SSL_set_ex_data(ssl, context->key_index, (void*)key);
+
+    session = NULL;
+    lock_it(&context->session_lock);
+    entry = &context->sessions[session_key_hash(key) & (context->session_slots - 1)];
+    if (NULL != entry->session && strcmp(entry->key, key) == 0)
+    {
+        session = entry->session;
+        if (SSL_SESSION_get_protocol_version(session) >= TLS1_3_VERSION)
+        {
+            /* ticket 只使用一次，连接之后服务端会下发新的 ticket */
+            entry->session = NULL;
+        }
+        else
+        {
+            SSL_SESSION_up_ref(session);
+        }
+    }
+    unlock_it(&context->session_lock);
+
+    if (NULL == session)
+    {
+        return 0;
+    }
+
+    /* 过期的会话在握手时自然转为完整握手 */
+    result = SSL_set_session(ssl, session);
+    SSL_SESSION_free(session);
+
+    return (result == 1 ? 1 : 0);
+}
+
+enum tls_context_mode tls_context_get_mode(tls_context_t *context)
+{
+    return context->mode;
+}
+
+SSL_CTX* tls_context_get_ssl_ctx(tls_context_t *context)
+{
+    return (NULL == context ? NULL : context->ssl_ctx);
+}
+
+BIO* tls_context_new_bio(tls_context_t *context, tls_bio_buffers_t *buffers)
+{
+    BIO *bio;
+
+    if (NULL == context || NULL == buffers)
+    {
+        log_error("tls_context_new_bio: bad context(%p) or bad buffers(%p)", context, buffers);
+        return NULL;
+    }
+
+    bio = BIO_new(context->bio_method);
+    if (NULL == bio)
+    {
+        return NULL;
+    }
+    BIO_set_data(bio, buffers);
+    BIO_set_init(bio, 1);
+
+    return bio;
+}
@@ -0,0 +1,86 @@
+
+/** 可在多个 TLS 连接之间共享的 SSL_CTX，含证书、会话缓存等配置
+  *
+  * 每个连接各自创建 SSL_CTX 的开销很大(证书与私钥的解析、内存占用)，且无法复用会话
+  * 同一类连接应共用一个 tls_context，其可跨 loop 线程使用，需在全部使用它的连接销毁之后再销毁
+  *
+  * 客户端模式下，按服务端地址缓存最近一次得到的会话(会话ID或 TLSv1.3 ticket)，
+  * 再次连接同一服务端时据此恢复会话，省去证书校验及密钥交换的开销
+  * TLSv1.3 的 ticket 只使用一次，恢复之后即从缓存中移出，等待服务端下发新的 ticket
+  */
+
+#ifndef TINYLIB_SSL_TLS_CONTEXT_H
+#define TINYLIB_SSL_TLS_CONTEXT_H
+
+struct tls_context;
+typedef struct tls_context tls_context_t;
+
+#include "tinylib/net/buffer.h"
+
+#include <openssl/ssl.h>
+
+enum tls_context_mode
+{
+    TLS_CONTEXT_MODE_CLIENT,
+    TLS_CONTEXT_MODE_SERVER,
+};
+
+/* 密文的收发缓冲区，可随时更换其中的 buffer */
+typedef struct tls_bio_buffers
+{
+    buffer_t *in;
+    buffer_t *out;
+}tls_bio_buffers_t;
+
+/* 会话缓存的默认条目数及超时(s)，客户端的缓存按地址直接映射，冲突的地址相互替换 */
+#define TLS_CONTEXT_DEFAULT_SESSION_CACHE_SIZE 1024
+#define TLS_CONTEXT_DEFAULT_SESSION_TIMEOUT 300
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 支持 TLSv1.2 及以上的版本 */
+tls_context_t* tls_context_new(enum tls_context_mode mode);
+
+void tls_context_destroy(tls_context_t *context);
+
+/* 指定本端使用的证书，仅支持PEM格式，服务端必须指定
+ * 如果key文件和cert文件是分离的，请通过private_key_file额外提供
+ * 如果证书是加密过的，请通过ca_pwd提供密码
+ */
+int tls_context_use_certificate(tls_context_t *context, const char *cert_file, const char *private_key_file, const char *ca_pwd);
+
+/* 设置会话缓存的条目数及超时(s)，为0时保持原值，客户端的条目数需在建立连接之前设置 */
+void tls_context_set_session_cache(tls_context_t *context, unsigned size, unsigned timeout);
+
+/* 开启 TLSv1.3 的 0-RTT early data，默认关闭
+ * 服务端最多接收 max_early_data 字节的 early data，随握手完成之后的数据一并交给使用者
+ * 客户端则允许在恢复会话时，将握手完成之前提交的数据作为 early data 随 ClientHello 发出
+ * early data 可被重放，只适用于幂等的请求
+ */
+void tls_context_set_max_early_data(tls_context_t *context, unsigned max_early_data);
+
+unsigned tls_context_get_max_early_data(tls_context_t *context);
+
+/* 客户端在握手之前调用: 以 key(如服务端的 "ip:port")查找缓存的会话并设置给 ssl，
+ * 握手之后得到的新会话也以 key 缓存；key 由调用者持有，需在 ssl 释放之后才能释放
+ * 找到可恢复的会话时返回1，否则返回0
+ */
+int tls_context_resume_session(tls_context_t *context, SSL *ssl, const char *key);
+
+enum tls_context_mode tls_context_get_mode(tls_context_t *context);
+
+/* 取得底层的 SSL_CTX，以便设置本模块未涵盖的选项 */
+SSL_CTX* tls_context_get_ssl_ctx(tls_context_t *context);
+
+/* 创建以 buffer_t 收发密文的 BIO，读取时从 in 中取出密文，写入的密文追加到 out 中
+ * in 为 NULL 或没有数据时读取返回重试，buffers 由调用者持有，需在 BIO 释放之后才能释放
+ */
+BIO* tls_context_new_bio(tls_context_t *context, tls_bio_buffers_t *buffers);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_SSL_TLS_CONTEXT_H */
@@ -0,0 +1,287 @@
+
+#define LOG_MODULE LOG_MODULE_SSL
+
+#include "tinylib/ssl/tls_server.h"
+#include "tinylib/util/log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* 尚未完成握手的连接 */
+typedef struct tls_handshake
+{
+    tls_server_t *server;
+    tls_connection_t *tls_connection;
+    loop_timer_t *timer;
+
+    struct tls_handshake *prev;
+    struct tls_handshake *next;
+}tls_handshake_t;
+
+struct tls_server
+{
+    loop_t *loop;
+    tcp_server_t *tcp_server;
+    tls_context_t *context;
+
+    tls_server_on_connection_f onconn;
+    void *userdata;
+
+    unsigned handshake_timeout;
+    tls_handshake_t *handshakes;
+
+    int is_in_callback;
+    int is_alive;
+};
+
+static
+void handshake_unlink(tls_handshake_t *handshake)
+{
+    tls_server_t *server = handshake->server;
+
+    if (NULL != handshake->prev)
+    {
+        handshake->prev->next = handshake->next;
+    }
+    else
+    {
+        server->handshakes = handshake->next;
+    }
+    if (NULL != handshake->next)
+    {
+        handshake->next->prev = handshake->prev;
+    }
+
+    if (NULL != handshake->timer)
+    {
+        loop_cancel(server->loop, handshake->timer);
+        handshake->timer = NULL;
+    }
+
+    return;
+}
+
+static
+void delete_server(tls_server_t *server)
+{
+    tls_handshake_t *handshake;
+
+    tcp_server_destroy(server->tcp_server);
+
+    while (NULL != server->handshakes)
+    {
+        handshake = server->handshakes;
+        handshake_unlink(handshake);
+        tls_connection_destroy(handshake->tls_connection);
+        free(handshake);
+    }
+
+    free(server);
+
+    return;
+}
+
+static
+void server_onhandshake(tls_connection_t* tls_connection, int ok, void* userdata)
+{
+    tls_handshake_t *handshake = (tls_handshake_t*)userdata;
+    tls_server_t *server = handshake->server;
+    const inetaddr_t *peer_addr = tcp_connection_getpeeraddr(tls_connection_getconnection(tls_connection));
+
+    handshake_unlink(handshake);
+    free(handshake);
+
+    if (ok)
+    {
+        log_debug("server_onhandshake: tls connection from %s:%u is established, resumed: %d",
+            peer_addr->ip, peer_addr->port, SSL_session_reused(tls_connection_getssl(tls_connection)));
+
+        tls_connection_setcallback(tls_connection, NULL, NULL, NULL, NULL);
+        server->is_in_callback = 1;
+        server->onconn(tls_connection, server->userdata, peer_addr);
+        server->is_in_callback = 0;
+    }
+    else
+    {
+        log_warn("server_onhandshake: tls handshake with %s:%u failed", peer_addr->ip, peer_addr->port);
+        tls_connection_destroy(tls_connection);
+    }
+
+    if (0 == server->is_alive)
+    {
+        delete_server(server);
+    }
+
+    return;
+}
+
+static
+void server_onhandshaketimeout(void *userdata)
+{
+    tls_handshake_t *handshake = (tls_handshake_t*)userdata;
+    tls_connection_t *tls_connection = handshake->tls_connection;
+    const inetaddr_t *peer_addr = tcp_connection_getpeeraddr(tls_connection_getconnection(tls_connection));
+
+    log_warn("server_onhandshaketimeout: tls handshake with %s:%u was not completed in %u ms",
+        peer_addr->ip, peer_addr->port, handshake->server->handshake_timeout);
+
+    handshake->timer = NULL;
+    handshake_unlink(handshake);
+    free(handshake);
+    tls_connection_destroy(tls_connection);
+
+    return;
+}
+
+static
+void server_onconnection(tcp_connection_t* connection, void* userdata, const inetaddr_t* peer_addr)
+{
+    tls_server_t *server = (tls_server_t*)userdata;
+    tls_handshake_t *handshake;
+
+    handshake = (tls_handshake_t*)malloc(sizeof(*handshake));
+    memset(handshake, 0, sizeof(*handshake));
+    handshake->server = server;
+
+    handshake->tls_connection = tls_connection_new(connection, server->context, server_onhandshake, NULL, NULL, handshake);
+    if (NULL == handshake->tls_connection)
+    {
+        log_error("server_onconnection: failed to create tls connection for %s:%u", peer_addr->ip, peer_addr->port);
+        free(handshake);
+        tcp_connection_destroy(connection);
+        return;
+    }
+
+    handshake->prev = NULL;
+    handshake->next = server->handshakes;
+    if (NULL != server->handshakes)
+    {
+        server->handshakes->prev = handshake;
+    }
+    server->handshakes = handshake;
+
+    if (server->handshake_timeout > 0)
+    {
+        handshake->timer = loop_runafter(server->loop, server->handshake_timeout, server_onhandshaketimeout, handshake);
+    }
+
+    return;
+}
+
+tls_server_t* tls_server_new
+(
+    loop_t *loop, tls_context_t *context, tls_server_on_connection_f onconn, void *userdata,
+    unsigned short port, const char* ip
+)
+{
+    tls_server_t *server;
+
+    if (NULL == loop || NULL == context || NULL == onconn || 0 == port || NULL == ip)
+    {
+        log_error("tls_server_new: bad loop(%p) or bad context(%p) or bad onconn(%p) or bad port(%u) or bad ip(%p)",
+            loop, context, onconn, port, ip);
+        return NULL;
+    }
+
+    if (tls_context_get_mode(context) != TLS_CONTEXT_MODE_SERVER)
+    {
+        log_error("tls_server_new: context(%p) is not in server mode", context);
+        return NULL;
+    }
+
+    server = (tls_server_t*)malloc(sizeof(*server));
+    memset(server, 0, sizeof(*server));
+
+    server->tcp_server = tcp_server_new(loop, server_onconnection, server, port, ip);
+    if (NULL == server->tcp_server)
+    {
+        free(server);
+        return NULL;
+    }
+
+    server->loop = loop;
+    server->context = context;
+    server->onconn = onconn;
+    server->userdata = userdata;
+    server->handshake_timeout = TLS_SERVER_DEFAULT_HANDSHAKE_TIMEOUT;
+    server->handshakes = NULL;
+    server->is_in_callback = 0;
+    server->is_alive = 1;
+
+    return server;
+}
+
+static
+void do_tls_server_destroy(void *userdata)
+{
+    tls_server_t *server = (tls_server_t*)userdata;
+
+    if (server->is_in_callback)
+    {
+        server->is_alive = 0;
+    }
+    else
+    {
+        delete_server(server);
+    }
+
+    return;
+}
+
+void tls_server_destroy(tls_server_t *server)
+{
+    if (NULL == server)
+    {
+        return;
+    }
+
+    loop_run_inloop(server->loop, do_tls_server_destroy, server);
+
+    return;
+}
+
+void tls_server_set_options(tls_server_t *server, const socket_options_t *options)
+{
+    if (NULL == server)
+    {
+        return;
+    }
+
+    tcp_server_set_options(server->tcp_server, options);
+
+    return;
+}
+
+void tls_server_set_handshake_timeout(tls_server_t *server, unsigned timeout)
+{
+    if (NULL == server)
+    {
+        return;
+    }
+
+    server->handshake_timeout = timeout;
+
+    return;
+}
+
+int tls_server_start(tls_server_t *server)
+{
+    if (NULL == server)
+    {
+        return -1;
+    }
+
+    return tcp_server_start(server->tcp_server);
+}
+
+void tls_server_stop(tls_server_t *server)
+{
+    if (NULL == server)
+    {
+        return;
+    }
+
+    tcp_server_stop(server->tcp_server);
+
+    return;
+}
@@ -0,0 +1,51 @@
+
+/** 基于 tcp_server 与 tls_connection 的 TLS 服务端
+  *
+  * 全部连接共用 context 中的 SSL_CTX 及会话缓存，握手由 tls_server 负责，
+  * 握手完成之后才以 onconn 将连接交给使用者，握手失败或超时的连接直接关闭
+  */
+
+#ifndef TINYLIB_SSL_TLS_SERVER_H
+#define TINYLIB_SSL_TLS_SERVER_H
+
+struct tls_server;
+typedef struct tls_server tls_server_t;
+
+#include "tinylib/ssl/tls_connection.h"
+#include "tinylib/net/tcp_server.h"
+
+/* 默认的握手超时(ms) */
+#define TLS_SERVER_DEFAULT_HANDSHAKE_TIMEOUT 10000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 握手完成的连接，使用者需在其中以 tls_connection_setcallback() 设置数据及关闭回调，并负责销毁 */
+typedef void (*tls_server_on_connection_f)(tls_connection_t* tls_connection, void* userdata, const inetaddr_t* peer_addr);
+
+/* context 需为服务端模式且已设置证书，由调用者持有，需在 tls_server 销毁之后再销毁 */
+tls_server_t* tls_server_new
+(
+    loop_t *loop, tls_context_t *context, tls_server_on_connection_f onconn, void *userdata,
+    unsigned short port, const char* ip
+);
+
+/* 尚未完成握手的连接一并关闭 */
+void tls_server_destroy(tls_server_t *server);
+
+/* 设置监听 socket 及 accept 出的连接所用的选项，需在 tls_server_start() 之前调用 */
+void tls_server_set_options(tls_server_t *server, const socket_options_t *options);
+
+/* 设置握手超时(ms)，为0时不限时 */
+void tls_server_set_handshake_timeout(tls_server_t *server, unsigned timeout);
+
+int tls_server_start(tls_server_t *server);
+
+void tls_server_stop(tls_server_t *server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_SSL_TLS_SERVER_H */
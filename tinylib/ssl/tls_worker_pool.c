@@ -0,0 +1,322 @@
+
+#define LOG_MODULE LOG_MODULE_SSL
+
+#include "tinylib/ssl/tls_worker_pool.h"
+#include "tinylib/util/log.h"
+#include "tinylib/util/lock.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+    #include <windows.h>
+    #include <process.h>
+    #include <errno.h>
+
+    typedef HANDLE worker_thread_t;
+    typedef CONDITION_VARIABLE worker_cond_t;
+#else
+    #include <pthread.h>
+
+    typedef pthread_t worker_thread_t;
+    typedef pthread_cond_t worker_cond_t;
+#endif
+
+typedef struct tls_worker_job
+{
+    loop_t *loop;
+    tls_worker_f work;
+    tls_worker_f done;
+    void *userdata;
+
+    struct tls_worker_job *next;
+}tls_worker_job_t;
+
+struct tls_worker_pool
+{
+    worker_thread_t *threads;
+    unsigned thread_count;
+
+    lock_t lock;
+    worker_cond_t cond;
+    tls_worker_job_t *jobs;
+    tls_worker_job_t *jobs_end;
+    int is_quit;
+};
+
+/* 条件变量与线程的平台差异，互斥锁使用 tinylib/util/lock.h */
+#ifdef WIN32
+
+static inline
+void cond_init(worker_cond_t *cond)
+{
+    InitializeConditionVariable(cond);
+    return;
+}
+
+static inline
+void cond_uninit(worker_cond_t *cond)
+{
+    return;
+}
+
+static inline
+void cond_wait(worker_cond_t *cond, lock_t *lock)
+{
+    SleepConditionVariableCS(cond, lock, INFINITE);
+    return;
+}
+
+static inline
+void cond_signal(worker_cond_t *cond)
+{
+    WakeConditionVariable(cond);
+    return;
+}
+
+static inline
+void cond_broadcast(worker_cond_t *cond)
+{
+    WakeAllConditionVariable(cond);
+    return;
+}
+
+#else
+
+static inline
+void cond_init(worker_cond_t *cond)
+{
+    pthread_cond_init(cond, NULL);
+    return;
+}
+
+static inline
+void cond_uninit(worker_cond_t *cond)
+{
+    pthread_cond_destroy(cond);
+    return;
+}
+
+static inline
+void cond_wait(worker_cond_t *cond, lock_t *lock)
+{
+    pthread_cond_wait(cond, lock);
+    return;
+}
+
+static inline
+void cond_signal(worker_cond_t *cond)
+{
+    pthread_cond_signal(cond);
+    return;
+}
+
+static inline
+void cond_broadcast(worker_cond_t *cond)
+{
+    pthread_cond_broadcast(cond);
+    return;
+}
+
+#endif
+
+static
+void tls_worker_run(tls_worker_pool_t *pool)
+{
+    tls_worker_job_t *job;
+
+    while (1)
+    {
+        lock_it(&pool->lock);
+        while (NULL == pool->jobs && 0 == pool->is_quit)
+        {
+            cond_wait(&pool->cond, &pool->lock);
+        }
+
+        /* 退出之前先把已提交的任务执行完 */
+        job = pool->jobs;
+        if (NULL == job)
+        {
+            unlock_it(&pool->lock);
+            break;
+        }
+        pool->jobs = job->next;
+        if (NULL == pool->jobs)
+        {
+            pool->jobs_end = NULL;
+        }
+        unlock_it(&pool->lock);
+
+        job->work(job->userdata);
+        loop_async(job->loop, job->done, job->userdata);
+        free(job);
+    }
+
+    return;
+}
+
+#ifdef WIN32
+
+static
+unsigned __stdcall tls_worker_entry(void *arg)
+{
+    tls_worker_run((tls_worker_pool_t*)arg);
+    return 0;
+}
+
+static
+int thread_start(worker_thread_t *thread, tls_worker_pool_t *pool)
+{
+    *thread = (HANDLE)_beginthreadex(NULL, 0, tls_worker_entry, pool, 0, NULL);
+    if (0 == *thread)
+    {
+        log_error("tls_worker_pool_new: _beginthreadex() failed, errno: %d", errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+static
+void thread_join(worker_thread_t thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    return;
+}
+
+#else
+
+static
+void* tls_worker_entry(void *arg)
+{
+    tls_worker_run((tls_worker_pool_t*)arg);
+    return NULL;
+}
+
+static
+int thread_start(worker_thread_t *thread, tls_worker_pool_t *pool)
+{
+    int ret;
+
+    ret = pthread_create(thread, NULL, tls_worker_entry, pool);
+    if (0 != ret)
+    {
+        log_error("tls_worker_pool_new: pthread_create() failed, errno: %d", ret);
+        return -1;
+    }
+
+    return 0;
+}
+
+static
+void thread_join(worker_thread_t thread)
+{
+    pthread_join(thread, NULL);
+    return;
+}
+
+#endif
+
+tls_worker_pool_t* tls_worker_pool_new(unsigned threads)
+{
+    tls_worker_pool_t *pool;
+    unsigned i;
+
+    if (0 == threads)
+    {
+        log_error("tls_worker_pool_new: bad threads(%u)", threads);
+        return NULL;
+    }
+
+    pool = (tls_worker_pool_t*)malloc(sizeof(*pool));
+    memset(pool, 0, sizeof(*pool));
+
+    lock_init(&pool->lock);
+    cond_init(&pool->cond);
+    pool->jobs = NULL;
+    pool->jobs_end = NULL;
+    pool->is_quit = 0;
+
+    pool->threads = (worker_thread_t*)malloc(sizeof(worker_thread_t) * threads);
+    pool->thread_count = 0;
+    for (i = 0; i < threads; ++i)
+    {
+        if (0 != thread_start(&pool->threads[i], pool))
+        {
+            tls_worker_pool_destroy(pool);
+            return NULL;
+        }
+        pool->thread_count++;
+    }
+
+    return pool;
+}
+
+void tls_worker_pool_destroy(tls_worker_pool_t *pool)
+{
+    unsigned i;
+
+    if (NULL == pool)
+    {
+        return;
+    }
+
+    lock_it(&pool->lock);
+    pool->is_quit = 1;
+    cond_broadcast(&pool->cond);
+    unlock_it(&pool->lock);
+
+    for (i = 0; i < pool->thread_count; ++i)
+    {
+        thread_join(pool->threads[i]);
+    }
+
+    cond_uninit(&pool->cond);
+    lock_uninit(&pool->lock);
+    free(pool->threads);
+    free(pool);
+
+    return;
+}
+
+int tls_worker_pool_submit(tls_worker_pool_t *pool, loop_t *loop, tls_worker_f work, tls_worker_f done, void *userdata)
+{
+    tls_worker_job_t *job;
+
+    if (NULL == pool || NULL == loop || NULL == work || NULL == done)
+    {
+        log_error("tls_worker_pool_submit: bad pool(%p) or bad loop(%p) or bad work(%p) or bad done(%p)",
+            pool, loop, work, done);
+        return -1;
+    }
+
+    job = (tls_worker_job_t*)malloc(sizeof(*job));
+    job->loop = loop;
+    job->work = work;
+    job->done = done;
+    job->userdata = userdata;
+    job->next = NULL;
+
+    lock_it(&pool->lock);
+    if (pool->is_quit)
+    {
+        unlock_it(&pool->lock);
+        free(job);
+        log_error("tls_worker_pool_submit: pool(%p) is being destroyed", pool);
+        return -1;
+    }
+    if (NULL == pool->jobs_end)
+    {
+        pool->jobs = job;
+    }
+    else
+    {
+        pool->jobs_end->next = job;
+    }
+    pool->jobs_end = job;
+    cond_signal(&pool->cond);
+    unlock_it(&pool->lock);
+
+    return 0;
+}
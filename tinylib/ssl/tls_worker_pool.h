@@ -0,0 +1,38 @@
+
+/** 执行 TLS 握手等密集计算的工作线程池
+  *
+  * 完整握手中的签名校验及密钥交换(RSA/ECDHE)耗时可达毫秒级，在 loop 线程中执行时，
+  * 一批连接同时(重)连会让同一 loop 上的其它连接全部停顿；交给线程池执行之后，loop 线程只负责收发
+  *
+  * 任务在工作线程中执行完毕之后，其完成回调经由 loop_async() 回到提交任务的 loop 线程中执行
+  * 一个线程池可被多个 loop 共用，需在全部使用它的连接销毁之后再销毁
+  */
+
+#ifndef TINYLIB_SSL_TLS_WORKER_POOL_H
+#define TINYLIB_SSL_TLS_WORKER_POOL_H
+
+struct tls_worker_pool;
+typedef struct tls_worker_pool tls_worker_pool_t;
+
+#include "tinylib/net/loop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*tls_worker_f)(void *userdata);
+
+/* threads 为工作线程的个数 */
+tls_worker_pool_t* tls_worker_pool_new(unsigned threads);
+
+/* 已提交的任务执行完毕之后才返回 */
+void tls_worker_pool_destroy(tls_worker_pool_t *pool);
+
+/* work 在某个工作线程中执行，之后 done 在 loop 线程中执行，可在任意线程中调用 */
+int tls_worker_pool_submit(tls_worker_pool_t *pool, loop_t *loop, tls_worker_f work, tls_worker_f done, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_SSL_TLS_WORKER_POOL_H */
@@ -25,6 +25,12 @@ typedef long atomic_t;
 
 #define atomic_cas_ptr(pptr, ptr_comp, ptr_value)  (InterlockedCompareExchangePointer((PVOID*)(pptr), (ptr_value), (ptr_comp)))
 
+/* 64位的值，32位平台上也是原子的，返回旧值 */
+#define atomic_cas64(atomic, comp, value)  (InterlockedCompareExchange64((LONGLONG volatile*)(atomic), (LONGLONG)(value), (LONGLONG)(comp)))
+
+/* 完整的内存屏障 */
+#define atomic_barrier() MemoryBarrier()
+
 #elif defined(__GNUC__)
 
 /* 返回旧值 */
@@ -44,6 +50,12 @@ typedef long atomic_t;
 
 #define atomic_cas_ptr(pptr, ptr_comp, ptr_value)        (__sync_val_compare_and_swap((pptr), (ptr_comp), (ptr_value)))
 
+/* 64位的值，32位平台上也是原子的，返回旧值 */
+#define atomic_cas64(atomic, comp, value)  (__sync_val_compare_and_swap((atomic), (comp), (value)))
+
+/* 完整的内存屏障 */
+#define atomic_barrier() __sync_synchronize()
+
 #endif
 
 #endif /* !TINYLIB_UTIL_ATOMIC_H */
@@ -0,0 +1,160 @@
+
+#include "tinylib/util/histogram.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+    #include <intrin.h>     /* for _BitScanReverse64() */
+#endif
+
+/* 每个2的幂区间均分的桶数为 2^HISTOGRAM_SUB_BITS */
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_LINEAR (HISTOGRAM_SUB_COUNT * 2)
+
+static inline
+unsigned highest_bit(unsigned long long value)
+{
+  #ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (unsigned)index;
+  #else
+    return 63 - (unsigned)__builtin_clzll(value);
+  #endif
+}
+
+static inline
+unsigned bucket_index(unsigned long long value)
+{
+    unsigned bit;
+    unsigned index;
+
+    if (value < HISTOGRAM_LINEAR)
+    {
+        return (unsigned)value;
+    }
+
+    /* 最高位决定所在的2的幂区间，其后的 HISTOGRAM_SUB_BITS 位决定区间内的桶 */
+    bit = highest_bit(value);
+    index = HISTOGRAM_LINEAR + (bit - (HISTOGRAM_SUB_BITS + 1)) * HISTOGRAM_SUB_COUNT
+        + (unsigned)((value >> (bit - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_COUNT - 1));
+    if (index >= HISTOGRAM_BUCKETS)
+    {
+        index = HISTOGRAM_BUCKETS - 1;
+    }
+
+    return index;
+}
+
+static inline
+unsigned long long bucket_upper(unsigned index)
+{
+    unsigned bit;
+    unsigned sub;
+
+    if (index < HISTOGRAM_LINEAR)
+    {
+        return index;
+    }
+
+    bit = (index - HISTOGRAM_LINEAR) / HISTOGRAM_SUB_COUNT + (HISTOGRAM_SUB_BITS + 1);
+    sub = (index - HISTOGRAM_LINEAR) % HISTOGRAM_SUB_COUNT;
+
+    return ((unsigned long long)(HISTOGRAM_SUB_COUNT + sub + 1) << (bit - HISTOGRAM_SUB_BITS)) - 1;
+}
+
+void histogram_reset(histogram_t *histogram)
+{
+    if (NULL != histogram)
+    {
+        memset(histogram, 0, sizeof(*histogram));
+    }
+
+    return;
+}
+
+void histogram_record(histogram_t *histogram, unsigned long long value)
+{
+    if (0 == histogram->count || value < histogram->min)
+    {
+        histogram->min = value;
+    }
+    if (value > histogram->max)
+    {
+        histogram->max = value;
+    }
+    histogram->count++;
+    histogram->sum += value;
+    histogram->buckets[bucket_index(value)]++;
+
+    return;
+}
+
+void histogram_merge(histogram_t *dst, const histogram_t *src)
+{
+    unsigned i;
+
+    if (NULL == dst || NULL == src || 0 == src->count)
+    {
+        return;
+    }
+
+    if (0 == dst->count || src->min < dst->min)
+    {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max)
+    {
+        dst->max = src->max;
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    for (i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        dst->buckets[i] += src->buckets[i];
+    }
+
+    return;
+}
+
+unsigned long long histogram_percentile(const histogram_t *histogram, double percentile)
+{
+    unsigned long long rank;
+    unsigned long long seen;
+    unsigned long long upper;
+    unsigned i;
+
+    if (NULL == histogram || 0 == histogram->count)
+    {
+        return 0;
+    }
+
+    if (percentile <= 0)
+    {
+        return histogram->min;
+    }
+    if (percentile >= 100)
+    {
+        return histogram->max;
+    }
+
+    rank = (unsigned long long)(histogram->count * percentile / 100);
+    if (rank * 100 < histogram->count * percentile)
+    {
+        rank++;
+    }
+
+    seen = 0;
+    for (i = 0; i < HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= rank)
+        {
+            break;
+        }
+    }
+
+    upper = bucket_upper(i);
+    return (upper > histogram->max) ? histogram->max : upper;
+}
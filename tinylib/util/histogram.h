@@ -0,0 +1,42 @@
+
+/* 对数分桶的直方图，用于记录耗时、时延等分布
+ *
+ * 小于16的值各占一个桶，之后每个2的幂区间再均分为8个桶，相对误差不超过 1/8，
+ * 可记录到 2^40，更大的值计入最后一个桶(max 仍是准确的)
+ *
+ * 记录只是数组下标计算及累加，不分配内存，也不加锁
+ */
+
+#ifndef TINYLIB_UTIL_HISTOGRAM_H
+#define TINYLIB_UTIL_HISTOGRAM_H
+
+#define HISTOGRAM_BUCKETS 304
+
+typedef struct histogram
+{
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long min;
+    unsigned long long max;
+    unsigned long long buckets[HISTOGRAM_BUCKETS];
+}histogram_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void histogram_reset(histogram_t *histogram);
+
+void histogram_record(histogram_t *histogram, unsigned long long value);
+
+/* 把 src 的记录累加到 dst 中 */
+void histogram_merge(histogram_t *dst, const histogram_t *src);
+
+/* percentile 取值 0~100，返回不小于该比例记录的最小值，为所在桶的上界(不超过 max)，无记录时返回0 */
+unsigned long long histogram_percentile(const histogram_t *histogram, double percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_UTIL_HISTOGRAM_H */
@@ -1,42 +1,42 @@
 
 #include "tinylib/util/log.h"
 #include "tinylib/util/util.h"
+#include "tinylib/util/atomic.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <time.h>
 #include <string.h>
 
 #ifdef WIN32
-    #include <windows.h>        /* for GetLocalTime() */
+    #include <windows.h>
 #elif defined(__linux__)
     #include <sys/time.h>       /* for gettimeofday() */
+    #include <sys/uio.h>
+    #include <sys/stat.h>
+    #include <pthread.h>
+    #include <signal.h>
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <errno.h>
 #endif
 
-static log_level_e g_log_level = LOG_LEVEL_INFO;
+/* 单条日志(含头部)的最大长度 */
+#define LOG_LINE_MAX 1280
+
+volatile int g_log_levels[LOG_MODULE_COUNT] = {LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO, LOG_LEVEL_INFO};
+static int g_level_is_set = 0;     /* 级别是否已由 log_setlevel()/log_setmodulelevel() 显式设置 */
 static FILE *g_out_fp = NULL;
 
+/* 格式化一行日志，返回其长度(含末尾的换行) */
 static
-void log_write(log_level_e level, const char *file, int line, const char *fmt, va_list ap)
+int log_format(char *buffer, log_level_e level, const char *file, int line, const char *fmt, va_list ap)
 {
-    char content[1024];
-    char time_head[28]; /* 2014-08-17 12:37:00.555 */
     const char *level_text = "NONE";
-    
-    FILE *fp;
-
-  #ifdef WIN32
-    SYSTEMTIME systime;
-  #elif defined(__linux__)
-    struct timeval tv;
-    time_t tt;
-    struct tm *tm;
-  #endif
-
-    if (g_log_level < level)
-    {
-        return;
-    }
+    int len;
+    int ret;
 
     if (LOG_LEVEL_LOG == level)
     {
@@ -59,21 +59,40 @@ void log_write(log_level_e level, const char *file, int line, const char *fmt, v
         level_text = "DEBUG";
     }
 
-    memset(time_head, 0, sizeof(time_head));
-  #ifdef WIN32
-    GetLocalTime(&systime);
-    snprintf(time_head, sizeof(time_head)-1, "%u-%02u-%02u %02u:%02u:%02u.%03u", 
-        systime.wYear, systime.wMonth, systime.wDay, systime.wHour, systime.wMinute, systime.wSecond, systime.wMilliseconds);
-  #elif defined(__linux__)
-    gettimeofday(&tv, NULL);
-    tt = tv.tv_sec;
-    tm = localtime(&tt);
-    snprintf(time_head, sizeof(time_head)-1, "%u-%02u-%02u %02u:%02u:%02u.%03u", 
-        tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec, (unsigned)(tv.tv_usec/1000));
-  #endif
+    /* [2014-08-17 12:37:00.555]，loop 线程中取本轮迭代缓存的时间，秒以上的部分按线程缓存 */
+    buffer[0] = '[';
+    len = 1 + time_format_local(buffer + 1, time_cache_now_ms());
+    buffer[len++] = ']';
+    ret = snprintf(buffer + len, LOG_LINE_MAX - len, "[%s] thread: %d on %s:%d ", level_text, current_tid(), file, line);
+    len = (ret < 0) ? LOG_LINE_MAX : len + ret;
+    if (len < 0 || len >= LOG_LINE_MAX - 1)
+    {
+        len = LOG_LINE_MAX - 2;
+    }
+
+    ret = vsnprintf(buffer + len, LOG_LINE_MAX - 1 - len, fmt, ap);
+    if (ret > 0)
+    {
+        len += ret;
+        if (len > LOG_LINE_MAX - 2)
+        {
+            len = LOG_LINE_MAX - 2;
+        }
+    }
+    buffer[len++] = '\n';
+    buffer[len] = '\0';
+
+    return len;
+}
+
+static
+void log_write(log_level_e level, const char *file, int line, const char *fmt, va_list ap)
+{
+    char buffer[LOG_LINE_MAX];
+    int len;
+    FILE *fp;
 
-    memset(content, 0, sizeof(content));
-    vsnprintf(content, sizeof(content)-1, fmt, ap);
+    len = log_format(buffer, level, file, line, fmt, ap);
 
     fp = g_out_fp;
     if (NULL == fp)
@@ -81,19 +100,39 @@ void log_write(log_level_e level, const char *file, int line, const char *fmt, v
         fp = stderr;
     }
 
-    fprintf(fp, "[%s][%s] thread: %d on %s:%d %s\n", time_head, level_text, current_tid(), file, line, content);
+    fwrite(buffer, 1, len, fp);
 
     return;
 }
 
 static print_f g_print = log_write;
 
+static
+void set_all_levels(log_level_e level)
+{
+    int i;
+
+    for (i = 0; i < LOG_MODULE_COUNT; ++i)
+    {
+        g_log_levels[i] = level;
+    }
+    atomic_barrier();
+
+    return;
+}
+
 void log_init(print_f printcb)
 {
     if (NULL != printcb)
     {
         g_print = printcb;
+        if (0 == g_level_is_set)
+        {
+            set_all_levels(LOG_LEVEL_DEBUG);
+        }
     }
+
+    return;
 }
 
 void log_file(const char *file)
@@ -110,16 +149,684 @@ void log_file(const char *file)
 
 void log_setlevel(log_level_e level)
 {
-    g_log_level = level;
+    g_level_is_set = 1;
+    set_all_levels(level);
+
+    return;
+}
+
+void log_setmodulelevel(log_module_e module, log_level_e level)
+{
+    if (module < LOG_MODULE_COUNT)
+    {
+        g_level_is_set = 1;
+        g_log_levels[module] = level;
+        atomic_barrier();
+    }
+
+    return;
+}
+
+log_level_e log_getlevel(log_module_e module)
+{
+    if (module >= LOG_MODULE_COUNT)
+    {
+        return LOG_LEVEL_NONE;
+    }
+
+    return (log_level_e)g_log_levels[module];
 }
 
 void log_print(log_level_e level, const char *file, int line, const char *fmt, ...)
 {
     va_list ap;
 
+    if (!log_enabled(LOG_MODULE_DEFAULT, level))
+    {
+        return;
+    }
+
     va_start(ap, fmt);
     g_print(level, file, line, fmt, ap);
     va_end(ap);
 
     return;
 }
+
+void log_output(log_level_e level, const char *file, int line, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    g_print(level, file, line, fmt, ap);
+    va_end(ap);
+
+    return;
+}
+
+int log_ratelimit_check(log_ratelimit_t *ratelimit, unsigned interval, long *suppressed)
+{
+    unsigned long long now;
+    unsigned long long last;
+
+    now = ts_ms();
+    last = ratelimit->last_ms;
+    if ((0 != last && now - last < interval) || (unsigned long long)atomic_cas64(&ratelimit->last_ms, last, now) != last)
+    {
+        (void)atomic_inc(&ratelimit->suppressed);
+        return 0;
+    }
+
+    *suppressed = atomic_set(&ratelimit->suppressed, 0);
+
+    return 1;
+}
+
+#if defined(__linux__)
+
+#define LOG_ASYNC_DEFAULT_RING_SIZE (64*1024)
+#define LOG_ASYNC_MIN_RING_SIZE (4*1024)
+#define LOG_ASYNC_DEFAULT_FLUSH_INTERVAL 100
+
+/* 后台线程每次 writev() 最多聚合的片段数 */
+#define LOG_ASYNC_MAX_IOV 64
+
+/* 单生产者(所属线程)单消费者(后台线程)的环形缓冲区，head/tail 只增不减，按 capacity 取模 */
+typedef struct log_ring
+{
+    struct log_ring *next;
+    volatile unsigned long head;    /* 只由所属线程修改 */
+    volatile unsigned long tail;    /* 只由后台线程修改 */
+    int is_dead;                    /* 所属线程已退出，输出完之后由后台线程释放 */
+    unsigned capacity;
+    char data[1];
+}log_ring_t;
+
+static struct
+{
+    volatile int is_running;
+    int is_stopping;
+    log_async_config_t config;
+    char file[256];
+
+    int fd;
+    unsigned long long file_size;
+    time_t opened_at;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake_cond;
+    pthread_cond_t flush_cond;
+    unsigned long flush_requested;
+    unsigned long flush_done;
+
+    log_ring_t *rings;              /* 由 mutex 保护 */
+    atomic_t dropped;
+}g_async = {0, 0, {0}, {0}, -1, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, NULL, 0};
+
+static pthread_once_t g_ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_ring_key;
+static __thread log_ring_t *t_ring = NULL;
+
+static
+void on_thread_exit(void *userdata)
+{
+    log_ring_t *ring = (log_ring_t*)userdata;
+    log_ring_t **pos;
+
+    pthread_mutex_lock(&g_async.mutex);
+    if (g_async.is_running)
+    {
+        ring->is_dead = 1;
+    }
+    else
+    {
+        for (pos = &g_async.rings; NULL != *pos; pos = &(*pos)->next)
+        {
+            if (*pos == ring)
+            {
+                *pos = ring->next;
+                break;
+            }
+        }
+        free(ring);
+    }
+    pthread_mutex_unlock(&g_async.mutex);
+
+    return;
+}
+
+static
+void create_ring_key(void)
+{
+    pthread_key_create(&g_ring_key, on_thread_exit);
+    return;
+}
+
+static
+log_ring_t* get_ring(void)
+{
+    log_ring_t *ring;
+    unsigned capacity;
+
+    if (NULL != t_ring)
+    {
+        return t_ring;
+    }
+
+    capacity = LOG_ASYNC_MIN_RING_SIZE;
+    while (capacity < g_async.config.ring_size)
+    {
+        capacity <<= 1;
+    }
+
+    ring = (log_ring_t*)malloc(offsetof(log_ring_t, data) + capacity);
+    memset(ring, 0, offsetof(log_ring_t, data));
+    ring->capacity = capacity;
+
+    pthread_mutex_lock(&g_async.mutex);
+    ring->next = g_async.rings;
+    g_async.rings = ring;
+    pthread_mutex_unlock(&g_async.mutex);
+
+    pthread_once(&g_ring_key_once, create_ring_key);
+    pthread_setspecific(g_ring_key, ring);
+    t_ring = ring;
+
+    return ring;
+}
+
+static
+void ring_push(log_ring_t *ring, const char *line, unsigned len)
+{
+    unsigned long head;
+    unsigned offset;
+    unsigned first;
+
+    head = ring->head;
+    while (ring->capacity - (head - ring->tail) < len)
+    {
+        if (LOG_OVERFLOW_DROP == g_async.config.overflow || 0 == g_async.is_running)
+        {
+            (void)atomic_inc(&g_async.dropped);
+            return;
+        }
+
+        /* 阻塞策略: 唤醒后台线程，等待其腾出空间 */
+        pthread_cond_signal(&g_async.wake_cond);
+        usleep(1000);
+    }
+    __sync_synchronize();   /* 确认 tail 之后才能覆盖已被输出的区域 */
+
+    offset = (unsigned)(head & (ring->capacity - 1));
+    first = ring->capacity - offset;
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(ring->data + offset, line, first);
+    memcpy(ring->data, line + first, len - first);
+
+    __sync_synchronize();   /* 数据先于 head 对后台线程可见 */
+    ring->head = head + len;
+
+    /* 超过一半时提前唤醒后台线程，不必等到刷新间隔 */
+    if ((head + len - ring->tail) * 2 > ring->capacity)
+    {
+        pthread_cond_signal(&g_async.wake_cond);
+    }
+
+    return;
+}
+
+static
+void log_async_write(log_level_e level, const char *file, int line, const char *fmt, va_list ap)
+{
+    char buffer[LOG_LINE_MAX];
+    int len;
+
+    if (0 == g_async.is_running)
+    {
+        log_write(level, file, line, fmt, ap);
+        return;
+    }
+
+    len = log_format(buffer, level, file, line, fmt, ap);
+    ring_push(get_ring(), buffer, (unsigned)len);
+
+    return;
+}
+
+/* 写出全部片段，处理部分写及 EINTR */
+static
+void writev_all(int fd, struct iovec *iovs, int count)
+{
+    ssize_t ret;
+
+    while (count > 0)
+    {
+        ret = writev(fd, iovs, count);
+        if (ret < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return;
+        }
+
+        while (count > 0 && (size_t)ret >= iovs->iov_len)
+        {
+            ret -= iovs->iov_len;
+            iovs++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iovs->iov_base = (char*)iovs->iov_base + ret;
+            iovs->iov_len -= ret;
+        }
+    }
+
+    return;
+}
+
+static
+int open_log_file(void)
+{
+    struct stat st;
+
+    g_async.fd = open(g_async.file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (g_async.fd < 0)
+    {
+        return -1;
+    }
+
+    g_async.file_size = 0;
+    if (fstat(g_async.fd, &st) == 0)
+    {
+        g_async.file_size = st.st_size;
+    }
+    g_async.opened_at = time(NULL);
+
+    return 0;
+}
+
+/* file -> file.1 -> file.2 ... 超出保留个数的最旧文件被覆盖 */
+static
+void rotate_log_file(void)
+{
+    char from[sizeof(g_async.file) + 16];
+    char to[sizeof(g_async.file) + 16];
+    unsigned i;
+
+    close(g_async.fd);
+    g_async.fd = -1;
+
+    if (g_async.config.rotate_keep > 0)
+    {
+        for (i = g_async.config.rotate_keep; i > 1; --i)
+        {
+            snprintf(from, sizeof(from), "%s.%u", g_async.file, i - 1);
+            snprintf(to, sizeof(to), "%s.%u", g_async.file, i);
+            rename(from, to);
+        }
+        snprintf(to, sizeof(to), "%s.1", g_async.file);
+        rename(g_async.file, to);
+    }
+    else
+    {
+        unlink(g_async.file);
+    }
+
+    if (open_log_file() != 0)
+    {
+        g_async.fd = STDERR_FILENO;
+    }
+
+    return;
+}
+
+static
+void write_batch(struct iovec *iovs, int count, unsigned long long size, log_ring_t **rings, unsigned long *heads, int ring_count)
+{
+    int i;
+
+    if ('\0' != g_async.file[0] && STDERR_FILENO != g_async.fd)
+    {
+        if ((g_async.config.rotate_size > 0 && g_async.file_size > 0 && g_async.file_size + size > g_async.config.rotate_size) ||
+            (g_async.config.rotate_interval > 0 && time(NULL) - g_async.opened_at >= (time_t)g_async.config.rotate_interval))
+        {
+            rotate_log_file();
+        }
+    }
+
+    writev_all(g_async.fd, iovs, count);
+    g_async.file_size += size;
+
+    __sync_synchronize();   /* 输出完之后才能把空间还给生产者 */
+    for (i = 0; i < ring_count; ++i)
+    {
+        rings[i]->tail = heads[i];
+    }
+
+    return;
+}
+
+/* 把全部线程缓冲区中的日志聚合成尽量少的 writev() 输出 */
+static
+void drain_rings(void)
+{
+    struct iovec iovs[LOG_ASYNC_MAX_IOV];
+    log_ring_t *rings[LOG_ASYNC_MAX_IOV/2];
+    unsigned long heads[LOG_ASYNC_MAX_IOV/2];
+    unsigned long long size = 0;
+    int count = 0;
+    int ring_count = 0;
+    log_ring_t *ring;
+    log_ring_t **pos;
+    unsigned long head;
+    unsigned long tail;
+    unsigned offset;
+    unsigned len;
+
+    pthread_mutex_lock(&g_async.mutex);
+
+    for (ring = g_async.rings; NULL != ring; ring = ring->next)
+    {
+        head = ring->head;
+        __sync_synchronize();
+        tail = ring->tail;
+        if (head == tail)
+        {
+            continue;
+        }
+
+        if (count + 2 > LOG_ASYNC_MAX_IOV)
+        {
+            write_batch(iovs, count, size, rings, heads, ring_count);
+            count = 0;
+            ring_count = 0;
+            size = 0;
+        }
+
+        offset = (unsigned)(tail & (ring->capacity - 1));
+        len = (unsigned)(head - tail);
+        iovs[count].iov_base = ring->data + offset;
+        if (offset + len > ring->capacity)
+        {
+            iovs[count].iov_len = ring->capacity - offset;
+            count++;
+            iovs[count].iov_base = ring->data;
+            iovs[count].iov_len = offset + len - ring->capacity;
+        }
+        else
+        {
+            iovs[count].iov_len = len;
+        }
+        count++;
+        size += len;
+        rings[ring_count] = ring;
+        heads[ring_count] = head;
+        ring_count++;
+    }
+    if (count > 0)
+    {
+        write_batch(iovs, count, size, rings, heads, ring_count);
+    }
+
+    /* 释放已退出且已输出完的线程的缓冲区 */
+    pos = &g_async.rings;
+    while (NULL != *pos)
+    {
+        ring = *pos;
+        if (ring->is_dead && ring->head == ring->tail)
+        {
+            *pos = ring->next;
+            free(ring);
+        }
+        else
+        {
+            pos = &ring->next;
+        }
+    }
+
+    pthread_mutex_unlock(&g_async.mutex);
+
+    return;
+}
+
+static
+void* log_async_entry(void *arg)
+{
+    struct timespec ts;
+    struct timeval tv;
+    unsigned long requested;
+    unsigned long long usec;
+    int is_stopping;
+
+    while (1)
+    {
+        pthread_mutex_lock(&g_async.mutex);
+        if (0 == g_async.is_stopping && g_async.flush_requested == g_async.flush_done)
+        {
+            gettimeofday(&tv, NULL);
+            usec = tv.tv_usec + (unsigned long long)g_async.config.flush_interval * 1000;
+            ts.tv_sec = tv.tv_sec + usec / 1000000;
+            ts.tv_nsec = (usec % 1000000) * 1000;
+            pthread_cond_timedwait(&g_async.wake_cond, &g_async.mutex, &ts);
+        }
+        requested = g_async.flush_requested;
+        is_stopping = g_async.is_stopping;
+        pthread_mutex_unlock(&g_async.mutex);
+
+        drain_rings();
+
+        pthread_mutex_lock(&g_async.mutex);
+        g_async.flush_done = requested;
+        pthread_cond_broadcast(&g_async.flush_cond);
+        pthread_mutex_unlock(&g_async.mutex);
+
+        if (is_stopping)
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static
+void log_async_onsignal(int sig)
+{
+    log_async_crash_flush();
+
+    /* SA_RESETHAND 已恢复默认处理，再次触发以产生 core */
+    raise(sig);
+
+    return;
+}
+
+int log_async_start(const log_async_config_t *config)
+{
+    static const int signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+    static int is_atexit_registered = 0;
+
+    struct sigaction action;
+    unsigned i;
+
+    if (NULL == config || (NULL != config->file && strlen(config->file) >= sizeof(g_async.file)))
+    {
+        log_error("log_async_start: bad config(%p) or file name too long", config);
+        return -1;
+    }
+    if (g_async.is_running || log_write != g_print)
+    {
+        log_error("log_async_start: async logging was already started or a custom print function was set");
+        return -1;
+    }
+
+    g_async.config = *config;
+    g_async.config.file = NULL;
+    if (0 == g_async.config.ring_size)
+    {
+        g_async.config.ring_size = LOG_ASYNC_DEFAULT_RING_SIZE;
+    }
+    if (0 == g_async.config.flush_interval)
+    {
+        g_async.config.flush_interval = LOG_ASYNC_DEFAULT_FLUSH_INTERVAL;
+    }
+
+    if (NULL != config->file)
+    {
+        strcpy(g_async.file, config->file);
+        if (open_log_file() != 0)
+        {
+            log_error("log_async_start: failed to open %s, errno: %d", config->file, errno);
+            g_async.file[0] = '\0';
+            return -1;
+        }
+    }
+    else
+    {
+        g_async.file[0] = '\0';
+        g_async.fd = STDERR_FILENO;
+    }
+
+    g_async.is_stopping = 0;
+    g_async.flush_requested = 0;
+    g_async.flush_done = 0;
+    g_async.is_running = 1;
+    if (pthread_create(&g_async.thread, NULL, log_async_entry, NULL) != 0)
+    {
+        g_async.is_running = 0;
+        if (STDERR_FILENO != g_async.fd)
+        {
+            close(g_async.fd);
+        }
+        g_async.fd = -1;
+        log_error("log_async_start: failed to create the logging thread, errno: %d", errno);
+        return -1;
+    }
+
+    if (config->crash_flush)
+    {
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = log_async_onsignal;
+        action.sa_flags = SA_RESETHAND;
+        sigemptyset(&action.sa_mask);
+        for (i = 0; i < sizeof(signals)/sizeof(signals[0]); ++i)
+        {
+            sigaction(signals[i], &action, NULL);
+        }
+    }
+
+    if (0 == is_atexit_registered)
+    {
+        is_atexit_registered = 1;
+        atexit(log_async_stop);
+    }
+
+    g_print = log_async_write;
+
+    return 0;
+}
+
+void log_async_stop(void)
+{
+    if (0 == g_async.is_running)
+    {
+        return;
+    }
+
+    g_print = log_write;
+
+    pthread_mutex_lock(&g_async.mutex);
+    g_async.is_stopping = 1;
+    pthread_cond_signal(&g_async.wake_cond);
+    pthread_mutex_unlock(&g_async.mutex);
+    pthread_join(g_async.thread, NULL);
+
+    pthread_mutex_lock(&g_async.mutex);
+    g_async.is_running = 0;
+    pthread_mutex_unlock(&g_async.mutex);
+
+    /* 停止之后到达的少量日志仍留在缓冲区中，同步输出 */
+    drain_rings();
+
+    if (STDERR_FILENO != g_async.fd)
+    {
+        close(g_async.fd);
+    }
+    g_async.fd = -1;
+
+    return;
+}
+
+void log_async_flush(void)
+{
+    unsigned long seq;
+
+    if (0 == g_async.is_running)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_async.mutex);
+    seq = ++g_async.flush_requested;
+    pthread_cond_signal(&g_async.wake_cond);
+    while (g_async.is_running && (long)(g_async.flush_done - seq) < 0)
+    {
+        pthread_cond_wait(&g_async.flush_cond, &g_async.mutex);
+    }
+    pthread_mutex_unlock(&g_async.mutex);
+
+    return;
+}
+
+void log_async_crash_flush(void)
+{
+    log_ring_t *ring;
+    unsigned long head;
+    unsigned long tail;
+    unsigned offset;
+    unsigned len;
+    ssize_t ret;
+
+    if (g_async.fd < 0)
+    {
+        return;
+    }
+
+    /* 进程已处于异常状态，不加锁，只用 write() 尽力输出尚未写出的日志 */
+    for (ring = g_async.rings; NULL != ring; ring = ring->next)
+    {
+        head = ring->head;
+        tail = ring->tail;
+        while (tail != head)
+        {
+            offset = (unsigned)(tail & (ring->capacity - 1));
+            len = (unsigned)(head - tail);
+            if (offset + len > ring->capacity)
+            {
+                len = ring->capacity - offset;
+            }
+            ret = write(g_async.fd, ring->data + offset, len);
+            if (ret <= 0)
+            {
+                break;
+            }
+            tail += ret;
+        }
+        ring->tail = tail;
+    }
+
+    return;
+}
+
+unsigned long long log_async_dropped(void)
+{
+    return (unsigned long long)atomic_get(&g_async.dropped);
+}
+
+#endif
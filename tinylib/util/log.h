@@ -14,50 +14,222 @@ typedef enum log_level{
     LOG_LEVEL_DEBUG,    /** 调试信息输出，用于功能流程诊断 */
 }log_level_e;
 
+/** 模块定义，各模块可单独设置级别 */
+typedef enum log_module{
+    LOG_MODULE_DEFAULT,
+    LOG_MODULE_NET,
+    LOG_MODULE_RTSP,    /** rtsp 及 rtp */
+    LOG_MODULE_SSL,
+    LOG_MODULE_COUNT,
+}log_module_e;
+
+/* 编译期的最低级别，取 log_level_e 的数值，如 -DLOG_COMPILE_LEVEL=4 时全部 log_debug() 在编译期即被去掉 */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 5
+#endif
+
+/* 源文件所属的模块，需在包含任何头文件之前定义，如 #define LOG_MODULE LOG_MODULE_NET */
+#ifndef LOG_MODULE
+#define LOG_MODULE LOG_MODULE_DEFAULT
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* 注意下面两种日志输出的方式 log_init() 指定输出函数的方式优先级更高
- * 此时级别控制由所指定的输出函数完成， log_file()/log_setlevel() 调用无实际效果！
+/* 注意下面两种日志输出的方式 log_init() 指定输出函数的方式优先级更高，此时 log_file() 调用无实际效果！
+ *
+ * 级别在下面的宏中、参数求值之前检查，级别之外的日志不会格式化也不会进入输出函数
  *
  * 不做任何设置时，全部输出到 stderr ，级别为 LOG_LEVEL_INFO
  */
 
-/* 设置日志的输出函数，并发环境中的重入问题由所指定的函数自行解决 */
+/* 设置日志的输出函数，并发环境中的重入问题由所指定的函数自行解决
+ * 为兼容原先由输出函数自行控制级别的用法，尚未显式设置过级别时，全部模块的级别随之放开到 LOG_LEVEL_DEBUG
+ */
 typedef void (*print_f)(log_level_e level, const char *file, int line, const char *fmt, va_list ap);
 void log_init(print_f printcb);
 
-/* 设置日志输出文件和输出级别 */
+/* 设置日志输出文件和输出级别，log_setlevel() 设置全部模块的级别
+ * 调用过 log_setlevel()/log_setmodulelevel() 之后，log_init() 不再改动级别，二者的先后顺序不限
+ */
 void log_file(const char *file);
 void log_setlevel(log_level_e level);
 
+/* 设置或取得单个模块的级别 */
+void log_setmodulelevel(log_module_e module, log_level_e level);
+log_level_e log_getlevel(log_module_e module);
+
+/* 各模块当前的级别，供下面的宏直接检查，请通过 log_setlevel()/log_setmodulelevel() 修改 */
+extern volatile int g_log_levels[LOG_MODULE_COUNT];
+
+#define log_enabled(module, level) ((int)(level) <= g_log_levels[(module)])
+
+/* 按 LOG_MODULE_DEFAULT 的级别检查之后输出 */
 void log_print(log_level_e level, const char *file, int line, const char *fmt, ...);
 
+/* 不再检查级别，直接输出，供下面的宏使用 */
+void log_output(log_level_e level, const char *file, int line, const char *fmt, ...);
+
+/* 限频输出，同一处日志每 interval 毫秒至多输出一次，期间被抑制的条数在下一次输出之前报告 */
+typedef struct log_ratelimit
+{
+    volatile unsigned long long last_ms;
+    volatile long suppressed;
+}log_ratelimit_t;
+
+/* 返回1表示本次可以输出，*suppressed 为之前被抑制的条数 */
+int log_ratelimit_check(log_ratelimit_t *ratelimit, unsigned interval, long *suppressed);
+
+/* 异步输出(仅 linux)
+ *
+ * 各线程把格式化好的日志写入自己的无锁环形缓冲区，由后台线程以 writev() 批量写出，
+ * 调用日志的线程(如 loop 线程)不再因写文件而阻塞
+ *
+ * log_async_start()/log_async_stop() 应在其他线程开始输出日志之前/停止输出日志之后调用，
+ * 不可与 log_init() 指定的输出函数同时使用
+ */
+
+/* 线程缓冲区已满时的处理: 丢弃该条日志，或等待后台线程腾出空间 */
+typedef enum log_overflow{
+    LOG_OVERFLOW_DROP,
+    LOG_OVERFLOW_BLOCK,
+}log_overflow_e;
+
+typedef struct log_async_config
+{
+    const char *file;               /* 输出文件，为NULL时输出到 stderr 且不滚动 */
+    unsigned ring_size;             /* 每个线程缓冲区的字节数，向上圆整为2的幂，0为默认的64K */
+    unsigned flush_interval;        /* 后台线程最长的写出间隔(ms)，0为默认的100ms */
+    unsigned long long rotate_size; /* 文件达到此尺寸时滚动，0为不按尺寸滚动 */
+    unsigned rotate_interval;       /* 每隔多少秒滚动一次，0为不按时间滚动 */
+    unsigned rotate_keep;           /* 滚动后保留的历史文件(file.1 ... file.N)个数，0为不保留 */
+    log_overflow_e overflow;
+    int crash_flush;                /* 非0时接管 SIGSEGV/SIGBUS/SIGFPE/SIGILL/SIGABRT，在进程终止之前写出缓冲区中的日志 */
+}log_async_config_t;
+
+int log_async_start(const log_async_config_t *config);
+
+/* 写出全部剩余的日志并停止后台线程，进程正常退出时会自动调用 */
+void log_async_stop(void);
+
+/* 阻塞直到调用之前输出的日志全部写出 */
+void log_async_flush(void);
+
+/* 供使用者自己的信号处理函数调用，不加锁地写出缓冲区中的日志 */
+void log_async_crash_flush(void);
+
+/* 因缓冲区已满而丢弃的日志条数 */
+unsigned long long log_async_dropped(void);
+
 /* 实际打印可使用下面的宏 */
 #ifdef _MSC_VER
 
-#define log_debug(arg, ...) log_print(LOG_LEVEL_DEBUG, __FILE__, __LINE__, arg, __VA_ARGS__)
+#define LOG_PRINT(level, arg, ...) \
+    (log_enabled(LOG_MODULE, (level)) ? log_output((level), __FILE__, __LINE__, arg, __VA_ARGS__) : (void)0)
+
+/* 编译期去掉的日志: 参数不会求值，但仍参与编译，避免仅用于日志的变量产生未使用的告警 */
+#define LOG_DISCARD(level, arg, ...) (0 ? log_output((level), __FILE__, __LINE__, arg, __VA_ARGS__) : (void)0)
+
+#define LOG_PRINT_RATELIMIT(level, interval, arg, ...) \
+    do { \
+        static log_ratelimit_t log_ratelimit_ = {0, 0}; \
+        long log_suppressed_; \
+        if (log_enabled(LOG_MODULE, (level)) && log_ratelimit_check(&log_ratelimit_, (interval), &log_suppressed_)) \
+        { \
+            if (log_suppressed_ > 0) \
+                log_output((level), __FILE__, __LINE__, "%ld similar messages suppressed", log_suppressed_); \
+            log_output((level), __FILE__, __LINE__, arg, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#if LOG_COMPILE_LEVEL >= 5
+#define log_debug(arg, ...) LOG_PRINT(LOG_LEVEL_DEBUG, arg, __VA_ARGS__)
+#else
+#define log_debug(arg, ...) LOG_DISCARD(LOG_LEVEL_DEBUG, arg, __VA_ARGS__)
+#endif
 
-#define log_info(arg, ...) log_print(LOG_LEVEL_INFO, __FILE__, __LINE__, arg, __VA_ARGS__)
+#if LOG_COMPILE_LEVEL >= 4
+#define log_info(arg, ...) LOG_PRINT(LOG_LEVEL_INFO, arg, __VA_ARGS__)
+#else
+#define log_info(arg, ...) LOG_DISCARD(LOG_LEVEL_INFO, arg, __VA_ARGS__)
+#endif
 
-#define log_warn(arg, ...) log_print(LOG_LEVEL_WARN, __FILE__, __LINE__, arg, __VA_ARGS__)
+#if LOG_COMPILE_LEVEL >= 3
+#define log_warn(arg, ...) LOG_PRINT(LOG_LEVEL_WARN, arg, __VA_ARGS__)
+#define log_warn_ratelimit(interval, arg, ...) LOG_PRINT_RATELIMIT(LOG_LEVEL_WARN, interval, arg, __VA_ARGS__)
+#else
+#define log_warn(arg, ...) LOG_DISCARD(LOG_LEVEL_WARN, arg, __VA_ARGS__)
+#define log_warn_ratelimit(interval, arg, ...) LOG_DISCARD(LOG_LEVEL_WARN, arg, __VA_ARGS__)
+#endif
 
-#define log_error(arg, ...) log_print(LOG_LEVEL_ERROR, __FILE__, __LINE__, arg, __VA_ARGS__)
+#if LOG_COMPILE_LEVEL >= 2
+#define log_error(arg, ...) LOG_PRINT(LOG_LEVEL_ERROR, arg, __VA_ARGS__)
+#define log_error_ratelimit(interval, arg, ...) LOG_PRINT_RATELIMIT(LOG_LEVEL_ERROR, interval, arg, __VA_ARGS__)
+#else
+#define log_error(arg, ...) LOG_DISCARD(LOG_LEVEL_ERROR, arg, __VA_ARGS__)
+#define log_error_ratelimit(interval, arg, ...) LOG_DISCARD(LOG_LEVEL_ERROR, arg, __VA_ARGS__)
+#endif
 
-#define log_log(arg, ...) log_print(LOG_LEVEL_LOG, __FILE__, __LINE__, arg, __VA_ARGS__)
+#if LOG_COMPILE_LEVEL >= 1
+#define log_log(arg, ...) LOG_PRINT(LOG_LEVEL_LOG, arg, __VA_ARGS__)
+#else
+#define log_log(arg, ...) LOG_DISCARD(LOG_LEVEL_LOG, arg, __VA_ARGS__)
+#endif
 
 #elif defined(__GNUC__)
 
-#define log_debug(arg...) log_print(LOG_LEVEL_DEBUG, __FILE__, __LINE__, ##arg)
+#define LOG_PRINT(level, arg...) \
+    (log_enabled(LOG_MODULE, (level)) ? log_output((level), __FILE__, __LINE__, ##arg) : (void)0)
+
+/* 编译期去掉的日志: 参数不会求值，但仍参与编译，避免仅用于日志的变量产生未使用的告警 */
+#define LOG_DISCARD(level, arg...) (0 ? log_output((level), __FILE__, __LINE__, ##arg) : (void)0)
+
+#define LOG_PRINT_RATELIMIT(level, interval, arg...) \
+    do { \
+        static log_ratelimit_t log_ratelimit_ = {0, 0}; \
+        long log_suppressed_; \
+        if (log_enabled(LOG_MODULE, (level)) && log_ratelimit_check(&log_ratelimit_, (interval), &log_suppressed_)) \
+        { \
+            if (log_suppressed_ > 0) \
+                log_output((level), __FILE__, __LINE__, "%ld similar messages suppressed", log_suppressed_); \
+            log_output((level), __FILE__, __LINE__, ##arg); \
+        } \
+    } while (0)
+
+#if LOG_COMPILE_LEVEL >= 5
+#define log_debug(arg...) LOG_PRINT(LOG_LEVEL_DEBUG, ##arg)
+#else
+#define log_debug(arg...) LOG_DISCARD(LOG_LEVEL_DEBUG, ##arg)
+#endif
 
-#define log_info(arg...) log_print(LOG_LEVEL_INFO, __FILE__, __LINE__, ##arg)
+#if LOG_COMPILE_LEVEL >= 4
+#define log_info(arg...) LOG_PRINT(LOG_LEVEL_INFO, ##arg)
+#else
+#define log_info(arg...) LOG_DISCARD(LOG_LEVEL_INFO, ##arg)
+#endif
 
-#define log_warn(arg...) log_print(LOG_LEVEL_WARN, __FILE__, __LINE__, ##arg)
+#if LOG_COMPILE_LEVEL >= 3
+#define log_warn(arg...) LOG_PRINT(LOG_LEVEL_WARN, ##arg)
+#define log_warn_ratelimit(interval, arg...) LOG_PRINT_RATELIMIT(LOG_LEVEL_WARN, interval, ##arg)
+#else
+#define log_warn(arg...) LOG_DISCARD(LOG_LEVEL_WARN, ##arg)
+#define log_warn_ratelimit(interval, arg...) LOG_DISCARD(LOG_LEVEL_WARN, ##arg)
+#endif
 
-#define log_error(arg...) log_print(LOG_LEVEL_ERROR, __FILE__, __LINE__, ##arg)
+#if LOG_COMPILE_LEVEL >= 2
+#define log_error(arg...) LOG_PRINT(LOG_LEVEL_ERROR, ##arg)
+#define log_error_ratelimit(interval, arg...) LOG_PRINT_RATELIMIT(LOG_LEVEL_ERROR, interval, ##arg)
+#else
+#define log_error(arg...) LOG_DISCARD(LOG_LEVEL_ERROR, ##arg)
+#define log_error_ratelimit(interval, arg...) LOG_DISCARD(LOG_LEVEL_ERROR, ##arg)
+#endif
 
-#define log_log(arg...) log_print(LOG_LEVEL_LOG, __FILE__, __LINE__, ##arg)
+#if LOG_COMPILE_LEVEL >= 1
+#define log_log(arg...) LOG_PRINT(LOG_LEVEL_LOG, ##arg)
+#else
+#define log_log(arg...) LOG_DISCARD(LOG_LEVEL_LOG, ##arg)
+#endif
 
 #endif
 
@@ -0,0 +1,171 @@
+
+#include "tinylib/util/metrics.h"
+
+#include <string.h>
+
+#ifdef __linux__
+
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef struct metrics_block
+{
+    metrics_t metrics;              /* 须为第一个成员，metrics_thread() 返回其地址 */
+    struct metrics_block *next;
+}metrics_block_t;
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static metrics_block_t *g_blocks = NULL;   /* 由 g_mutex 保护 */
+static metrics_t g_retired;                /* 已退出线程的计数，由 g_mutex 保护 */
+
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_key;
+static __thread metrics_block_t *t_block = NULL;
+
+static
+void on_thread_exit(void *userdata)
+{
+    metrics_block_t *block = (metrics_block_t*)userdata;
+    metrics_block_t **pos;
+
+    pthread_mutex_lock(&g_mutex);
+    for (pos = &g_blocks; NULL != *pos; pos = &(*pos)->next)
+    {
+        if (*pos == block)
+        {
+            *pos = block->next;
+            break;
+        }
+    }
+    /* 线程已不存在，其心跳不再有意义 */
+    block->metrics.loop_heartbeat_ms = 0;
+    metrics_merge(&g_retired, &block->metrics);
+    pthread_mutex_unlock(&g_mutex);
+
+    t_block = NULL;
+    free(block);
+
+    return;
+}
+
+static
+void create_key(void)
+{
+    pthread_key_create(&g_key, on_thread_exit);
+    return;
+}
+
+metrics_t* metrics_thread(void)
+{
+    metrics_block_t *block;
+
+    if (NULL != t_block)
+    {
+        return &t_block->metrics;
+    }
+
+    block = (metrics_block_t*)malloc(sizeof(*block));
+    memset(block, 0, sizeof(*block));
+
+    pthread_mutex_lock(&g_mutex);
+    block->next = g_blocks;
+    g_blocks = block;
+    pthread_mutex_unlock(&g_mutex);
+
+    pthread_once(&g_key_once, create_key);
+    pthread_setspecific(g_key, block);
+    t_block = block;
+
+    return &block->metrics;
+}
+
+int metrics_snapshot(const metrics_t *thread_metrics, metrics_t *metrics)
+{
+    metrics_block_t *block;
+    int ret = -1;
+
+    if (NULL == thread_metrics || NULL == metrics)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_mutex);
+    for (block = g_blocks; NULL != block; block = block->next)
+    {
+        if (&block->metrics == thread_metrics)
+        {
+            memcpy(metrics, thread_metrics, sizeof(*metrics));
+            ret = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_mutex);
+
+    return ret;
+}
+
+void metrics_collect(metrics_t *metrics)
+{
+    metrics_block_t *block;
+
+    if (NULL == metrics)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_mutex);
+    memcpy(metrics, &g_retired, sizeof(*metrics));
+    for (block = g_blocks; NULL != block; block = block->next)
+    {
+        metrics_merge(metrics, &block->metrics);
+    }
+    pthread_mutex_unlock(&g_mutex);
+
+    return;
+}
+
+#endif /* __linux__ */
+
+#define MERGE_SUM(field) dst->field += src->field
+#define MERGE_MAX(field) if (src->field > dst->field) dst->field = src->field
+
+void metrics_merge(metrics_t *dst, const metrics_t *src)
+{
+    if (NULL == dst || NULL == src)
+    {
+        return;
+    }
+
+    MERGE_SUM(loop_iterations);
+    MERGE_SUM(loop_events);
+    if (0 != src->loop_heartbeat_ms && (0 == dst->loop_heartbeat_ms || src->loop_heartbeat_ms < dst->loop_heartbeat_ms))
+    {
+        dst->loop_heartbeat_ms = src->loop_heartbeat_ms;
+    }
+    histogram_merge(&dst->loop_wakeup_events, &src->loop_wakeup_events);
+    histogram_merge(&dst->loop_iteration_us, &src->loop_iteration_us);
+    histogram_merge(&dst->loop_callback_us, &src->loop_callback_us);
+
+    MERGE_SUM(timer_expired);
+    histogram_merge(&dst->timer_lag_us, &src->timer_lag_us);
+
+    MERGE_SUM(async_tasks);
+    histogram_merge(&dst->async_depth, &src->async_depth);
+    histogram_merge(&dst->async_latency_us, &src->async_latency_us);
+
+    MERGE_SUM(tcp_accepts);
+    MERGE_SUM(tcp_connects);
+    MERGE_SUM(tcp_reads);
+    MERGE_SUM(tcp_writes);
+    MERGE_SUM(tcp_bytes_in);
+    MERGE_SUM(tcp_bytes_out);
+    MERGE_MAX(tcp_in_buffer_max);
+    MERGE_MAX(tcp_out_buffer_max);
+
+    MERGE_SUM(udp_packets_in);
+    MERGE_SUM(udp_packets_out);
+    MERGE_SUM(udp_bytes_in);
+    MERGE_SUM(udp_bytes_out);
+
+    return;
+}
@@ -0,0 +1,79 @@
+
+/* 运行指标(仅 linux)
+ *
+ * 计数按线程记录: 每个线程首次更新时建立自己的计数块，只由本线程写入，不加锁也不使用原子操作；
+ * loop、tcp_connection、tcp_server、tcp_client、udp_peer 及异步任务队列在各自所在的线程中更新，
+ * 使用者按需拉取: loop_getmetrics() 取得单个 loop 线程的计数，metrics_collect() 汇总全部线程(含已退出的线程)
+ *
+ * 读取与写入并发进行，每个字段各自准确，但字段之间不是同一时刻的快照
+ *
+ * loop_iteration_us、loop_callback_us 及 async_latency_us 需在每个事件、任务前后读取时钟，
+ * 编译时定义 METRICS_TIMING=0 可关闭这几项的统计(其计数保持为0)，其他计数不受影响
+ */
+
+#ifndef TINYLIB_UTIL_METRICS_H
+#define TINYLIB_UTIL_METRICS_H
+
+#include "tinylib/util/histogram.h"
+
+#ifndef METRICS_TIMING
+#define METRICS_TIMING 1
+#endif
+
+typedef struct metrics
+{
+    /* loop */
+    unsigned long long loop_iterations;     /* epoll_wait() 的调用次数 */
+    unsigned long long loop_events;         /* epoll_wait() 返回的事件总数 */
+    unsigned long long loop_heartbeat_ms;   /* 最近一轮迭代开始的时刻(同 ts_ms())，loop 结束后为0，汇总时取各 loop 中最早的 */
+    histogram_t loop_wakeup_events;         /* 每次唤醒的事件数 */
+    histogram_t loop_iteration_us;          /* 每轮迭代中处理IO事件及 timer 的耗时，不含等待 */
+    histogram_t loop_callback_us;           /* 单个IO事件回调的耗时 */
+
+    /* timer */
+    unsigned long long timer_expired;       /* 执行的超时回调次数 */
+    histogram_t timer_lag_us;               /* 实际执行时刻减去预定的超时时刻 */
+
+    /* 异步任务队列 */
+    unsigned long long async_tasks;         /* 执行的任务数 */
+    histogram_t async_depth;                /* 每次处理时队列中积压的任务数 */
+    histogram_t async_latency_us;           /* 任务从提交到开始执行的时延 */
+
+    /* tcp */
+    unsigned long long tcp_accepts;
+    unsigned long long tcp_connects;
+    unsigned long long tcp_reads;
+    unsigned long long tcp_writes;
+    unsigned long long tcp_bytes_in;
+    unsigned long long tcp_bytes_out;
+    unsigned long long tcp_in_buffer_max;   /* 接收缓冲区的最高水位(字节)，汇总时取最大值 */
+    unsigned long long tcp_out_buffer_max;  /* 发送缓冲区的最高水位(字节)，汇总时取最大值 */
+
+    /* udp */
+    unsigned long long udp_packets_in;
+    unsigned long long udp_packets_out;
+    unsigned long long udp_bytes_in;
+    unsigned long long udp_bytes_out;
+}metrics_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 当前线程的计数块，首次调用时建立，线程退出时其计数并入汇总，供各组件在本线程中更新 */
+metrics_t* metrics_thread(void);
+
+/* 复制某个线程的计数块，该线程已退出时返回-1 */
+int metrics_snapshot(const metrics_t *thread_metrics, metrics_t *metrics);
+
+/* 汇总全部线程的计数 */
+void metrics_collect(metrics_t *metrics);
+
+/* 把 src 的计数累加到 dst 中，水位取最大值，心跳取非0的最早值 */
+void metrics_merge(metrics_t *dst, const metrics_t *src);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TINYLIB_UTIL_METRICS_H */
@@ -0,0 +1,181 @@
+
+/** 文本协议(rtsp/http)解析中用到的字符查找
+ *
+ * 一次比较16(SSE2)或32(AVX2)个字节，用于快速定位行尾、head 中的':'以及 head 结束处的空行
+ * 编译时按目标平台支持的指令集选择实现，均不支持时使用逐字节比较的实现
+ * 所有函数均在 [pos, end) 范围内查找，未找到时返回NULL
+ */
+
+#ifndef TINYLIB_UTIL_TEXT_SCAN_H
+#define TINYLIB_UTIL_TEXT_SCAN_H
+
+#include <stddef.h>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define TEXT_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define TEXT_SCAN_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && (defined(TEXT_SCAN_AVX2) || defined(TEXT_SCAN_SSE2))
+  #include <intrin.h>
+static inline
+unsigned text_scan_ctz(unsigned mask)
+{
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+}
+#else
+  #define text_scan_ctz(mask) ((unsigned)__builtin_ctz(mask))
+#endif
+
+/* 以下为逐字节比较的实现，也用于处理向量化实现中不足一个向量长度的尾部数据 */
+
+static inline
+const char* text_scan_char_scalar(const char *pos, const char *end, char c)
+{
+    for (; pos < end; ++pos)
+    {
+        if (*pos == c)
+        {
+            return pos;
+        }
+    }
+
+    return NULL;
+}
+
+static inline
+const char* text_scan_char2_scalar(const char *pos, const char *end, char c1, char c2)
+{
+    for (; pos < end; ++pos)
+    {
+        if (*pos == c1 || *pos == c2)
+        {
+            return pos;
+        }
+    }
+
+    return NULL;
+}
+
+/* 返回空行"\r\n\r\n"之后的位置 */
+static inline
+const char* text_scan_head_end_scalar(const char *pos, const char *end)
+{
+    for (; (end - pos) >= 4; ++pos)
+    {
+        if (pos[0] == '\r' && pos[1] == '\n' && pos[2] == '\r' && pos[3] == '\n')
+        {
+            return (pos + 4);
+        }
+    }
+
+    return NULL;
+}
+
+#if defined(TEXT_SCAN_AVX2)
+
+#define TEXT_SCAN_WIDTH 32
+
+typedef __m256i text_scan_vec_t;
+#define text_scan_load(p) _mm256_loadu_si256((const __m256i*)(p))
+#define text_scan_splat(c) _mm256_set1_epi8(c)
+#define text_scan_eq(a, b) _mm256_cmpeq_epi8((a), (b))
+#define text_scan_or(a, b) _mm256_or_si256((a), (b))
+#define text_scan_and(a, b) _mm256_and_si256((a), (b))
+#define text_scan_mask(v) ((unsigned)_mm256_movemask_epi8(v))
+
+#elif defined(TEXT_SCAN_SSE2)
+
+#define TEXT_SCAN_WIDTH 16
+
+typedef __m128i text_scan_vec_t;
+#define text_scan_load(p) _mm_loadu_si128((const __m128i*)(p))
+#define text_scan_splat(c) _mm_set1_epi8(c)
+#define text_scan_eq(a, b) _mm_cmpeq_epi8((a), (b))
+#define text_scan_or(a, b) _mm_or_si128((a), (b))
+#define text_scan_and(a, b) _mm_and_si128((a), (b))
+#define text_scan_mask(v) ((unsigned)_mm_movemask_epi8(v))
+
+#endif
+
+#if defined(TEXT_SCAN_WIDTH)
+
+static inline
+const char* text_scan_char(const char *pos, const char *end, char c)
+{
+    text_scan_vec_t target = text_scan_splat(c);
+    unsigned mask;
+
+    for (; (end - pos) >= TEXT_SCAN_WIDTH; pos += TEXT_SCAN_WIDTH)
+    {
+        mask = text_scan_mask(text_scan_eq(text_scan_load(pos), target));
+        if (0 != mask)
+        {
+            return (pos + text_scan_ctz(mask));
+        }
+    }
+
+    return text_scan_char_scalar(pos, end, c);
+}
+
+static inline
+const char* text_scan_char2(const char *pos, const char *end, char c1, char c2)
+{
+    text_scan_vec_t target1 = text_scan_splat(c1);
+    text_scan_vec_t target2 = text_scan_splat(c2);
+    text_scan_vec_t data;
+    unsigned mask;
+
+    for (; (end - pos) >= TEXT_SCAN_WIDTH; pos += TEXT_SCAN_WIDTH)
+    {
+        data = text_scan_load(pos);
+        mask = text_scan_mask(text_scan_or(text_scan_eq(data, target1), text_scan_eq(data, target2)));
+        if (0 != mask)
+        {
+            return (pos + text_scan_ctz(mask));
+        }
+    }
+
+    return text_scan_char2_scalar(pos, end, c1, c2);
+}
+
+static inline
+const char* text_scan_head_end(const char *pos, const char *end)
+{
+    text_scan_vec_t cr = text_scan_splat('\r');
+    text_scan_vec_t lf = text_scan_splat('\n');
+    text_scan_vec_t hit;
+    unsigned mask;
+    unsigned index;
+
+    /* 同时比较 pos[i]=='\r' && pos[i+1]=='\n' && pos[i+2]=='\r' && pos[i+3]=='\n'，需要多读3个字节 */
+    for (; (end - pos) >= (TEXT_SCAN_WIDTH + 3); pos += TEXT_SCAN_WIDTH)
+    {
+        hit = text_scan_and(text_scan_eq(text_scan_load(pos), cr), text_scan_eq(text_scan_load(pos + 1), lf));
+        hit = text_scan_and(hit, text_scan_eq(text_scan_load(pos + 2), cr));
+        hit = text_scan_and(hit, text_scan_eq(text_scan_load(pos + 3), lf));
+        mask = text_scan_mask(hit);
+        if (0 != mask)
+        {
+            index = text_scan_ctz(mask);
+            return (pos + index + 4);
+        }
+    }
+
+    return text_scan_head_end_scalar(pos, end);
+}
+
+#else
+
+#define text_scan_char(pos, end, c) text_scan_char_scalar((pos), (end), (c))
+#define text_scan_char2(pos, end, c1, c2) text_scan_char2_scalar((pos), (end), (c1), (c2))
+#define text_scan_head_end(pos, end) text_scan_head_end_scalar((pos), (end))
+
+#endif
+
+#endif /* !TINYLIB_UTIL_TEXT_SCAN_H */
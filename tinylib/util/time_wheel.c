@@ -8,7 +8,7 @@
 
 struct wheel_bucket
 {
-    onexpire_f callback;
+    time_wheel_onexpire_f callback;
     void *userdata;
     unsigned index;
     unsigned steps;
@@ -60,12 +60,12 @@ void time_wheel_destroy(time_wheel_t* wheel)
         }
     }
 
-    free(bucket);
+    free(wheel);
 
     return;
 }
 
-void* time_wheel_submit(time_wheel_t* wheel, onexpire_f callback, void* userdata, unsigned steps)
+void* time_wheel_submit(time_wheel_t* wheel, time_wheel_onexpire_f callback, void* userdata, unsigned steps)
 {
     int index;
     struct wheel_bucket *head;
@@ -22,14 +22,14 @@ extern "C" {
 /* 如果返回值是oneshot，则该timer是一次性的，超时之后不再活动
  * 反之返回值是其他值时时默认为loop，该timer是循环timer，直至其返回oneshot或被cancel为止
  */
-typedef int(*onexpire_f)(void *userdata);
+typedef int(*time_wheel_onexpire_f)(void *userdata);
 
 time_wheel_t* time_wheel_create(unsigned max_step);
 
 void time_wheel_destroy(time_wheel_t* wheel);
 
 /* 返回值为timer的handle，在time_wheel_refresh时使用 */
-void* time_wheel_submit(time_wheel_t* wheel, onexpire_f func, void* userdata, unsigned steps);
+void* time_wheel_submit(time_wheel_t* wheel, time_wheel_onexpire_f func, void* userdata, unsigned steps);
 
 void time_wheel_cancel(time_wheel_t* wheel, void *handle);
 
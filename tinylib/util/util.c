@@ -1,9 +1,18 @@
 
+/* rand_s() 需在首次包含 stdlib.h 之前声明 */
+#ifdef WIN32
+  #define _CRT_RAND_S
+#endif
+
 #include "tinylib/util/util.h"
 #include "tinylib/util/log.h"
 
+#include <string.h>
+#include <time.h>
+
 #ifdef WIN32
 
+#include <stdlib.h>
 #include <windows.h>
 
 #ifdef _MSC_VER
@@ -35,12 +44,66 @@ unsigned long long ts_ms(void)
     return now_ms();
 }
 
+unsigned long long ts_us(void)
+{
+    return ts_ms() * 1000;
+}
+
+int random_bytes(void *buffer, int len)
+{
+    unsigned char *pos = (unsigned char*)buffer;
+    unsigned int value;
+    int i;
+
+    while (len > 0)
+    {
+        if (0 != rand_s(&value))
+        {
+            return -1;
+        }
+        for (i = 0; i < 4 && len > 0; ++i, --len)
+        {
+            *pos++ = (unsigned char)(value >> (i * 8));
+        }
+    }
+
+    return 0;
+}
+
+#define THREAD_LOCAL __declspec(thread)
+
+/* FILETIME 的起点为 1601-01-01，转换为 1970-01-01 起的ms */
+static
+unsigned long long system_now_ms(void)
+{
+    FILETIME now_fs;
+    GetSystemTimeAsFileTime(&now_fs);
+
+    return (((ULARGE_INTEGER*)&now_fs)->QuadPart - 116444736000000000ULL) / 10000;
+}
+
+static
+void second_to_local(time_t t, struct tm *tm)
+{
+    localtime_s(tm, &t);
+    return;
+}
+
+static
+void second_to_gmt(time_t t, struct tm *tm)
+{
+    gmtime_s(tm, &t);
+    return;
+}
+
 #elif defined(__linux__)
 
 #include <time.h>
 #include <sys/time.h>
-#include <sys/syscall.h>    /* for SYS_gettid */
+#include <sys/syscall.h>    /* for SYS_gettid, SYS_getrandom */
 #include <unistd.h>         /* for syscall() */
+#include <errno.h>
+#include <fcntl.h>
 
 __thread int t_cachedTid = 0;
 
@@ -70,4 +133,180 @@ unsigned long long ts_ms(void)
     return tspec.tv_sec * 1000 + tspec.tv_nsec / 1000000;
 }
 
+unsigned long long ts_us(void)
+{
+    struct timespec tspec;
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+
+    return (unsigned long long)tspec.tv_sec * 1000000 + tspec.tv_nsec / 1000;
+}
+
+int random_bytes(void *buffer, int len)
+{
+    unsigned char *pos = (unsigned char*)buffer;
+    long result;
+    int fd;
+
+  #ifdef SYS_getrandom
+    while (len > 0)
+    {
+        result = syscall(SYS_getrandom, pos, (size_t)len, 0);
+        if (result < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            break;
+        }
+        pos += result;
+        len -= (int)result;
+    }
+    if (0 == len)
+    {
+        return 0;
+    }
+  #endif
+
+    /* 内核不支持 getrandom 时改从 /dev/urandom 读取 */
+    fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    while (len > 0)
+    {
+        result = read(fd, pos, len);
+        if (result < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            break;
+        }
+        pos += result;
+        len -= (int)result;
+    }
+    close(fd);
+
+    return (0 == len) ? 0 : -1;
+}
+
+#define THREAD_LOCAL __thread
+
+static
+unsigned long long system_now_ms(void)
+{
+    return now_ms();
+}
+
+static
+void second_to_local(time_t t, struct tm *tm)
+{
+    localtime_r(&t, tm);
+    return;
+}
+
+static
+void second_to_gmt(time_t t, struct tm *tm)
+{
+    gmtime_r(&t, tm);
+    return;
+}
+
 #endif
+
+static THREAD_LOCAL int t_time_cached = 0;
+static THREAD_LOCAL unsigned long long t_cached_ms = 0;
+
+unsigned long long time_cache_now_ms(void)
+{
+    if (t_time_cached)
+    {
+        return t_cached_ms;
+    }
+
+    return system_now_ms();
+}
+
+void time_cache_update(void)
+{
+    t_cached_ms = system_now_ms();
+    t_time_cached = 1;
+
+    return;
+}
+
+void time_cache_invalidate(void)
+{
+    t_time_cached = 0;
+    return;
+}
+
+/* "2014-08-17 12:37:00." 共20个字符，其后3位为毫秒 */
+#define LOCAL_SECOND_LEN 20
+#define LOCAL_TEXT_LEN 23
+
+static THREAD_LOCAL time_t t_local_second = (time_t)-1;
+static THREAD_LOCAL char t_local_text[LOCAL_SECOND_LEN] = "0000-00-00 00:00:00.";
+
+static inline
+void put_digits(char *text, unsigned value, int count)
+{
+    while (count > 0)
+    {
+        count--;
+        text[count] = '0' + value % 10;
+        value /= 10;
+    }
+
+    return;
+}
+
+int time_format_local(char *buffer, unsigned long long ms)
+{
+    time_t second;
+    struct tm tm;
+
+    second = (time_t)(ms / 1000);
+    if (second != t_local_second)
+    {
+        second_to_local(second, &tm);
+        put_digits(t_local_text, tm.tm_year + 1900, 4);
+        put_digits(t_local_text + 5, tm.tm_mon + 1, 2);
+        put_digits(t_local_text + 8, tm.tm_mday, 2);
+        put_digits(t_local_text + 11, tm.tm_hour, 2);
+        put_digits(t_local_text + 14, tm.tm_min, 2);
+        put_digits(t_local_text + 17, tm.tm_sec, 2);
+        t_local_second = second;
+    }
+
+    memcpy(buffer, t_local_text, LOCAL_SECOND_LEN);
+    put_digits(buffer + LOCAL_SECOND_LEN, (unsigned)(ms % 1000), 3);
+    buffer[LOCAL_TEXT_LEN] = '\0';
+
+    return LOCAL_TEXT_LEN;
+}
+
+static THREAD_LOCAL time_t t_gmt_second = (time_t)-1;
+static THREAD_LOCAL int t_gmt_len = 0;
+static THREAD_LOCAL char t_gmt_text[32];
+
+int time_format_gmt(char *buffer, unsigned long long ms)
+{
+    time_t second;
+    struct tm tm;
+
+    second = (time_t)(ms / 1000);
+    if (second != t_gmt_second)
+    {
+        second_to_gmt(second, &tm);
+        t_gmt_len = (int)strftime(t_gmt_text, sizeof(t_gmt_text), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        t_gmt_second = second;
+    }
+
+    memcpy(buffer, t_gmt_text, t_gmt_len + 1);
+
+    return t_gmt_len;
+}
@@ -19,6 +19,29 @@ unsigned long long now_ms(void);
  */
 unsigned long long ts_ms(void);
 
+/* 同 ts_ms()，以us为单位 */
+unsigned long long ts_us(void);
+
+/* 以系统的密码学安全随机源(linux 为 getrandom()/dev/urandom，windows 为 rand_s())填充 len 字节，失败时返回-1 */
+int random_bytes(void *buffer, int len);
+
+/* 线程缓存的当前时间，以ms为单位，起点为 1970-01-01 00:00:00 UTC
+ *
+ * loop 线程在每轮迭代(等待IO返回之后)调用 time_cache_update() 刷新一次，本轮中的各回调读取的都是这一时刻，
+ * 不再反复读取系统时间；从未刷新过或已 time_cache_invalidate() 的线程(如非 loop 线程)每次调用都读取系统时间
+ */
+unsigned long long time_cache_now_ms(void);
+void time_cache_update(void);
+void time_cache_invalidate(void);
+
+/* 把ms时间(起点同上)格式化为本地时间 "2014-08-17 12:37:00.555"，buffer 至少 24 字节，返回长度
+ * 每个线程缓存秒及以上的部分，同一秒内只填入毫秒
+ */
+int time_format_local(char *buffer, unsigned long long ms);
+
+/* 格式化为 GMT 时间 "Sun, 17 Aug 2014 12:37:00 GMT"，buffer 至少 32 字节，返回长度，同样按秒缓存 */
+int time_format_gmt(char *buffer, unsigned long long ms);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/util/util.h"
 #include "tinylib/util/log.h"
 #include "tinylib/windows/net/channel.h"
@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/windows/net/loop.h"
 #include "tinylib/windows/net/timer_queue.h"
 #include "async_task_queue.h"
@@ -25,6 +27,8 @@ struct loop
 
     async_task_queue_t *task_queue;
     timer_queue_t *timer_queue;
+
+    unsigned long long now_ms;
 };
 
 loop_t* loop_new(unsigned hint)
@@ -243,11 +247,15 @@ void loop_loop(loop_t *loop)
 
     loop->threadId = current_tid();
     loop->started = 1;
+    loop->now_ms = ts_ms();
 
     while (loop->quited == 0)
     {
         timeout = timer_queue_gettimeout(loop->timer_queue);
         ret = WSAPoll(loop->pollfds, loop->count, (int)timeout);
+        /* 本轮迭代中的回调、timer 及日志、rtsp Date 等共用此刻缓存的时间 */
+        loop->now_ms = ts_ms();
+        time_cache_update();
         if (ret > 0)
         {
             active_channels_count = 0;
@@ -279,6 +287,8 @@ void loop_loop(loop_t *loop)
         timer_queue_process_inloop(loop->timer_queue);
     }
 
+    time_cache_invalidate();
+
     return;
 }
 
@@ -312,7 +322,7 @@ loop_timer_t* loop_runafter(loop_t* loop, unsigned interval, onexpire_f expirecb
         return NULL;
     }
 
-    timestamp = ts_ms() + interval;
+    timestamp = loop_now_ms(loop) + interval;
     return timer_queue_add(loop->timer_queue, timestamp, 0, expirecb, userdata);
 }
 
@@ -326,7 +336,7 @@ loop_timer_t* loop_runevery(loop_t* loop, unsigned interval, onexpire_f expirecb
         return NULL;
     }
 
-    timestamp = ts_ms() + interval;
+    timestamp = loop_now_ms(loop) + interval;
     return timer_queue_add(loop->timer_queue, timestamp, interval, expirecb, userdata);
 }
 
@@ -349,3 +359,28 @@ void loop_refresh(loop_t* loop, loop_timer_t *timer)
 
     return;
 }
+
+unsigned long long loop_now_ms(loop_t* loop)
+{
+    if (NULL == loop)
+    {
+        return 0;
+    }
+
+    if (loop_inloopthread(loop))
+    {
+        return loop->now_ms;
+    }
+
+    return ts_ms();
+}
+
+unsigned long long loop_now_us(loop_t* loop)
+{
+    return loop_now_ms(loop) * 1000;
+}
+
+void loop_usecoarseclock(loop_t* loop, int enable)
+{
+    return;
+}
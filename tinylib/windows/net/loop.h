@@ -70,6 +70,15 @@ void loop_cancel(loop_t* loop, loop_timer_t *timer);
  */
 void loop_refresh(loop_t* loop, loop_timer_t *timer);
 
+/* loop 缓存的单调时间戳，与 ts_ms() 同源
+ * loop 线程中返回本轮迭代 WSAPoll() 返回时刷新的值，其他线程中读取当前时间
+ */
+unsigned long long loop_now_ms(loop_t* loop);
+unsigned long long loop_now_us(loop_t* loop);
+
+/* windows 下时间本已是毫秒精度，此设置无实际效果，仅为与 linux 接口一致 */
+void loop_usecoarseclock(loop_t* loop, int enable);
+
 #ifdef __cplusplus
 }
 #endif
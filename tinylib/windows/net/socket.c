@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/windows/net/socket.h"
 #include "tinylib/util/log.h"
 
@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/windows/net/tcp_client.h"
 #include "tinylib/windows/net/channel.h"
 #include "tinylib/windows/net/inetaddr.h"
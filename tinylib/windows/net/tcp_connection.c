@@ -1,5 +1,7 @@
 
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/windows/net/channel.h"
 #include "tinylib/windows/net/tcp_connection.h"
 #include "tinylib/windows/net/inetaddr.h"
@@ -438,6 +440,11 @@ int tcp_connection_connected(tcp_connection_t *connection)
     return NULL == connection ? 0 : connection->is_connected;
 }
 
+int tcp_connection_pending_bytes(tcp_connection_t *connection)
+{
+    return NULL == connection ? 0 : buffer_readablebytes(connection->out_buffer);
+}
+
 void tcp_connection_expand_send_buffer(tcp_connection_t *connection, unsigned size)
 {
     int result;
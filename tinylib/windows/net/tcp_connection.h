@@ -46,6 +46,11 @@ loop_t* tcp_connection_getloop(tcp_connection_t *connection);
 
 int tcp_connection_connected(tcp_connection_t *connection);
 
+/* 返回发送缓冲区中尚未发出的字节数，可据此判断对端接收是否跟得上 
+ * 只能在 connection 所在的IO线程中执行！
+ */
+int tcp_connection_pending_bytes(tcp_connection_t *connection);
+
 void tcp_connection_expand_send_buffer(tcp_connection_t *connection, unsigned size);
 void tcp_connection_expand_recv_buffer(tcp_connection_t *connection, unsigned size);
 
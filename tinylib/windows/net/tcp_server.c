@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/windows/net/tcp_server.h"
 #include "tinylib/windows/net/socket.h"
 #include "tinylib/windows/net/buffer.h"
@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/windows/net/timer_queue.h"
 
 #include "tinylib/util/log.h"
@@ -55,7 +57,7 @@ timer_queue_t* timer_queue_create(loop_t *loop)
     timer_queue->loop = loop;
     timer_queue->timer_list = NULL;
     timer_queue->timer_list_end = NULL;
-    timer_queue->min_timestamp = ts_ms();
+    timer_queue->min_timestamp = loop_now_ms(timer_queue->loop);
 
     return timer_queue;
 }
@@ -153,7 +155,7 @@ void remove_timer_inloop(timer_queue_t *timer_queue, loop_timer_t *timer)
         else
         {
             timer_queue->timer_list_end = NULL;
-            timer_queue->min_timestamp = ts_ms();
+            timer_queue->min_timestamp = loop_now_ms(timer_queue->loop);
         }
     }
     else if (timer_queue->timer_list_end == timer)
@@ -286,7 +288,7 @@ void do_timer_queue_refresh(void *userdata)
     timer_queue_t *timer_queue = timer->timer_queue;
 
     remove_timer_inloop(timer_queue, timer);
-    timer->timestamp = ts_ms() + timer->interval;
+    timer->timestamp = loop_now_ms(timer_queue->loop) + timer->interval;
     timer->prev = NULL;
     timer->next = NULL;
     insert_timer_inloop(timer_queue, timer);
@@ -325,7 +327,7 @@ long timer_queue_gettimeout(timer_queue_t *timer_queue)
         return 100;
     }
 
-    now = ts_now();
+    now = loop_now_ms(timer_queue->loop);
     interval = (long)(timer_queue->min_timestamp - now);
 
     timeout = 100;
@@ -361,7 +363,7 @@ void timer_queue_process_inloop(timer_queue_t *timer_queue)
         return;
     }
 
-    now = ts_now();
+    now = loop_now_ms(timer_queue->loop);
 
     /* 寻找第一个时间戳大于now的节点，在该节点之前的所有timer均为已超时 */
     timer = timer_queue->timer_list;
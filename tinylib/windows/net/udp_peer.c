@@ -1,4 +1,6 @@
 
+#define LOG_MODULE LOG_MODULE_NET
+
 #include "tinylib/windows/net/udp_peer.h"
 #include "tinylib/windows/net/socket.h"
 #include "tinylib/windows/net/channel.h"
@@ -101,7 +103,7 @@ void udp_peer_onevent(SOCKET fd, short event, void* userdata)
                 saved_errno = WSAGetLastError();
                 if (WSAECONNRESET != saved_errno && WSAEWOULDBLOCK != saved_errno)
                 {
-                    log_error("udp_peer_onevent: WSARecvFrom() failed, errno: %d, peer: %s:%u", saved_errno, peer->ip, peer->port);
+                    log_error_ratelimit(1000, "udp_peer_onevent: WSARecvFrom() failed, errno: %d, peer: %s:%u", saved_errno, peer->ip, peer->port);
                 }
 
                 break;
@@ -126,7 +128,7 @@ void udp_peer_onevent(SOCKET fd, short event, void* userdata)
             }
             else
             {
-                log_warn("udp_peer(%s:%u): no message callback was found, all received data will be dropped", peer->ip, peer->port);
+                log_warn_ratelimit(1000, "udp_peer(%s:%u): no message callback was found, all received data will be dropped", peer->ip, peer->port);
             }
         }
     }
@@ -391,7 +393,7 @@ int udp_peer_send(udp_peer_t* peer, const void *message, unsigned len, const ine
     WSASendTo(peer->fd, &wsabuf, 1, &written, 0, (struct sockaddr*)&addr, sizeof(addr), NULL, NULL);
     if (written != len)
     {
-        log_warn("udp_peer_send: WSASendTo() failed, errno: %d", WSAGetLastError());
+        log_warn_ratelimit(1000, "udp_peer_send: WSASendTo() failed, errno: %d", WSAGetLastError());
         ret = -1;
     }
 
@@ -420,7 +422,7 @@ int udp_peer_send2(udp_peer_t* peer, const void *message, unsigned len, const st
     WSASendTo(peer->fd, &wsabuf, 1, &written, 0, (struct sockaddr*)peer_addr, sizeof(*peer_addr), NULL, NULL);
     if (written != len)
     {
-        log_warn("udp_peer_send2: WSASendTo() failed, errno: %d", WSAGetLastError());
+        log_warn_ratelimit(1000, "udp_peer_send2: WSASendTo() failed, errno: %d", WSAGetLastError());
         ret = -1;
     }
 
@@ -0,0 +1,342 @@
+
+/* 生成 rtsp_message_codec.c 中 head 名称到 rtsp_head_key_e 的完美哈希表
+ *
+ * head 名称取自 rtsp_message_codec.c 中的 head_key_prefix 表，对应的 key 取自 rtsp_message_codec.h 中的 rtsp_head_key_e，
+ * 两者的顺序一致；seed 从0开始依次尝试，取第一个使全部名称互不冲突的，表的大小为不小于名称数2倍的2的幂
+ * 生成的内容替换 rtsp_message_codec.c 中从 "#define RTSP_HEAD_HASH_SEED" 到表结尾 "};" 的部分
+ *
+ * 增删 head 时，先修改 rtsp_head_key_e 及 head_key_prefix，再重新生成:
+ *   cmake --build <build dir> --target rtsp_head_hash
+ * 或者
+ *   gcc -o rtsp_head_hash_gen tools/rtsp_head_hash_gen.c
+ *   ./rtsp_head_hash_gen tinylib/rtsp/rtsp_message_codec.h tinylib/rtsp/rtsp_message_codec.c
+ * 最后加上 -stdout 时只把生成的内容输出到 stdout，不修改源文件
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#define MAX_HEADS 128
+#define MAX_SEED (1u << 24)
+
+typedef struct head_name
+{
+    char key[64];
+    char name[64];
+    int len;
+}head_name_t;
+
+static head_name_t g_heads[MAX_HEADS];
+static int g_count = 0;
+
+static
+char* read_file(const char *path, long *size)
+{
+    FILE *fp;
+    char *data;
+
+    fp = fopen(path, "rb");
+    if (NULL == fp)
+    {
+        fprintf(stderr, "failed to open %s\n", path);
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    data = (char*)malloc(*size + 1);
+    if ((long)fread(data, 1, *size, fp) != *size)
+    {
+        fprintf(stderr, "failed to read %s\n", path);
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+    data[*size] = '\0';
+    fclose(fp);
+
+    return data;
+}
+
+/* 依次取出 rtsp_head_key_e 中 RTSP_HEAD_EXTENSION 之前的各项 */
+static
+int parse_keys(const char *header)
+{
+    const char *pos;
+    const char *end;
+    int count;
+    int len;
+
+    pos = strstr(header, "typedef enum rtsp_head_key");
+    if (NULL == pos)
+    {
+        fprintf(stderr, "rtsp_head_key_e not found\n");
+        return -1;
+    }
+
+    count = 0;
+    while (NULL != (pos = strstr(pos, "RTSP_HEAD_")))
+    {
+        end = pos;
+        while (isalnum((unsigned char)*end) || *end == '_')
+        {
+            end++;
+        }
+        len = (int)(end - pos);
+        if (len == (int)strlen("RTSP_HEAD_EXTENSION") && strncmp(pos, "RTSP_HEAD_EXTENSION", len) == 0)
+        {
+            break;
+        }
+        if (count >= MAX_HEADS || len >= (int)sizeof(g_heads[0].key))
+        {
+            fprintf(stderr, "too many or too long head keys\n");
+            return -1;
+        }
+
+        memcpy(g_heads[count].key, pos, len);
+        g_heads[count].key[len] = '\0';
+        count++;
+        pos = end;
+    }
+
+    return count;
+}
+
+/* 依次取出 head_key_prefix 中 "Name: " 的 Name 部分 */
+static
+int parse_names(const char *source)
+{
+    const char *pos;
+    const char *table_end;
+    const char *end;
+    int count;
+    int len;
+
+    pos = strstr(source, "head_key_prefix[]");
+    if (NULL == pos)
+    {
+        fprintf(stderr, "head_key_prefix not found\n");
+        return -1;
+    }
+    table_end = strstr(pos, "};");
+
+    count = 0;
+    while (NULL != (pos = strstr(pos, "{\"")) && pos < table_end)
+    {
+        pos += 2;
+        end = strstr(pos, ": \"");
+        if (NULL == end || count >= MAX_HEADS || (end - pos) >= (int)sizeof(g_heads[0].name))
+        {
+            fprintf(stderr, "bad head_key_prefix entry\n");
+            return -1;
+        }
+
+        len = (int)(end - pos);
+        memcpy(g_heads[count].name, pos, len);
+        g_heads[count].name[len] = '\0';
+        g_heads[count].len = len;
+        count++;
+        pos = end;
+    }
+
+    return count;
+}
+
+/* 与 rtsp_message_codec.c 中的 rtsp_head_hash() 相同 */
+static
+unsigned head_hash(uint32_t seed, const char *name, int len, unsigned size)
+{
+    uint32_t hash;
+    int i;
+
+    hash = seed;
+    for (i = 0; i < len; ++i)
+    {
+        hash = hash * 31 + (uint8_t)(name[i] | 0x20);
+    }
+
+    return ((hash ^ (hash >> 16)) & (size - 1));
+}
+
+static
+int find_seed(unsigned size, uint32_t *seed, int *slots)
+{
+    unsigned index;
+    uint32_t s;
+    int i;
+
+    for (s = 0; s < MAX_SEED; ++s)
+    {
+        for (i = 0; i < (int)size; ++i)
+        {
+            slots[i] = -1;
+        }
+        for (i = 0; i < g_count; ++i)
+        {
+            index = head_hash(s, g_heads[i].name, g_heads[i].len, size);
+            if (slots[index] >= 0)
+            {
+                break;
+            }
+            slots[index] = i;
+        }
+        if (i == g_count)
+        {
+            *seed = s;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static
+void write_table(FILE *fp, uint32_t seed, unsigned size, const int *slots)
+{
+    int min_len;
+    int max_len;
+    unsigned i;
+    int j;
+
+    min_len = g_heads[0].len;
+    max_len = g_heads[0].len;
+    for (j = 1; j < g_count; ++j)
+    {
+        if (g_heads[j].len < min_len)
+        {
+            min_len = g_heads[j].len;
+        }
+        if (g_heads[j].len > max_len)
+        {
+            max_len = g_heads[j].len;
+        }
+    }
+
+    fprintf(fp, "#define RTSP_HEAD_HASH_SEED %u\n", seed);
+    fprintf(fp, "#define RTSP_HEAD_HASH_SIZE %u\n", size);
+    fprintf(fp, "#define RTSP_HEAD_NAME_MIN_LEN %d\n", min_len);
+    fprintf(fp, "#define RTSP_HEAD_NAME_MAX_LEN %d\n", max_len);
+    fprintf(fp, "\n");
+    fprintf(fp, "static const struct rtsp_head_hash_entry\n");
+    fprintf(fp, "{\n");
+    fprintf(fp, "    const char *name;\n");
+    fprintf(fp, "    int len;\n");
+    fprintf(fp, "    rtsp_head_key_e key;\n");
+    fprintf(fp, "} head_key_hash_table[RTSP_HEAD_HASH_SIZE] = {\n");
+    for (i = 0; i < size; ++i)
+    {
+        if (slots[i] < 0)
+        {
+            fprintf(fp, "    {NULL, 0, RTSP_HEAD_EXTENSION},\n");
+        }
+        else
+        {
+            fprintf(fp, "    {\"%s\", %d, %s},\n", g_heads[slots[i]].name, g_heads[slots[i]].len, g_heads[slots[i]].key);
+        }
+    }
+    fprintf(fp, "};");
+
+    return;
+}
+
+/* 替换 source 中从 "#define RTSP_HEAD_HASH_SEED" 到其后第一个 "};" 的部分 */
+static
+int update_source(const char *path, const char *source, uint32_t seed, unsigned size, const int *slots)
+{
+    const char *start;
+    const char *end;
+    FILE *fp;
+
+    start = strstr(source, "#define RTSP_HEAD_HASH_SEED");
+    end = (NULL == start) ? NULL : strstr(start, "};");
+    if (NULL == end)
+    {
+        fprintf(stderr, "hash table not found in %s\n", path);
+        return -1;
+    }
+    end += 2;
+
+    fp = fopen(path, "wb");
+    if (NULL == fp)
+    {
+        fprintf(stderr, "failed to write %s\n", path);
+        return -1;
+    }
+    fwrite(source, 1, start - source, fp);
+    write_table(fp, seed, size, slots);
+    fwrite(end, 1, strlen(end), fp);
+    fclose(fp);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static int slots[MAX_HEADS * 4];
+    char *header;
+    char *source;
+    long size;
+    int key_count;
+    uint32_t seed;
+    unsigned table_size;
+    int ret;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <rtsp_message_codec.h> <rtsp_message_codec.c> [-stdout]\n", argv[0]);
+        return 1;
+    }
+
+    header = read_file(argv[1], &size);
+    source = read_file(argv[2], &size);
+    if (NULL == header || NULL == source)
+    {
+        return 1;
+    }
+
+    key_count = parse_keys(header);
+    g_count = parse_names(source);
+    if (key_count <= 0 || g_count != key_count)
+    {
+        fprintf(stderr, "rtsp_head_key_e has %d keys but head_key_prefix has %d names\n", key_count, g_count);
+        return 1;
+    }
+
+    for (table_size = 1; table_size < (unsigned)g_count * 2; table_size <<= 1)
+    {
+    }
+
+    for (; table_size <= MAX_HEADS * 4; table_size <<= 1)
+    {
+        if (0 == find_seed(table_size, &seed, slots))
+        {
+            break;
+        }
+    }
+    if (table_size > MAX_HEADS * 4)
+    {
+        fprintf(stderr, "no perfect hash seed found\n");
+        return 1;
+    }
+
+    if (argc > 3 && strcmp(argv[3], "-stdout") == 0)
+    {
+        write_table(stdout, seed, table_size, slots);
+        printf("\n");
+        ret = 0;
+    }
+    else
+    {
+        ret = update_source(argv[2], source, seed, table_size, slots);
+    }
+
+    free(header);
+    free(source);
+
+    return (0 == ret) ? 0 : 1;
+}